@@ -65,7 +65,8 @@ class Backend {
         corelib(P4::P4CoreLibrary::instance), json(new BMV2::JsonObjects()) {
         refMap->setIsV1(options.isv1());
         }
-    void serialize(std::ostream& out) const { json->toplevel->serialize(out); }
+    /// Writes the program in one pass, in the format of Util::IJson::serialize
+    void serialize(std::ostream& out) const { Util::JsonWriter(out).value(json->toplevel); }
     virtual void convert(const IR::ToplevelBlock* block) = 0;
 };
 
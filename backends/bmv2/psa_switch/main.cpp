@@ -105,7 +105,8 @@ int main(int argc, char *const argv[]) {
             toplevel->getMain() == nullptr)
             return 1;
         if (options.dumpJsonFile)
-            JSONGenerator(*openFile(options.dumpJsonFile, true), true) << program << std::endl;
+            JSONGenerator(*openFile(options.dumpJsonFile, true), true, options.dumpJsonCompact)
+                << program << std::endl;
     } catch (const Util::P4CExceptionBase &bug) {
         std::cerr << bug.what() << std::endl;
         return 1;
@@ -77,7 +77,8 @@ void compile(EbpfOptions& options) {
     midend.addDebugHook(hook);
     auto toplevel = midend.run(options, program);
     if (options.dumpJsonFile)
-        JSONGenerator(*openFile(options.dumpJsonFile, true)) << program << std::endl;
+        JSONGenerator(*openFile(options.dumpJsonFile, true), false, options.dumpJsonCompact)
+            << program << std::endl;
     if (::errorCount() > 0)
         return;
 
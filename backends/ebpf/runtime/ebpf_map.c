@@ -89,3 +89,105 @@ int bpf_map_delete_map(struct bpf_map *map) {
     free(map);
     return EXIT_SUCCESS;
 }
+
+struct bpf_shared_map *bpf_shared_map_create() {
+    struct bpf_shared_map *map = calloc(1, sizeof(struct bpf_shared_map));
+    if (!map) {
+        perror("Fatal: Could not allocate memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < BPF_MAP_SHARDS; i++)
+        pthread_rwlock_init(&map->shards[i].lock, NULL);
+    return map;
+}
+
+/* Keep @ptr until the map is deleted; the shard must be locked for writing */
+static void retire(struct bpf_retired **retired, void *ptr) {
+    struct bpf_retired *entry = malloc(sizeof(struct bpf_retired));
+    entry->ptr = ptr;
+    entry->next = *retired;
+    *retired = entry;
+}
+
+void *bpf_shared_map_lookup_elem(struct bpf_shared_map *map, void *key, unsigned int key_size) {
+    unsigned hashv;
+    struct bpf_map *tmp_map;
+    HASH_VALUE(key, key_size, hashv);
+    /* The low bits of the hash select the bucket within the shard */
+    unsigned shard = (hashv >> 24) % BPF_MAP_SHARDS;
+    pthread_rwlock_rdlock(&map->shards[shard].lock);
+    HASH_FIND_BYHASHVALUE(hh, map->shards[shard].map, key, key_size, hashv, tmp_map);
+    void *value = tmp_map ? tmp_map->value : NULL;
+    pthread_rwlock_unlock(&map->shards[shard].lock);
+    return value;
+}
+
+int bpf_shared_map_update_elem(struct bpf_shared_map *map, void *key, unsigned int key_size, void *value, unsigned int value_size, unsigned long long flags) {
+    unsigned hashv;
+    struct bpf_map *tmp_map;
+    HASH_VALUE(key, key_size, hashv);
+    unsigned shard = (hashv >> 24) % BPF_MAP_SHARDS;
+    /* Copy the value before taking the lock */
+    void *new_value = malloc(value_size);
+    memcpy(new_value, value, value_size);
+    pthread_rwlock_wrlock(&map->shards[shard].lock);
+    HASH_FIND_BYHASHVALUE(hh, map->shards[shard].map, key, key_size, hashv, tmp_map);
+    int ret = check_flags(tmp_map, flags);
+    if (ret) {
+        pthread_rwlock_unlock(&map->shards[shard].lock);
+        free(new_value);
+        return ret;
+    }
+    if (tmp_map == NULL) {
+        tmp_map = (struct bpf_map *) malloc(sizeof(struct bpf_map));
+        tmp_map->key = malloc(key_size);
+        memcpy(tmp_map->key, key, key_size);
+        HASH_ADD_KEYPTR_BYHASHVALUE(hh, map->shards[shard].map, tmp_map->key, key_size, hashv, tmp_map);
+    } else {
+        retire(&map->shards[shard].retired, tmp_map->value);
+    }
+    tmp_map->value = new_value;
+    pthread_rwlock_unlock(&map->shards[shard].lock);
+    return EXIT_SUCCESS;
+}
+
+int bpf_shared_map_delete_elem(struct bpf_shared_map *map, void *key, unsigned int key_size) {
+    unsigned hashv;
+    struct bpf_map *tmp_map;
+    HASH_VALUE(key, key_size, hashv);
+    unsigned shard = (hashv >> 24) % BPF_MAP_SHARDS;
+    pthread_rwlock_wrlock(&map->shards[shard].lock);
+    HASH_FIND_BYHASHVALUE(hh, map->shards[shard].map, key, key_size, hashv, tmp_map);
+    if (tmp_map != NULL) {
+        HASH_DEL(map->shards[shard].map, tmp_map);
+        retire(&map->shards[shard].retired, tmp_map->value);
+        retire(&map->shards[shard].retired, tmp_map->key);
+        retire(&map->shards[shard].retired, tmp_map);
+    }
+    pthread_rwlock_unlock(&map->shards[shard].lock);
+    return EXIT_SUCCESS;
+}
+
+int bpf_shared_map_delete_map(struct bpf_shared_map *map) {
+    if (!map)
+        return EXIT_SUCCESS;
+    for (int i = 0; i < BPF_MAP_SHARDS; i++) {
+        struct bpf_map *curr_map, *tmp_map;
+        HASH_ITER(hh, map->shards[i].map, curr_map, tmp_map) {
+            HASH_DEL(map->shards[i].map, curr_map);
+            free(curr_map->value);
+            free(curr_map->key);
+            free(curr_map);
+        }
+        struct bpf_retired *retired = map->shards[i].retired;
+        while (retired) {
+            struct bpf_retired *next = retired->next;
+            free(retired->ptr);
+            free(retired);
+            retired = next;
+        }
+        pthread_rwlock_destroy(&map->shards[i].lock);
+    }
+    free(map);
+    return EXIT_SUCCESS;
+}
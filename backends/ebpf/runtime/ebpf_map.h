@@ -16,14 +16,18 @@ limitations under the License.
 
 /*
  * This file defines a library of simple hashmap operations which emulate the behavior
- * of the kernel ebpf map API. This library is currently not thread-safe.
+ * of the kernel ebpf map API. The bpf_map operations are not thread-safe; the
+ * bpf_shared_map operations may be used by several threads at once.
  */
 
 #ifndef BACKENDS_EBPF_RUNTIME_EBPF_MAP_H_
 #define BACKENDS_EBPF_RUNTIME_EBPF_MAP_H_
 
+#include <pthread.h>
 #include "contrib/uthash.h"  // exports string.h, stddef.h, and stdlib.h
 
+#define BPF_MAP_SHARDS 16  // number of independently locked parts of a shared map
+
 struct bpf_map {
     void *key;
     void *value;
@@ -67,5 +71,37 @@ int bpf_map_delete_elem(struct bpf_map *map, void *key, unsigned int key_size);
  */
 int bpf_map_delete_map(struct bpf_map *map);
 
+/* Memory which may still be referenced by a reader and is freed with its map */
+struct bpf_retired {
+    void *ptr;
+    struct bpf_retired *next;
+};
+
+/**
+ * A map shared by several threads. Keys are spread over BPF_MAP_SHARDS hash
+ * tables, each guarded by its own reader-writer lock, so threads working on
+ * different keys rarely wait for each other. Like the kernel (RCU), an update
+ * or delete never frees memory a reader may still use: a value pointer
+ * returned by a lookup stays valid until the map is deleted. Concurrent
+ * writes through such a pointer are not synchronized, as in the kernel.
+ */
+struct bpf_shared_map {
+    struct {
+        pthread_rwlock_t lock;
+        struct bpf_map *map;
+        struct bpf_retired *retired;
+    } shards[BPF_MAP_SHARDS];
+};
+
+struct bpf_shared_map *bpf_shared_map_create();
+
+void *bpf_shared_map_lookup_elem(struct bpf_shared_map *map, void *key, unsigned int key_size);
+
+int bpf_shared_map_update_elem(struct bpf_shared_map *map, void *key, unsigned int key_size, void *value, unsigned int value_size, unsigned long long flags);
+
+int bpf_shared_map_delete_elem(struct bpf_shared_map *map, void *key, unsigned int key_size);
+
+int bpf_shared_map_delete_map(struct bpf_shared_map *map);
+
 
 #endif  // BACKENDS_EBPF_RUNTIME_EBPF_MAP_H_
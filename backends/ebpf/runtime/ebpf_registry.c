@@ -63,6 +63,8 @@ int registry_add(struct bpf_table *tbl) {
         return EXIT_FAILURE;
     }
     /* Add the table */
+    if (tbl->bpf_map == NULL)
+        tbl->bpf_map = bpf_shared_map_create();
     tmp_reg = malloc(sizeof(registry_entry));
     if (!tmp_reg) {
         perror("Fatal: Could not allocate memory\n");
@@ -83,7 +85,8 @@ void registry_delete() {
     registry_entry *curr_tbl, *tmp_tbl;
     HASH_ITER(h_name, reg_tables_name, curr_tbl, tmp_tbl) {
         HASH_DELETE(h_name, reg_tables_name, curr_tbl);
-        bpf_map_delete_map(curr_tbl->tbl->bpf_map);
+        bpf_shared_map_delete_map(curr_tbl->tbl->bpf_map);
+        curr_tbl->tbl->bpf_map = NULL;
         free(curr_tbl);
     }
     curr_tbl = NULL;
@@ -96,7 +99,8 @@ void registry_delete() {
 int registry_delete_tbl(const char *name) {
     registry_entry *tmp_reg = find_register(name);
     if (tmp_reg != NULL) {
-        bpf_map_delete_map(tmp_reg->tbl->bpf_map);
+        bpf_shared_map_delete_map(tmp_reg->tbl->bpf_map);
+        tmp_reg->tbl->bpf_map = NULL;
         HASH_DELETE(h_name, reg_tables_name, tmp_reg);
         HASH_DELETE(h_id, reg_tables_id, tmp_reg);
         free(tmp_reg);
@@ -125,7 +129,7 @@ int registry_update_table(const char *name, void *key, void *value, unsigned lon
     if (tmp_tbl == NULL)
         /* not found, return */
         return EXIT_FAILURE;
-    bpf_map_update_elem(&tmp_tbl->bpf_map, key, tmp_tbl->key_size, value, tmp_tbl->value_size, flags);
+    bpf_shared_map_update_elem(tmp_tbl->bpf_map, key, tmp_tbl->key_size, value, tmp_tbl->value_size, flags);
     return EXIT_SUCCESS;
 }
 
@@ -134,7 +138,7 @@ int registry_update_table_id(int tbl_id, void *key, void *value, unsigned long l
     if (tmp_tbl == NULL)
         /* not found, return */
         return EXIT_FAILURE;
-    bpf_map_update_elem(&tmp_tbl->bpf_map, key, tmp_tbl->key_size, value, tmp_tbl->value_size, flags);
+    bpf_shared_map_update_elem(tmp_tbl->bpf_map, key, tmp_tbl->key_size, value, tmp_tbl->value_size, flags);
     return EXIT_SUCCESS;
 }
 
@@ -143,8 +147,7 @@ void *registry_lookup_table_elem(const char *name, void *key) {
     if (tmp_tbl == NULL)
         /* not found, return */
         return NULL;
-    if (tmp_tbl->bpf_map)
-    return bpf_map_lookup_elem(tmp_tbl->bpf_map, key, tmp_tbl->key_size);
+    return bpf_shared_map_lookup_elem(tmp_tbl->bpf_map, key, tmp_tbl->key_size);
 }
 
 void *registry_lookup_table_elem_id(int tbl_id, void *key) {
@@ -152,8 +155,7 @@ void *registry_lookup_table_elem_id(int tbl_id, void *key) {
     if (tmp_tbl == NULL)
         /* not found, return */
         return NULL;
-    if (tmp_tbl->bpf_map)
-    return bpf_map_lookup_elem(tmp_tbl->bpf_map, key, tmp_tbl->key_size);
+    return bpf_shared_map_lookup_elem(tmp_tbl->bpf_map, key, tmp_tbl->key_size);
 }
 
 int registry_get_id(const char *name) {
@@ -18,7 +18,8 @@ limitations under the License.
  * This file defines a shared registry. It is required by the p4c-ebpf test framework
  * and acts as an interface between the emulated control and data plane. It provides
  * a mechanism to access shared tables by name or id and is intended to approximate the
- * kernel ebpf object API as closely as possible. This library is currently not thread-safe.
+ * kernel ebpf object API as closely as possible. Tables must be added and deleted by a
+ * single thread; their entries may be looked up and updated by several threads at once.
  */
 
 #ifndef BACKENDS_EBPF_RUNTIME_EBPF_REGISTRY_H_
@@ -33,7 +34,7 @@ limitations under the License.
  * @details This structure describes various properties of the ebpf table
  * such as key and value size and the maximum amount of entries possible.
  * In userspace, this space is theoretically unlimited.
- * This table definition points to an actual hashmap managed by uthash,
+ * This table definition points to an actual (sharded) hashmap managed by uthash,
  * the relation is many-to-one.
  * "name" should not exceed VAR_SIZE. Functions using bpf_table also assume
  * that "name" is a conventional null-terminated string.
@@ -44,7 +45,7 @@ struct bpf_table {
     unsigned int key_size;      // size of the key structure
     unsigned int value_size;    // size of the value structure
     unsigned int max_entries;   // Maximum of possible entries
-    struct bpf_map *bpf_map;    // Pointer to the actual hash map
+    struct bpf_shared_map *bpf_map;  // Pointer to the actual hash map
 };
 
 /**
@@ -99,7 +100,7 @@ int registry_get_id(const char *name);
  * @brief Insert a key/value pair into the hashmap.
  * @details A safe wrapper function to update a bpf map.
  * If the map can be found and exists, this function calls
- * the bpf_map_update_elem function to insert an entry.
+ * the bpf_shared_map_update_elem function to insert an entry.
  * This operation uses a char name as the key.
  * @return EXIT_FAILURE if map cannot be found.
  */
@@ -109,7 +110,7 @@ int registry_update_table(const char *name, void *key, void *value, unsigned lon
  * @brief Insert a key/value pair into the hashmap.
  * @details A safe wrapper function to update a bpf map.
  * If the map can be found and exists, this function calls
- * the bpf_map_update_elem function to insert an entry.
+ * the bpf_shared_map_update_elem function to insert an entry.
  * This operation uses an integer as the key.
  * @return EXIT_FAILURE if map cannot be found.
  */
@@ -119,7 +120,7 @@ int registry_update_table_id(int tbl_id, void *key, void *value, unsigned long l
  * @brief Retrieve a value from a bpf map through the registry.
  * @details A wrapper function to retrieve a value from a hash map
  * where only the name is known. The function looks up the identifier
- * in the registry and calls bpf_map_lookup_elem on the retrieved list.
+ * in the registry and calls bpf_shared_map_lookup_elem on the retrieved list.
  * If there is no table, this function also returns NULL.
  * This operation uses a char name as the key.
  * @return NULL if the value cannot be found.
@@ -130,7 +131,7 @@ void *registry_lookup_table_elem(const char *name, void *key);
  * @brief Retrieve a value from a bpf map through the registry.
  * @details A wrapper function to retrieve a value from a hash map
  * where only the name is known. The function looks up the identifier
- * in the registry and calls bpf_map_lookup_elem on the retrieved list.
+ * in the registry and calls bpf_shared_map_lookup_elem on the retrieved list.
  * If there is no table, this function also returns NULL.
  * This operation uses an integer as the key.
  * @return NULL if the value cannot be found.
@@ -33,7 +33,11 @@ limitations under the License.
 #define PCAPIN  "_in.pcap"
 #define DELIM   '_'
 
+#define DEFAULT_BATCH_SIZE 64
+
 static int debug = 0;
+static int num_threads = 0;     // 0: process all packets on the main thread
+static uint32_t batch_size = DEFAULT_BATCH_SIZE;
 
 void usage(char *name) {
     fprintf(stderr, "This program expects a pcap file pattern, "
@@ -41,35 +45,38 @@ void usage(char *name) {
             "in the order given by the packet time,"
             "then feeds the individual packets into a filter function, "
             "and returns the output.\n");
-    fprintf(stderr, "Usage: %s [-d] -f file.pcap -n num_pcaps\n", name);
+    fprintf(stderr, "Usage: %s [-d] [-t num_threads [-b batch_size]] "
+            "-f file.pcap -n num_pcaps\n", name);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "\t-d: Turn on debug messages\n");
     fprintf(stderr, "\t-f: The input pcap file\n");
     fprintf(stderr, "\t-n: Specifies the number of input pcap files\n");
+    fprintf(stderr, "\t-t: Process the packets on the given number of threads "
+            "and report the packets per second\n");
+    fprintf(stderr, "\t-b: Number of packets a thread processes at a time "
+            "(default %d)\n", DEFAULT_BATCH_SIZE);
     exit(EXIT_FAILURE);
 }
 
-static pcap_list_t *get_packets(const char *pcap_base, uint16_t num_pcaps, pcap_list_t *merged_list) {
-    pcap_list_array_t *tmp_list_array = allocate_pkt_list_array();
-    /* Retrieve a list for each file and append it to the temporary array */
+static pcap_list_t *get_packets(const char *pcap_base, uint16_t num_pcaps) {
+    const char *pcap_in_names[num_pcaps];
     for (uint16_t i = 0; i < num_pcaps; i++) {
-        char *pcap_in_name = generate_pcap_name(pcap_base, i, PCAPIN);
+        pcap_in_names[i] = generate_pcap_name(pcap_base, i, PCAPIN);
         if (debug)
-            printf("Processing input file: %s\n", pcap_in_name);
-        pcap_list_t *pkt_list = read_pkts_from_pcap(pcap_in_name, i);
-        tmp_list_array = insert_list(tmp_list_array, pkt_list, i);
-        free(pcap_in_name);
+            printf("Processing input file: %s\n", pcap_in_names[i]);
     }
-    /* Merge the array into a newly allocated list. This destroys the array. */
-    return merge_and_delete_lists(tmp_list_array, merged_list);
+    /* Map the files and merge their packets by time into a single list */
+    pcap_list_t *merged_list = read_and_merge_pcaps(pcap_in_names, num_pcaps);
+    for (uint16_t i = 0; i < num_pcaps; i++)
+        free((char *) pcap_in_names[i]);
+    if (merged_list == NULL)
+        exit(EXIT_FAILURE);
+    return merged_list;
 }
 
 void launch_runtime(const char *pcap_name, uint16_t num_pcaps) {
     if (num_pcaps == 0)
         return;
-    /* Initialize the list of input packets */
-    pcap_list_t *input_list = allocate_pkt_list();
-
     /* Create the basic pcap filename from the input */
     const char *suffix = strrchr(pcap_name, DELIM);
     if (suffix == NULL) {
@@ -82,11 +89,9 @@ void launch_runtime(const char *pcap_name, uint16_t num_pcaps) {
     snprintf(pcap_base, baselen + 1 , "%s", pcap_name);
 
     /* Open all matching pcap files retrieve a merged list of packets */
-    input_list = get_packets(pcap_base, num_pcaps, input_list);
-    /* Sort the list */
-    sort_pcap_list(input_list);
+    pcap_list_t *input_list = get_packets(pcap_base, num_pcaps);
     /* Run the "program" and retrieve output lists */
-    RUN(ebpf_filter, pcap_base, num_pcaps, input_list, debug);
+    RUN(ebpf_filter, pcap_base, num_pcaps, input_list, num_threads, batch_size, debug);
     /* Delete the list of input packets */
     delete_list(input_list);
 }
@@ -97,7 +102,7 @@ int main(int argc, char **argv) {
     int c;
     opterr = 0;
 
-    while ((c = getopt (argc, argv, "dn:f:")) != -1) {
+    while ((c = getopt (argc, argv, "dn:f:t:b:")) != -1) {
         switch (c) {
             case 'd':
             debug = 1;
@@ -114,6 +119,24 @@ int main(int argc, char **argv) {
             case 'f':
                 pcap_name = optarg;
             break;
+            case 't':
+                num_threads = (int)strtol(optarg, (char **)NULL, 10);
+                if (num_threads < 1 || num_threads > UINT16_MAX) {
+                    fprintf(stderr,
+                        "Number of threads out of bounds! Maximum is %d\n",
+                        UINT16_MAX);
+                    return EXIT_FAILURE;
+                }
+            break;
+            case 'b': {
+                long size = strtol(optarg, (char **)NULL, 10);
+                if (size < 1 || size > UINT32_MAX) {
+                    fprintf(stderr, "Batch size out of bounds!\n");
+                    return EXIT_FAILURE;
+                }
+                batch_size = size;
+            }
+            break;
             case '?':
                 if (optopt == 'f')
                     fprintf(stderr, "The input trace file is missing. "
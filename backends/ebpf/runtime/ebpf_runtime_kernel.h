@@ -29,7 +29,7 @@ limitations under the License.
 
 void run_and_record_output(pcap_list_t *pkt_list, char *pcap_base, uint16_t num_pcaps, int debug);
 
-#define RUN(ebpf_filter, pcap_base, num_pcaps, input_list, debug) \
+#define RUN(ebpf_filter, pcap_base, num_pcaps, input_list, num_threads, batch_size, debug) \
     run_and_record_output(input_list, pcap_base, num_pcaps, debug)
 #define INIT_EBPF_TABLES(debug)
 #define DELETE_EBPF_TABLES(debug)
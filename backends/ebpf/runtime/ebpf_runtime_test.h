@@ -28,12 +28,12 @@ limitations under the License.
 
 typedef int (*packet_filter)(SK_BUFF* s);
 
-void *run_and_record_output(packet_filter ebpf_filter, const char *pcap_base, pcap_list_t *pkt_list, int debug);
+void *run_and_record_output(packet_filter ebpf_filter, const char *pcap_base, pcap_list_t *pkt_list, int num_threads, uint32_t batch_size, int debug);
 void init_ebpf_tables(int debug);
 void delete_ebpf_tables(int debug);
 
-#define RUN(ebpf_filter, pcap_base, num_pcaps, input_list, debug) \
-    run_and_record_output(ebpf_filter, pcap_base, input_list, debug)
+#define RUN(ebpf_filter, pcap_base, num_pcaps, input_list, num_threads, batch_size, debug) \
+    run_and_record_output(ebpf_filter, pcap_base, input_list, num_threads, batch_size, debug)
 #define INIT_EBPF_TABLES(debug) init_ebpf_tables(debug)
 #define DELETE_EBPF_TABLES(debug) delete_ebpf_tables(debug)
 
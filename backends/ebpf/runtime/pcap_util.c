@@ -16,18 +16,55 @@ limitations under the License.
 
 #include <stdlib.h>     // EXIT_SUCCESS, EXIT_FAILURE
 #include <string.h>     // memcpy()
+#include <fcntl.h>      // open()
+#include <unistd.h>     // close()
+#include <sys/mman.h>   // mmap()
+#include <sys/stat.h>   // fstat()
 #include "pcap_util.h"
 
 #define DLT_EN10MB 1        // Ethernet Link Type, see also 'man pcap-linktype'
 
+/* Magic numbers of the classic pcap file format */
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+#define PCAP_FILE_HDR_LEN 24
+#define PCAP_RECORD_HDR_LEN 16
+
+/* Packet descriptors are allocated in blocks of this many packets */
+#define PKT_BLOCK_LEN 4096
+
+/* Memory holding packets which were not allocated one by one:
+   a capture file mapped into memory, or a block of packet descriptors.
+ */
+struct pcap_backing {
+    void *addr;
+    size_t length;      // Length of the mapping, 0 if allocated by malloc()
+    struct pcap_backing *next;
+};
 
 /* Dynamically-allocated list of packets.
+   If the list has a backing, its packets are views into the backing and
+   are released together with it rather than one by one.
  */
 struct pcap_list {
     pcap_pkt **pkts;
     uint32_t len;
+    uint32_t capacity;
+    struct pcap_backing *backing;
 };
 
+/* A capture file whose records are read one at a time */
+typedef struct {
+    unsigned char *next;        // The next record in the file
+    unsigned char *end;
+    int swapped;                // Written with the other byte order
+    int nsec;                   // Timestamps are in nanoseconds
+    int unordered;              // A record was older than its predecessor
+    iface_index ifindex;
+    struct pcap_pkthdr hdr;     // Header of the current record
+    char *data;                 // Data of the current record, NULL at the end
+} pcap_source;
+
 /* An array of lists of packets */
 struct pcap_list_array {
     pcap_list_t **lists;
@@ -38,14 +75,18 @@ pcap_list_t *append_packet(pcap_list_t *pkt_list, pcap_pkt *pkt) {
     if (!pkt_list)
         /* If the list is not allocated yet, create it */
         pkt_list = allocate_pkt_list();
-    pkt_list->len++;
-    pkt_list->pkts = realloc(pkt_list->pkts, pkt_list->len * sizeof(pcap_pkt *));
-    if (pkt_list->pkts == NULL) {
-        fprintf(stderr, "Fatal: Failed to expand the"
-            "packet list with size %u !\n", pkt_list->len);
-        exit(EXIT_FAILURE);
+    if (pkt_list->len == pkt_list->capacity) {
+        /* Double the capacity, so appending takes constant amortized time */
+        pkt_list->capacity = pkt_list->capacity ? 2 * pkt_list->capacity : 16;
+        pkt_list->pkts = realloc(pkt_list->pkts,
+            pkt_list->capacity * sizeof(pcap_pkt *));
+        if (pkt_list->pkts == NULL) {
+            fprintf(stderr, "Fatal: Failed to expand the"
+                "packet list with size %u !\n", pkt_list->len);
+            exit(EXIT_FAILURE);
+        }
     }
-    pkt_list->pkts[pkt_list->len - 1] = pkt;
+    pkt_list->pkts[pkt_list->len++] = pkt;
     return pkt_list;
 }
 
@@ -105,12 +146,38 @@ pcap_list_array_t *allocate_pkt_list_array() {
     return pkt_list_arr;
 }
 
+static void add_backing(pcap_list_t *pkt_list, void *addr, size_t length) {
+    struct pcap_backing *backing = malloc(sizeof(struct pcap_backing));
+    if (backing == NULL) {
+        fprintf(stderr, "Fatal: Failed to allocate a packet backing!\n");
+        exit(EXIT_FAILURE);
+    }
+    backing->addr = addr;
+    backing->length = length;
+    backing->next = pkt_list->backing;
+    pkt_list->backing = backing;
+}
+
 void delete_list(pcap_list_t *pkt_list) {
-    for(uint32_t i = 0; i < pkt_list->len; i++) {
-        free(pkt_list->pkts[i]->data);
-        /* Set the data pointer to NULL, to mitigate duplicate frees */
-        pkt_list->pkts[i]->data = NULL;
-        free(pkt_list->pkts[i]);
+    if (pkt_list->backing) {
+        /* The packets are views, release the memory they point into */
+        struct pcap_backing *backing = pkt_list->backing;
+        while (backing) {
+            struct pcap_backing *next = backing->next;
+            if (backing->length)
+                munmap(backing->addr, backing->length);
+            else
+                free(backing->addr);
+            free(backing);
+            backing = next;
+        }
+    } else {
+        for(uint32_t i = 0; i < pkt_list->len; i++) {
+            free(pkt_list->pkts[i]->data);
+            /* Set the data pointer to NULL, to mitigate duplicate frees */
+            pkt_list->pkts[i]->data = NULL;
+            free(pkt_list->pkts[i]);
+        }
     }
     free(pkt_list->pkts);
     free(pkt_list);
@@ -124,33 +191,245 @@ void delete_array(pcap_list_array_t *pkt_list_array) {
     free(pkt_list_array);
 }
 
-pcap_list_t *read_pkts_from_pcap(const char *pcap_file_name, iface_index index) {
+/* Read the capture file through libpcap and write its packets to memory in
+   the classic pcap format, for formats the mapped reader does not know. */
+static unsigned char *copy_pcap_file(const char *pcap_file_name, size_t *length) {
     struct pcap_pkthdr *pcap_hdr;
     const unsigned char *tmp_pkt;
     char errbuf[PCAP_ERRBUF_SIZE];
     int ret;
-    pcap_t *in_handle;
-    in_handle = pcap_open_offline(pcap_file_name, errbuf);
+    pcap_t *in_handle = pcap_open_offline(pcap_file_name, errbuf);
     if (in_handle == NULL) {
         fprintf(stderr, "Failed to open pcap file! %s \n", pcap_file_name );
-        perror("pcap_open_offline");
+        fprintf(stderr, "pcap_open_offline: %s\n", errbuf);
         return NULL;
     }
-    pcap_list_t *pkt_list = allocate_pkt_list();
-    /* Fill the packet list with packets */
+    size_t capacity = 1 << 16;
+    unsigned char *buf = malloc(capacity);
+    if (buf == NULL) {
+        fprintf(stderr, "Fatal: Failed to copy the pcap file %s!\n", pcap_file_name);
+        exit(EXIT_FAILURE);
+    }
+    /* Only the magic number and the records are read back */
+    uint32_t file_hdr[PCAP_FILE_HDR_LEN / 4] = { PCAP_MAGIC_USEC, 2 | (4 << 16), 0, 0,
+                                                 UINT16_MAX, DLT_EN10MB };
+    memcpy(buf, file_hdr, PCAP_FILE_HDR_LEN);
+    *length = PCAP_FILE_HDR_LEN;
     while ((ret = pcap_next_ex(in_handle, &pcap_hdr, &tmp_pkt)) == 1) {
-        /* Save the data we extracted from the pcap buffer */
-        pcap_pkt *pkt = calloc(1, sizeof(pcap_pkt));
-        pkt->data = calloc(pcap_hdr->len, 1);
-        memcpy(pkt->data, tmp_pkt, pcap_hdr->len);
-        /* Also save the header and the interface "index" */
-        pkt->pcap_hdr = *pcap_hdr;
-        pkt->ifindex = index;
-        pkt_list = append_packet(pkt_list, pkt);
+        size_t record_len = PCAP_RECORD_HDR_LEN + pcap_hdr->caplen;
+        if (*length + record_len > capacity) {
+            while (*length + record_len > capacity)
+                capacity *= 2;
+            buf = realloc(buf, capacity);
+            if (buf == NULL) {
+                fprintf(stderr, "Fatal: Failed to copy the pcap file %s!\n", pcap_file_name);
+                exit(EXIT_FAILURE);
+            }
+        }
+        uint32_t record_hdr[PCAP_RECORD_HDR_LEN / 4] = {
+            pcap_hdr->ts.tv_sec, pcap_hdr->ts.tv_usec, pcap_hdr->caplen, pcap_hdr->len };
+        memcpy(buf + *length, record_hdr, PCAP_RECORD_HDR_LEN);
+        memcpy(buf + *length + PCAP_RECORD_HDR_LEN, tmp_pkt, pcap_hdr->caplen);
+        *length += record_len;
     }
     if (ret == -1)
         pcap_perror(in_handle, "Error: Failed to parse data");
     pcap_close(in_handle);
+    return buf;
+}
+
+static uint32_t read_uint32(const pcap_source *source, const unsigned char *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return source->swapped ? __builtin_bswap32(value) : value;
+}
+
+/* Rank timestamps, earlier first */
+static int compare_time(const struct timeval *t1, const struct timeval *t2) {
+    if (t1->tv_sec != t2->tv_sec)
+        return t1->tv_sec < t2->tv_sec ? -1 : 1;
+    if (t1->tv_usec != t2->tv_usec)
+        return t1->tv_usec < t2->tv_usec ? -1 : 1;
+    return 0;
+}
+
+/* Advance to the next record of the file; sets data to NULL at the end */
+static void next_record(pcap_source *source) {
+    size_t left = source->end - source->next;
+    int first = source->data == NULL;
+    source->data = NULL;
+    if (left == 0)
+        return;
+    if (left < PCAP_RECORD_HDR_LEN) {
+        fprintf(stderr, "Error: Truncated packet header in the pcap file\n");
+        return;
+    }
+    struct pcap_pkthdr hdr;
+    uint32_t frac = read_uint32(source, source->next + 4);
+    hdr.ts.tv_sec = read_uint32(source, source->next);
+    hdr.ts.tv_usec = source->nsec ? frac / 1000 : frac;
+    hdr.caplen = read_uint32(source, source->next + 8);
+    hdr.len = read_uint32(source, source->next + 12);
+    if (hdr.caplen > left - PCAP_RECORD_HDR_LEN) {
+        fprintf(stderr, "Error: Truncated packet in the pcap file\n");
+        return;
+    }
+    if (!first && compare_time(&hdr.ts, &source->hdr.ts) < 0)
+        source->unordered = 1;
+    source->hdr = hdr;
+    source->data = (char *) source->next + PCAP_RECORD_HDR_LEN;
+    source->next += PCAP_RECORD_HDR_LEN + hdr.caplen;
+}
+
+/* Check the file header of the capture file in memory and start reading it */
+static int start_source(pcap_source *source, unsigned char *addr, size_t length) {
+    uint32_t magic = 0;
+    if (length >= PCAP_FILE_HDR_LEN)
+        memcpy(&magic, addr, sizeof(magic));
+    source->swapped = magic == __builtin_bswap32(PCAP_MAGIC_USEC) ||
+                      magic == __builtin_bswap32(PCAP_MAGIC_NSEC);
+    if (source->swapped)
+        magic = __builtin_bswap32(magic);
+    if (magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC)
+        return EXIT_FAILURE;
+    source->nsec = magic == PCAP_MAGIC_NSEC;
+    source->unordered = 0;
+    source->next = addr + PCAP_FILE_HDR_LEN;
+    source->end = addr + length;
+    source->data = NULL;
+    next_record(source);
+    return EXIT_SUCCESS;
+}
+
+/* Map the capture file into memory and start reading it. The memory is
+   added to the backing of the given list. */
+static int open_source(pcap_source *source, const char *pcap_file_name,
+                       iface_index index, pcap_list_t *pkt_list) {
+    source->ifindex = index;
+    int fd = open(pcap_file_name, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Failed to open pcap file! %s \n", pcap_file_name );
+        perror("open");
+        if (fd >= 0)
+            close(fd);
+        return EXIT_FAILURE;
+    }
+    size_t length = st.st_size;
+    /* The mapping is private and writable, so that filters can rewrite
+       packets in place without changing the file */
+    void *addr = length ? mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+                        : MAP_FAILED;
+    close(fd);
+    if (addr != MAP_FAILED) {
+        madvise(addr, length, MADV_SEQUENTIAL);
+        if (start_source(source, addr, length) == EXIT_SUCCESS) {
+            add_backing(pkt_list, addr, length);
+            return EXIT_SUCCESS;
+        }
+        munmap(addr, length);
+    }
+    /* Not a classic pcap file, let libpcap read it */
+    addr = copy_pcap_file(pcap_file_name, &length);
+    if (addr == NULL)
+        return EXIT_FAILURE;
+    add_backing(pkt_list, addr, 0);
+    return start_source(source, addr, length);
+}
+
+/* Order sources by the time of their current packet, then by interface */
+static int source_before(const pcap_source *s1, const pcap_source *s2) {
+    int order = compare_time(&s1->hdr.ts, &s2->hdr.ts);
+    return order < 0 || (order == 0 && s1->ifindex < s2->ifindex);
+}
+
+static void sift_down(pcap_source **heap, uint16_t len, uint16_t i) {
+    for (;;) {
+        uint32_t first = i;
+        uint32_t left = 2 * i + 1;
+        if (left < len && source_before(heap[left], heap[first]))
+            first = left;
+        if (left + 1 < len && source_before(heap[left + 1], heap[first]))
+            first = left + 1;
+        if (first == i)
+            return;
+        pcap_source *tmp = heap[i];
+        heap[i] = heap[first];
+        heap[first] = tmp;
+        i = first;
+    }
+}
+
+/* Append the packets of the sources to the list, always taking the earliest
+   current packet of all sources. Returns 1 if a source was not ordered by
+   time, in which case the list is not ordered either. */
+static int merge_sources(pcap_source *sources, uint16_t num_sources, pcap_list_t *pkt_list) {
+    pcap_source **heap = malloc(num_sources * sizeof(pcap_source *));
+    uint16_t heap_len = 0;
+    for (uint16_t i = 0; i < num_sources; i++)
+        if (sources[i].data)
+            heap[heap_len++] = &sources[i];
+    for (int i = heap_len / 2 - 1; i >= 0; i--)
+        sift_down(heap, heap_len, i);
+
+    pcap_pkt *block = NULL;
+    uint32_t block_left = 0;
+    while (heap_len > 0) {
+        pcap_source *source = heap[0];
+        if (block_left == 0) {
+            block = malloc(PKT_BLOCK_LEN * sizeof(pcap_pkt));
+            if (block == NULL) {
+                fprintf(stderr, "Fatal: Failed to allocate packets!\n");
+                exit(EXIT_FAILURE);
+            }
+            add_backing(pkt_list, block, 0);
+            block_left = PKT_BLOCK_LEN;
+        }
+        /* The packet points into the file, its data is not copied */
+        pcap_pkt *pkt = block++;
+        block_left--;
+        pkt->data = source->data;
+        pkt->pcap_hdr = source->hdr;
+        pkt->ifindex = source->ifindex;
+        append_packet(pkt_list, pkt);
+        next_record(source);
+        if (source->data == NULL)
+            heap[0] = heap[--heap_len];
+        sift_down(heap, heap_len, 0);
+    }
+    free(heap);
+
+    int unordered = 0;
+    for (uint16_t i = 0; i < num_sources; i++)
+        unordered |= sources[i].unordered;
+    return unordered;
+}
+
+pcap_list_t *read_pkts_from_pcap(const char *pcap_file_name, iface_index index) {
+    pcap_source source;
+    pcap_list_t *pkt_list = allocate_pkt_list();
+    if (open_source(&source, pcap_file_name, index, pkt_list) != EXIT_SUCCESS) {
+        delete_list(pkt_list);
+        return NULL;
+    }
+    merge_sources(&source, 1, pkt_list);
+    return pkt_list;
+}
+
+pcap_list_t *read_and_merge_pcaps(const char **pcap_file_names, uint16_t num_pcaps) {
+    pcap_source *sources = malloc(num_pcaps * sizeof(pcap_source));
+    pcap_list_t *pkt_list = allocate_pkt_list();
+    for (uint16_t i = 0; i < num_pcaps; i++) {
+        if (open_source(&sources[i], pcap_file_names[i], i, pkt_list) != EXIT_SUCCESS) {
+            free(sources);
+            delete_list(pkt_list);
+            return NULL;
+        }
+    }
+    if (merge_sources(sources, num_pcaps, pkt_list))
+        /* The merge relies on ordered files, sort the others */
+        sort_pcap_list(pkt_list);
+    free(sources);
     return pkt_list;
 }
 
@@ -183,6 +462,14 @@ pcap_list_t *merge_and_delete_lists(pcap_list_array_t *array, pcap_list_t *merge
             for (uint32_t j = 0; j < array->lists[i]->len; j++)
                 merged_list = append_packet(
                     merged_list, array->lists[i]->pkts[j]);
+        /* The merged list now owns the memory the packets point into */
+        struct pcap_backing *backing = array->lists[i]->backing;
+        while (backing) {
+            struct pcap_backing *next = backing->next;
+            backing->next = merged_list->backing;
+            merged_list->backing = backing;
+            backing = next;
+        }
         /* We do not need the previous list anymore */
         free(array->lists[i]->pkts);
         free(array->lists[i]);
@@ -221,7 +508,8 @@ pcap_list_array_t *split_and_delete_list(pcap_list_t *input_list, pcap_list_arra
 
 pcap_pkt *copy_pkt(pcap_pkt *src_pkt) {
     pcap_pkt *new_pkt = malloc(sizeof(pcap_pkt));
-    uint32_t datalen = src_pkt->pcap_hdr.len;
+    /* Only the captured part of the packet is stored */
+    uint32_t datalen = src_pkt->pcap_hdr.caplen;
     new_pkt->data = malloc(datalen);
     memcpy(new_pkt->data, src_pkt->data, datalen);
     new_pkt->pcap_hdr = src_pkt->pcap_hdr;
@@ -230,15 +518,41 @@ pcap_pkt *copy_pkt(pcap_pkt *src_pkt) {
 }
 
 /* Rank packets based on the timestamp of the pcap header */
-static int compare_pkt_time(const void *s1, const void *s2) {
-  pcap_pkt *p1 = *(pcap_pkt **)s1;
-  pcap_pkt *p2 = *(pcap_pkt **)s2;
-  return p1->pcap_hdr.ts.tv_usec - p2->pcap_hdr.ts.tv_usec;
+static int compare_pkt_time(const pcap_pkt *p1, const pcap_pkt *p2) {
+    return compare_time(&p1->pcap_hdr.ts, &p2->pcap_hdr.ts);
 }
 
 void sort_pcap_list(pcap_list_t *pkt_list) {
-    /* Sort the master list and return the meta information*/
-    qsort(pkt_list->pkts, pkt_list->len, sizeof(pcap_pkt *), compare_pkt_time);
+    /* A bottom-up merge sort, which keeps packets with the same time in order */
+    uint32_t len = pkt_list->len;
+    pcap_pkt **src = pkt_list->pkts;
+    pcap_pkt **dst = malloc(len * sizeof(pcap_pkt *));
+    if (len > 0 && dst == NULL) {
+        fprintf(stderr, "Fatal: Failed to sort the packet list!\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t width = 1; width < len; width *= 2) {
+        for (uint32_t lo = 0; lo < len; lo += 2 * width) {
+            uint32_t mid = lo + width < len ? lo + width : len;
+            uint32_t hi = mid + width < len ? mid + width : len;
+            uint32_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                dst[k++] = compare_pkt_time(src[j], src[i]) < 0 ? src[j++] : src[i++];
+            while (i < mid)
+                dst[k++] = src[i++];
+            while (j < hi)
+                dst[k++] = src[j++];
+        }
+        pcap_pkt **tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    /* The sorted packets may have ended up in the temporary array */
+    if (src != pkt_list->pkts) {
+        memcpy(pkt_list->pkts, src, len * sizeof(pcap_pkt *));
+        dst = src;
+    }
+    free(dst);
 }
 
 char *generate_pcap_name(const char *pcap_base, int index, const char *suffix) {
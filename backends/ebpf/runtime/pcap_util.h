@@ -48,10 +48,12 @@ typedef struct pcap_list_array pcap_list_array_t;
  * @brief Retrieve packets from a pcap file.
  * @details Retrieves a list of packets from a given pcap file.
  * Allocates a packet list and fills it with the packets from the
- * supplied pcap file. All data in the capture file is copied to the new list.
+ * supplied pcap file. The capture file is mapped into memory and the packets
+ * of the list point into the mapping, their data is not copied. Files which
+ * are not in the classic pcap format are read through libpcap instead.
  * Each packet is assigned the given interface index as meta-information.
  * A list allocated by this function should subsequently be freed by
- * delete_list().
+ * delete_list(), which also releases the mapping.
  *
  * @param pcap_file_name The exact name of the pcap file.
  * @param index Interface index of the file.
@@ -61,6 +63,25 @@ typedef struct pcap_list_array pcap_list_array_t;
  */
 pcap_list_t *read_pkts_from_pcap(const char *pcap_file_name, iface_index index);
 
+/**
+ * @brief Retrieve the packets of several pcap files ordered by time.
+ * @details Maps the given pcap files into memory like read_pkts_from_pcap()
+ * and merges their packets into a single list in one pass, always taking the
+ * earliest next packet of all files. Packets with the same timestamp are
+ * ordered by interface, then by their order in the file. The packets of the
+ * i-th file are assigned the interface index i. Files whose packets are not
+ * ordered by time are supported, but then the list is sorted afterwards.
+ * A list allocated by this function should subsequently be freed by
+ * delete_list().
+ *
+ * @param pcap_file_names The exact names of the pcap files.
+ * @param num_pcaps The number of files.
+ *
+ * @return A handle to the allocated list. Null if one of the files could
+ * not be read.
+ */
+pcap_list_t *read_and_merge_pcaps(const char **pcap_file_names, uint16_t num_pcaps);
+
 /**
  * @brief Write a list of packets to a pcap file.
  * @details Iteratively dumps the packets to the given filename.
@@ -75,7 +96,9 @@ int write_pkts_to_pcap(const char *pcap_file_name, const pcap_list_t *pkt_list);
 /**
  * @brief Merges a given list array into a single list.
  * @details Expects a handle to an array list and allocates a single list from
- * it. The array and its data structures are subsequently destroyed.
+ * it. The array and its data structures are subsequently destroyed. The merged
+ * list takes over the mappings the packets of the lists point into, so either
+ * all or none of the lists should come from read_pkts_from_pcap().
  *
  * @param array The array containing the lists to split
  * @param merged_list The output lists to fill with packets.
@@ -100,8 +123,8 @@ pcap_list_array_t *split_and_delete_list(pcap_list_t *input_list, pcap_list_arra
 /**
  * @brief Appends a  packet to a given list of packets.
  * @details This function takes a pointer to a packet and appends it to the
- * given list. If the list is Null, it is allocated. For each new packet
- * to append, the list is expanded by the size of the packet pointer.
+ * given list. If the list is Null, it is allocated. When the list is full,
+ * its capacity is doubled.
  *
  * @param pkt_list List descriptor. Can be Null
  * @param pkt Pointer of the packet to append.
@@ -180,7 +203,8 @@ pcap_list_t *get_list(pcap_list_array_t *list, uint16_t index);
 /**
  * @brief Copies a packet in full, including its referenced data.
  * @details Allocates a new packet and copies all data and structures
- * contained in the reference packet. Both packets remain allocated.
+ * contained in the reference packet. Only the captured length of the data
+ * is copied. Both packets remain allocated.
  * @param src_pkt The packet to copy.
  *
  * @return An allocated copy of the packet.
@@ -190,7 +214,7 @@ pcap_pkt *copy_pkt(pcap_pkt *src_pkt);
 /**
  * @brief Completely erases the list.
  * @details Deletes the given list. Also deletes the data referenced by the
- * pcap packets in the list.
+ * pcap packets in the list, or unmaps the files the packets point into.
  *
  * @param pkt_list The list to delete.
  */
@@ -208,6 +232,7 @@ void delete_array(pcap_list_array_t *pkt_list_array);
 /**
  * @brief Sort a list in place.
  * @details Sorts a given list by the timestamp of the packets contained in it.
+ * Packets with the same timestamp keep their order.
  * This alters the order in place, the input list is permanently modified.
  *
  * @param pkt_list A list.
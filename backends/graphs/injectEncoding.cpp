@@ -1,232 +1,377 @@
 #include "injectEncoding.h"
-	
-namespace graphs {
-
-std::map<std::string, std::pair<int, int> > actionMap;
-std::map<std::string, int> tableActionScaling;
 
-InjectEncoding::InjectEncoding(P4::ReferenceMap *refMap, P4::TypeMap *typeMap)
-    : refMap(refMap), typeMap(typeMap) {
-    visitDagOnce = true;
-}
+#include <cstdint>
+#include <vector>
 
-int InjectEncoding::findScaling(IR::Node *n) {
-	int sequentialScaling = 1;
-	auto ancestor = getContext();
-	auto search = getOriginal();
-	n->dbprint(std::cout);
-	std::cout << "\n\n";
-	while (!ancestor->node->is<IR::Apply>() && !ancestor->node->is<IR::P4Control>() && !ancestor->node->is<IR::P4Action>()) {
-		if (ancestor->node->is<IR::BlockStatement>()){
-			auto parent = ancestor->node->to<IR::BlockStatement>();
-			bool flag = false;
-			parent->dbprint(std::cout);
-			std::cout << "\n\n";
-			for (auto c : parent->components) {
-				c->dbprint(std::cout);
-				std::cout << "\n\n";
-				if (*c == *search || c->getNode() == search) {
-					flag = true;
-					continue;
-				}
-				if (flag) {
-					sequentialScaling *= c->numPaths;
-				}
-			}
-		}
-		search = ancestor->original;
-		ancestor = ancestor->parent;
-		std::cout << "\n" << search->node_type_name() << " " << ancestor->node->node_type_name() << " " << ancestor->parent->node->node_type_name() << "\n";
-	}
-    auto action = findContext<IR::P4Action>();
-	if (action != nullptr) {
-		std::ostringstream key;
-	    key << action->name << "();";
-	    std::string keyString = key.str();
-		sequentialScaling *= actionMap[key.str()].second;
-	}
-	for(auto elem : actionMap) {
-	   std::cout << elem.first << " " << elem.second.first << " " << elem.second.second << "\n";
-	}
-    return sequentialScaling;
-}
+#include "frontends/p4/methodInstance.h"
+#include "lib/log.h"
+#include "parserPaths.h"
 
-const IR::Node *InjectEncoding::postorder(IR::IfStatement *statement) {
-    std::cout << "Postorder IS = " << statement->id << "\n" << statement->toString() << "\n";
-    statement->dbprint(std::cout);
-    std::cout << "\n\n";
-    int sequentialScaling = findScaling(statement);
-    IR::Add *add;
-
-   	if (statement->ifFalse == nullptr) {
-		add = new IR::Add(new IR::PathExpression("meta.BL"), new IR::Constant(sequentialScaling));
-   	}
-   	else {
-	   	add = new IR::Add(new IR::PathExpression("meta.BL"), new IR::Constant(statement->ifFalse->numPaths * sequentialScaling));
-   	}
-
-   	IR::AssignmentStatement *assignment = new IR::AssignmentStatement(new IR::PathExpression("meta.BL"), add);
-
-   	IR::IndexedVector<IR::StatOrDecl> *blockBody = new IR::IndexedVector<IR::StatOrDecl>();
-   	blockBody->push_back(assignment);
-   	if (statement->ifTrue->is<IR::BlockStatement>()) {
-	   	for (auto stat : statement->ifTrue->to<IR::BlockStatement>()->components) {
-	   		blockBody->push_back(stat);
-	   	}
-	}
-	else {
-		blockBody->push_back(statement->ifTrue);
-	}
-
-   	IR::BlockStatement *block = new IR::BlockStatement();
-   	block->components = *blockBody;
-
-   	statement->ifTrue = block;
-    return statement;
-}
+namespace graphs {
 
+namespace {
 
-const IR::Node *InjectEncoding::postorder(IR::SwitchStatement *statement) {
-    IR::SwitchStatement* newSwitch = new IR::SwitchStatement(statement->expression, *(new IR::Vector<IR::SwitchCase>()));
-    newSwitch->numPaths = 0;
-
-    int sequentialScaling = findScaling(statement);
-
-   	for (auto scase : statement->cases) {
-   		IR::SwitchCase* newScase = new IR::SwitchCase(scase->label, nullptr);
-   		if (scase->statement == nullptr) {
-   			newSwitch->cases.push_back(newScase);
-   			continue;
-   		}
-   		IR::Add *add = new IR::Add(new IR::PathExpression("meta.BL"), new IR::Constant(newSwitch->numPaths * sequentialScaling));
-	   	IR::AssignmentStatement *assignment = new IR::AssignmentStatement(new IR::PathExpression("meta.BL"), add);
-
-	   	IR::IndexedVector<IR::StatOrDecl> *blockBody = new IR::IndexedVector<IR::StatOrDecl>();
-	   	blockBody->push_back(assignment);
-	   	blockBody->push_back(scase->statement);
-
-	   	IR::BlockStatement *block = new IR::BlockStatement();
-   		block->components = *blockBody;
-
-	   	newScase->statement = block;
-	   	newSwitch->numPaths += scase->numPaths;
-	   	newSwitch->cases.push_back(newScase);
-   	}
-    return newSwitch;
+const IR::Expression *pathRegister() {
+    return new IR::PathExpression("meta.BL");
 }
 
-const IR::Node *InjectEncoding::postorder(IR::BlockStatement *block) {
-	std::cout << "Postorder SS = " << block->id << "\n" << block->toString() << "\n";
-    block->dbprint(std::cout);
-    std::cout << "\n\n";
+/// @returns @body with @statement in front of it.
+const IR::Statement *prepend(const IR::Statement *statement, const IR::Statement *body) {
+    auto block = new IR::BlockStatement();
+    block->components.push_back(statement);
+    if (auto inner = body == nullptr ? nullptr : body->to<IR::BlockStatement>()) {
+        block->srcInfo = inner->srcInfo;
+        block->annotations = inner->annotations;
+        block->components.append(inner->components);
+    } else if (body != nullptr) {
+        block->components.push_back(body);
+    }
     return block;
 }
 
-const IR::Node *InjectEncoding::postorder(IR::MethodCallStatement *statement) {
-	std::cout << "Postorder SS = " << statement->id << "\n" << statement->toString() << "\n";
-    statement->dbprint(std::cout);
-    std::cout << "\n\n" << statement->methodCall <<"\n\n";
-    return statement;
+/// @returns the statement adding @value to the path register.
+const IR::Statement *addToPathRegister(const mpz_class &value) {
+    const IR::Expression *sum;
+    if (value > 0)
+        sum = new IR::Add(pathRegister(), new IR::Constant(value));
+    else
+        sum = new IR::Sub(pathRegister(), new IR::Constant(-value));
+    return new IR::AssignmentStatement(pathRegister(), sum);
 }
 
-const IR::Node *InjectEncoding::postorder(IR::P4Action *action) {
-	std::ostringstream key;
-    key << action->name << "();";
-    std::string keyString = key.str();
-    if (tableActionScaling.count(keyString) > 0) {
-    	if(tableActionScaling[keyString] > 0) {
-		    IR::Add *add = new IR::Add(new IR::PathExpression("meta.BL"), new IR::Constant(tableActionScaling[keyString] * actionMap[keyString].second));
-			IR::AssignmentStatement *assignment = new IR::AssignmentStatement(new IR::PathExpression("meta.BL"), add);
-			IR::IndexedVector<IR::StatOrDecl> *blockBody = new IR::IndexedVector<IR::StatOrDecl>();
-			blockBody->push_back(assignment);
-	    	if (action->body != nullptr) {
-			   	for (auto stat : action->body->components) {
-			   		blockBody->push_back(stat);
-			   	}
-			}
-
-		   	IR::BlockStatement *block = new IR::BlockStatement();
-		   	block->components = *blockBody;
-
-		   	action->body = block;
-    	}
-    }
-    return action;
+/// counter(size, CounterType.packets) name;
+const IR::Declaration *pathCounter(cstring name, const mpz_class &size) {
+    auto arguments = new IR::Vector<IR::Argument>();
+    arguments->push_back(new IR::Argument(new IR::Constant(size)));
+    arguments->push_back(new IR::Argument(
+        new IR::Member(new IR::TypeNameExpression("CounterType"), "packets")));
+    return new IR::Declaration_Instance(IR::ID(name), new IR::Type_Name("counter"), arguments);
 }
 
-const IR::Node *InjectEncoding::postorder(IR::P4Table *table) {
-    return table;
+/// counter.count(offset + ((bit<32>)meta.BL & mask)), without the mask if it is 0.
+const IR::Statement *countPath(const IR::Expression *counter, const mpz_class &offset,
+                               const mpz_class &mask = 0) {
+    const IR::Expression *index = new IR::Cast(IR::Type_Bits::get(32), pathRegister());
+    if (mask != 0)
+        index = new IR::BAnd(index, new IR::Constant(mask));
+    if (offset != 0)
+        index = new IR::Add(new IR::Constant(offset), index);
+    auto count = new IR::MethodCallExpression(new IR::Member(counter, "count"), { index });
+    return new IR::MethodCallStatement(count);
 }
 
+}  // namespace
 
-const IR::Node *InjectEncoding::postorder(IR::Node *node) {
-    return node;
+InjectEncoding::InjectEncoding(P4::ReferenceMap *refMap, P4::TypeMap *typeMap,
+                               const PathProfile *profile, uint64_t maxPaths)
+    : refMap(refMap), typeMap(typeMap), profile(profile), maxPaths(maxPaths) {
+    visitDagOnce = true;
 }
 
-const IR::Node *InjectEncoding::preorder(IR::PackageBlock *block) {
-    for (auto it : block->constantValue) {
-	    if (it.second->is<IR::ControlBlock>()) {          
-	        visit(it.second->getNode());
-	    }
-	}
-    return block;
+const IR::Statement *InjectEncoding::increment(const IR::Node *branch, unsigned index) const {
+    auto it = increments.find({ branch, index });
+    if (it == increments.end())
+        return nullptr;
+    return addToPathRegister(it->second);
 }
-const IR::Node *InjectEncoding::preorder(IR::ControlBlock *block) {
-    visit(block->container);
-    return block;
+
+const IR::Node *InjectEncoding::preorder(IR::P4Program *program) {
+    counters = false;
+    for (auto decl : *program->getDeclsByName("counter")->toVector())
+        counters = counters || decl->getNode()->is<IR::Type_Extern>();
+    return program;
 }
+
 const IR::Node *InjectEncoding::preorder(IR::P4Control *control) {
-	//visit table first to change its member action's sequential scaling
-	for (auto e : control->controlLocals) {
-		e->dbprint(std::cout);
-		std::cout << "\n";
-		if (e->is<IR::P4Table>()) {
-			visit(e->to<IR::P4Table>());
-		}
-	}
-	for (auto e : control->controlLocals) {
-		visit(e);
-	}
-    visit(control->body);
+    increments.clear();
+    regions.clear();
+    ControlPaths paths(getOriginal<IR::P4Control>(), refMap, typeMap, maxPaths);
+    if (paths.numPaths() <= 1)
+        return control;
+    std::vector<PathCounts> counts;
+    if (auto controlCounts = profile ? profile->get(control->name) : nullptr)
+        counts = paths.split(*controlCounts);
+
+    // The arms of actions applied from several places share their
+    // statements, so their edges are taken into the spanning tree first.
+    std::map<std::pair<const IR::Node *, unsigned>,
+             std::vector<std::pair<unsigned, unsigned>>> places;
+    for (unsigned r = 0; r < paths.regions.size(); ++r) {
+        auto &arms = paths.regions[r].graph.arms;
+        for (unsigned arm = 0; arm < arms.size(); ++arm)
+            places[{ arms[arm].branch, arms[arm].index }].emplace_back(r, arm);
+    }
+    std::vector<std::vector<bool>> shared(paths.regions.size());
+    for (unsigned r = 0; r < paths.regions.size(); ++r)
+        shared[r].resize(paths.regions[r].graph.arms.size());
+    for (auto &place : places)
+        for (auto arm : place.second)
+            shared[arm.first][arm.second] = place.second.size() > 1;
+
+    // Without side exits, a path through the start of an arm also goes
+    // through its end: both increments are placed at the start.
+    std::vector<std::vector<mpz_class>> armIncrements;
+    // Numbering each arm in place adds the offset of the arm to every arm
+    // of an if statement or a table but the first, and to every case.
+    unsigned structural = 0, placed = 0;
+    double structuralCost = 0, placedCost = 0;
+    for (unsigned r = 0; r < paths.regions.size(); ++r) {
+        auto &region = paths.regions[r];
+        auto &graph = region.graph;
+        // The counts of hashed regions do not tell their paths apart
+        bool profiled = r < counts.size() && !region.hashed;
+        graph.placeIncrements(profiled ? &counts[r] : nullptr, &shared[r]);
+        armIncrements.emplace_back(graph.arms.size());
+        for (auto &edge : graph.edges)
+            armIncrements[r][edge.arm] += edge.increment;
+        for (auto &arm : graph.arms) {
+            auto sw = arm.branch->to<IR::SwitchStatement>();
+            if (graph.edges[arm.start].value != 0 || (sw && arm.index < sw->cases.size())) {
+                ++structural;
+                structuralCost += graph.frequency[arm.start];
+            }
+        }
+        BUG_CHECK(graph.init >= 0, "%1%: negative initial path id", control);
+    }
+    for (auto &place : places) {
+        auto first = place.second.front();
+        auto &value = armIncrements[first.first][first.second];
+        for (auto arm : place.second) {
+            if (armIncrements[arm.first][arm.second] != value) {
+                ::warning(ErrorType::WARN_UNSUPPORTED,
+                          "%1%: path ids of the places this is applied from overlap",
+                          place.first.first);
+                break;
+            }
+        }
+        if (value != 0) {
+            increments.emplace(place.first, value);
+            ++placed;
+            for (auto arm : place.second) {
+                auto &graph = paths.regions[arm.first].graph;
+                placedCost += graph.frequency[graph.arms[arm.second].start];
+            }
+        }
+    }
+    LOG1(control->name << ": " << paths.numPaths() << " paths in " << paths.regions.size()
+         << " regions, " << structural << " increments numbering each arm ("
+         << structuralCost << " per packet), " << placed << " on chords ("
+         << placedCost << " per packet)");
+    structuralIncrements += structural;
+    placedIncrements += placed;
+    this->structuralCost += structuralCost;
+    this->placedCost += placedCost;
+    regions = std::move(paths.regions);
     return control;
 }
-const IR::Node *InjectEncoding::preorder(IR::BlockStatement *statement) {
-    return statement;
+
+const IR::Node *InjectEncoding::preorder(IR::P4Parser *parser) {
+    prune();
+    if (!counters)
+        return parser;
+    auto original = getOriginal<IR::P4Parser>();
+    ParserPaths paths(original);
+    auto &graph = paths.graph;
+    if (graph.numPaths() <= 1)
+        return parser;
+    if ((maxPaths != 0 && graph.numPaths() > maxPaths) || graph.numPaths() > UINT32_MAX) {
+        ::warning(ErrorType::WARN_UNSUPPORTED,
+                  "%1%: %2% paths do not fit a counter within the bound; not instrumented",
+                  parser, graph.numPaths().get_str());
+        return parser;
+    }
+    // The edges from the entry are taken into the spanning tree first: most
+    // paths then start with the path register set to init.
+    std::vector<bool> fromEntry(graph.arms.size());
+    for (auto e : graph.out.front())
+        fromEntry[graph.edges[e].arm] = true;
+    graph.placeIncrements(profile ? profile->get(parser->name) : nullptr, &fromEntry);
+
+    auto counter = new IR::PathExpression(refMap->newName("path_counter"));
+    parser->parserLocals.push_back(pathCounter(counter->path->name, graph.numPaths()));
+    // A path starts with the path register set to init plus the increment
+    // of the edge from the entry it takes, which wraps around the 32 bits of
+    // the register if it is negative; by the state the path resumes at, or
+    // nullptr for start.
+    std::map<const IR::ParserState *, mpz_class> starts;
+    for (auto e : graph.out.front()) {
+        mpz_class value = graph.init + graph.edges[e].increment;
+        if (value < 0)
+            value += mpz_class(1) << 32;
+        auto &transition = paths.transitions[e];
+        bool resume = transition.kind == ParserPaths::Transition::Kind::Resume;
+        starts.emplace(resume ? transition.to : nullptr, value);
+    }
+    auto count = [&](const mpz_class &increment, IR::IndexedVector<IR::StatOrDecl> &components) {
+        if (increment != 0)
+            components.push_back(addToPathRegister(increment));
+        components.push_back(countPath(counter, 0));
+    };
+
+    // The transitions to accept and reject go through states counting the
+    // path, and the ones of select cases with an increment through states
+    // adding it.
+    IR::IndexedVector<IR::ParserState> added;
+    std::map<const IR::ParserState *, cstring> ends;
+    std::map<std::pair<const IR::ParserState *, int>, unsigned> edgeOf;
+    unsigned placed = 0;
+    for (unsigned e = 0; e < paths.transitions.size(); ++e) {
+        auto &transition = paths.transitions[e];
+        placed += graph.edges[e].increment != 0;
+        if (transition.kind == ParserPaths::Transition::Kind::End) {
+            cstring name = refMap->newName(cstring("path_") + transition.from->name.name);
+            IR::IndexedVector<IR::StatOrDecl> components;
+            count(graph.edges[e].increment, components);
+            added.push_back(new IR::ParserState(IR::ID(name), components,
+                                                new IR::PathExpression(transition.from->name)));
+            ends.emplace(transition.from, name);
+        } else if (transition.from != nullptr) {
+            edgeOf.emplace(std::make_pair(transition.from, transition.selectCase), e);
+        }
+    }
+
+    IR::IndexedVector<IR::ParserState> states;
+    for (auto state : original->states) {
+        IR::IndexedVector<IR::StatOrDecl> components;
+        if (state->name == IR::ParserState::start)
+            components.push_back(new IR::AssignmentStatement(
+                pathRegister(), new IR::Constant(starts.at(nullptr))));
+        components.append(state->components);
+        // @returns where the transition of @state taking @selectCase to
+        // @target goes to instead
+        auto retarget = [&](int selectCase, const IR::PathExpression *target)
+                -> const IR::PathExpression * {
+            auto it = edgeOf.find({ state, selectCase });
+            if (it == edgeOf.end())
+                return target;
+            auto &transition = paths.transitions[it->second];
+            auto &increment = graph.edges[it->second].increment;
+            IR::IndexedVector<IR::StatOrDecl> statements;
+            cstring base = "path_increment";
+            if (transition.kind == ParserPaths::Transition::Kind::Loop) {
+                // The path ends, and a new one starts at the state looped back to
+                count(increment, statements);
+                statements.push_back(new IR::AssignmentStatement(
+                    pathRegister(), new IR::Constant(starts.at(transition.to))));
+                base = "path_loop";
+            } else {
+                auto end = ends.find(transition.to);
+                if (end != ends.end())
+                    target = new IR::PathExpression(end->second);
+                if (increment != 0)
+                    statements.push_back(addToPathRegister(increment));
+            }
+            if (statements.empty())
+                return target;
+            if (selectCase < 0) {
+                components.append(statements);
+                return target;
+            }
+            cstring name = refMap->newName(base);
+            added.push_back(new IR::ParserState(IR::ID(name), statements, target));
+            return new IR::PathExpression(name);
+        };
+        const IR::Expression *next = state->selectExpression;
+        if (auto path = next ? next->to<IR::PathExpression>() : nullptr) {
+            next = retarget(-1, path);
+        } else if (auto select = next ? next->to<IR::SelectExpression>() : nullptr) {
+            IR::Vector<IR::SelectCase> cases;
+            for (unsigned index = 0; index < select->selectCases.size(); ++index) {
+                auto c = select->selectCases.at(index);
+                auto target = retarget(index, c->state);
+                if (target != c->state)
+                    c = new IR::SelectCase(c->srcInfo, c->keyset, target);
+                cases.push_back(c);
+            }
+            next = new IR::SelectExpression(select->srcInfo, select->select, cases);
+        }
+        states.push_back(new IR::ParserState(state->srcInfo, state->name, state->annotations,
+                                             components, next));
+    }
+    states.append(added);
+    parser->states = states;
+    LOG1(parser->name << ": " << graph.numPaths() << " paths, " << placed
+         << " increments on chords");
+    return parser;
 }
-const IR::Node *InjectEncoding::preorder(IR::IfStatement *statement) {
-    return statement;
+
+const IR::Node *InjectEncoding::postorder(IR::P4Control *control) {
+    if (regions.empty())
+        return control;
+    const IR::Expression *counter = nullptr;
+    mpz_class size = regions.back().offset + regions.back().size;
+    if (counters && size > UINT32_MAX) {
+        ::warning(ErrorType::WARN_UNSUPPORTED,
+                  "%1%: %2% path ids do not fit a counter; bound the paths of its regions",
+                  control, size.get_str());
+    } else if (counters) {
+        cstring name = refMap->newName("path_counter");
+        control->controlLocals.push_back(pathCounter(name, size));
+        counter = new IR::PathExpression(name);
+    }
+
+    // Each region sets the path register at its start and counts it at its end
+    auto body = new IR::BlockStatement(control->body->srcInfo, control->body->annotations);
+    for (auto &region : regions) {
+        auto init = new IR::Constant(region.graph.init);
+        body->components.push_back(new IR::AssignmentStatement(pathRegister(), init));
+        for (size_t index = region.begin; index < region.end; ++index)
+            body->components.push_back(control->body->components.at(index));
+        if (counter == nullptr)
+            continue;
+        mpz_class mask = region.hashed ? mpz_class(region.size - 1) : 0;
+        body->components.push_back(countPath(counter, region.offset, mask));
+    }
+    control->body = body;
+    increments.clear();
+    regions.clear();
+    return control;
 }
-const IR::Node *InjectEncoding::preorder(IR::SwitchStatement *statement) {
-    return statement;
 
+const IR::Node *InjectEncoding::postorder(IR::IfStatement *statement) {
+    auto original = getOriginal();
+    if (auto add = increment(original, 1))
+        statement->ifTrue = prepend(add, statement->ifTrue);
+    if (auto add = increment(original, 0))
+        statement->ifFalse = prepend(add, statement->ifFalse);
+    return statement;
 }
-const IR::Node *InjectEncoding::preorder(IR::MethodCallStatement *statement) {
+
+const IR::Node *InjectEncoding::postorder(IR::SwitchStatement *statement) {
+    auto original = getOriginal<IR::SwitchStatement>();
+    IR::Vector<IR::SwitchCase> cases;
+    for (unsigned index = 0; index < statement->cases.size(); ++index) {
+        auto c = statement->cases.at(index);
+        if (auto add = increment(original, index))
+            c = new IR::SwitchCase(c->srcInfo, c->label, prepend(add, c->statement));
+        cases.push_back(c);
+    }
+    // The implicit default case
+    if (auto add = increment(original, original->cases.size()))
+        cases.push_back(new IR::SwitchCase(new IR::DefaultExpression(), prepend(add, nullptr)));
+    statement->cases = cases;
     return statement;
 }
 
-const IR::Node *InjectEncoding::preorder(IR::P4Table *table) {
-	auto actionList = table->getActionList();
-	actionList->dbprint(std::cout);
-	std::cout << "\n";
-	std::ostringstream key;
-    key << table->name;
-    std::string tablekeyString = key.str();
-	for (auto a : actionList->actionList) {
-		std::ostringstream elKey;
-		elKey << a;
-		std::string elKeyString = elKey.str();
-		if (elKeyString.rfind(" ") != std::string::npos) {
-			elKeyString = elKeyString.erase(0 , elKeyString.rfind(" ") + 1);
-		}
-		if (actionMap.count(elKeyString)) {
-			actionMap[elKeyString].second *= actionMap[tablekeyString].second;
-		}
-	}
-    return table;
-
-} 
-const IR::Node *InjectEncoding::preorder(IR::Node * n) {
-    return n;
+const IR::Node *InjectEncoding::postorder(IR::MethodCallStatement *statement) {
+    auto original = getOriginal<IR::MethodCallStatement>();
+    auto first = increments.lower_bound({ original, 0 });
+    if (first == increments.end() || first->first.first != original)
+        return statement;
+
+    // t.apply(); becomes switch (t.apply().action_run) { ... }
+    auto instance = P4::MethodInstance::resolve(original, refMap, typeMap);
+    auto table = instance->to<P4::ApplyMethod>()->object->to<IR::P4Table>();
+    auto actionList = table->getActionList();
+    IR::Vector<IR::SwitchCase> cases;
+    for (unsigned index = 0; index < actionList->size(); ++index) {
+        if (auto add = increment(original, index)) {
+            auto label = new IR::PathExpression(actionList->actionList.at(index)->getPath());
+            cases.push_back(new IR::SwitchCase(label, prepend(add, nullptr)));
+        }
+    }
+    auto actionRun = new IR::Member(statement->methodCall, IR::Type_Table::action_run);
+    return new IR::SwitchStatement(statement->srcInfo, actionRun, cases);
 }
 
-} 
\ No newline at end of file
+}  // namespace graphs
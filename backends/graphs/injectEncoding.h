@@ -1,38 +1,76 @@
-#ifndef INJECT_ENCODING_H
-#define INJECT_ENCODING_H
+#ifndef _BACKENDS_GRAPHS_INJECTENCODING_H_
+#define _BACKENDS_GRAPHS_INJECTENCODING_H_
+
 #include <map>
 #include <utility>
-#include "graphs.h"
+#include <vector>
+
+#include "ir/ir.h"
+#include "pathGraph.h"
 
 namespace graphs {
 
+/// Instruments the controls with a Ball-Larus path register, meta.BL, which
+/// holds the id of the path taken through the apply block of a control when
+/// the block ends.  Paths are numbered on the PathGraph of the control.  The
+/// register is set at the start of the block and only updated on the chords
+/// of a spanning tree of the graph, which is chosen to leave the hot edges
+/// uninstrumented: see PathGraph::placeIncrements.  The increments of the
+/// actions of a table are placed in a switch on the action run by the table.
+/// Controls with a single path are left alone.
+///
+/// Controls with more than @maxPaths paths are numbered in regions, as
+/// described by ControlPaths: the register is set again at the start of
+/// each region.  If the architecture has a counter extern, as v1model does,
+/// the id is counted at the end of each region, at the counter index which
+/// follows those of the previous regions.
+///
+/// With a counter extern, the parsers are instrumented too, on the graph of
+/// their ParserPaths: the register is set in the start state, select cases
+/// with an increment go through a new state adding it, and the transitions
+/// to accept and reject go through new states counting the id.  The back
+/// edges of loops count the id of the path they end and set the register
+/// for the path which resumes.  Parsers with more than @maxPaths paths are
+/// left alone.
 class InjectEncoding : public Transform {
-  public:
-    InjectEncoding(P4::ReferenceMap *refMap, P4::TypeMap *typeMap);
-    int findScaling(IR::Node *n);
+ public:
+    InjectEncoding(P4::ReferenceMap *refMap, P4::TypeMap *typeMap,
+                   const PathProfile *profile = nullptr,
+                   uint64_t maxPaths = ControlPaths::defaultMaxPaths);
+
+    /// The number of increments numbering each arm in place takes, and the
+    /// number of increments placed, over all controls; and how many of them
+    /// are executed per packet, according to the profile or estimated.
+    unsigned structuralIncrements = 0;
+    unsigned placedIncrements = 0;
+    double structuralCost = 0;
+    double placedCost = 0;
 
-    const IR::Node *preorder(IR::PackageBlock *block) override;
-    const IR::Node *preorder(IR::ControlBlock *block) override;
+    const IR::Node *preorder(IR::P4Program *program) override;
     const IR::Node *preorder(IR::P4Control *control) override;
-    const IR::Node *preorder(IR::BlockStatement *statement) override;
-    const IR::Node *preorder(IR::IfStatement *statement) override;
-    const IR::Node *preorder(IR::SwitchStatement *statement) override;
-    const IR::Node *preorder(IR::MethodCallStatement *statement) override;
-    const IR::Node *preorder(IR::P4Table *table) override;
+    const IR::Node *preorder(IR::P4Parser *parser) override;
 
-    const IR::Node *postorder(IR::Node *node) override;
+    const IR::Node *postorder(IR::P4Control *control) override;
     const IR::Node *postorder(IR::IfStatement *statement) override;
     const IR::Node *postorder(IR::SwitchStatement *statement) override;
-    const IR::Node *postorder(IR::BlockStatement *block) override;
     const IR::Node *postorder(IR::MethodCallStatement *statement) override;
-    const IR::Node *postorder(IR::P4Action *action) override;
-    const IR::Node *postorder(IR::P4Table *table) override;
-
-    const IR::Node *preorder(IR::Node *) override;
 
  private:
     P4::ReferenceMap *refMap; P4::TypeMap *typeMap;
+    const PathProfile *profile;
+    uint64_t maxPaths;
+    /// Whether the program declares the v1model counter extern.
+    bool counters = false;
+    /// What to add to the path register at the start of the arms of the
+    /// current control, by branch and arm index.
+    std::map<std::pair<const IR::Node *, unsigned>, mpz_class> increments;
+    /// The regions of the current control, if it is instrumented.
+    std::vector<ControlPaths::Region> regions;
+
+    /// @returns the statement adding to the path register in @index of @branch.
+    const IR::Statement *increment(const IR::Node *branch, unsigned index) const;
 };
 
-}
-#endif
\ No newline at end of file
+}  // namespace graphs
+
+#endif  // _BACKENDS_GRAPHS_INJECTENCODING_H_
@@ -46,6 +46,7 @@ limitations under the License.
 #include "controls.h"
 #include "parsers.h"
 
+#include "pathDecoder.h"
 #include "pathEncoding.h"
 #include "injectEncoding.h"
 #include "encodeActions.h"
@@ -128,6 +129,8 @@ class Options : public CompilerOptions {
     cstring graphsDir{"."};
     // read from json
     bool loadIRFromJson = false;
+    cstring decodePaths = nullptr;
+    uint64_t maxPaths = ControlPaths::defaultMaxPaths;
     Options() {
         registerOption("--graphs-dir", "dir",
                        [this](const char* arg) { graphsDir = arg; return true; },
@@ -137,6 +140,21 @@ class Options : public CompilerOptions {
                 [this](const char* arg) { loadIRFromJson = true; file = arg; return true; },
                 "Use IR representation from JsonFile dumped previously,"\
                 "the compilation starts with reduced midEnd.");
+        registerOption("--decode-paths", "file",
+                       [this](const char* arg) { decodePaths = arg; return true; },
+                       "Decode the path ids counted in file, as numbered by the path\n"
+                       "encoding, and print the hot paths of each control and parser as JSON");
+        registerOption("--max-paths", "n",
+                       [this](const char* arg) {
+                           char *end = nullptr;
+                           maxPaths = strtoull(arg, &end, 10);
+                           if (*arg == '\0' || *end != '\0') {
+                               ::error("--max-paths: expected a number, got %1%", arg);
+                               return false;
+                           }
+                           return true; },
+                       "Number the paths of controls in regions of at most n paths, as\n"
+                       "the path encoding does (default 65536, 0 for no bound)");
     }
 };
 
@@ -206,7 +224,8 @@ int main(int argc, char *const argv[]) {
     try {
         top = midEnd.process(program); 
         if (options.dumpJsonFile)
-            JSONGenerator(*openFile(options.dumpJsonFile, true)) << program << std::endl;
+            JSONGenerator(*openFile(options.dumpJsonFile, true), false, options.dumpJsonCompact)
+                << program << std::endl;
     } catch (const Util::P4CExceptionBase &bug) {
         std::cerr << bug.what() << std::endl;
         return 1;
@@ -214,6 +233,20 @@ int main(int argc, char *const argv[]) {
     if (::errorCount() > 0)
         return 1;
 
+    if (options.decodePaths) {
+        std::ifstream samples(options.decodePaths);
+        if (!samples) {
+            ::error("%s: No such file or directory.", options.decodePaths);
+            return 1;
+        }
+        graphs::PathProfile profile;
+        if (!profile.read(samples))
+            return 1;
+        graphs::PathDecoder decoder(program, &midEnd.refMap, &midEnd.typeMap, options.maxPaths);
+        decoder.write(profile, std::cout);
+        return ::errorCount() > 0;
+    }
+
     LOG2("Generating graphs under " << options.graphsDir);
     LOG2("Generating control graphs");
     std::ifstream table_info("variables.json");
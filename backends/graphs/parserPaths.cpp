@@ -0,0 +1,118 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "parserPaths.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace graphs {
+
+namespace {
+
+/// The states @state transitions to, with the index of the select case
+/// taking each transition, or -1.
+std::vector<std::pair<const IR::ParserState *, int>>
+successors(const IR::P4Parser *parser, const IR::ParserState *state) {
+    std::vector<std::pair<const IR::ParserState *, int>> rv;
+    auto target = [parser](const IR::PathExpression *path) {
+        auto decl = parser->states.getDeclaration(path->path->name);
+        BUG_CHECK(decl != nullptr, "%1%: unknown state", path);
+        return decl->to<IR::ParserState>();
+    };
+    if (state->selectExpression == nullptr)
+        return rv;
+    if (auto path = state->selectExpression->to<IR::PathExpression>()) {
+        rv.emplace_back(target(path), -1);
+    } else if (auto select = state->selectExpression->to<IR::SelectExpression>()) {
+        for (unsigned index = 0; index < select->selectCases.size(); ++index)
+            rv.emplace_back(target(select->selectCases.at(index)->state), index);
+    }
+    return rv;
+}
+
+}  // namespace
+
+ParserPaths::ParserPaths(const IR::P4Parser *parser) {
+    auto start = parser->states.getDeclaration<IR::ParserState>(IR::ParserState::start);
+    BUG_CHECK(start != nullptr, "%1%: parser without a start state", parser);
+
+    // The reverse postorder of a depth-first search from start orders the
+    // states topologically, but for the back edges, which go to a state
+    // which does not come later.
+    std::set<const IR::ParserState *> visited = { start };
+    std::vector<const IR::ParserState *> postorder;
+    struct Frame {
+        const IR::ParserState *state;
+        std::vector<std::pair<const IR::ParserState *, int>> next;
+        size_t index;
+    };
+    std::vector<Frame> stack = { { start, successors(parser, start), 0 } };
+    while (!stack.empty()) {
+        auto &frame = stack.back();
+        if (frame.index == frame.next.size()) {
+            postorder.push_back(frame.state);
+            stack.pop_back();
+            continue;
+        }
+        auto to = frame.next[frame.index++].first;
+        if (visited.insert(to).second)
+            stack.push_back({ to, successors(parser, to), 0 });
+    }
+
+    std::map<const IR::ParserState *, unsigned> vertex;
+    unsigned entry = graph.addVertex();
+    for (auto it = postorder.rbegin(); it != postorder.rend(); ++it)
+        vertex[*it] = graph.addVertex();
+    unsigned exit = graph.addVertex();
+    auto add = [&](unsigned from, unsigned to, Transition transition) {
+        auto branch = transition.from ? transition.from : transition.to;
+        unsigned index = std::max(transition.selectCase, 0);
+        graph.arms.push_back({ branch, index, unsigned(graph.edges.size()) });
+        graph.addEdge(from, to, graph.arms.size() - 1);
+        transitions.push_back(transition);
+    };
+
+    add(entry, vertex[start], { Transition::Kind::Start, nullptr, start, -1 });
+    std::vector<const IR::ParserState *> resumed;
+    for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+        auto state = *it;
+        if (state->name == IR::ParserState::accept || state->name == IR::ParserState::reject) {
+            add(vertex[state], exit, { Transition::Kind::End, state, nullptr, -1 });
+            continue;
+        }
+        for (auto &next : successors(parser, state)) {
+            auto to = next.first;
+            if (vertex[to] > vertex[state]) {
+                add(vertex[state], vertex[to], { Transition::Kind::Next, state, to, next.second });
+            } else {
+                add(vertex[state], exit, { Transition::Kind::Loop, state, to, next.second });
+                if (std::find(resumed.begin(), resumed.end(), to) == resumed.end())
+                    resumed.push_back(to);
+            }
+        }
+    }
+    std::sort(resumed.begin(), resumed.end(),
+              [&](const IR::ParserState *a, const IR::ParserState *b) {
+        return vertex[a] < vertex[b]; });
+    for (auto state : resumed)
+        add(entry, vertex[state], { Transition::Kind::Resume, nullptr, state, -1 });
+    graph.number();
+}
+
+}  // namespace graphs
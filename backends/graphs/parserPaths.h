@@ -0,0 +1,66 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _BACKENDS_GRAPHS_PARSERPATHS_H_
+#define _BACKENDS_GRAPHS_PARSERPATHS_H_
+
+#include <vector>
+
+#include "ir/ir.h"
+#include "pathGraph.h"
+
+namespace graphs {
+
+/// The paths through the states of a parser, numbered on an acyclic
+/// PathGraph as described by Ball and Larus.  The vertices are an entry,
+/// the states reachable from start, in topological order, and an exit.
+/// Each transition to a state is an edge; accept and reject lead to the
+/// exit.  The back edges of loops, such as the ones parsing header stacks,
+/// are cut: a path ends when it takes one, with an edge to the exit, and a
+/// new one resumes at the state it goes to, with an edge from the entry.
+/// Packets which no case of a select expression matches are rejected
+/// without taking any edge: their paths are not numbered.
+class ParserPaths {
+ public:
+    /// What each edge of the graph stands for.
+    struct Transition {
+        enum class Kind {
+            Start,   // from the entry to start
+            Resume,  // from the entry to a state where loops go back
+            Next,    // from a state to the next one
+            Loop,    // from a state to the exit, going back to an earlier state
+            End      // from accept or reject to the exit
+        };
+        Kind kind;
+        /// The states the transition leaves and goes to; from is nullptr for
+        /// the edges from the entry, and to for the edges from accept and
+        /// reject.
+        const IR::ParserState *from, *to;
+        /// The index of the case of the select expression of @from which
+        /// takes the transition, if any.
+        int selectCase;
+    };
+
+    PathGraph graph;
+    /// By edge.
+    std::vector<Transition> transitions;
+
+    explicit ParserPaths(const IR::P4Parser *parser);
+};
+
+}  // namespace graphs
+
+#endif  // _BACKENDS_GRAPHS_PARSERPATHS_H_
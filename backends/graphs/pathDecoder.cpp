@@ -0,0 +1,228 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "pathDecoder.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "frontends/p4/methodInstance.h"
+#include "frontends/p4/toP4/toP4.h"
+#include "lib/error.h"
+
+namespace graphs {
+
+namespace {
+
+cstring print(const IR::Expression *expression) {
+    std::stringstream sstream;
+    expression->apply(P4::ToP4(&sstream, false));
+    return cstring(sstream);
+}
+
+}  // namespace
+
+PathDecoder::PathDecoder(const IR::P4Program *program, P4::ReferenceMap *refMap,
+                         P4::TypeMap *typeMap, uint64_t maxPaths)
+    : refMap(refMap), typeMap(typeMap) {
+    for (auto object : program->objects) {
+        if (auto control = object->to<IR::P4Control>())
+            controls.emplace_back(control, ControlPaths(control, refMap, typeMap, maxPaths));
+        else if (auto parser = object->to<IR::P4Parser>())
+            parsers.emplace_back(parser, ParserPaths(parser));
+    }
+}
+
+void PathDecoder::writeArm(Util::JsonWriter &json, const PathGraph::Arm &arm) const {
+    json.beginObject();
+    if (auto statement = arm.branch->to<IR::IfStatement>()) {
+        json.key("if").value(print(statement->condition));
+        json.key("taken").value(arm.index == 1);
+    } else if (auto statement = arm.branch->to<IR::SwitchStatement>()) {
+        json.key("switch").value(print(statement->expression));
+        cstring label = "default";
+        if (arm.index < statement->cases.size()) {
+            auto expression = statement->cases.at(arm.index)->label;
+            label = print(expression);
+            if (auto path = expression->to<IR::PathExpression>()) {
+                auto decl = refMap->getDeclaration(path->path);
+                if (decl != nullptr && decl->is<IR::P4Action>())
+                    label = decl->to<IR::P4Action>()->controlPlaneName();
+            }
+        }
+        json.key("case").value(label);
+    } else {
+        auto call = arm.branch->to<IR::MethodCallStatement>();
+        auto instance = P4::MethodInstance::resolve(call, refMap, typeMap);
+        auto table = instance->to<P4::ApplyMethod>()->object->to<IR::P4Table>();
+        auto element = table->getActionList()->actionList.at(arm.index);
+        auto action = refMap->getDeclaration(element->getPath(), true)->to<IR::P4Action>();
+        json.key("table").value(table->controlPlaneName());
+        json.key("action").value(action->controlPlaneName());
+    }
+    if (arm.branch->srcInfo.isValid())
+        json.key("source").value(arm.branch->srcInfo.toPositionString());
+    json.endObject();
+}
+
+void PathDecoder::writeTransition(Util::JsonWriter &json,
+                                  const ParserPaths::Transition &transition) const {
+    using Kind = ParserPaths::Transition::Kind;
+    json.beginObject();
+    if (transition.kind == Kind::Resume) {
+        json.key("resume").value(transition.to->name.name);
+        json.endObject();
+        return;
+    }
+    json.key("from").value(transition.from->name.name);
+    json.key("to").value(transition.to->name.name);
+    const IR::Node *source = transition.from->selectExpression;
+    if (transition.selectCase >= 0) {
+        auto select = transition.from->selectExpression->to<IR::SelectExpression>();
+        auto selectCase = select->selectCases.at(transition.selectCase);
+        json.key("case").value(print(selectCase->keyset));
+        source = selectCase;
+    }
+    if (transition.kind == Kind::Loop)
+        json.key("loop").value(true);
+    if (source->srcInfo.isValid())
+        json.key("source").value(source->srcInfo.toPositionString());
+    json.endObject();
+}
+
+void PathDecoder::write(const PathProfile &profile, std::ostream &out) const {
+    using Sample = std::pair<mpz_class, uint64_t>;
+    Util::JsonWriter json(out);
+    json.beginObject().key("controls").beginArray();
+    std::vector<unsigned> path;
+    for (auto &entry : controls) {
+        auto control = entry.first;
+        auto &paths = entry.second;
+        std::vector<std::vector<Sample>> ranked(paths.regions.size());
+        uint64_t samples = 0, invalid = 0;
+        if (auto counts = profile.get(control->name)) {
+            mpz_class id;
+            for (auto &sample : *counts) {
+                samples += sample.second;
+                if (auto region = paths.find(sample.first, id))
+                    ranked[region - paths.regions.data()].emplace_back(id, sample.second);
+                else
+                    invalid += sample.second;
+            }
+        }
+        if (invalid > 0)
+            ::warning(ErrorType::WARN_INVALID, "%1%: %2% samples are not path ids, ignored",
+                      control, invalid);
+
+        json.beginObject();
+        json.key("name").value(control->name);
+        json.key("paths").value(paths.numPaths());
+        json.key("samples").value(samples);
+        json.key("invalid_samples").value(invalid);
+        json.key("regions").beginArray();
+        for (unsigned r = 0; r < paths.regions.size(); ++r) {
+            auto &region = paths.regions[r];
+            // Counts are sorted hottest first; ties keep the order of the ids
+            std::stable_sort(ranked[r].begin(), ranked[r].end(),
+                             [](const Sample &a, const Sample &b) {
+                return a.second > b.second; });
+            json.beginObject();
+            json.key("first_index").value(region.offset);
+            json.key("paths").value(region.graph.numPaths());
+            if (region.hashed)
+                json.key("hashed").value(true);
+            json.key("hot_paths").beginArray();
+            for (auto &sample : ranked[r]) {
+                json.beginObject();
+                json.key("index").value(mpz_class(region.offset + sample.first));
+                if (region.hashed) {
+                    json.key("hash").value(sample.first);
+                    json.key("count").value(sample.second);
+                    json.endObject();
+                    continue;
+                }
+                json.key("id").value(sample.first);
+                json.key("count").value(sample.second);
+                json.key("branches").beginArray();
+                region.graph.decode(sample.first, path);
+                // Each arm is entered by its start edge
+                for (auto e : path) {
+                    auto &arm = region.graph.arms[region.graph.edges[e].arm];
+                    if (arm.start == e)
+                        writeArm(json, arm);
+                }
+                json.endArray();
+                json.endObject();
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    }
+    json.endArray();
+
+    json.key("parsers").beginArray();
+    for (auto &entry : parsers) {
+        auto parser = entry.first;
+        auto &graph = entry.second.graph;
+        std::vector<Sample> ranked;
+        uint64_t samples = 0, invalid = 0;
+        if (auto counts = profile.get(parser->name)) {
+            for (auto &sample : *counts) {
+                samples += sample.second;
+                if (sample.first >= 0 && sample.first < graph.numPaths())
+                    ranked.emplace_back(sample.first, sample.second);
+                else
+                    invalid += sample.second;
+            }
+        }
+        if (invalid > 0)
+            ::warning(ErrorType::WARN_INVALID, "%1%: %2% samples are not path ids, ignored",
+                      parser, invalid);
+        std::stable_sort(ranked.begin(), ranked.end(), [](const Sample &a, const Sample &b) {
+            return a.second > b.second; });
+
+        json.beginObject();
+        json.key("name").value(parser->name);
+        json.key("paths").value(graph.numPaths());
+        json.key("samples").value(samples);
+        json.key("invalid_samples").value(invalid);
+        json.key("hot_paths").beginArray();
+        for (auto &sample : ranked) {
+            json.beginObject();
+            json.key("id").value(sample.first);
+            json.key("count").value(sample.second);
+            json.key("transitions").beginArray();
+            graph.decode(sample.first, path);
+            // The edges entering start and leaving accept and reject go without saying
+            for (auto e : path) {
+                auto &transition = entry.second.transitions[e];
+                if (transition.kind != ParserPaths::Transition::Kind::Start &&
+                    transition.kind != ParserPaths::Transition::Kind::End)
+                    writeTransition(json, transition);
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endArray();
+        json.endObject();
+    }
+    json.endArray().endObject();
+    out << std::endl;
+}
+
+}  // namespace graphs
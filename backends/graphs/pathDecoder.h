@@ -0,0 +1,79 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _BACKENDS_GRAPHS_PATHDECODER_H_
+#define _BACKENDS_GRAPHS_PATHDECODER_H_
+
+#include <iosfwd>
+#include <utility>
+#include <vector>
+
+#include "ir/ir.h"
+#include "lib/json.h"
+#include "parserPaths.h"
+#include "pathGraph.h"
+
+namespace graphs {
+
+/// Maps the path ids collected from the path register of the controls of a
+/// program back to the branches they took.  The paths of each control are
+/// numbered in the regions of its ControlPaths, as InjectEncoding numbers
+/// them when it instruments the same program with the same bound, and the
+/// paths of each parser on the graph of its ParserPaths.
+class PathDecoder {
+ public:
+    PathDecoder(const IR::P4Program *program, P4::ReferenceMap *refMap, P4::TypeMap *typeMap,
+                uint64_t maxPaths = ControlPaths::defaultMaxPaths);
+
+    /// Writes, for each control, the paths of @profile, which is indexed by
+    /// counter index, ranked by decreasing count within each region, with
+    /// the sequence of arms each of them takes:
+    ///
+    ///     { "controls" : [ { "name" : ..., "paths" : ..., "samples" : ...,
+    ///         "invalid_samples" : ..., "regions" : [ { "first_index" : ...,
+    ///         "paths" : ..., "hot_paths" : [ { "index" : ..., "id" : ...,
+    ///         "count" : ..., "branches" : [ ... ] } ] } ] } ] }
+    ///
+    /// A branch is { "if" : condition, "taken" : true/false },
+    /// { "switch" : expression, "case" : label } or
+    /// { "table" : name, "action" : name }, with its "source" position.
+    /// Hashed regions are marked "hashed", and list the count of each
+    /// "hash" instead of paths.
+    ///
+    /// The paths of the parsers follow, as
+    ///
+    ///     "parsers" : [ { "name" : ..., "paths" : ..., "samples" : ...,
+    ///         "invalid_samples" : ..., "hot_paths" : [ { "id" : ...,
+    ///         "count" : ..., "transitions" : [ ... ] } ] } ]
+    ///
+    /// where a transition is { "from" : state, "to" : state }, with the
+    /// "case" of the select expression taking it, if any; transitions back
+    /// to an earlier state, which end the path, are marked "loop", and
+    /// paths resuming after one start with { "resume" : state }.
+    void write(const PathProfile &profile, std::ostream &out) const;
+
+ private:
+    P4::ReferenceMap *refMap; P4::TypeMap *typeMap;
+    std::vector<std::pair<const IR::P4Control *, ControlPaths>> controls;
+    std::vector<std::pair<const IR::P4Parser *, ParserPaths>> parsers;
+
+    void writeArm(Util::JsonWriter &json, const PathGraph::Arm &arm) const;
+    void writeTransition(Util::JsonWriter &json, const ParserPaths::Transition &transition) const;
+};
+
+}  // namespace graphs
+
+#endif  // _BACKENDS_GRAPHS_PATHDECODER_H_
@@ -1,230 +1,180 @@
-#include <iostream>
+#include "pathEncoding.h"
+
+#include <climits>
+#include <set>
+#include <sstream>
 
 #include "frontends/p4/methodInstance.h"
 #include "frontends/p4/tableApply.h"
-#include "lib/nullstream.h"
-#include "pathEncoding.h"
+#include "lib/log.h"
 
 namespace graphs {
 
-extern std::map<std::string, std::pair<int, int> > actionMap;
-extern std::map<std::string, int> tableActionScaling;
+std::map<std::string, std::pair<int, int> > actionMap;
+std::map<std::string, int> tableActionScaling;
+
+namespace {
+
+int addPaths(int a, int b) {
+    long long sum = static_cast<long long>(a) + b;
+    return sum > INT_MAX ? INT_MAX : static_cast<int>(sum);
+}
+
+int multiplyPaths(int a, int b) {
+    long long product = static_cast<long long>(a) * b;
+    return product > INT_MAX ? INT_MAX : static_cast<int>(product);
+}
+
+}  // namespace
 
 PathEncoding::PathEncoding(P4::ReferenceMap *refMap, P4::TypeMap *typeMap)
     : refMap(refMap), typeMap(typeMap) {
     visitDagOnce = true;
 }
 
-int PathEncoding::findScaling(IR::Node *statement) {
-	int sequentialScaling = 1;
-	auto ancestor = getContext();
-	auto search = getOriginal();
-	statement->dbprint(std::cout);
-	std::cout << "\n\n";
-	while (!ancestor->node->is<IR::Apply>() && !ancestor->node->is<IR::P4Control>() && !ancestor->node->is<IR::P4Action>()) {
-		if (ancestor->node->is<IR::BlockStatement>()){
-			auto parent = ancestor->node->to<IR::BlockStatement>();
-			bool flag = false;
-			parent->dbprint(std::cout);
-			std::cout << "\n\n";
-			for (auto c : parent->components) {
-				c->dbprint(std::cout);
-				std::cout << "\n\n";
-				if (*c == *search || c->getNode() == search) {
-					flag = true;
-					continue;
-				}
-				if (flag) {
-					sequentialScaling *= c->numPaths;
-				}
-			}
-		}
-		std::cout << search->node_type_name() << " " << ancestor->node->node_type_name() << "\n";
-		search = ancestor->original;
-		ancestor = ancestor->parent;
-	}
-	return sequentialScaling;
+Visitor::profile_t PathEncoding::init_apply(const IR::Node *root) {
+    // The maps describe the last program the pass was applied to
+    actionMap.clear();
+    tableActionScaling.clear();
+    return Modifier::init_apply(root);
+}
+
+std::string PathEncoding::callKey(const IR::MethodCallStatement *statement) const {
+    std::ostringstream key;
+    auto instance = P4::MethodInstance::resolve(statement->methodCall, refMap, typeMap);
+    if (auto am = instance->to<P4::ApplyMethod>()) {
+        if (am->isTableApply())
+            key << am->object->to<IR::P4Table>()->name;
+    } else {
+        key << statement->methodCall;
+    }
+    return key.str();
+}
+
+void PathEncoding::scaleCalls(const IR::Node *node, int scaling) {
+    if (auto block = node->to<IR::BlockStatement>()) {
+        for (auto c : block->components) {
+            auto it = sequentialScaling.find(c);
+            int following = it == sequentialScaling.end() ? 1 : it->second;
+            scaleCalls(c, multiplyPaths(scaling, following));
+        }
+    } else if (auto statement = node->to<IR::IfStatement>()) {
+        scaleCalls(statement->ifTrue, scaling);
+        if (statement->ifFalse != nullptr)
+            scaleCalls(statement->ifFalse, scaling);
+    } else if (auto statement = node->to<IR::SwitchStatement>()) {
+        for (auto scase : statement->cases)
+            if (scase->statement != nullptr)
+                scaleCalls(scase->statement, scaling);
+    } else if (auto statement = node->to<IR::MethodCallStatement>()) {
+        auto key = callKey(statement);
+        if (actionMap.count(key) == 1)
+            actionMap[key].second = scaling;
+    }
 }
 
 void PathEncoding::postorder(IR::IfStatement *statement) {
-   	if (statement->ifFalse == nullptr) {
-   		statement->numPaths = statement->ifTrue->numPaths + 1;
-   	}
-   	else {
-   		statement->numPaths = statement->ifTrue->numPaths + statement->ifFalse->numPaths;
-   	}
-    return;
+    int ifFalse = statement->ifFalse == nullptr ? 1 : statement->ifFalse->numPaths;
+    statement->numPaths = addPaths(statement->ifTrue->numPaths, ifFalse);
 }
 
 void PathEncoding::postorder(IR::SwitchStatement *statement) {
-   	for (auto scase : statement->cases) {
-	   	statement->numPaths += scase->statement->numPaths;
-	}
-    return;
+    // Labels without a statement fall through to the next case
+    statement->numPaths = 0;
+    std::set<cstring> labels;
+    bool hasDefault = false;
+    for (unsigned index = 0; index < statement->cases.size(); ++index) {
+        auto scase = statement->cases.at(index);
+        if (scase->label->is<IR::DefaultExpression>())
+            hasDefault = true;
+        else
+            labels.emplace(scase->label->to<IR::PathExpression>()->path->name);
+        if (scase->statement != nullptr)
+            statement->numPaths = addPaths(statement->numPaths, scase->statement->numPaths);
+        else if (index + 1 == statement->cases.size())
+            statement->numPaths = addPaths(statement->numPaths, 1);
+    }
+    // The implicit default case
+    if (!hasDefault) {
+        auto table = P4::TableApplySolver::isActionRun(statement->expression, refMap, typeMap);
+        if (table == nullptr || labels.size() < table->getActionList()->size())
+            statement->numPaths = addPaths(statement->numPaths, 1);
+    }
 }
 
 void PathEncoding::postorder(IR::BlockStatement *block) {
-    for (auto c : block->components) {
-    	block->numPaths *= c->numPaths;
+    // From the last component back, each component is scaled by the number
+    // of paths through the components following it.
+    int scaling = 1;
+    for (size_t index = block->components.size(); index-- > 0; ) {
+        auto c = block->components.at(index);
+        sequentialScaling[c] = scaling;
+        scaling = multiplyPaths(scaling, c->numPaths);
     }
-
-    return;
+    block->numPaths = scaling;
 }
 
 void PathEncoding::postorder(IR::MethodCallStatement *statement) {
-	std::ostringstream key;
-	auto instance = P4::MethodInstance::resolve(statement->methodCall, refMap, typeMap);
-	if (instance->is<P4::ApplyMethod>()) {
-   		auto am = instance->to<P4::ApplyMethod>();
-   		if (am->isTableApply()) {
-   			auto table = am->object->to<IR::P4Table>();
-   			key << table->name;
-   		}
-   	}
-   	else {
-    	key << statement->methodCall;
-    }
-
-    std::string keyString = key.str();
-    if (actionMap.count(key.str()) == 1) {
-		statement->numPaths = actionMap[key.str()].first;
-		actionMap[key.str()].second = findScaling(statement);
-	}
-	for(auto elem : actionMap) {
-	   std::cout << elem.first << " " << elem.second.first << " " << elem.second.second << "\n";
-	}
-    
-    return;
+    auto key = callKey(statement);
+    if (actionMap.count(key) == 1)
+        statement->numPaths = actionMap[key].first;
 }
 
 void PathEncoding::postorder(IR::P4Action *action) {
     std::ostringstream key;
     key << action->name << "();";
-   	action->numPaths = action->body->numPaths;
-   	if (actionMap.count(key.str()) == 0) {
-		actionMap[key.str()] = std::pair<int, int> (action->numPaths, 1);
-	}
-
-    return;
+    action->numPaths = action->body->numPaths;
+    if (actionMap.count(key.str()) == 0)
+        actionMap[key.str()] = std::pair<int, int>(action->numPaths, 1);
+    scaleCalls(action->body, 1);
 }
 
 void PathEncoding::postorder(IR::P4Table *table) {
-	std::cout << getContext()->node->node_type_name() << "\n";
-	table->dbprint(std::cout);
-	std::cout << "\n";
-	table->numPaths = 0;
-	auto actionList = table->getActionList();
-	actionList->dbprint(std::cout);
-	std::cout << "\n";
-	for (int index = actionList->actionList.size() - 1; index >=0; index--) {
-		auto a = actionList->actionList.at(index);
-		std::ostringstream elKey;
-		elKey << a;
-		std::string elKeyString = elKey.str();
-		if (elKeyString.rfind(" ") != std::string::npos) {
-			elKeyString = elKeyString.erase(0 , elKeyString.rfind(" ") + 1);
-		}
-		if (actionMap.count(elKeyString)) {
-			tableActionScaling[elKeyString] = table->numPaths;
-			table->numPaths += actionMap[elKeyString].first;
-		}
-	}
-
-	std::ostringstream key;
-    key << table->name;
-    std::string keyString = key.str();
-   	if (actionMap.count(key.str()) == 0) {
-		actionMap[key.str()] = std::pair<int, int> (table->numPaths, 1);
-	}
-    return;
-}
-
-
-void PathEncoding::postorder(IR::Node *node) {
-    std::vector<const IR::Node *> children;
-    //node->get_children(children);
-    node->numPaths = 0;
-    for (unsigned int i = 0; i < children.size(); i++) {
-        if (children[i] != nullptr) {
-            node->numPaths += children[i]->numPaths;
+    table->numPaths = 0;
+    auto actionList = table->getActionList();
+    for (int index = actionList->actionList.size() - 1; index >= 0; index--) {
+        auto a = actionList->actionList.at(index);
+        std::ostringstream elKey;
+        elKey << a;
+        std::string elKeyString = elKey.str();
+        if (elKeyString.rfind(" ") != std::string::npos)
+            elKeyString = elKeyString.erase(0, elKeyString.rfind(" ") + 1);
+        if (actionMap.count(elKeyString)) {
+            tableActionScaling[elKeyString] = table->numPaths;
+            table->numPaths = addPaths(table->numPaths, actionMap[elKeyString].first);
         }
     }
-    if (node->numPaths == 0) {
-        node->numPaths = 1;
-    }
-    return;
-}
 
-bool PathEncoding::preorder(IR::PackageBlock *block) {
-    for (auto it : block->constantValue) {
-	    if (it.second->is<IR::ControlBlock>()) {          
-	        visit(it.second->getNode());
-	    }
-	}
-    return true;
+    std::ostringstream key;
+    key << table->name;
+    if (actionMap.count(key.str()) == 0)
+        actionMap[key.str()] = std::pair<int, int>(table->numPaths, 1);
 }
 
-
-bool PathEncoding::preorder(IR::P4Control * control) {
-	control->controlLocals.dbprint(std::cout);
-	std::cout << "\n";
-	control->body->dbprint(std::cout);
-	std::cout << "\n";
-
-	//visit action befor table or apply
-	for (auto e : control->controlLocals) {
-		e->dbprint(std::cout);
-		std::cout << "\n";
-		if (e->is<IR::P4Action>()) {
-			visit(e->to<IR::P4Action>());
-		}
-	}
-	for (auto e : control->controlLocals) {
-		visit(e);
-	}
-    return true;
+void PathEncoding::postorder(IR::P4Control *control) {
+    scaleCalls(control->body, 1);
+    sequentialScaling.clear();
+    for (auto &elem : actionMap)
+        LOG3(elem.first << " " << elem.second.first << " " << elem.second.second);
 }
 
-bool PathEncoding::preorder(IR::BlockStatement * statement) {
-	//visit in reverse order to sequentialScaling to be calculatable
-	for (int index = statement->components.size() - 1; index >= 0; index--) {
-		visit(statement->components.at(index));
-	}
-    return true;
+void PathEncoding::postorder(IR::Node *node) {
+    node->numPaths = 1;
 }
 
-
-bool PathEncoding::preorder(IR::MethodCallStatement *statement) {
-	std::cout << "\n";
-	statement->dbprint(std::cout);
-	std::cout << "\n";
-    auto instance = P4::MethodInstance::resolve(statement->methodCall, refMap, typeMap);
-    if (instance->is<P4::ActionCall>()) {
-    	auto ac = instance->to<P4::ActionCall>();
-    	if (ac->action->numPaths <= 1) {
-    		visit(ac->action);
-    	}
-   	}
-   	if (instance->is<P4::ApplyMethod>()) {
-   		auto am = instance->to<P4::ApplyMethod>();
-   		if (am->object->is<IR::P4Table>()) {
-   			auto table = am->object->to<IR::P4Table>();
-			std::cout << "\n";
-			table->dbprint(std::cout);
-			std::cout << "\n";
-
-   			visit(am->object->to<IR::P4Table>());
-   		}
-   	}
+bool PathEncoding::preorder(IR::PackageBlock *block) {
+    for (auto it : block->constantValue) {
+        if (it.second->is<IR::ControlBlock>())
+            visit(it.second->getNode());
+    }
     return true;
-
 }
-bool PathEncoding::preorder(IR::P4Table *) {
-    return true;
 
-} 
-bool PathEncoding::preorder(IR::Node *) {
+bool PathEncoding::preorder(IR::P4Control *) {
+    // Actions and tables are declared before they are used: the control
+    // locals are visited, and their paths counted, before the body.
+    sequentialScaling.clear();
     return true;
 }
 
-}
\ No newline at end of file
+}  // namespace graphs
@@ -1,23 +1,41 @@
-#ifndef PATH_ENCODING_H
-#define PATH_ENCODING_H
+#ifndef _BACKENDS_GRAPHS_PATHENCODING_H_
+#define _BACKENDS_GRAPHS_PATHENCODING_H_
+
 #include <map>
+#include <string>
 #include <utility>
-#include "graphs.h"
+
+#include "ir/ir.h"
+
+namespace P4 {
+
+class ReferenceMap;
+class TypeMap;
+
+}  // namespace P4
 
 namespace graphs {
 
+/// The number of paths through each action and table, and by how much the
+/// ids of their paths are scaled: the number of paths through the statements
+/// following their call.  Keyed by table name or by action call.
+extern std::map<std::string, std::pair<int, int> > actionMap;
+/// The offset of the paths of each action in the paths of its table.
+extern std::map<std::string, int> tableActionScaling;
+
+/// Sets the numPaths of the statements of the controls, and fills actionMap.
+/// Path counts are computed bottom-up in a single pass; the scaling of each
+/// call then follows from the suffix products kept for the components of
+/// the blocks, in a walk down the body of the control.  Counts which do not
+/// fit an int saturate at INT_MAX.
 class PathEncoding : public Modifier {
-  public:
+ public:
     PathEncoding(P4::ReferenceMap *refMap, P4::TypeMap *typeMap);
-    int findScaling(IR::Node *statement);
+
+    profile_t init_apply(const IR::Node *root) override;
 
     bool preorder(IR::PackageBlock *block) override;
     bool preorder(IR::P4Control *cont) override;
-    bool preorder(IR::BlockStatement *statement) override;
-    bool preorder(IR::MethodCallStatement *statement) override;
-    bool preorder(IR::P4Table *table) override;
-
-    bool preorder(IR::Node *) override;
 
     void postorder(IR::Node *node) override;
     void postorder(IR::IfStatement *statement) override;
@@ -26,10 +44,21 @@ class PathEncoding : public Modifier {
     void postorder(IR::MethodCallStatement *statement) override;
     void postorder(IR::P4Action *action) override;
     void postorder(IR::P4Table *table) override;
+    void postorder(IR::P4Control *control) override;
 
  private:
     P4::ReferenceMap *refMap; P4::TypeMap *typeMap;
+    /// The number of paths through the components following each component
+    /// of a block, up to the end of the block.
+    std::map<const IR::Node *, int> sequentialScaling;
+
+    /// @returns the key of the table applied or the action called by @statement.
+    std::string callKey(const IR::MethodCallStatement *statement) const;
+    /// Sets the scaling of the calls in @node, @scaling being the number of
+    /// paths from the end of @node to the end of the body.
+    void scaleCalls(const IR::Node *node, int scaling);
 };
 
-}
-#endif
\ No newline at end of file
+}  // namespace graphs
+
+#endif  // _BACKENDS_GRAPHS_PATHENCODING_H_
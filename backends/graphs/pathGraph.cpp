@@ -0,0 +1,451 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "pathGraph.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/methodInstance.h"
+#include "frontends/p4/tableApply.h"
+#include "frontends/p4/typeMap.h"
+#include "lib/error.h"
+
+namespace graphs {
+
+/// Adds the branches of the statements it visits to a PathGraph.
+class BuildPathGraph : public Inspector {
+    PathGraph *graph;
+    P4::ReferenceMap *refMap;
+    P4::TypeMap *typeMap;
+    /// The vertex control is at.
+    unsigned current = 0;
+
+    /// The index of an arm and the statement in it, if any.
+    using ArmBody = std::pair<unsigned, const IR::Node *>;
+
+    /// Adds @arms of @branch from the current vertex to a new join vertex.
+    void addBranch(const IR::Node *branch, const std::vector<ArmBody> &arms) {
+        unsigned from = current;
+        std::vector<std::pair<unsigned, unsigned>> ends;
+        for (auto &body : arms) {
+            unsigned arm = graph->arms.size();
+            current = graph->addVertex();
+            graph->arms.push_back({branch, body.first, graph->edges.size()});
+            graph->addEdge(from, current, arm);
+            if (body.second != nullptr)
+                visit(body.second);
+            ends.emplace_back(arm, current);
+        }
+        // The join is created after the arms to keep vertices in topological order
+        unsigned join = graph->addVertex();
+        for (auto &end : ends)
+            graph->addEdge(end.second, join, end.first);
+        current = join;
+    }
+
+ public:
+    BuildPathGraph(PathGraph *graph, P4::ReferenceMap *refMap, P4::TypeMap *typeMap)
+        : graph(graph), refMap(refMap), typeMap(typeMap) {
+        // Actions called from several places are part of the graph at each place
+        visitDagOnce = false;
+    }
+
+    bool preorder(const IR::Expression *) override { return false; }
+
+    bool preorder(const IR::IfStatement *statement) override {
+        addBranch(statement, { { 0, statement->ifFalse }, { 1, statement->ifTrue } });
+        return false;
+    }
+
+    bool preorder(const IR::SwitchStatement *statement) override {
+        std::vector<ArmBody> arms;
+        std::set<cstring> labels;
+        bool hasDefault = false;
+        for (unsigned index = 0; index < statement->cases.size(); ++index) {
+            auto c = statement->cases.at(index);
+            if (c->label->is<IR::DefaultExpression>())
+                hasDefault = true;
+            else
+                labels.emplace(c->label->to<IR::PathExpression>()->path->name);
+            // Labels without a statement fall through to the next case
+            if (c->statement != nullptr || index + 1 == statement->cases.size())
+                arms.emplace_back(index, c->statement);
+        }
+        if (!hasDefault) {
+            auto table = P4::TableApplySolver::isActionRun(statement->expression,
+                                                           refMap, typeMap);
+            if (table == nullptr || labels.size() < table->getActionList()->size())
+                arms.emplace_back(statement->cases.size(), nullptr);
+        }
+        addBranch(statement, arms);
+        return false;
+    }
+
+    bool preorder(const IR::MethodCallStatement *statement) override {
+        auto instance = P4::MethodInstance::resolve(statement, refMap, typeMap);
+        if (auto apply = instance->to<P4::ApplyMethod>()) {
+            if (!apply->isTableApply())
+                return false;
+            auto actionList = apply->object->to<IR::P4Table>()->getActionList();
+            if (actionList == nullptr || actionList->size() == 0)
+                return false;
+            // Actions are numbered in the reverse order of the action list
+            std::vector<ArmBody> arms;
+            for (unsigned index = actionList->size(); index-- > 0; ) {
+                auto element = actionList->actionList.at(index);
+                auto action = refMap->getDeclaration(element->getPath(), true);
+                arms.emplace_back(index, action->to<IR::P4Action>()->body);
+            }
+            addBranch(statement, arms);
+        } else if (auto call = instance->to<P4::ActionCall>()) {
+            visit(call->action->body);
+        }
+        return false;
+    }
+};
+
+PathGraph::PathGraph(const IR::P4Control *control, P4::ReferenceMap *refMap,
+                     P4::TypeMap *typeMap)
+    : PathGraph(control->body, refMap, typeMap) { }
+
+PathGraph::PathGraph(const IR::Statement *body, P4::ReferenceMap *refMap,
+                     P4::TypeMap *typeMap) {
+    addVertex();
+    BuildPathGraph build(this, refMap, typeMap);
+    body->apply(build);
+    number();
+}
+
+unsigned PathGraph::addVertex() {
+    out.emplace_back();
+    return out.size() - 1;
+}
+
+unsigned PathGraph::addEdge(unsigned from, unsigned to, unsigned arm) {
+    Edge edge;
+    edge.from = from;
+    edge.to = to;
+    edge.arm = arm;
+    edges.push_back(edge);
+    out.at(from).push_back(edges.size() - 1);
+    return edges.size() - 1;
+}
+
+void PathGraph::number() {
+    paths.assign(vertices(), 1);
+    for (unsigned v = vertices(); v-- > 0; ) {
+        if (out[v].empty())
+            continue;
+        mpz_class sum = 0;
+        for (auto e : out[v]) {
+            edges[e].value = sum;
+            sum += paths[edges[e].to];
+        }
+        paths[v] = sum;
+    }
+}
+
+void PathGraph::placeIncrements(const PathCounts *profile, const std::vector<bool> *preferred) {
+    // Estimated frequencies break the ties between edges the profile does not tell apart
+    std::vector<double> estimate(edges.size()), flow(vertices());
+    flow[0] = 1;
+    for (unsigned v = 0; v < vertices(); ++v) {
+        for (auto e : out[v]) {
+            estimate[e] = flow[v] / out[v].size();
+            flow[edges[e].to] += estimate[e];
+        }
+    }
+    std::vector<double> counts = profile != nullptr ? edgeCounts(*profile)
+                                                    : std::vector<double>(edges.size());
+    double total = 0;
+    for (auto e : out.front())
+        total += counts[e];
+    frequency = estimate;
+    for (unsigned e = 0; total > 0 && e < edges.size(); ++e)
+        frequency[e] = counts[e] / total;
+    auto isPreferred = [&](unsigned e) {
+        return preferred != nullptr && preferred->at(edges[e].arm); };
+    std::vector<unsigned> order(edges.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+        if (isPreferred(a) != isPreferred(b))
+            return isPreferred(a);
+        if (counts[a] != counts[b])
+            return counts[a] > counts[b];
+        return estimate[a] > estimate[b];
+    });
+
+    // Kruskal's algorithm; the edges left out of the tree are the chords.
+    // The edge from the end back to the start, which closes every path, is
+    // always a chord: its increment is the initial value of the register.
+    std::vector<unsigned> component(vertices());
+    std::iota(component.begin(), component.end(), 0);
+    auto find = [&](unsigned v) {
+        while (component[v] != v)
+            v = component[v] = component[component[v]];
+        return v;
+    };
+    std::vector<std::vector<unsigned>> tree(vertices());
+    for (auto e : order) {
+        auto &edge = edges[e];
+        unsigned from = find(edge.from), to = find(edge.to);
+        edge.chord = from == to;
+        if (edge.chord)
+            continue;
+        component[from] = to;
+        tree[edge.from].push_back(e);
+        tree[edge.to].push_back(e);
+    }
+
+    // The potential of a vertex is the value of the path register along the
+    // tree path from the start, so that the increment of a chord is the
+    // difference it makes to the value of the cycle it closes.
+    std::vector<mpz_class> potential(vertices());
+    std::vector<bool> reached(vertices());
+    std::vector<unsigned> stack = { 0 };
+    reached[0] = true;
+    while (!stack.empty()) {
+        unsigned v = stack.back();
+        stack.pop_back();
+        for (auto e : tree[v]) {
+            auto &edge = edges[e];
+            unsigned other = edge.from == v ? edge.to : edge.from;
+            if (reached[other])
+                continue;
+            if (edge.from == v)
+                potential[other] = potential[v] + edge.value;
+            else
+                potential[other] = potential[v] - edge.value;
+            reached[other] = true;
+            stack.push_back(other);
+        }
+    }
+    for (auto &edge : edges) {
+        if (edge.chord)
+            edge.increment = edge.value + potential[edge.from] - potential[edge.to];
+        else
+            edge.increment = 0;
+    }
+    init = potential.back();
+}
+
+bool PathGraph::decode(mpz_class id, std::vector<unsigned> &path) const {
+    path.clear();
+    if (id < 0 || id >= numPaths())
+        return false;
+    unsigned v = 0;
+    while (!out[v].empty()) {
+        // The edge with the largest value not above what is left of the id
+        auto &edgesOut = out[v];
+        auto next = std::upper_bound(edgesOut.begin(), edgesOut.end(), id,
+            [this](const mpz_class &id, unsigned e) { return id < edges[e].value; });
+        unsigned e = *(next - 1);
+        id -= edges[e].value;
+        path.push_back(e);
+        v = edges[e].to;
+    }
+    return true;
+}
+
+std::vector<double> PathGraph::edgeCounts(const PathCounts &profile) const {
+    std::vector<double> counts(edges.size());
+    std::vector<unsigned> path;
+    for (auto &sample : profile) {
+        if (!decode(sample.first, path)) {
+            ::warning(ErrorType::WARN_INVALID, "%1%: not a path id, ignored",
+                      sample.first.get_str());
+            continue;
+        }
+        for (auto e : path)
+            counts[e] += sample.second;
+    }
+    return counts;
+}
+
+ControlPaths::ControlPaths(const IR::P4Control *control, P4::ReferenceMap *refMap,
+                           P4::TypeMap *typeMap, const mpz_class &maxPaths) {
+    auto &components = control->body->components;
+    PathGraph whole(control, refMap, typeMap);
+    if (maxPaths <= 0 || whole.numPaths() <= maxPaths) {
+        mpz_class size = whole.numPaths();
+        regions.push_back(Region{0, components.size(), std::move(whole), 0, size, false});
+        return;
+    }
+
+    // Statements are added to a region as long as its paths stay within the bound
+    mpz_class offset = 0, paths = 1, hashSize = 1;
+    while (hashSize * 2 <= maxPaths)
+        hashSize *= 2;
+    size_t begin = 0;
+    auto close = [&](size_t end) {
+        auto body = new IR::BlockStatement(control->body->srcInfo);
+        for (size_t index = begin; index < end; ++index)
+            body->components.push_back(components.at(index));
+        PathGraph graph(body, refMap, typeMap);
+        bool hashed = graph.numPaths() > maxPaths;
+        mpz_class size = hashed ? hashSize : graph.numPaths();
+        regions.push_back(Region{begin, end, std::move(graph), offset, size, hashed});
+        offset += size;
+        begin = end;
+        paths = 1;
+    };
+    for (size_t index = 0; index < components.size(); ++index) {
+        auto statement = components.at(index)->to<IR::Statement>();
+        mpz_class statementPaths = 1;
+        if (statement != nullptr)
+            statementPaths = PathGraph(statement, refMap, typeMap).numPaths();
+        if (index > begin && paths * statementPaths > maxPaths)
+            close(index);
+        paths *= statementPaths;
+    }
+    close(components.size());
+}
+
+mpz_class ControlPaths::size() const {
+    return regions.back().offset + regions.back().size;
+}
+
+mpz_class ControlPaths::numPaths() const {
+    mpz_class paths = 1;
+    for (auto &region : regions)
+        paths *= region.graph.numPaths();
+    return paths;
+}
+
+const ControlPaths::Region *ControlPaths::find(const mpz_class &index, mpz_class &id) const {
+    if (index < 0 || index >= size())
+        return nullptr;
+    auto region = std::upper_bound(regions.begin(), regions.end(), index,
+        [](const mpz_class &index, const Region &region) { return index < region.offset; });
+    --region;
+    id = index - region->offset;
+    return &*region;
+}
+
+std::vector<PathCounts> ControlPaths::split(const PathCounts &profile) const {
+    std::vector<PathCounts> counts(regions.size());
+    mpz_class id;
+    for (auto &sample : profile)
+        if (auto region = find(sample.first, id))
+            counts[region - regions.data()][id] += sample.second;
+    return counts;
+}
+
+bool PathProfile::read(std::istream &in) {
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    auto text = buffer.str();
+    return read(text.data(), text.size());
+}
+
+namespace {
+
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+mpz_class toMpz(uint64_t v) {
+    mpz_class rv;
+    mpz_import(rv.get_mpz_t(), 1, 1, sizeof(v), 0, 0, &v);
+    return rv;
+}
+
+/// Parses the decimal number at @p into @value, if it fits 64 bits.
+/// @returns the end of the digits, or nullptr if there are none or too many.
+const char *parseUint64(const char *p, const char *end, uint64_t &value) {
+    const char *start = p;
+    value = 0;
+    for (; p < end && isDigit(*p); ++p) {
+        uint64_t digit = *p - '0';
+        if (value > (UINT64_MAX - digit) / 10)
+            return nullptr;
+        value = value * 10 + digit;
+    }
+    return p == start ? nullptr : p;
+}
+
+}  // namespace
+
+bool PathProfile::read(const char *data, size_t size) {
+    // Dumps repeat the same few ids many times: the counts of the ids which
+    // fit 64 bits are added up in hash tables, and converted once per id.
+    std::map<cstring, std::unordered_map<uint64_t, uint64_t>> small;
+    cstring control = "";
+    auto *current = &small[control];
+    const char *end = data + size;
+    unsigned lineNumber = 1;
+    for (const char *line = data; line < end; ++lineNumber) {
+        auto eol = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (eol == nullptr)
+            eol = end;
+        const char *p = line;
+        line = eol + 1;
+        while (p < eol && isBlank(*p)) ++p;
+        if (p == eol || *p == '#')
+            continue;
+
+        const char *first = p;
+        while (p < eol && !isBlank(*p)) ++p;
+        const char *firstEnd = p;
+        while (p < eol && isBlank(*p)) ++p;
+        if (p == eol && !isDigit(*first)) {
+            control = cstring(first, firstEnd - first);
+            current = &small[control];
+            continue;
+        }
+
+        uint64_t id, count;
+        const char *idEnd = parseUint64(first, firstEnd, id);
+        const char *countEnd = parseUint64(p, eol, count);
+        // Ids too wide for 64 bits take the slow path
+        bool wide = idEnd == nullptr && std::all_of(first, firstEnd, isDigit);
+        if ((idEnd != firstEnd && !wide) || countEnd == nullptr ||
+            std::find_if_not(countEnd, eol, isBlank) != eol) {
+            ::error("path profile, line %1%: expected a path id and a count", lineNumber);
+            return false;
+        }
+        if (wide)
+            counts[control][mpz_class(std::string(first, firstEnd))] += count;
+        else
+            (*current)[id] += count;
+    }
+    for (auto &table : small) {
+        if (table.second.empty())
+            continue;
+        auto &controlCounts = counts[table.first];
+        for (auto &sample : table.second)
+            controlCounts[toMpz(sample.first)] += sample.second;
+    }
+    return true;
+}
+
+const PathCounts *PathProfile::get(cstring control) const {
+    auto it = counts.find(control);
+    if (it == counts.end())
+        it = counts.find("");
+    return it == counts.end() ? nullptr : &it->second;
+}
+
+}  // namespace graphs
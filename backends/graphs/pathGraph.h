@@ -0,0 +1,185 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _BACKENDS_GRAPHS_PATHGRAPH_H_
+#define _BACKENDS_GRAPHS_PATHGRAPH_H_
+
+#include <iosfwd>
+#include <map>
+#include <vector>
+
+#include "ir/ir.h"
+
+namespace P4 {
+
+class ReferenceMap;
+class TypeMap;
+
+}  // namespace P4
+
+namespace graphs {
+
+/// The number of times each path through a control was taken, by path id.
+using PathCounts = std::map<mpz_class, uint64_t>;
+
+/// The acyclic control flow graph of a control, on which the paths from the
+/// start to the end of the apply block are numbered as described by Ball and
+/// Larus, "Efficient Path Profiling" (MICRO 1996).
+///
+/// Vertices are the points where control flow branches or joins.  Each arm
+/// of a branch -- a branch of an if statement, a case of a switch statement,
+/// an action of an applied table -- contributes an edge from the branch to
+/// the start of the arm and an edge from the end of the arm to the join.
+/// Actions which are called directly are part of the graph of their caller.
+/// Vertices are numbered in topological order: 0 is the start of the
+/// control, the last vertex is its end.
+class PathGraph {
+ public:
+    /// An arm of a branch of the control.
+    struct Arm {
+        /// The IfStatement, the SwitchStatement or the MethodCallStatement
+        /// applying a table.
+        const IR::Node *branch;
+        /// 1 for the true branch of an if statement and 0 for the false one;
+        /// the index of the case in a switch statement, which is the number
+        /// of cases for the implicit default case; the index of the action
+        /// in the action list of a table.
+        unsigned index;
+        /// The edge from the branch to the start of the arm.
+        unsigned start;
+    };
+
+    struct Edge {
+        unsigned from, to;
+        /// The arm the edge enters or leaves.
+        unsigned arm;
+        /// What the edge adds to the id of the paths taking it.
+        mpz_class value;
+        /// What the edge adds to the path register, if it is a chord.
+        mpz_class increment;
+        bool chord = false;
+    };
+
+    std::vector<Arm> arms;
+    std::vector<Edge> edges;
+    /// The edges leaving each vertex, by increasing value.
+    std::vector<std::vector<unsigned>> out;
+    /// The number of paths from each vertex to the end of the control.
+    std::vector<mpz_class> paths;
+    /// The value the path register starts with.
+    mpz_class init;
+    /// How often each edge is taken per run of the control, according to the
+    /// profile or estimated, as computed by placeIncrements.
+    std::vector<double> frequency;
+
+    /// Builds and numbers the graph of the apply block of @control.
+    PathGraph(const IR::P4Control *control, P4::ReferenceMap *refMap, P4::TypeMap *typeMap);
+    /// Builds and numbers the graph of the statement @body.
+    PathGraph(const IR::Statement *body, P4::ReferenceMap *refMap, P4::TypeMap *typeMap);
+
+    unsigned vertices() const { return out.size(); }
+    const mpz_class &numPaths() const { return paths.front(); }
+
+    /// Chooses the chords on which to place the increments of the path
+    /// register: the edges which are not part of a maximum spanning tree of
+    /// the graph, so that the increments are placed on the coldest edges.
+    /// Edge frequencies come from @profile if given, and otherwise are
+    /// estimated by assuming that every arm of a branch is equally likely.
+    /// The edges of arms in @preferred are taken into the tree first.
+    void placeIncrements(const PathCounts *profile = nullptr,
+                         const std::vector<bool> *preferred = nullptr);
+
+    /// Computes the edges along the path numbered @id.
+    /// @returns false if there is no such path.
+    bool decode(mpz_class id, std::vector<unsigned> &path) const;
+
+    /// @returns how many times each edge was taken according to @profile.
+    std::vector<double> edgeCounts(const PathCounts &profile) const;
+
+ private:
+    friend class BuildPathGraph;
+    friend class ParserPaths;
+
+    PathGraph() = default;
+    unsigned addVertex();
+    unsigned addEdge(unsigned from, unsigned to, unsigned arm);
+    void number();
+};
+
+/// The paths of the apply block of a control, numbered in regions: runs of
+/// consecutive top-level statements with at most maxPaths paths, so that the
+/// ids of the paths of a control fit a counter of bounded size.  Each region
+/// is numbered on its own PathGraph, and its ids are counted at the indices
+/// of the counter which follow those of the previous regions.  A statement
+/// with more paths than the bound is a region of its own, whose ids are
+/// hashed to their low bits.  Without a bound, or if the control has few
+/// enough paths, the whole apply block is a single region.
+class ControlPaths {
+ public:
+    struct Region {
+        /// The top-level statements of the region, as a range of indices
+        /// into the components of the apply block.
+        size_t begin, end;
+        PathGraph graph;
+        /// The first counter index of the region and the number of indices
+        /// it takes.
+        mpz_class offset, size;
+        /// The ids are hashed into size indices, a power of two.
+        bool hashed;
+    };
+
+    /// The bound on the paths of a region instrumentation uses by default.
+    static const uint64_t defaultMaxPaths = 1 << 16;
+
+    std::vector<Region> regions;
+
+    /// Numbers the paths of @control; a @maxPaths of 0 is no bound.
+    ControlPaths(const IR::P4Control *control, P4::ReferenceMap *refMap, P4::TypeMap *typeMap,
+                 const mpz_class &maxPaths);
+
+    /// The number of counter indices of all regions.
+    mpz_class size() const;
+    /// The number of paths through the control.
+    mpz_class numPaths() const;
+    /// @returns the region counter index @index belongs to, or nullptr if it
+    /// is out of range, and sets @id to the id or the hash within the region.
+    const Region *find(const mpz_class &index, mpz_class &id) const;
+    /// @returns the counts of @profile, indexed by counter index, by region
+    /// and by id within the region.
+    std::vector<PathCounts> split(const PathCounts &profile) const;
+};
+
+/// The path counts of the controls of a program.
+class PathProfile {
+ public:
+    std::map<cstring, PathCounts> counts;
+
+    /// Reads a profile: every line holds a path id and the number of times
+    /// the path was taken, or the name of the control the following lines
+    /// are about.  Lines starting with '#' are ignored.  Counts for the same
+    /// path are added up.
+    /// @returns false, after reporting an error, if the input is malformed.
+    bool read(std::istream &in);
+    bool read(const char *data, size_t size);
+
+    /// @returns the counts of @control.  Counts which follow no control name
+    /// are used for all controls which are not named.
+    const PathCounts *get(cstring control) const;
+};
+
+}  // namespace graphs
+
+#endif  // _BACKENDS_GRAPHS_PATHGRAPH_H_
@@ -20,6 +20,7 @@ limitations under the License.
 #include "backends/p4test/version.h"
 #include "control-plane/p4RuntimeSerializer.h"
 #include "ir/ir.h"
+#include "ir/ir_binary.h"
 #include "ir/json_loader.h"
 #include "lib/log.h"
 #include "lib/error.h"
@@ -39,6 +40,7 @@ class P4TestOptions : public CompilerOptions {
     bool parseOnly = false;
     bool validateOnly = false;
     bool loadIRFromJson = false;
+    cstring dumpBinaryFile = nullptr;
     P4TestOptions() {
         registerOption("--parse-only", nullptr,
                        [this](const char*) {
@@ -57,7 +59,14 @@ class P4TestOptions : public CompilerOptions {
                            file = arg;
                            return true;
                        },
-                       "read previously dumped json instead of P4 source code");
+                       "read previously dumped json (or binary IR) instead of P4 source code");
+        registerOption("--toBinaryIR", "file",
+                       [this](const char* arg) {
+                           dumpBinaryFile = arg;
+                           return true;
+                       },
+                       "Dump the compiler IR after the midend in binary form, which\n"
+                       "--fromJSON reloads much faster than json");
      }
 };
 
@@ -93,12 +102,16 @@ int main(int argc, char *const argv[]) {
     const IR::P4Program *program = nullptr;
     auto hook = options.getDebugHook();
     if (options.loadIRFromJson) {
-        std::ifstream json(options.file);
-        if (json) {
-            JSONLoader loader(json);
+        BinaryIR::File binary(options.file);
+        std::ifstream json;
+        if (binary.error()) json.open(options.file);
+        if (!binary.error() || json) {
             const IR::Node* node = nullptr;
-            loader >> node;
-            if (!(program = node->to<IR::P4Program>()))
+            if (!binary.error())
+                node = BinaryIR::load(binary);
+            else
+                JSONLoader(json) >> node;
+            if (!node || !(program = node->to<IR::P4Program>()))
                 error("%s is not a P4Program in json format", options.file);
         } else {
             error("Can't open %s", options.file); }
@@ -150,7 +163,10 @@ int main(int argc, char *const argv[]) {
             log_dump(top, "Top level block");
         }
         if (options.dumpJsonFile)
-            JSONGenerator(*openFile(options.dumpJsonFile, true), true) << program << std::endl;
+            JSONGenerator(*openFile(options.dumpJsonFile, true), true, options.dumpJsonCompact)
+                << program << std::endl;
+        if (options.dumpBinaryFile)
+            BinaryIR::write(*openFile(options.dumpBinaryFile, true), program, true);
         if (options.debugJson) {
             std::stringstream ss1, ss2;
             JSONGenerator gen1(ss1), gen2(ss2);
@@ -10,6 +10,9 @@
 /* Define to 1 if you have the LIBGC library. */
 #cmakedefine HAVE_LIBGC 1
 
+/* Define to 1 to support per-compilation arena allocation. */
+#cmakedefine HAVE_ARENA_ALLOCATOR 1
+
 /* Define to 1 if you have the memchr function. */
 #cmakedefine HAVE_MEMCHR 1
 
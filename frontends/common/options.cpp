@@ -21,12 +21,14 @@ limitations under the License.
 #include <unordered_set>
 
 #include "options.h"
+#include "preprocessor.h"
 #include "lib/log.h"
 #include "lib/exceptions.h"
 #include "lib/nullstream.h"
 #include "lib/path.h"
 #include "frontends/p4/toP4/toP4.h"
 #include "ir/json_generator.h"
+#include "ir/pass_profile.h"
 
 const char* p4includePath = CONFIG_PKGDATADIR "/p4include";
 const char* p4_14includePath = CONFIG_PKGDATADIR "/p4_14include";
@@ -60,6 +62,9 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("--nocpp", nullptr,
                    [this](const char*) { doNotPreprocess = true; return true; },
                    "Skip preprocess, assume input file is already preprocessed.");
+    registerOption("--external-preprocessor", nullptr,
+                   [this](const char*) { externalPreprocessor = true; return true; },
+                   "Run the system C preprocessor instead of the built-in one");
     registerOption("--p4v", "{14|16}",
                    [this](const char* arg) {
                        if (!strcmp(arg, "1.0") || !strcmp(arg, "14")) {
@@ -97,6 +102,9 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("--toJSON", "file",
                    [this](const char* arg) { dumpJsonFile = arg; return true; },
                    "Dump the compiler IR after the midend as JSON in the specified file.");
+    registerOption("--compactJSON", nullptr,
+                   [this](const char*) { dumpJsonCompact = true; return true; },
+                   "Write the --toJSON output without newlines or indentation.");
     registerOption("--p4runtime-files", "filelist",
                    [this](const char* arg) { p4RuntimeFiles = arg; return true; },
                    "Write the P4Runtime control plane API description to the specified\n"
@@ -198,6 +206,11 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("--dump", "folder",
                    [this](const char* arg) { dumpFolder = arg; return true; },
                    "[Compiler debugging] Folder where P4 programs are dumped\n");
+    registerOption("--profile-passes", "file",
+                   [](const char* arg) { PassProfile::enable(arg); return true; },
+                   "[Compiler debugging] Write the time, memory allocated and IR nodes\n"
+                   "visited and cloned by each pass to the specified file, in Chrome\n"
+                   "trace-event JSON format.");
     registerUsage("loglevel format is:\n"
                   "  sourceFile:level,...,sourceFile:level\n"
                   "where 'sourceFile' is a compiler source file and\n"
@@ -310,10 +323,22 @@ void CompilerOptions::validateOptions() const {
 
 FILE* CompilerOptions::preprocess() {
     FILE* in = nullptr;
+    P4::Preprocessor cpp;
 
     if (file == "-") {
         file = "<stdin>";
         in = stdin;
+    } else if (!externalPreprocessor && setupPreprocessor(cpp)) {
+        if (Log::verbose())
+            std::cerr << "Preprocessing " << file << std::endl;
+        if (!cpp.preprocess(file, preprocessed))
+            return nullptr;
+        in = fmemopen(&preprocessed[0], preprocessed.size(), "r");
+        if (in == nullptr) {
+            ::error("Error reading preprocessor output");
+            return nullptr;
+        }
+        close_memory = true;
     } else {
 #ifdef __clang__
         std::string cmd("cc -E -x c -Wno-comment");
@@ -353,7 +378,21 @@ FILE* CompilerOptions::preprocess() {
     return in;
 }
 
+bool CompilerOptions::setupPreprocessor(P4::Preprocessor& cpp) const {
+    if (!cpp.addOptions(preprocessor_options))
+        return false;  // options only the system preprocessor understands
+    // headers from the standard include paths are kept for later compilations
+    char * driverP4IncludePath =
+      isv1() ? getenv("P4C_14_INCLUDE_PATH") : getenv("P4C_16_INCLUDE_PATH");
+    if (driverP4IncludePath)
+        cpp.addIncludePath(driverP4IncludePath, true);
+    cpp.addIncludePath(isv1() ? p4_14includePath : p4includePath, true);
+    return true;
+}
+
 void CompilerOptions::closeInput(FILE* inputStream) const {
+    if (close_memory)
+        fclose(inputStream);
     if (close_input) {
         int exitCode = pclose(inputStream);
         if (WIFEXITED(exitCode) && WEXITSTATUS(exitCode) == 4)
@@ -27,6 +27,10 @@ limitations under the License.
 // for p4::P4RuntimeFormat definition
 #include "control-plane/p4RuntimeSerializer.h"
 
+namespace P4 {
+class Preprocessor;
+}  // namespace P4
+
 // Standard include paths for .p4 header files. The values are determined by
 // `configure`.
 extern const char* p4includePath;
@@ -37,10 +41,15 @@ extern const char* p4_14includePath;
 // Each back-end should subclass this file.
 class CompilerOptions : public Util::Options {
     bool close_input = false;
+    bool close_memory = false;      // the input is `preprocessed`
+    std::string preprocessed;
     static const char* defaultMessage;
 
     // Checks if parsed options make sense with respect to each-other.
     void validateOptions() const;
+    // Passes the preprocessor options to the built-in preprocessor; false
+    // if it doesn't understand them.
+    bool setupPreprocessor(P4::Preprocessor& cpp) const;
 
  protected:
     // Function that is returned by getDebugHook.
@@ -67,6 +76,8 @@ class CompilerOptions : public Util::Options {
     bool doNotCompile = false;
     // if true skip preprocess
     bool doNotPreprocess = false;
+    // if true run the system preprocessor instead of the built-in one
+    bool externalPreprocessor = false;
     // debugging dumps of programs written in this folder
     cstring dumpFolder = ".";
     // Pretty-print the program in the specified file
@@ -77,6 +88,9 @@ class CompilerOptions : public Util::Options {
     // Dump a JSON representation of the IR in the file
     cstring dumpJsonFile = nullptr;
 
+    // Write the JSON representation without newlines or indentation
+    bool dumpJsonCompact = false;
+
     // Dump and undump the IR tree
     bool debugJson = false;
 
@@ -0,0 +1,1616 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "preprocessor.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include "lib/error.h"
+#include "lib/gc.h"
+
+/* The expansion algorithm, including where white space is (and isn't) output,
+ * follows GCC's cpplib closely, so that the output is the same as cpp's.  In
+ * cpplib terms: comments are tokens (-C), there are no digraphs or named
+ * operators, unknown directives and `# <number>` lines are passed through as
+ * text and pasting tokens that don't form a token is not an error
+ * (-x assembler-with-cpp). */
+
+namespace P4 {
+
+namespace {
+
+enum TokenType : uint8_t {
+    NAME, NUMBER, CHAR, STRING, HEADER, PUNCT, OTHER, COMMENT,
+    MACRO_ARG,      // a parameter in a macro body
+    PADDING,        // where white space may be needed in the output
+    END,            // end of the input, a directive, or a macro argument
+};
+
+enum : uint8_t {
+    WHITE = 1,          // preceded by white space
+    BOL = 2,            // first token on a line
+    NO_EXPAND = 4,      // a macro name that must not be expanded
+    PASTE_LEFT = 8,     // followed by ## in a macro body
+    STRINGIFY = 16,     // a MACRO_ARG preceded by #
+    SOURCE = 32,        // PADDING: WHITE is copied from the token it stands for
+};
+
+struct Token {
+    TokenType   type = END;
+    uint8_t     flags = 0;
+    uint16_t    arg = 0;        // MACRO_ARG: the parameter number
+    unsigned    line = 0;
+    unsigned    col = 0;
+    cstring     text;
+
+    bool is(char c) const {
+        return type == PUNCT && text.c_str()[0] == c && text.c_str()[1] == 0; }
+    bool is(const char *s) const { return type == PUNCT && text == s; }
+};
+
+Token padding(const Token *source) {
+    Token rv;
+    rv.type = PADDING;
+    if (source) rv.flags = SOURCE | (source->flags & WHITE);
+    return rv;
+}
+
+/// The names the preprocessor looks for, interned once
+struct Names {
+    cstring define = "define", undef = "undef", include = "include",
+            include_next = "include_next", import = "import", if_ = "if", ifdef = "ifdef",
+            ifndef = "ifndef", elif = "elif", elifdef = "elifdef", elifndef = "elifndef",
+            else_ = "else", endif = "endif", line = "line", error = "error", warning = "warning",
+            pragma = "pragma", ident = "ident", sccs = "sccs", assert = "assert",
+            unassert = "unassert", defined = "defined", once = "once", va_args = "__VA_ARGS__",
+            has_include = "__has_include", has_include_next = "__has_include_next";
+};
+
+const Names &names() {
+    static const Names *names = [] { gc_global_allocation global; return new Names; }();
+    return *names;
+}
+
+unsigned newlines(cstring text) {
+    unsigned rv = 0;
+    for (const char *p = text.c_str(); (p = strchr(p, '\n')); ++p) ++rv;
+    return rv;
+}
+
+bool isIdent(unsigned char c) {
+    return isalnum(c) || c == '_' || c == '$' || c >= 0x80; }
+
+/// The tokens of a file
+struct SourceFile {
+    cstring             path;
+    std::vector<Token>  tokens;
+    cstring             guard;      // macro guarding the whole file against reinclusion
+    struct timespec     mtime = {};
+    off_t               size = 0;
+    ino_t               inode = 0;
+};
+
+const char *const punctuators[] = {
+    "<<=", ">>=", "...", "->", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=", "##", nullptr };
+
+/// Splits text into tokens.  Line splices are removed before tokenizing, as
+/// cpp does; tokens keep the line and column they start at in the original.
+class Lexer {
+    std::string         text;
+    std::vector<size_t> splices;    // offsets in text where a spliced line starts
+    cstring             path;
+    std::vector<Token>  &tokens;
+
+    void clean(const char *data, size_t size) {
+        text.reserve(size);
+        for (const char *p = data, *end = data + size; p < end; ++p) {
+            if (*p == '\\') {
+                const char *q = p + 1;
+                while (q < end && (*q == ' ' || *q == '\t')) ++q;
+                if (q < end && *q == '\r') ++q;
+                if (q < end && *q == '\n') {
+                    splices.push_back(text.size());
+                    p = q;
+                    continue; }
+            } else if (*p == '\r') {
+                if (p + 1 < end && p[1] == '\n') continue;
+                text += '\n';
+                continue; }
+            text += *p; }
+    }
+
+ public:
+    bool error = false;
+
+    Lexer(cstring path, std::vector<Token> &tokens) : path(path), tokens(tokens) {}
+
+    void lex(const char *data, size_t size) {
+        if (memchr(data, '\\', size) || memchr(data, '\r', size))
+            clean(data, size);
+        else
+            text.assign(data, size);
+        const char *base = text.c_str(), *p = base, *end = base + text.size();
+        const char *lineStart = p, *tracked = p;
+        unsigned line = 1;
+        size_t nextSplice = 0;
+        bool bol = true, white = false;
+        enum { NONE, HASH, INCLUDE, OTHER_DIRECTIVE } directive = NONE;
+
+        while (p < end) {
+            char c = *p;
+            if (c == '\n') {
+                bol = true;
+                white = false;
+                directive = NONE;
+                ++p;
+                continue; }
+            if (c == ' ' || c == '\t' || c == '\f' || c == '\v' || c == '\0') {
+                white = true;
+                ++p;
+                continue; }
+
+            // where the token starts
+            for (; tracked < p; ++tracked) {
+                while (nextSplice < splices.size() &&
+                       splices[nextSplice] == size_t(tracked - base)) {
+                    ++line;
+                    lineStart = tracked;
+                    ++nextSplice; }
+                if (*tracked == '\n') {
+                    ++line;
+                    lineStart = tracked + 1; } }
+            while (nextSplice < splices.size() && splices[nextSplice] == size_t(p - base)) {
+                ++line;
+                lineStart = p;
+                ++nextSplice; }
+
+            Token tok;
+            tok.line = line;
+            tok.col = p - lineStart + 1;
+            tok.flags = (white ? WHITE : 0) | (bol ? BOL : 0);
+            const char *start = p;
+            if (c == '/' && p[1] == '*') {
+                const char *close = strstr(p + 2, "*/");
+                if (!close) {
+                    ::error("%1%(%2%): unterminated comment", path, line);
+                    error = true;
+                    p = end;
+                } else {
+                    p = close + 2; }
+                tok.type = COMMENT;
+            } else if (c == '/' && p[1] == '/') {
+                while (p < end && *p != '\n') ++p;
+                tok.type = COMMENT;
+            } else if (isIdent(c) && !isdigit(c)) {
+                while (isIdent(*p)) ++p;
+                tok.type = NAME;
+            } else if (isdigit(c) || (c == '.' && isdigit(p[1]))) {
+                for (++p; ; ++p) {
+                    if (isIdent(*p) || *p == '.') continue;
+                    if ((*p == '+' || *p == '-') && strchr("eEpP", p[-1])) continue;
+                    break; }
+                tok.type = NUMBER;
+            } else if (c == '"' || c == '\'') {
+                const char *q = p + 1;
+                while (q < end && *q != c && *q != '\n')
+                    q += (*q == '\\' && q + 1 < end && q[1] != '\n') ? 2 : 1;
+                if (q < end && *q == c) {
+                    p = q + 1;
+                    tok.type = c == '"' ? STRING : CHAR;
+                } else {
+                    // an unterminated literal is just text in assembler
+                    p = q;
+                    tok.type = OTHER; }
+            } else if (c == '<' && directive == INCLUDE && strcspn(p, ">\n") < size_t(end - p)
+                       && p[strcspn(p, ">\n")] == '>') {
+                p += strcspn(p, ">\n") + 1;
+                tok.type = HEADER;
+            } else if (strchr("[](){}.&*+-~!/%<>^|?:;=,#", c)) {
+                tok.type = PUNCT;
+                ++p;
+                for (auto *punct = punctuators; *punct; ++punct) {
+                    size_t len = strlen(*punct);
+                    if (strncmp(start, *punct, len) == 0) {
+                        p = start + len;
+                        break; } }
+            } else {
+                tok.type = OTHER;
+                ++p; }
+            tok.text = cstring(start, p - start);
+
+            if (tok.type != COMMENT) {
+                if (bol && tok.is('#'))
+                    directive = HASH;
+                else if (directive == HASH && tok.type == NAME &&
+                         (tok.text == names().include || tok.text == names().include_next ||
+                          tok.text == names().import))
+                    directive = INCLUDE;
+                else if (directive != NONE)
+                    directive = OTHER_DIRECTIVE; }
+            tokens.push_back(tok);
+            bol = white = false; }
+    }
+};
+
+/// Does the whole of @file look like `#ifndef X ... #endif`?  Then it need not
+/// be read again while X is defined (cpp's multiple include optimization).
+cstring findGuard(const std::vector<Token> &tokens) {
+    auto directive = [&](size_t i) -> cstring {
+        if (i + 1 < tokens.size() && (tokens[i].flags & BOL) && tokens[i].is('#') &&
+            tokens[i + 1].type == NAME && !(tokens[i + 1].flags & BOL))
+            return tokens[i + 1].text;
+        return nullptr; };
+    if (directive(0) != names().ifndef || tokens.size() < 3 || tokens[2].type != NAME ||
+        (tokens[2].flags & BOL))
+        return nullptr;
+    cstring guard = tokens[2].text;
+    int depth = 0;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        cstring name = directive(i);
+        if (!name) continue;
+        if (name == names().if_ || name == names().ifdef || name == names().ifndef) {
+            ++depth;
+        } else if (depth == 1 && (name == names().else_ || name == names().elif ||
+                                  name == names().elifdef || name == names().elifndef)) {
+            return nullptr;
+        } else if (name == names().endif && --depth == 0) {
+            for (size_t j = i + 1; j < tokens.size(); ++j)
+                if (tokens[j].flags & BOL) return nullptr;
+            return guard; } }
+    return nullptr;
+}
+
+bool fileInfo(cstring path, struct stat &st) {
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+std::shared_ptr<const SourceFile> readFile(cstring path, const struct stat &st, bool &error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return nullptr;
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    auto rv = std::make_shared<SourceFile>();
+    rv->path = path;
+    rv->mtime = st.st_mtim;
+    rv->size = st.st_size;
+    rv->inode = st.st_ino;
+    Lexer lexer(path, rv->tokens);
+    lexer.lex(contents.data(), contents.size());
+    rv->guard = findGuard(rv->tokens);
+    error = lexer.error;
+    return rv;
+}
+
+/// Files from the standard include directories, kept across compilations
+struct FileCache {
+    std::mutex                                                          lock;
+    std::unordered_map<cstring, std::shared_ptr<const SourceFile>>      files;
+};
+
+FileCache &fileCache() {
+    static FileCache *cache = [] { gc_global_allocation global; return new FileCache; }();
+    return *cache;
+}
+
+std::string quote(cstring s) {
+    std::string rv;
+    for (const char *p = s.c_str(); *p; ++p) {
+        if (*p == '\\' || *p == '"') rv += '\\';
+        rv += *p; }
+    return rv;
+}
+
+/// Can @a and @b be written next to each other without changing the tokens
+/// (cpp_avoid_paste)?
+bool mustSeparate(const Token &a, const Token &b) {
+    char c = b.type == PUNCT ? b.text.c_str()[0] : 0;
+    if (a.type == PUNCT) {
+        const char *s = a.text.c_str();
+        static const char *const eq[] = {
+            "=", "!", ">", "<", "+", "-", "*", "/", "%", "&", "|", "^", ">>", "<<", nullptr };
+        if (c == '=') {
+            for (auto *e = eq; *e; ++e)
+                if (strcmp(s, *e) == 0) return true; }
+        if (s[1] == 0) {
+            switch (s[0]) {
+            case '>': return c == '>';
+            case '<': return c == '<' || c == '%' || c == ':';
+            case '+': return c == '+';
+            case '-': return c == '-' || c == '>';
+            case '/': return c == '/' || c == '*';
+            case '%': return c == ':' || c == '%';
+            case '&': return c == '&';
+            case '|': return c == '|';
+            case ':': return c == ':' || c == '>';
+            case '.': return c == '.' || c == '%' || b.type == NUMBER;
+            case '#': return c == '#' || c == '%'; } }
+        return strcmp(s, "->") == 0 && c == '*'; }
+    if (a.type == NAME)
+        return b.type == NAME || b.type == NUMBER || b.type == CHAR || b.type == STRING;
+    if (a.type == NUMBER)
+        return b.type == NUMBER || b.type == NAME || b.type == CHAR ||
+               c == '.' || c == '+' || c == '-';
+    if (a.type == OTHER && a.text.c_str()[0] == '\\' && b.type == NAME)
+        return true;
+    return false;
+}
+
+}  // namespace
+
+class Preprocessor::Engine {
+    const Preprocessor &pp;
+    std::string &out;
+    const Names &names;
+
+    struct Macro {
+        enum Builtin { NONE, FILE_, LINE_, BASE_FILE_, INCLUDE_LEVEL_, COUNTER_, DATE_, TIME_ };
+        cstring                 name;
+        std::vector<Token>      body;
+        std::vector<cstring>    params;
+        bool                    funlike = false;
+        bool                    variadic = false;
+        bool                    disabled = false;
+        Builtin                 builtin = NONE;
+    };
+    std::vector<std::unique_ptr<Macro>>         allMacros;
+    std::unordered_map<cstring, Macro *>        macros;
+
+    struct Context {
+        const Token             *tokens;
+        size_t                  pos = 0, count;
+        std::vector<Token>      owned;
+        Macro                   *macro;
+        Context(const Token *tokens, size_t count, Macro *macro)
+        : tokens(tokens), count(count), macro(macro) {}
+        Context(std::vector<Token> &&owned, Macro *macro)
+        : tokens(owned.data()), count(owned.size()), owned(std::move(owned)), macro(macro) {}
+    };
+    std::vector<Context>        contexts;
+
+    struct Conditional {
+        cstring     directive;
+        unsigned    line;
+        bool        wasSkipping;    // skipping before the #if
+        bool        taken;          // some group of this #if has been (or is being) used
+        bool        sawElse;
+    };
+    struct Buffer {
+        std::shared_ptr<const SourceFile>   file;
+        size_t                              pos = 0;
+        cstring                             name;       // the file name as reported
+        cstring                             dir;        // for "" includes
+        int                                 lineDelta = 0;
+        size_t                              dirIndex;   // where it was found, for #include_next
+        unsigned                            returnLine = 0;
+        std::vector<Conditional>            ifs;
+    };
+    std::vector<Buffer>         buffers;
+    std::vector<Token>          lookahead;
+    std::unordered_map<cstring, std::shared_ptr<const SourceFile>>      files;
+    std::set<std::pair<dev_t, ino_t>>                                   once;
+
+    // cpplib state
+    int         preventExpansion = 0;
+    int         parsingArgs = 0;
+    bool        inDirective = false;
+    bool        skipping = false;
+    bool        fromContext = false;    // where the last token came from
+    bool        pendingWhite = false;   // a comment was dropped in a directive
+    bool        fatal = false;
+    bool        failed = false;
+    unsigned    expansionLine = 0;
+    unsigned    counter = 0;
+    cstring     baseFile;
+
+    // output state
+    bool        output = false;
+    unsigned    printLine = 0;
+    bool        printed = false;
+    bool        avoidPaste = false;
+    int         printSource = -1;       // -1: none, else whether the source had WHITE
+    bool        hasPrev = false;
+    Token       prev;
+
+    struct Arg {
+        std::vector<Token>      first;
+        std::vector<Token>      expanded;
+        bool                    isExpanded = false;
+        bool                    omitted = false;
+        Token                   stringified;
+        bool                    isStringified = false;
+    };
+
+    // --- diagnostics
+    unsigned currentLine() const {
+        if (buffers.empty()) return 0;
+        auto &b = buffers.back();
+        size_t pos = std::min(b.pos, b.file->tokens.size());
+        unsigned line = pos > 0 ? b.file->tokens[pos - 1].line : 1;
+        return line + b.lineDelta; }
+    cstring currentName() const {
+        return buffers.empty() ? cstring("<command-line>") : buffers.back().name; }
+    void error(const std::string &msg) {
+        ::error("%1%(%2%): %3%", currentName(), currentLine(), msg);
+        failed = true; }
+    void warning(const std::string &msg) {
+        ::warning("%1%(%2%): %3%", currentName(), currentLine(), msg); }
+
+    // --- output (c-ppoutput.c)
+    void startLine(unsigned line, cstring file, const char *flags) {
+        if (!output) return;
+        if (printed) out += '\n';
+        printed = false;
+        printLine = line;
+        out += "# ";
+        out += std::to_string(line);
+        out += " \"";
+        out += quote(file);
+        out += '"';
+        out += flags;
+        out += '\n'; }
+    void maybeStartLine(unsigned line) {
+        if (!output) return;
+        if (printed) {
+            out += '\n';
+            ++printLine;
+            printed = false; }
+        if (line >= printLine && line < printLine + 8) {
+            for (; printLine < line; ++printLine) out += '\n';
+        } else {
+            startLine(line, buffers.back().name, ""); } }
+    void lineChange(const Token &tok) {
+        if (!output || parsingArgs) return;
+        maybeStartLine(tok.line + buffers.back().lineDelta);
+        hasPrev = false;
+        printSource = -1;
+        if (tok.col > 2) out.append(tok.col - 2, ' ');
+        printed = true; }
+    void print(const Token &tok) {
+        if (tok.type == PADDING) {
+            avoidPaste = true;
+            if (printSource < 0 || (printSource == 0 && !(tok.flags & SOURCE)))
+                printSource = (tok.flags & SOURCE) ? (tok.flags & WHITE) : -1;
+            return; }
+        if (avoidPaste) {
+            if (printSource < 0) printSource = tok.flags & WHITE;
+            if (printSource || (hasPrev && mustSeparate(prev, tok)) || (!hasPrev && tok.is('#')))
+                out += ' ';
+        } else if (tok.flags & WHITE) {
+            out += ' '; }
+        avoidPaste = false;
+        printSource = -1;
+        prev = tok;
+        hasPrev = true;
+        out.append(tok.text.c_str(), tok.text.size());
+        if (tok.type == COMMENT) printLine += newlines(tok.text); }
+
+    // --- files
+    std::shared_ptr<const SourceFile> getFile(cstring path, bool cached, const struct stat &st) {
+        auto &local = files[path];
+        if (local) return local;
+        bool lexError = false;
+        if (cached) {
+            auto &cache = fileCache();
+            std::lock_guard<std::mutex> guard(cache.lock);
+            auto &entry = cache.files[path];
+            if (!entry || entry->size != st.st_size || entry->inode != st.st_ino ||
+                entry->mtime.tv_sec != st.st_mtim.tv_sec ||
+                entry->mtime.tv_nsec != st.st_mtim.tv_nsec) {
+                gc_global_allocation global;
+                entry = readFile(path, st, lexError);
+                if (lexError) {
+                    failed = true;
+                    local = entry;
+                    entry = nullptr;
+                    return local; } }
+            return local = entry; }
+        local = readFile(path, st, lexError);
+        if (lexError) failed = true;
+        return local; }
+
+    void pushFile(std::shared_ptr<const SourceFile> file, cstring name, size_t dirIndex) {
+        Buffer b;
+        b.file = file;
+        b.name = name;
+        const char *slash = strrchr(file->path.c_str(), '/');
+        b.dir = slash ? file->path.before(slash) : cstring("");
+        if (slash == file->path.c_str()) b.dir = "/";
+        b.dirIndex = dirIndex;
+        buffers.push_back(std::move(b)); }
+
+    void popBuffer() {
+        auto &b = buffers.back();
+        for (auto &cond : b.ifs)
+            ::error("%1%(%2%): unterminated #%3%", b.name, cond.line, cond.directive);
+        if (!b.ifs.empty()) failed = true;
+        skipping = false;
+        buffers.pop_back();
+        if (!buffers.empty()) startLine(buffers.back().returnLine, buffers.back().name, " 2"); }
+
+    void include(cstring name, bool angled, bool next, unsigned includeLine, unsigned returnLine) {
+        if (buffers.size() >= 200) {
+            error("#include nested depth 200 exceeds maximum of 200");
+            fatal = true;
+            return; }
+        cstring path;
+        struct stat st;
+        size_t dirIndex = SIZE_MAX;
+        bool cached = false;
+        if (name.startsWith("/")) {
+            if (fileInfo(name, st)) path = name;
+        } else {
+            size_t start = 0;
+            if (next && buffers.back().dirIndex != SIZE_MAX) {
+                start = buffers.back().dirIndex + 1;
+            } else if (!angled) {
+                auto &dir = buffers.back().dir;
+                cstring candidate = dir.isNullOrEmpty() ? name :
+                                    dir == "/" ? "/" + name : dir + "/" + name;
+                if (fileInfo(candidate, st)) path = candidate; }
+            for (size_t i = start; !path && i < pp.includePath.size(); ++i) {
+                cstring candidate = pp.includePath[i].path + "/" + name;
+                if (fileInfo(candidate, st)) {
+                    path = candidate;
+                    dirIndex = i;
+                    cached = pp.includePath[i].cached; } } }
+        if (!path) {
+            error(std::string(name) + ": No such file or directory");
+            fatal = true;
+            return; }
+        if (once.count(std::make_pair(st.st_dev, st.st_ino))) return;
+        auto file = getFile(path, cached, st);
+        if (!file) {
+            error(std::string(path) + ": can't read file");
+            fatal = true;
+            return; }
+        if (file->guard && macros.count(file->guard)) return;
+        buffers.back().returnLine = returnLine;
+        maybeStartLine(includeLine);
+        startLine(1, path, " 1");
+        pushFile(file, path, dirIndex); }
+
+    // --- tokens from files (_cpp_lex_token)
+    void unget(const Token &tok) {
+        if (fromContext)
+            --contexts.back().pos;
+        else
+            lookahead.push_back(tok); }
+
+    Token lexFile() {
+        for (;;) {
+            if (fatal) return Token();
+            Token tok;
+            if (!lookahead.empty()) {
+                tok = lookahead.back();
+                lookahead.pop_back();
+            } else {
+                auto &b = buffers.back();
+                if (b.pos == b.file->tokens.size()) {
+                    if (inDirective || parsingArgs || buffers.size() == 1) return Token();
+                    popBuffer();
+                    continue; }
+                tok = b.file->tokens[b.pos];
+                if (inDirective) {
+                    if (tok.flags & BOL) return Token();
+                    ++b.pos;
+                    if (tok.type == COMMENT) {
+                        pendingWhite = true;
+                        continue; }
+                    if (pendingWhite) tok.flags |= WHITE;
+                    pendingWhite = false;
+                    return tok; }
+                ++b.pos;
+                if (skipping) {
+                    if ((tok.flags & BOL) && tok.is('#')) directive();
+                    continue; } }
+            if (tok.flags & BOL) {
+                if (tok.is('#') && parsingArgs != 1 && directive())
+                    continue;
+                lineChange(tok); }
+            return tok; } }
+
+    /// The rest of the directive, with no macro expansion
+    Token raw() { return lexFile(); }
+    void skipLine() {
+        contexts.clear();
+        while (raw().type != END) {} }
+    /// The line after the directive just read
+    unsigned nextLine() {
+        auto &b = buffers.back();
+        if (b.pos == 0) return 1 + b.lineDelta;
+        auto &last = b.file->tokens[b.pos - 1];
+        unsigned line = last.line + 1 + (last.type == COMMENT ? newlines(last.text) : 0);
+        return line + b.lineDelta; }
+
+    // --- directives
+    bool directive() {
+        auto &b = buffers.back();
+        unsigned line = b.pos > 0 ? b.file->tokens[b.pos - 1].line : 1;
+        size_t after = b.pos;
+        bool wasParsingArgs = parsingArgs;
+        inDirective = true;
+        pendingWhite = false;
+        Token name = raw();
+        cstring dir = name.type == NAME ? name.text : cstring();
+        bool conditional = dir == names.if_ || dir == names.ifdef || dir == names.ifndef ||
+                           dir == names.elif || dir == names.elifdef || dir == names.elifndef ||
+                           dir == names.else_ || dir == names.endif;
+        if (skipping && !conditional) {
+            skipLine();
+            inDirective = false;
+            return true; }
+        if (name.type == END) {
+            inDirective = false;
+            return true; }
+        if (wasParsingArgs && dir == names.include) {
+            error("#include nested in macro arguments");
+            skipLine();
+            inDirective = false;
+            return true; }
+
+        if (dir == names.define) {
+            define();
+        } else if (dir == names.undef) {
+            Token t = raw();
+            if (t.type != NAME)
+                error(t.type == END ? "no macro name given in #undef directive"
+                                    : "macro names must be identifiers");
+            else
+                macros.erase(t.text);
+        } else if (dir == names.include || dir == names.include_next || dir == names.import) {
+            includeDirective(dir == names.include_next, line + b.lineDelta);
+            return true;
+        } else if (dir == names.if_ || dir == names.ifdef || dir == names.ifndef) {
+            bool value = false;
+            if (!skipping) value = dir == names.if_ ? evaluate() : isDefined(dir);
+            buffers.back().ifs.push_back(Conditional{ dir, line + b.lineDelta, skipping,
+                                                      skipping || value, false });
+            skipping = skipping || !value;
+        } else if (dir == names.elif || dir == names.elifdef || dir == names.elifndef) {
+            auto &ifs = buffers.back().ifs;
+            if (ifs.empty()) {
+                error("#" + std::string(dir) + " without #if");
+            } else if (ifs.back().sawElse) {
+                error("#" + std::string(dir) + " after #else");
+            } else if (ifs.back().taken) {
+                skipping = true;
+            } else {
+                skipping = false;
+                bool value = dir == names.elif ? evaluate()
+                                               : isDefined(dir == names.elifdef ? names.ifdef
+                                                                                : names.ifndef);
+                ifs.back().taken = value;
+                skipping = !value; }
+        } else if (dir == names.else_) {
+            auto &ifs = buffers.back().ifs;
+            if (ifs.empty()) {
+                error("#else without #if");
+            } else {
+                if (ifs.back().sawElse) error("#else after #else");
+                ifs.back().sawElse = true;
+                skipping = ifs.back().wasSkipping || ifs.back().taken;
+                ifs.back().taken = true; }
+        } else if (dir == names.endif) {
+            auto &ifs = buffers.back().ifs;
+            if (ifs.empty()) {
+                error("#endif without #if");
+            } else {
+                skipping = ifs.back().wasSkipping;
+                ifs.pop_back(); }
+        } else if (dir == names.line) {
+            lineDirective();
+        } else if (dir == names.error || dir == names.warning) {
+            std::string msg = "#" + std::string(dir);
+            for (Token t = raw(); t.type != END; t = raw()) {
+                if (t.flags & WHITE) msg += ' ';
+                msg += t.text; }
+            if (dir == names.error)
+                error(msg);
+            else
+                warning(msg);
+        } else if (dir == names.pragma) {
+            Token t = raw();
+            if (t.type == NAME && t.text == names.once) {
+                struct stat st;
+                if (buffers.size() == 1) {
+                    warning("#pragma once in main file");
+                    lineChange(t);  // cpp leaves the indentation of `once` in the output
+                } else if (stat(buffers.back().file->path, &st) == 0) {
+                    once.emplace(st.st_dev, st.st_ino); } }
+        } else if (dir == names.ident || dir == names.sccs || dir == names.assert ||
+                   dir == names.unassert) {
+            // dropped from assembler output
+        } else {
+            // an assembler comment or pseudo-op: the line is text
+            buffers.back().pos = after;
+            inDirective = false;
+            return false; }
+        skipLine();
+        inDirective = false;
+        return true; }
+
+    bool isDefined(cstring dir) {
+        Token t = raw();
+        if (t.type != NAME) {
+            error(t.type == END ? "no macro name given in #" + std::string(dir) + " directive"
+                                : "macro names must be identifiers");
+            return false; }
+        return (macros.count(t.text) != 0) == (dir == names.ifdef); }
+
+    void includeDirective(bool next, unsigned includeLine) {
+        Token t = raw();
+        cstring name;
+        bool angled = false;
+        if (t.type == STRING || t.type == HEADER) {
+            name = t.text.substr(1, t.text.size() - 2);
+            angled = t.type == HEADER;
+        } else {
+            unget(t);
+            std::string spelled;
+            t = getNonPadding();
+            if (t.type == STRING) {
+                name = t.text.substr(1, t.text.size() - 2);
+            } else if (t.is('<')) {
+                angled = true;
+                for (t = get(); t.type != END && !t.is('>'); t = get()) {
+                    if (t.type == PADDING) continue;
+                    if ((t.flags & WHITE) && !spelled.empty()) spelled += ' ';
+                    spelled += t.text; }
+                if (t.type == END) error("missing terminating > character");
+                name = spelled; } }
+        if (!name || name.isNullOrEmpty()) {
+            if (!failed || name) error("#include expects \"FILENAME\" or <FILENAME>");
+            skipLine();
+            inDirective = false;
+            return; }
+        skipLine();
+        unsigned returnLine = nextLine();
+        inDirective = false;
+        include(name, angled, next, includeLine, returnLine); }
+
+    void lineDirective() {
+        Token t;
+        t = getNonPadding();
+        char *end;
+        unsigned long line = t.type == NUMBER ? strtoul(t.text, &end, 10) : 0;
+        if (t.type != NUMBER || *end) {
+            error("\"" + std::string(t.text ? t.text : "") + "\" after #line is not a positive "
+                  "integer");
+            return; }
+        t = getNonPadding();
+        auto &b = buffers.back();
+        if (t.type == STRING)
+            b.name = t.text.substr(1, t.text.size() - 2);
+        else if (t.type != END)
+            error("invalid filename \"" + std::string(t.text) + "\"");
+        skipLine();
+        b.lineDelta = 0;
+        b.lineDelta = int(line) - int(nextLine());
+        startLine(line, b.name, ""); }
+
+    void define() {
+        Token name = raw();
+        if (name.type != NAME) {
+            error(name.type == END ? "no macro name given in #define directive"
+                                   : "macro names must be identifiers");
+            return; }
+        if (name.text == names.defined) {
+            error("\"defined\" cannot be used as a macro name");
+            return; }
+        std::unique_ptr<Macro> m(new Macro);
+        m->name = name.text;
+        Token t = raw();
+        if (t.is('(') && !(t.flags & WHITE)) {
+            m->funlike = true;
+            for (t = raw(); !t.is(')'); ) {
+                if (t.type == NAME && t.text != names.va_args) {
+                    for (auto p : m->params)
+                        if (p == t.text) {
+                            error("duplicate macro parameter \"" + std::string(t.text) + "\"");
+                            return; }
+                    m->params.push_back(t.text);
+                    t = raw();
+                    if (t.is("...")) {
+                        m->variadic = true;
+                        t = raw();
+                        if (!t.is(')')) {
+                            error("missing ')' in macro parameter list");
+                            return; }
+                        break; }
+                } else if (t.is("...")) {
+                    m->variadic = true;
+                    m->params.push_back(names.va_args);
+                    t = raw();
+                    if (!t.is(')')) {
+                        error("missing ')' in macro parameter list");
+                        return; }
+                    break;
+                } else {
+                    error(t.type == END ? "missing ')' in macro parameter list"
+                                        : "expected parameter name, found \"" +
+                                          std::string(t.text) + "\"");
+                    return; }
+                if (t.is(')')) break;
+                if (!t.is(',')) {
+                    error(t.type == END ? "missing ')' in macro parameter list"
+                                        : "expected ',' or ')', found \"" +
+                                          std::string(t.text) + "\"");
+                    return; }
+                t = raw(); }
+            t = raw(); }
+
+        auto param = [&](Token &tok) {
+            if (tok.type != NAME) return;
+            for (size_t i = 0; i < m->params.size(); ++i)
+                if (m->params[i] == tok.text) {
+                    tok.type = MACRO_ARG;
+                    tok.arg = i;
+                    return; } };
+        for (; t.type != END; t = raw()) {
+            if (m->funlike) param(t);
+            if (t.is("##")) {
+                if (m->body.empty()) {
+                    error("'##' cannot appear at either end of a macro expansion");
+                    return; }
+                m->body.back().flags |= PASTE_LEFT;
+                t = raw();
+                if (t.type == END) {
+                    error("'##' cannot appear at either end of a macro expansion");
+                    return; }
+                if (m->funlike) param(t);
+                m->body.push_back(t);
+                continue; }
+            if (m->funlike && t.is('#')) {
+                Token arg = raw();
+                param(arg);
+                if (arg.type == MACRO_ARG) {
+                    arg.flags = (arg.flags & ~WHITE) | STRINGIFY | (t.flags & WHITE);
+                    m->body.push_back(arg);
+                    continue; }
+                // assembler allows a # that is not followed by a parameter
+                m->body.push_back(t);
+                if (arg.type == END) break;
+                t = arg;
+                if (t.is("##")) {
+                    m->body.back().flags |= PASTE_LEFT;
+                    continue; } }
+            m->body.push_back(t); }
+        if (!m->body.empty()) m->body[0].flags &= ~WHITE;
+
+        auto it = macros.find(m->name);
+        if (it != macros.end() && !sameDefinition(*it->second, *m))
+            warning("\"" + std::string(m->name) + "\" redefined");
+        macros[m->name] = m.get();
+        allMacros.push_back(std::move(m)); }
+
+    static bool sameDefinition(const Macro &a, const Macro &b) {
+        if (a.builtin || b.builtin || a.funlike != b.funlike || a.variadic != b.variadic ||
+            a.params != b.params || a.body.size() != b.body.size())
+            return false;
+        for (size_t i = 0; i < a.body.size(); ++i) {
+            auto &x = a.body[i], &y = b.body[i];
+            if (x.type != y.type || x.text != y.text || x.arg != y.arg ||
+                (x.flags & (WHITE | PASTE_LEFT | STRINGIFY)) !=
+                (y.flags & (WHITE | PASTE_LEFT | STRINGIFY)))
+                return false; }
+        return true; }
+
+    // --- #if expressions
+    struct Value {
+        intmax_t    v;
+        bool        uns;
+        Value(intmax_t v = 0, bool uns = false) : v(v), uns(uns) {}  // NOLINT(runtime/explicit)
+    };
+    struct ExprToken {
+        enum { VALUE, OP, END } kind;
+        Value       value;
+        Token       tok;
+    };
+    ExprToken cur;
+    int skipEval = 0;
+    bool exprError = false;
+
+    void exprFail(const std::string &msg) {
+        if (!exprError) error(msg);
+        exprError = true; }
+
+    Value number(const Token &t) {
+        Value rv;
+        const char *s = t.text.c_str();
+        int base = 10;
+        if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+            base = 16;
+            s += 2;
+        } else if (s[0] == '0' && (s[1] == 'b' || s[1] == 'B')) {
+            base = 2;
+            s += 2;
+        } else if (s[0] == '0') {
+            base = 8; }
+        const char *digits = s;
+        uintmax_t v = 0;
+        bool overflow = false;
+        for (; isxdigit(*s) || *s == '.'; ++s) {
+            if (*s == '.' || (base != 16 && (*s == 'e' || *s == 'E'))) {
+                exprFail("floating constant in preprocessor expression");
+                return rv; }
+            int d = isdigit(*s) ? *s - '0' : tolower(*s) - 'a' + 10;
+            if (d >= base) break;
+            if (v > (UINTMAX_MAX - d) / base) overflow = true;
+            v = v * base + d; }
+        if (s == digits && base != 8) {
+            exprFail("invalid suffix \"" + std::string(s) + "\" on integer constant");
+            return rv; }
+        bool uns = false;
+        int longs = 0;
+        for (const char *suffix = s; *suffix; ++suffix) {
+            if ((*suffix == 'u' || *suffix == 'U') && !uns) {
+                uns = true;
+            } else if ((*suffix == 'l' || *suffix == 'L') && longs < 2) {
+                ++longs;
+            } else {
+                if (strchr("eEpP", *suffix) || *suffix == '.')
+                    exprFail("floating constant in preprocessor expression");
+                else
+                    exprFail("invalid suffix \"" + std::string(s) + "\" on integer constant");
+                return rv; } }
+        if (overflow) warning("integer constant is too large for its type");
+        rv.v = intmax_t(v);
+        rv.uns = uns || v > uintmax_t(INTMAX_MAX);
+        return rv; }
+
+    Value character(const Token &t) {
+        Value rv;
+        const char *s = t.text.c_str() + 1;
+        int c = *s;
+        if (c == '\\') {
+            c = *++s;
+            switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'a': c = '\a'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'v': c = '\v'; break;
+            case 'x': c = strtol(s + 1, nullptr, 16); break;
+            default:
+                if (c >= '0' && c <= '7') c = strtol(s, nullptr, 8); } }
+        rv.v = static_cast<signed char>(c);
+        return rv; }
+
+    cstring headerName() {
+        Token t;
+        t = getNonPadding();
+        if (t.type == STRING || t.type == HEADER) return t.text.substr(1, t.text.size() - 2);
+        if (!t.is('<')) return nullptr;
+        std::string spelled;
+        for (t = get(); t.type != END && !t.is('>'); t = get()) {
+            if (t.type == PADDING) continue;
+            if ((t.flags & WHITE) && !spelled.empty()) spelled += ' ';
+            spelled += t.text; }
+        return t.type == END ? cstring() : cstring(spelled); }
+
+    bool hasInclude(cstring name, bool angled, bool next) {
+        struct stat st;
+        if (name.startsWith("/")) return fileInfo(name, st);
+        size_t start = 0;
+        if (next && buffers.back().dirIndex != SIZE_MAX) {
+            start = buffers.back().dirIndex + 1;
+        } else if (!angled) {
+            auto &dir = buffers.back().dir;
+            if (fileInfo(dir.isNullOrEmpty() ? name : dir + "/" + name, st)) return true; }
+        for (size_t i = start; i < pp.includePath.size(); ++i)
+            if (fileInfo(pp.includePath[i].path + "/" + name, st)) return true;
+        return false; }
+
+    void advance() {
+        Token t;
+        for (t = get(); t.type == PADDING || t.type == COMMENT; t = get()) {}
+        cur.tok = t;
+        cur.value = Value();
+        if (t.type == END) {
+            cur.kind = ExprToken::END;
+        } else if (t.type == NAME && t.text == names.defined) {
+            ++preventExpansion;
+            t = getNonPadding();
+            bool paren = t.is('(');
+            if (paren) t = getNonPadding();
+            if (t.type != NAME) {
+                exprFail("operator \"defined\" requires an identifier");
+            } else {
+                cur.value.v = macros.count(t.text) || t.text == names.has_include ||
+                              t.text == names.has_include_next;
+                if (paren) {
+                    t = getNonPadding();
+                    if (!t.is(')')) exprFail("missing ')' after \"defined\""); } }
+            --preventExpansion;
+            cur.kind = ExprToken::VALUE;
+        } else if (t.type == NAME && (t.text == names.has_include ||
+                                      t.text == names.has_include_next)) {
+            bool next = t.text == names.has_include_next;
+            t = getNonPadding();
+            if (!t.is('(')) {
+                exprFail("missing '(' before \"__has_include\" operand");
+            } else {
+                Token start;
+                start = getNonPadding();
+                unget(start);
+                cstring name = headerName();
+                if (!name) {
+                    exprFail("operator \"__has_include\" requires a header-name");
+                } else {
+                    cur.value.v = hasInclude(name, start.is('<') || start.type == HEADER, next);
+                    t = getNonPadding();
+                    if (!t.is(')')) exprFail("missing ')' after \"__has_include\" operand"); } }
+            cur.kind = ExprToken::VALUE;
+        } else if (t.type == NAME) {
+            cur.kind = ExprToken::VALUE;
+        } else if (t.type == NUMBER) {
+            cur.kind = ExprToken::VALUE;
+            cur.value = number(t);
+        } else if (t.type == CHAR) {
+            cur.kind = ExprToken::VALUE;
+            cur.value = character(t);
+        } else if (t.type == PUNCT && strcmp(t.text, "#") && strcmp(t.text, "##") &&
+                   strcmp(t.text, "{") && strcmp(t.text, "}") && strcmp(t.text, "[") &&
+                   strcmp(t.text, "]") && strcmp(t.text, ";") && strcmp(t.text, ".") &&
+                   strcmp(t.text, "...") && strcmp(t.text, "->") &&
+                   (strchr(t.text, '=') == nullptr || t.is("==") || t.is("!=") ||
+                    t.is("<=") || t.is(">=")) &&
+                   !t.is("++") && !t.is("--")) {
+            cur.kind = ExprToken::OP;
+        } else {
+            exprFail("token \"" + std::string(t.text) + "\" is not valid in preprocessor "
+                     "expressions");
+            cur.kind = ExprToken::END; } }
+
+    bool isOp(const char *op) const { return cur.kind == ExprToken::OP && cur.tok.text == op; }
+
+    static int precedence(cstring op) {
+        static const std::pair<const char *, int> table[] = {
+            {"*", 10}, {"/", 10}, {"%", 10}, {"+", 9}, {"-", 9}, {"<<", 8}, {">>", 8},
+            {"<", 7}, {">", 7}, {"<=", 7}, {">=", 7}, {"==", 6}, {"!=", 6}, {"&", 5},
+            {"^", 4}, {"|", 3}, {"&&", 2}, {"||", 1} };
+        for (auto &e : table)
+            if (op == e.first) return e.second;
+        return 0; }
+
+    Value unary() {
+        if (exprError) return Value();
+        if (cur.kind == ExprToken::VALUE) {
+            Value v = cur.value;
+            advance();
+            return v; }
+        if (cur.kind == ExprToken::END) {
+            exprFail("#if with no expression");
+            return Value(); }
+        cstring op = cur.tok.text;
+        if (op == "(") {
+            advance();
+            if (isOp(")")) {
+                exprFail("missing expression between '(' and ')'");
+                return Value(); }
+            Value v = comma();
+            if (!isOp(")")) exprFail("missing ')' in expression");
+            else
+                advance();
+            return v; }
+        if (op == "+" || op == "-" || op == "!" || op == "~") {
+            advance();
+            if (cur.kind == ExprToken::END) {
+                exprFail("operator '" + std::string(op) + "' has no right operand");
+                return Value(); }
+            Value v = unary();
+            if (op == "-")
+                v.v = v.uns ? intmax_t(-uintmax_t(v.v)) : -v.v;
+            else if (op == "~")
+                v.v = ~v.v;
+            else if (op == "!")
+                v = Value(!v.v);
+            return v; }
+        exprFail("operator '" + std::string(op) + "' has no left operand");
+        return Value(); }
+
+    Value binary(int minPrec) {
+        Value lhs = unary();
+        for (;;) {
+            if (exprError) return lhs;
+            if (cur.kind == ExprToken::VALUE) {
+                exprFail("missing binary operator before token \"" + std::string(cur.tok.text) +
+                         "\"");
+                return lhs; }
+            if (cur.kind != ExprToken::OP) return lhs;
+            cstring op = cur.tok.text;
+            int prec = precedence(op);
+            if (prec == 0 || prec < minPrec) {
+                if (prec == 0 && op != ")" && op != "?" && op != ":" && op != ",")
+                    exprFail("token \"" + std::string(op) + "\" is not valid in preprocessor "
+                             "expressions");
+                return lhs; }
+            advance();
+            if (cur.kind == ExprToken::END) {
+                exprFail("operator '" + std::string(op) + "' has no right operand");
+                return lhs; }
+            bool shortCircuit = (op == "&&" && !lhs.v) || (op == "||" && lhs.v);
+            if (shortCircuit) ++skipEval;
+            Value rhs = binary(prec + 1);
+            if (shortCircuit) --skipEval;
+            lhs = apply(op, lhs, rhs); } }
+
+    Value apply(cstring op, Value a, Value b) {
+        bool uns = a.uns || b.uns;
+        uintmax_t x = a.v, y = b.v;
+        if (op == "&&") return Value(a.v && b.v);
+        if (op == "||") return Value(a.v || b.v);
+        if (op == "==") return Value(x == y);
+        if (op == "!=") return Value(x != y);
+        if (op == "<") return Value(uns ? x < y : a.v < b.v);
+        if (op == ">") return Value(uns ? x > y : a.v > b.v);
+        if (op == "<=") return Value(uns ? x <= y : a.v <= b.v);
+        if (op == ">=") return Value(uns ? x >= y : a.v >= b.v);
+        // arithmetic wraps around, as cpp's does
+        if (op == "+") return Value(x + y, uns);
+        if (op == "-") return Value(x - y, uns);
+        if (op == "*") return Value(x * y, uns);
+        if (op == "&") return Value(x & y, uns);
+        if (op == "|") return Value(x | y, uns);
+        if (op == "^") return Value(x ^ y, uns);
+        if (op == "<<" || op == ">>") {
+            bool left = (op == "<<") == (b.uns || b.v >= 0);
+            uintmax_t n = b.uns || b.v >= 0 ? y : -y;
+            if (n >= sizeof(intmax_t) * CHAR_BIT)
+                return Value(left || a.uns || a.v >= 0 ? 0 : -1, a.uns);
+            if (left) return Value(x << n, a.uns);
+            return Value(a.uns ? intmax_t(x >> n) : a.v >> n, a.uns); }
+        // division
+        if (y == 0) {
+            if (!skipEval) exprFail("division by zero in #if");
+            return Value(0, uns); }
+        if (uns) return Value(op == "/" ? x / y : x % y, true);
+        if (a.v == INTMAX_MIN && b.v == -1) return Value(op == "/" ? INTMAX_MIN : 0);
+        return Value(op == "/" ? a.v / b.v : a.v % b.v); }
+
+    Value conditional() {
+        Value cond = binary(1);
+        if (exprError || !isOp("?")) return cond;
+        advance();
+        if (!cond.v) ++skipEval;
+        Value a = comma();
+        if (!cond.v) --skipEval;
+        if (!isOp(":")) {
+            exprFail("'?' without following ':'");
+            return Value(); }
+        advance();
+        if (cond.v) ++skipEval;
+        Value b = conditional();
+        if (cond.v) --skipEval;
+        Value rv = cond.v ? a : b;
+        rv.uns = a.uns || b.uns;
+        return rv; }
+
+    Value comma() {
+        Value v = conditional();
+        while (!exprError && isOp(",")) {
+            advance();
+            v = conditional(); }
+        return v; }
+
+    bool evaluate() {
+        exprError = false;
+        skipEval = 0;
+        advance();
+        if (cur.kind == ExprToken::END && !exprError) {
+            exprFail("#if with no expression");
+            return false; }
+        Value v = comma();
+        if (!exprError && cur.kind != ExprToken::END) {
+            if (isOp(")")) exprFail("missing '(' in expression");
+            else if (isOp(":")) exprFail("':' without preceding '?'");
+            else
+                exprFail("missing binary operator before token \"" +
+                         std::string(cur.tok.text) + "\""); }
+        return !exprError && v.v != 0; }
+
+    // --- macro expansion (cpp_get_token)
+    Token get() {
+        for (;;) {
+            Token tok;
+            if (!contexts.empty()) {
+                auto &c = contexts.back();
+                if (c.pos == c.count) {
+                    if (c.macro) c.macro->disabled = false;
+                    contexts.pop_back();
+                    if (inDirective) continue;
+                    return padding(nullptr); }
+                tok = c.tokens[c.pos++];
+                fromContext = true;
+                if (tok.flags & PASTE_LEFT) {
+                    Token lhs = tok;
+                    pasteAll(lhs);
+                    if (inDirective) continue;
+                    return padding(&tok); }
+            } else {
+                tok = lexFile();
+                fromContext = false; }
+            if (tok.type != NAME || (tok.flags & NO_EXPAND)) return tok;
+            auto it = macros.find(tok.text);
+            if (it == macros.end()) return tok;
+            Macro *m = it->second;
+            if (m->disabled) {
+                tok.flags |= NO_EXPAND;
+                return tok; }
+            if (preventExpansion) return tok;
+            if (contexts.empty()) expansionLine = tok.line + buffers.back().lineDelta;
+            if (enterMacro(m, tok)) {
+                if (inDirective) continue;
+                return padding(&tok); }
+            return tok; } }
+
+    Token getNonPadding() {
+        Token t;
+        for (t = get(); t.type == PADDING; t = get()) {}
+        return t; }
+
+    bool paste(Token &lhs, const Token &rhs) {
+        std::string text = std::string(lhs.text);
+        if (lhs.is('/') && !rhs.is('=')) text += ' ';
+        text += rhs.text;
+        std::vector<Token> tokens;
+        Lexer lexer(currentName(), tokens);
+        lexer.lex(text.data(), text.size());
+        if (tokens.size() != 1 || tokens[0].type == COMMENT || tokens[0].text.size() != text.size())
+            return false;
+        tokens[0].line = lhs.line;
+        tokens[0].col = lhs.col;
+        tokens[0].flags = lhs.flags & WHITE;
+        lhs = tokens[0];
+        return true; }
+
+    void pasteAll(Token lhs) {
+        Token rhs;
+        do {
+            auto &c = contexts.back();
+            if (c.pos == c.count) break;
+            rhs = c.tokens[c.pos++];
+            if (rhs.type == PADDING) continue;
+            if (!paste(lhs, rhs)) {
+                --c.pos;
+                break; }
+        } while (rhs.flags & PASTE_LEFT);
+        lhs.flags &= ~PASTE_LEFT;
+        std::vector<Token> pasted(1, lhs);
+        contexts.emplace_back(std::move(pasted), nullptr); }
+
+    Token builtin(const Macro &m, const Token &name) {
+        Token rv;
+        rv.line = name.line;
+        rv.col = name.col;
+        switch (m.builtin) {
+        case Macro::FILE_:
+            rv.type = STRING;
+            rv.text = "\"" + quote(buffers.back().name) + "\"";
+            break;
+        case Macro::BASE_FILE_:
+            rv.type = STRING;
+            rv.text = "\"" + quote(baseFile) + "\"";
+            break;
+        case Macro::LINE_:
+            rv.type = NUMBER;
+            rv.text = std::to_string(expansionLine);
+            break;
+        case Macro::INCLUDE_LEVEL_:
+            rv.type = NUMBER;
+            rv.text = std::to_string(buffers.size() - 1);
+            break;
+        case Macro::COUNTER_:
+            rv.type = NUMBER;
+            rv.text = std::to_string(counter++);
+            break;
+        case Macro::DATE_:
+        case Macro::TIME_: {
+            char buf[32];
+            time_t now = time(nullptr);
+            struct tm tm;
+            localtime_r(&now, &tm);
+            strftime(buf, sizeof(buf), m.builtin == Macro::DATE_ ? "\"%b %e %Y\"" : "\"%T\"", &tm);
+            rv.type = STRING;
+            rv.text = buf;
+            break; }
+        case Macro::NONE:
+            break; }
+        return rv; }
+
+    bool enterMacro(Macro *m, const Token &name) {
+        if (m->builtin) {
+            if (m->builtin == Macro::LINE_ && !fromContext && contexts.empty())
+                expansionLine = name.line + buffers.back().lineDelta;
+            std::vector<Token> value(1, builtin(*m, name));
+            contexts.emplace_back(std::move(value), nullptr);
+            return true; }
+        std::vector<Arg> args;
+        if (m->funlike) {
+            ++preventExpansion;
+            parsingArgs = 1;
+            Token pad, t;
+            bool hasPad = false;
+            for (t = get(); t.type == PADDING; t = get()) {
+                if (!hasPad || !(t.flags & SOURCE)) pad = t;
+                hasPad = true; }
+            bool ok = t.is('(');
+            if (ok) {
+                parsingArgs = 2;
+                ok = collectArgs(m, args);
+            } else {
+                if (t.type != END || fromContext) unget(t);
+                if (hasPad) contexts.emplace_back(std::vector<Token>(1, pad), nullptr); }
+            parsingArgs = 0;
+            --preventExpansion;
+            if (!ok) return false; }
+        if (!m->params.empty())
+            contexts.emplace_back(replaceArgs(m, args), m);
+        else
+            contexts.emplace_back(m->body.data(), m->body.size(), m);
+        m->disabled = true;
+        return true; }
+
+    bool collectArgs(Macro *m, std::vector<Arg> &args) {
+        args.emplace_back();
+        int depth = 0;
+        for (;;) {
+            Token t = get();
+            auto &arg = args.back().first;
+            if (t.type == PADDING) {
+                if (!arg.empty()) arg.push_back(t);
+                continue; }
+            if (t.type == END) {
+                if (fromContext || inDirective) unget(t);
+                error("unterminated argument list invoking macro \"" + std::string(m->name) +
+                      "\"");
+                return false; }
+            if (t.is('(')) {
+                ++depth;
+            } else if (t.is(')')) {
+                if (depth-- == 0) break;
+            } else if (t.is(',') && depth == 0 &&
+                       !(m->variadic && args.size() == m->params.size())) {
+                while (!arg.empty() && arg.back().type == PADDING) arg.pop_back();
+                args.emplace_back();
+                continue; }
+            arg.push_back(t); }
+        auto &last = args.back().first;
+        while (!last.empty() && last.back().type == PADDING) last.pop_back();
+
+        size_t argc = args.size(), paramc = m->params.size();
+        if (argc == 1 && paramc == 0 && args[0].first.empty()) argc = 0;
+        if (argc < paramc) {
+            if (argc + 1 == paramc && m->variadic) {
+                args.emplace_back();
+                args.back().omitted = true;
+            } else {
+                error("macro \"" + std::string(m->name) + "\" requires " +
+                      std::to_string(paramc) + " arguments, but only " + std::to_string(argc) +
+                      " given");
+                return false; }
+        } else if (argc > paramc) {
+            error("macro \"" + std::string(m->name) + "\" passed " + std::to_string(argc) +
+                  " arguments, but takes just " + std::to_string(paramc));
+            return false; }
+        return true; }
+
+    void expandArg(Arg &arg) {
+        if (arg.isExpanded) return;
+        arg.isExpanded = true;
+        std::vector<Token> tokens(arg.first);
+        tokens.push_back(Token());
+        size_t depth = contexts.size();
+        contexts.emplace_back(std::move(tokens), nullptr);
+        for (Token t = get(); t.type != END; t = get())
+            arg.expanded.push_back(t);
+        while (contexts.size() > depth) contexts.pop_back(); }
+
+    Token stringify(const std::vector<Token> &tokens) {
+        std::string s = "\"";
+        int source = -1;
+        for (auto &t : tokens) {
+            if (t.type == PADDING) {
+                if (source < 0 || (source == 0 && !(t.flags & SOURCE)))
+                    source = (t.flags & SOURCE) ? (t.flags & WHITE) : -1;
+                continue; }
+            if (s.size() > 1) {
+                if (source < 0) source = t.flags & WHITE;
+                if (source) s += ' '; }
+            source = -1;
+            if (t.type == STRING || t.type == CHAR)
+                s += quote(t.text);
+            else
+                s += t.text; }
+        size_t backslashes = 0;
+        for (size_t i = s.size(); i > 1 && s[i - 1] == '\\'; --i) ++backslashes;
+        if (backslashes % 2) {
+            warning("invalid string literal, ignoring final '\\'");
+            s.pop_back(); }
+        s += '"';
+        Token rv;
+        rv.type = STRING;
+        rv.text = s;
+        return rv; }
+
+    std::vector<Token> replaceArgs(Macro *m, std::vector<Arg> &args) {
+        std::vector<Token> out;
+        for (size_t i = 0; i < m->body.size(); ++i) {
+            const Token &src = m->body[i];
+            if (src.type != MACRO_ARG) {
+                out.push_back(src);
+                continue; }
+            Arg &arg = args[src.arg];
+            ssize_t pasteFlag = -1;
+            const std::vector<Token> *from;
+            std::vector<Token> single;
+            bool afterPaste = i > 0 && (m->body[i - 1].flags & PASTE_LEFT);
+            if (src.flags & STRINGIFY) {
+                if (!arg.isStringified) {
+                    arg.stringified = stringify(arg.first);
+                    arg.isStringified = true; }
+                single.push_back(arg.stringified);
+                from = &single;
+            } else if (src.flags & PASTE_LEFT) {
+                from = &arg.first;
+            } else if (afterPaste) {
+                from = &arg.first;
+                if (!out.empty()) {
+                    if (out.back().is(',') && m->variadic && src.arg == m->params.size() - 1) {
+                        // GNU `, ## __VA_ARGS__`: drop the comma if there are no arguments
+                        if (arg.omitted) out.pop_back();
+                        else
+                            pasteFlag = out.size() - 1;
+                    } else if (from->empty()) {
+                        pasteFlag = out.size() - 1; } }
+            } else {
+                expandArg(arg);
+                from = &arg.expanded; }
+
+            if (!inDirective && i > 0 && !afterPaste) out.push_back(padding(&src));
+            if (!from->empty()) {
+                out.insert(out.end(), from->begin(), from->end());
+                if (src.flags & PASTE_LEFT) pasteFlag = out.size() - 1; }
+            if (!inDirective && !(src.flags & PASTE_LEFT)) out.push_back(padding(nullptr));
+            if (pasteFlag >= 0) {
+                if (src.flags & PASTE_LEFT)
+                    out[pasteFlag].flags |= PASTE_LEFT;
+                else
+                    out[pasteFlag].flags &= ~PASTE_LEFT; } }
+        return out; }
+
+    // --- setup
+    void builtinMacro(const char *name, Macro::Builtin kind) {
+        std::unique_ptr<Macro> m(new Macro);
+        m->name = name;
+        m->builtin = kind;
+        macros[m->name] = m.get();
+        allMacros.push_back(std::move(m)); }
+
+    void commandLine(const std::string &text, cstring name) {
+        auto file = std::make_shared<SourceFile>();
+        file->path = name;
+        Lexer lexer(name, file->tokens);
+        lexer.lex(text.data(), text.size());
+        pushFile(file, name, SIZE_MAX);
+        for (Token t = get(); t.type != END; t = get()) {}
+        buffers.clear(); }
+
+ public:
+    Engine(const Preprocessor &pp, std::string &out) : pp(pp), out(out), names(P4::names()) {}
+
+    bool run(cstring file) {
+        struct stat st;
+        if (!fileInfo(file, st)) {
+            ::error("input file %s does not exist", file);
+            return false; }
+        auto main = getFile(file, false, st);
+        if (!main) {
+            ::error("Can't read %s", file);
+            return false; }
+        baseFile = file;
+        output = true;
+        startLine(0, file, "");
+        startLine(0, "<built-in>", "");
+        startLine(0, "<command-line>", "");
+        output = false;
+
+        builtinMacro("__FILE__", Macro::FILE_);
+        builtinMacro("__LINE__", Macro::LINE_);
+        builtinMacro("__BASE_FILE__", Macro::BASE_FILE_);
+        builtinMacro("__INCLUDE_LEVEL__", Macro::INCLUDE_LEVEL_);
+        builtinMacro("__COUNTER__", Macro::COUNTER_);
+        builtinMacro("__DATE__", Macro::DATE_);
+        builtinMacro("__TIME__", Macro::TIME_);
+        commandLine("#define __STDC__ 1\n#define __STDC_HOSTED__ 1\n#define __ASSEMBLER__ 1\n",
+                    "<built-in>");
+        std::string definitions;
+        for (auto &d : pp.definitions) {
+            if (!d.second) {
+                definitions += "#undef " + std::string(d.first) + "\n";
+                continue; }
+            std::string def(d.first);
+            auto eq = def.find('=');
+            if (eq == std::string::npos)
+                definitions += "#define " + def + " 1\n";
+            else
+                definitions += "#define " + def.substr(0, eq) + " " + def.substr(eq + 1) + "\n"; }
+        commandLine(definitions, "<command-line>");
+
+        output = true;
+        pushFile(main, file, SIZE_MAX);
+        startLine(1, file, "");
+        for (Token t = get(); t.type != END; t = get())
+            print(t);
+        if (!fatal) {
+            while (buffers.size() > 1) popBuffer();
+            for (auto &cond : buffers.back().ifs) {
+                ::error("%1%(%2%): unterminated #%3%", buffers.back().name, cond.line,
+                        cond.directive);
+                failed = true; } }
+        if (printed) out += '\n';
+        return !failed && !fatal; }
+};
+
+void Preprocessor::addIncludePath(cstring dir, bool cached) {
+    std::string path(dir);
+    while (path.size() > 1 && path.back() == '/') path.pop_back();
+    includePath.push_back(Directory{ path, cached });
+}
+
+void Preprocessor::define(cstring definition) {
+    definitions.emplace_back(definition, true);
+}
+
+void Preprocessor::undefine(cstring name) {
+    definitions.emplace_back(name, false);
+}
+
+bool Preprocessor::addOptions(cstring options) {
+    std::istringstream in(options.c_str());
+    std::string option;
+    while (in >> option) {
+        if (option.size() < 2 || option[0] != '-' || !strchr("IDU", option[1])) return false;
+        std::string arg = option.substr(2);
+        if (arg.empty() && !(in >> arg)) return false;
+        if (option[1] == 'I') addIncludePath(arg);
+        else if (option[1] == 'D') define(arg);
+        else
+            undefine(arg); }
+    return true;
+}
+
+bool Preprocessor::preprocess(cstring file, std::string &output) const {
+    output.clear();
+    return Engine(*this, output).run(file);
+}
+
+void Preprocessor::clearCache() {
+    auto &cache = fileCache();
+    std::lock_guard<std::mutex> guard(cache.lock);
+    cache.files.clear();
+}
+
+}  // namespace P4
@@ -0,0 +1,71 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _FRONTENDS_COMMON_PREPROCESSOR_H_
+#define _FRONTENDS_COMMON_PREPROCESSOR_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "lib/cstring.h"
+
+namespace P4 {
+
+/**
+ * A C preprocessor that runs in the compiler process, producing the same output
+ * as `cpp -C -undef -nostdinc -x assembler-with-cpp` (as of GCC 12): the same
+ * macro expansion, spacing, comments and line markers.
+ *
+ * Files are tokenized once per compilation.  Files found in a directory added
+ * with `addIncludePath(dir, true)` (the standard p4include directories) are
+ * tokenized once per process instead, and reused by every later compilation
+ * for as long as the file is unchanged.
+ *
+ * Errors are reported with ::error, so the output should not be used if the
+ * error count went up.
+ */
+class Preprocessor {
+    class Engine;
+    struct Directory {
+        cstring path;
+        bool    cached;
+    };
+    std::vector<Directory>                      includePath;
+    std::vector<std::pair<cstring, bool>>       definitions;    // (definition, define?)
+
+ public:
+    /// Search @dir for #include files, after the directories added before it;
+    /// files found there are cached across compilations if @cached.
+    void addIncludePath(cstring dir, bool cached = false);
+    /// Handle `-D @definition`: `name`, `name=body` or `name(params)=body`.
+    void define(cstring definition);
+    /// Handle `-U @name`.
+    void undefine(cstring name);
+    /// Handle -I, -D and -U options in the form CompilerOptions collects them.
+    /// @return false if @options has anything else.
+    bool addOptions(cstring options);
+
+    /// Preprocess @file, replacing the contents of @output.
+    /// @return false if there were errors.
+    bool preprocess(cstring file, std::string &output) const;
+
+    /// Forget all the cached files.
+    static void clearCache();
+};
+
+}  // namespace P4
+
+#endif /* _FRONTENDS_COMMON_PREPROCESSOR_H_ */
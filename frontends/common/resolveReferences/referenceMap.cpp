@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
 #include <sstream>
 #include "referenceMap.h"
 #include "frontends/p4/reservedWords.h"
@@ -34,11 +35,10 @@ void ReferenceMap::setDeclaration(const IR::Path* path, const IR::IDeclaration*
     CHECK_NULL(path);
     CHECK_NULL(decl);
     LOG1("Resolved " << path << " to " << decl);
-    auto previous = get(pathToDeclaration, path);
-    if (previous != nullptr && previous != decl)
+    auto previous = pathToDeclaration.emplace(path, decl).first;
+    if (*previous != decl)
         BUG("%1% already resolved to %2% instead of %3%",
-            dbp(path), dbp(previous), dbp(decl->getNode()));
-    pathToDeclaration.emplace(path, decl);
+            dbp(path), dbp(*previous), dbp(decl->getNode()));
     usedName(path->name.name);
     used.insert(decl);
 }
@@ -70,7 +70,8 @@ const IR::IDeclaration* ReferenceMap::getDeclaration(const IR::This* pointer, bo
 
 const IR::IDeclaration* ReferenceMap::getDeclaration(const IR::Path* path, bool notNull) const {
     CHECK_NULL(path);
-    auto result = get(pathToDeclaration, path);
+    auto found = pathToDeclaration.find(path);
+    auto result = found ? *found : nullptr;
 
     if (result)
         LOG1("Looking up " << path << " found " << result->getNode());
@@ -85,7 +86,13 @@ const IR::IDeclaration* ReferenceMap::getDeclaration(const IR::Path* path, bool
 void ReferenceMap::dbprint(std::ostream &out) const {
     if (pathToDeclaration.empty())
         out << "Empty" << std::endl;
-    for (auto e : pathToDeclaration)
+    typedef std::pair<const IR::Path*, const IR::IDeclaration*> Resolved;
+    std::vector<Resolved> sorted;
+    pathToDeclaration.for_each([&](const IR::Path* path, const IR::IDeclaration* decl) {
+        sorted.emplace_back(path, decl); });
+    std::sort(sorted.begin(), sorted.end(), [](const Resolved& a, const Resolved& b) {
+        return a.first->id < b.first->id; });
+    for (auto e : sorted)
         out << dbp(e.first) << "->" << dbp(e.second) << std::endl;
 }
 
@@ -20,6 +20,7 @@ limitations under the License.
 #include "ir/ir.h"
 #include "lib/cstring.h"
 #include "lib/map.h"
+#include "lib/node_map.h"
 #include "frontends/common/programMap.h"
 
 namespace P4 {
@@ -37,7 +38,7 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
     bool isv1;
 
     /// Maps paths in the program to declarations.
-    std::map<const IR::Path*, const IR::IDeclaration*> pathToDeclaration;
+    node_map<const IR::Path*, const IR::IDeclaration*> pathToDeclaration;
 
     /// Set containing all declarations in the program.
     std::set<const IR::IDeclaration*> used;
@@ -83,6 +84,9 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
 
     /// Indicate that @p name is used in the program.
     void usedName(cstring name) { usedNames.insert(name); }
+
+    /// Bytes of memory used for the declarations of the paths.
+    size_t memory() const { return pathToDeclaration.memory(); }
 };
 
 }  // namespace P4
@@ -15,103 +15,92 @@ limitations under the License.
 */
 
 #include "resolveReferences.h"
+#include <algorithm>
+#include <iterator>
 #include <sstream>
 
 namespace P4 {
 
-std::vector<const IR::IDeclaration*>*
-ResolutionContext::resolve(IR::ID name, P4::ResolutionType type, bool forwardOK) const {
-    static std::vector<const IR::IDeclaration*> empty;
-
-    std::vector<const IR::INamespace*> toTry(stack);
-    toTry.insert(toTry.end(), globals.begin(), globals.end());
-
-    for (auto it = toTry.rbegin(); it != toTry.rend(); ++it) {
-        const IR::INamespace* current = *it;
-        LOG3("Trying to resolve in " << current->toString());
-
-        if (current->is<IR::IGeneralNamespace>()) {
-            auto gen = current->to<IR::IGeneralNamespace>();
-            Util::Enumerator<const IR::IDeclaration*>* decls = gen->getDeclsByName(name);
-            switch (type) {
-                case P4::ResolutionType::Any:
-                    break;
-                case P4::ResolutionType::Type: {
-                    std::function<bool(const IR::IDeclaration*)> kindFilter =
-                            [](const IR::IDeclaration* d) {
-                        return d->is<IR::Type>();
-                    };
-                    decls = decls->where(kindFilter);
-                    break;
-                }
-                case P4::ResolutionType::TypeVariable: {
-                    std::function<bool(const IR::IDeclaration*)> kindFilter =
-                            [](const IR::IDeclaration* d) {
-                    return d->is<IR::Type_Var>(); };
-                    decls = decls->where(kindFilter);
-                    break;
-                }
-            default:
-                BUG("Unexpected enumeration value %1%", static_cast<int>(type));
-            }
-
-            if (!forwardOK && name.srcInfo.isValid()) {
-                std::function<bool(const IR::IDeclaration*)> locationFilter =
-                        [name](const IR::IDeclaration* d) {
-                    Util::SourceInfo nsi = name.srcInfo;
-                    Util::SourceInfo dsi = d->getNode()->srcInfo;
-                    bool before = dsi <= nsi;
-                    LOG3("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
-                    return before;
-                };
-                decls = decls->where(locationFilter);
-            }
-
-            auto vector = decls->toVector();
-            if (!vector->empty()) {
-                LOG3("Resolved in " << dbp(current->getNode()));
-                return vector;
-            } else {
-                continue;
-            }
-        } else {
-            auto simple = current->to<IR::ISimpleNamespace>();
-            auto decl = simple->getDeclByName(name);
-            if (decl == nullptr)
-                continue;
-            switch (type) {
-                case P4::ResolutionType::Any:
-                    break;
-                case P4::ResolutionType::Type: {
-                    if (!decl->is<IR::Type>())
-                        continue;
-                    break;
-                }
-                case P4::ResolutionType::TypeVariable: {
-                    if (!decl->is<IR::Type_Var>())
-                        continue;
-                    break;
-                }
+const std::unordered_map<cstring, ResolutionContext::DeclVector>&
+ResolutionContext::getDecls(const IR::IGeneralNamespace* ns) const {
+    auto it = namespaceDecls.find(ns);
+    if (it != namespaceDecls.end())
+        return it->second;
+    auto &decls = namespaceDecls[ns];
+    for (auto d : *ns->getDeclarations()) {
+        CHECK_NULL(d);
+        decls[d->getName().name].push_back(d);
+    }
+    return decls;
+}
+
+const ResolutionContext::DeclVector*
+ResolutionContext::lookup(const IR::INamespace* current, IR::ID name,
+                          P4::ResolutionType type, bool forwardOK) const {
+    LOG3("Trying to resolve in " << current->toString());
+    auto matches = [&](const IR::IDeclaration* d) {
+        switch (type) {
+            case P4::ResolutionType::Any:
+                break;
+            case P4::ResolutionType::Type:
+                if (!d->is<IR::Type>())
+                    return false;
+                break;
+            case P4::ResolutionType::TypeVariable:
+                if (!d->is<IR::Type_Var>())
+                    return false;
+                break;
             default:
                 BUG("Unexpected enumeration value %1%", static_cast<int>(type));
-            }
-
-            if (!forwardOK && name.srcInfo.isValid()) {
-                Util::SourceInfo nsi = name.srcInfo;
-                Util::SourceInfo dsi = decl->getNode()->srcInfo;
-                bool before = dsi <= nsi;
-                LOG3("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
-                if (!before)
-                    continue;
-            }
-
+        }
+        if (!forwardOK && name.srcInfo.isValid()) {
+            Util::SourceInfo nsi = name.srcInfo;
+            Util::SourceInfo dsi = d->getNode()->srcInfo;
+            bool before = dsi <= nsi;
+            LOG3("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
+            return before;
+        }
+        return true;
+    };
+
+    if (auto gen = current->to<IR::IGeneralNamespace>()) {
+        auto &decls = getDecls(gen);
+        auto it = decls.find(name.name);
+        if (it == decls.end())
+            return nullptr;
+        // Only copy the declarations if some of them do not match.
+        auto &all = it->second;
+        auto first = std::find_if_not(all.begin(), all.end(), matches);
+        if (first == all.end()) {
             LOG3("Resolved in " << dbp(current->getNode()));
-            auto result = new std::vector<const IR::IDeclaration*>();
-            result->push_back(decl);
-            return result;
+            return &all;
         }
+        resolved.assign(all.begin(), first);
+        std::copy_if(first + 1, all.end(), std::back_inserter(resolved), matches);
+    } else {
+        auto simple = current->to<IR::ISimpleNamespace>();
+        auto decl = simple->getDeclByName(name);
+        if (decl == nullptr || !matches(decl))
+            return nullptr;
+        resolved.assign(1, decl);
     }
+    if (resolved.empty())
+        return nullptr;
+    LOG3("Resolved in " << dbp(current->getNode()));
+    return &resolved;
+}
 
+const std::vector<const IR::IDeclaration*>*
+ResolutionContext::resolve(IR::ID name, P4::ResolutionType type, bool forwardOK) const {
+    static const std::vector<const IR::IDeclaration*> empty;
+
+    // The globals are tried first, then the stack from the innermost namespace out.
+    for (auto it = globals.rbegin(); it != globals.rend(); ++it)
+        if (auto decls = lookup(*it, name, type, forwardOK))
+            return decls;
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+        if (auto decls = lookup(*it, name, type, forwardOK))
+            return decls;
     return &empty;
 }
 
@@ -126,15 +115,16 @@ ResolutionContext::resolveUnique(IR::ID name,
                                  bool forwardOK) const {
     const std::vector<const IR::IDeclaration*> *decls = resolve(name, type, forwardOK);
     // Check overloaded symbols.
+    std::vector<const IR::IDeclaration*> matching;
     if (!argumentStack.empty() && decls->size() > 1) {
         auto arguments = argumentStack.back();
-        decls = Util::Enumerator<const IR::IDeclaration*>::createEnumerator(*decls)->
-                where([arguments](const IR::IDeclaration* d) {
+        std::copy_if(decls->begin(), decls->end(), std::back_inserter(matching),
+                     [arguments](const IR::IDeclaration* d) {
                         auto func = d->to<IR::IFunctional>();
                         if (func == nullptr)
                             return true;
-                        return func->callMatches(arguments); })->
-                toVector();
+                        return func->callMatches(arguments); });
+        decls = &matching;
     }
 
     if (decls->empty()) {
@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _COMMON_RESOLVEREFERENCES_RESOLVEREFERENCES_H_
 #define _COMMON_RESOLVEREFERENCES_RESOLVEREFERENCES_H_
 
+#include <unordered_map>
 #include "ir/ir.h"
 #include "referenceMap.h"
 #include "lib/exceptions.h"
@@ -44,6 +45,23 @@ class ResolutionContext : public IHasDbPrint {
 
     std::vector<const IR::Vector<IR::Argument>*> argumentStack;
 
+    typedef std::vector<const IR::IDeclaration*> DeclVector;
+    /// The declarations in each general namespace by name, indexed the
+    /// first time a name is looked up there.  A namespace which is changed
+    /// is a new node, so the index never has to be invalidated while the
+    /// program being resolved is not changing.
+    mutable std::unordered_map<const IR::INamespace*,
+                               std::unordered_map<cstring, DeclVector>> namespaceDecls;
+    /// Holds the results of resolve() which are not a whole index entry.
+    mutable DeclVector resolved;
+
+    /// The declarations of @p name in @p ns which are @p type and visible
+    /// from @p name; nullptr if there are none.
+    const DeclVector* lookup(const IR::INamespace* ns, IR::ID name,
+                             ResolutionType type, bool forwardOK) const;
+    const std::unordered_map<cstring, DeclVector>&
+    getDecls(const IR::IGeneralNamespace* ns) const;
+
  public:
     explicit ResolutionContext(const IR::INamespace* rootNamespace) :
             rootNamespace(rootNamespace)
@@ -87,7 +105,8 @@ class ResolutionContext : public IHasDbPrint {
 
     /// Resolve references for @p name, restricted to @p type declarations.
     /// If @p forwardOK is `false`, the referenced location must precede the location of @p name.
-    std::vector<const IR::IDeclaration*>*
+    /// The result is only valid until the next call.
+    const std::vector<const IR::IDeclaration*>*
     resolve(IR::ID name, ResolutionType type, bool forwardOK) const;
 
     /// Resolve reference for @p name, restricted to @p type declarations, and expect one result.
@@ -30,13 +30,20 @@ bool CheckNamedArgs::checkArguments(const IR::Vector<IR::Argument>* arguments) {
             hasName = argHasName;
             first = false;
         } else {
-            if (argHasName != hasName)
-                ::error(ErrorType::ERR_INVALID,
-                        "either all or none of the arguments of a call must be named", arg);
+            if (argHasName != hasName) {
+                errors.push_back([arg]() {
+                    ::error(ErrorType::ERR_INVALID,
+                            "either all or none of the arguments of a call must be named", arg);
+                });
+            }
             if (argHasName) {
                 auto it = found.find(argName);
-                if (it != found.end())
-                    ::error("%1% and %2%: same argument name", it->second, arg);
+                if (it != found.end()) {
+                    auto prev = it->second;
+                    errors.push_back([prev, arg]() {
+                        ::error("%1% and %2%: same argument name", prev, arg);
+                    });
+                }
             }
         }
         if (argHasName)
@@ -47,12 +54,25 @@ bool CheckNamedArgs::checkArguments(const IR::Vector<IR::Argument>* arguments) {
 
 bool CheckNamedArgs::preorder(const IR::Parameter* parameter) {
     if (parameter->defaultValue != nullptr) {
-        if (parameter->isOptional())
-            ::error("%1%: optional parameters cannot have default values", parameter);
-        if (parameter->hasOut())
-            ::error("%1%: out parameters cannot have default values", parameter);
+        if (parameter->isOptional()) {
+            errors.push_back([parameter]() {
+                ::error("%1%: optional parameters cannot have default values", parameter);
+            });
+        }
+        if (parameter->hasOut()) {
+            errors.push_back([parameter]() {
+                ::error("%1%: out parameters cannot have default values", parameter);
+            });
+        }
     }
     return true;
 }
 
+void CheckNamedArgs::end_apply() {
+    for (auto& report : errors)
+        report();
+    errors.clear();
+    Inspector::end_apply();
+}
+
 }  // namespace P4
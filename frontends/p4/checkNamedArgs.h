@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef _FRONTENDS_P4_CHECKNAMEDARGS_H_
 #define _FRONTENDS_P4_CHECKNAMEDARGS_H_
 
+#include <functional>
 #include "ir/ir.h"
 
 namespace P4 {
@@ -24,11 +25,26 @@ namespace P4 {
 /// A method call must have either all or none of the arguments named.
 /// We also check that no argument appears twice.
 /// We also check that no optional parameter has a default value.
+/// The objects of a program are checked in parallel; the errors are
+/// collected and reported in program order at the end of the pass.
 class CheckNamedArgs : public Inspector {
+    std::vector<std::function<void()>> errors;
+
  public:
     CheckNamedArgs() {
         setName("CheckNamedArgs");
+        visitObjectsInParallel = true;
+    }
+    CheckNamedArgs* clone() const override {
+        auto rv = new CheckNamedArgs(*this);
+        rv->errors.clear();
+        return rv;
+    }
+    void parallel_merge(Inspector& other) override {
+        auto& o = dynamic_cast<CheckNamedArgs&>(other);
+        errors.insert(errors.end(), o.errors.begin(), o.errors.end());
     }
+    void end_apply() override;
 
     bool checkArguments(const IR::Vector<IR::Argument> *arguments);
     bool preorder(const IR::MethodCallExpression* call) override
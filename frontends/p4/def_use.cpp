@@ -283,7 +283,51 @@ bool ProgramPoints::operator==(const ProgramPoints& other) const {
     return true;
 }
 
+unsigned DefinitionIndex::locationId(const BaseLocation* location) {
+    auto it = locationIds.emplace(location, locationDefs.size());
+    if (it.second)
+        locationDefs.emplace_back();
+    return it.first->second;
+}
+
+unsigned DefinitionIndex::definition(const BaseLocation* location, const ProgramPoint& point) {
+    auto loc = locationId(location);
+    auto pt = pointIds.emplace(point, points.size());
+    if (pt.second)
+        points.push_back(point);
+    auto key = (static_cast<uint64_t>(loc) << 32) | pt.first->second;
+    auto it = defIds.emplace(key, defs.size());
+    if (it.second) {
+        defs.emplace_back(location, pt.first->second);
+        locationDefs[loc].setbit(it.first->second);
+    }
+    return it.first->second;
+}
+
+void Definitions::addBits(const BaseLocation* location, const ProgramPoints* points) {
+    for (auto &p : *points)
+        bits.setbit(index->definition(location, p));
+}
+
+std::map<const BaseLocation*, const ProgramPoints*>
+Definitions::fromBits(const bitvec& defs) const {
+    std::map<const BaseLocation*, ProgramPoints*> grouped;
+    for (auto def : defs) {
+        auto &points = grouped[index->location(def)];
+        if (points == nullptr)
+            points = new ProgramPoints();
+        points->add(index->point(def));
+    }
+    return std::map<const BaseLocation*, const ProgramPoints*>(grouped.begin(), grouped.end());
+}
+
 Definitions* Definitions::joinDefinitions(const Definitions* other) const {
+    if (index) {
+        BUG_CHECK(index == other->index, "joining definitions from different analyses");
+        auto result = new Definitions(index);
+        result->bits = bits | other->bits;
+        return result;
+    }
     auto result = new Definitions();
     for (auto d : other->definitions) {
         auto loc = d.first;
@@ -307,16 +351,26 @@ Definitions* Definitions::joinDefinitions(const Definitions* other) const {
     return result;
 }
 
+void Definitions::setDefinition(const BaseLocation* location, const ProgramPoints* point) {
+    CHECK_NULL(location); CHECK_NULL(point);
+    if (index) {
+        bits -= index->definitionsOf(location);
+        addBits(location, point);
+    } else {
+        definitions[location] = point;
+    }
+}
+
 void Definitions::setDefinition(const StorageLocation* location, const ProgramPoints* point) {
     LocationSet locset;
     locset.addCanonical(location);
     for (auto sl : locset)
-        definitions[sl->to<BaseLocation>()] = point;
+        setDefinition(sl->to<BaseLocation>(), point);
 }
 
 void Definitions::setDefinition(const LocationSet* locations, const ProgramPoints* point) {
     for (auto sl : *locations->canonicalize())
-        definitions[sl->to<BaseLocation>()] = point;
+        setDefinition(sl->to<BaseLocation>(), point);
 }
 
 void Definitions::removeLocation(const StorageLocation* location) {
@@ -324,13 +378,50 @@ void Definitions::removeLocation(const StorageLocation* location) {
     loc->addCanonical(location);
     for (auto sl : *loc) {
         auto bl = sl->to<BaseLocation>();
+        if (index) {
+            bits -= index->definitionsOf(bl);
+            continue;
+        }
         auto it = definitions.find(bl);
         if (it != definitions.end())
             definitions.erase(it);
     }
 }
 
+bool Definitions::hasLocation(const BaseLocation* location) const {
+    if (index)
+        return bits.intersects(index->definitionsOf(location));
+    return definitions.find(location) != definitions.end();
+}
+
+const ProgramPoints* Definitions::getPoints(const BaseLocation* location) const {
+    if (index) {
+        auto defs = bits & index->definitionsOf(location);
+        BUG_CHECK(!defs.empty(), "%1%: no definitions", location);
+        auto result = new ProgramPoints();
+        for (auto def : defs)
+            result->add(index->point(def));
+        return result;
+    }
+    auto r = ::get(definitions, location);
+    BUG_CHECK(r != nullptr, "%1%: no definitions", location);
+    return r;
+}
+
 const ProgramPoints* Definitions::getPoints(const LocationSet* locations) const {
+    if (index) {
+        bitvec defs;
+        for (auto sl : *locations->canonicalize()) {
+            auto bl = sl->to<BaseLocation>();
+            auto locDefs = bits & index->definitionsOf(bl);
+            BUG_CHECK(!locDefs.empty(), "%1%: no definitions", bl);
+            defs |= locDefs;
+        }
+        auto result = new ProgramPoints();
+        for (auto def : defs)
+            result->add(index->point(def));
+        return result;
+    }
     const ProgramPoints* result = new ProgramPoints();
     for (auto sl : *locations->canonicalize()) {
         auto points = getPoints(sl->to<BaseLocation>());
@@ -339,6 +430,13 @@ const ProgramPoints* Definitions::getPoints(const LocationSet* locations) const
     return result;
 }
 
+std::vector<const BaseLocation*> Definitions::getLocations() const {
+    std::vector<const BaseLocation*> result;
+    for (auto d : index ? fromBits(bits) : definitions)
+        result.push_back(d.first);
+    return result;
+}
+
 Definitions* Definitions::writes(ProgramPoint point, const LocationSet* locations) const {
     auto result = new Definitions(*this);
     auto points = new ProgramPoints();
@@ -350,6 +448,10 @@ Definitions* Definitions::writes(ProgramPoint point, const LocationSet* location
 }
 
 bool Definitions::operator==(const Definitions& other) const {
+    if (index) {
+        BUG_CHECK(index == other.index, "comparing definitions from different analyses");
+        return bits == other.bits;
+    }
     if (definitions.size() != other.definitions.size())
         return false;
     for (auto d : definitions) {
@@ -375,7 +477,7 @@ void ComputeWriteSet::enterScope(const IR::ParameterList* parameters,
     if (!clear)
         defs = currentDefinitions;
     if (defs == nullptr)
-        defs = new Definitions();
+        defs = allDefinitions->newDefinitions();
 
     auto startPoints = new ProgramPoints(entryPoint);
     auto uninit = new ProgramPoints(ProgramPoint::beforeStart);
@@ -753,8 +855,8 @@ bool ComputeWriteSet::preorder(const IR::P4Control* control) {
     LOG3("CWS Visiting " << dbp(control));
     auto startPoint = ProgramPoint(control);
     enterScope(control->getApplyParameters(), &control->controlLocals, startPoint);
-    exitDefinitions = new Definitions();
-    returnedDefinitions = new Definitions();
+    exitDefinitions = allDefinitions->newDefinitions();
+    returnedDefinitions = allDefinitions->newDefinitions();
     for (auto l : control->controlLocals) {
         if (l->is<IR::Declaration_Instance>())
             visit(l);  // process virtual Functions if any
@@ -790,13 +892,13 @@ bool ComputeWriteSet::preorder(const IR::ReturnStatement* statement) {
         visit(statement->expression);
     returnedDefinitions = returnedDefinitions->joinDefinitions(currentDefinitions);
     LOG3("Return definitions " << returnedDefinitions);
-    return setDefinitions(new Definitions());
+    return setDefinitions(allDefinitions->newDefinitions());
 }
 
 bool ComputeWriteSet::preorder(const IR::ExitStatement*) {
     exitDefinitions = exitDefinitions->joinDefinitions(currentDefinitions);
     LOG3("Exit definitions " << exitDefinitions);
-    return setDefinitions(new Definitions());
+    return setDefinitions(allDefinitions->newDefinitions());
 }
 
 bool ComputeWriteSet::preorder(const IR::EmptyStatement*) {
@@ -824,7 +926,7 @@ bool ComputeWriteSet::preorder(const IR::SwitchStatement* statement) {
     auto defs = currentDefinitions->writes(getProgramPoint(statement->expression), locs);
     (void)setDefinitions(defs, statement->expression);
     auto save = currentDefinitions;
-    auto result = new Definitions();
+    auto result = allDefinitions->newDefinitions();
     bool seenDefault = false;
     for (auto s : statement->cases) {
         currentDefinitions = save;
@@ -847,7 +949,7 @@ bool ComputeWriteSet::preorder(const IR::SwitchStatement* statement) {
 bool ComputeWriteSet::preorder(const IR::P4Action* action) {
     LOG3("CWS Visiting " << dbp(action));
     auto saveReturned = returnedDefinitions;
-    returnedDefinitions = new Definitions();
+    returnedDefinitions = allDefinitions->newDefinitions();
 
     auto decls = new IR::IndexedVector<IR::Declaration>();
     // We assume that there are no declarations in inner scopes
@@ -894,7 +996,7 @@ bool ComputeWriteSet::preorder(const IR::Function* function) {
     auto retVal = allDefinitions->storageMap->addRetVal();
     currentDefinitions->setDefinition(retVal, uninit);
 
-    returnedDefinitions = new Definitions();
+    returnedDefinitions = allDefinitions->newDefinitions();
     visit(function->body);
     currentDefinitions = currentDefinitions->joinDefinitions(returnedDefinitions);
     allDefinitions->setDefinitionsAt(callingContext, currentDefinitions);
@@ -911,7 +1013,7 @@ bool ComputeWriteSet::preorder(const IR::P4Table* table) {
     enterScope(nullptr, nullptr, pt, false);
 
     // non-deterministic call of one of the actions in the table
-    auto after = new Definitions();
+    auto after = allDefinitions->newDefinitions();
     auto beforeTable = currentDefinitions;
     auto actions = table->getActionList();
     for (auto ale : actions->actionList) {
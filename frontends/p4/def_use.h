@@ -18,6 +18,7 @@ limitations under the License.
 #define _FRONTENDS_P4_DEF_USE_H_
 
 #include "ir/ir.h"
+#include "lib/bitvec.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 
 namespace P4 {
@@ -324,35 +325,69 @@ class ProgramPoints : public IHasDbPrint {
     { return points.cend(); }
 };
 
+/// Numbers the base locations and program points seen by one analysis, and
+/// each definition (a program point writing a base location), so that sets of
+/// definitions can be represented as bit vectors.
+class DefinitionIndex {
+    std::unordered_map<const BaseLocation*, unsigned> locationIds;
+    std::unordered_map<ProgramPoint, unsigned> pointIds;
+    std::vector<ProgramPoint> points;
+    /// For each location number, the definitions of that location.
+    std::vector<bitvec> locationDefs;
+    /// Definition number of each (location number, point number) pair.
+    std::unordered_map<uint64_t, unsigned> defIds;
+    /// Location and point of each definition.
+    std::vector<std::pair<const BaseLocation*, unsigned>> defs;
+
+    unsigned locationId(const BaseLocation* location);
+
+ public:
+    /// @returns the number of the definition of @location by @point.
+    unsigned definition(const BaseLocation* location, const ProgramPoint& point);
+    /// @returns the numbers of all definitions of @location.
+    const bitvec& definitionsOf(const BaseLocation* location)
+    { return locationDefs.at(locationId(location)); }
+    const BaseLocation* location(unsigned def) const { return defs.at(def).first; }
+    const ProgramPoint& point(unsigned def) const { return points.at(defs.at(def).second); }
+};
+
 /// List of definers for each base storage (at a specific program point).
 class Definitions : public IHasDbPrint {
     /// Set of program points that have written last to each location
     /// (conservative approximation).
     std::map<const BaseLocation*, const ProgramPoints*> definitions;
+    /// If not null, the definitions are kept in @bits instead, as the
+    /// set of the numbers @index gives them.
+    DefinitionIndex* index = nullptr;
+    bitvec bits;
+
+    /// Adds the definitions of @location by @points to @bits.
+    void addBits(const BaseLocation* location, const ProgramPoints* points);
+    /// @returns the definitions in @defs, grouped by location.
+    std::map<const BaseLocation*, const ProgramPoints*> fromBits(const bitvec& defs) const;
 
  public:
     Definitions() = default;
-    Definitions(const Definitions& other) : definitions(other.definitions) {}
+    explicit Definitions(DefinitionIndex* index) : index(index) {}
+    Definitions(const Definitions& other) :
+            definitions(other.definitions), index(other.index), bits(other.bits) {}
     Definitions* joinDefinitions(const Definitions* other) const;
     /// Point writes the specified LocationSet.
     Definitions* writes(ProgramPoint point, const LocationSet* locations) const;
-    void setDefintion(const BaseLocation* loc, const ProgramPoints* point)
-    { CHECK_NULL(loc); CHECK_NULL(point); definitions[loc] = point; }
+    void setDefinition(const BaseLocation* loc, const ProgramPoints* point);
     void setDefinition(const StorageLocation* loc, const ProgramPoints* point);
     void setDefinition(const LocationSet* loc, const ProgramPoints* point);
-    bool hasLocation(const BaseLocation* location) const
-    { return definitions.find(location) != definitions.end(); }
-    const ProgramPoints* getPoints(const BaseLocation* location) const {
-        auto r = ::get(definitions, location);
-        BUG_CHECK(r != nullptr, "%1%: no definitions", location);
-        return r; }
+    bool hasLocation(const BaseLocation* location) const;
+    const ProgramPoints* getPoints(const BaseLocation* location) const;
     const ProgramPoints* getPoints(const LocationSet* locations) const;
+    /// @returns all the locations which have definitions.
+    std::vector<const BaseLocation*> getLocations() const;
     bool operator==(const Definitions& other) const;
     void dbprint(std::ostream& out) const {
-        if (definitions.empty())
+        if (empty())
             out << "  Empty definitions";
         bool first = true;
-        for (auto d : definitions) {
+        for (auto d : index ? fromBits(bits) : definitions) {
             if (!first)
                 out << std::endl;
             out << "  " << *d.first << "=>" << *d.second;
@@ -361,7 +396,7 @@ class Definitions : public IHasDbPrint {
     }
     Definitions* cloneDefinitions() const { return new Definitions(*this); }
     void removeLocation(const StorageLocation* loc);
-    bool empty() const { return definitions.empty(); }
+    bool empty() const { return index ? bits.empty() : definitions.empty(); }
 };
 
 class AllDefinitions : public IHasDbPrint {
@@ -369,16 +404,23 @@ class AllDefinitions : public IHasDbPrint {
     /// However, for ProgramPoints representing P4Control, P4Action, and P4Table
     /// the definitions are BEFORE the ProgramPoint.
     std::unordered_map<ProgramPoint, Definitions*> atPoint;
+    /// If not null, all definitions are bit vectors numbered by this index.
+    DefinitionIndex* index;
 
  public:
     StorageMap* storageMap;
-    AllDefinitions(ReferenceMap* refMap, TypeMap* typeMap) :
+    /// If @bitvecs is true the definitions are represented as bit vectors,
+    /// which are much faster to merge and compare in large blocks.
+    AllDefinitions(ReferenceMap* refMap, TypeMap* typeMap, bool bitvecs = false) :
+            index(bitvecs ? new DefinitionIndex() : nullptr),
             storageMap(new StorageMap(refMap, typeMap)) {}
+    /// @returns a new empty set of definitions with the right representation.
+    Definitions* newDefinitions() const { return new Definitions(index); }
     Definitions* getDefinitions(ProgramPoint point, bool emptyIfNotFound = false) {
         auto it = atPoint.find(point);
         if (it == atPoint.end()) {
             if (emptyIfNotFound) {
-                auto defs = new Definitions();
+                auto defs = newDefinitions();
                 setDefinitionsAt(point, defs);
                 return defs;
             }
@@ -388,6 +430,10 @@ class AllDefinitions : public IHasDbPrint {
     }
     void setDefinitionsAt(ProgramPoint point, Definitions* defs)
     { atPoint[point] = defs; }
+    std::unordered_map<ProgramPoint, Definitions*>::const_iterator begin() const
+    { return atPoint.cbegin(); }
+    std::unordered_map<ProgramPoint, Definitions*>::const_iterator end() const
+    { return atPoint.cend(); }
     void dbprint(std::ostream& out) const {
         for (auto e : atPoint)
             out << e.first << " => " << e.second << std::endl;
@@ -446,7 +492,7 @@ class ComputeWriteSet : public Inspector {
  public:
     explicit ComputeWriteSet(AllDefinitions* allDefinitions) :
             allDefinitions(allDefinitions), currentDefinitions(nullptr),
-            returnedDefinitions(nullptr), exitDefinitions(new Definitions()),
+            returnedDefinitions(nullptr), exitDefinitions(allDefinitions->newDefinitions()),
             storageMap(allDefinitions->storageMap), lhs(false)
     { CHECK_NULL(allDefinitions); visitDagOnce = false; }
 
@@ -564,7 +564,7 @@ class ProcessDefUse : public PassManager {
     HasUses         hasUses;
  public:
     ProcessDefUse(ReferenceMap* refMap, TypeMap* typeMap) :
-            definitions(new AllDefinitions(refMap, typeMap)) {
+            definitions(new AllDefinitions(refMap, typeMap, true)) {
         passes.push_back(new ComputeWriteSet(definitions));
         passes.push_back(new FindUninitialized(definitions, &hasUses));
         passes.push_back(new RemoveUnused(&hasUses));
@@ -60,7 +60,13 @@ class DoStrengthReduction final : public Transform {
     const IR::Node* simplifyConcat(IR::Slice* expr);
 
  public:
-    DoStrengthReduction() { visitDagOnce = true; setName("StrengthReduction"); }
+    DoStrengthReduction() {
+        visitDagOnce = true;
+        // only the postorders of expressions are overridden, so the rest of the
+        // program is not cloned unless an expression in it is simplified
+        cloneOnWrite = true;
+        setName("StrengthReduction");
+    }
 
     using Transform::postorder;
 
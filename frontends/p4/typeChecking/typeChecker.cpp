@@ -574,7 +574,28 @@ const IR::Node* TypeInference::preorder(IR::P4Program* program) {
     if (typeMap->checkMap(getOriginal()) && readOnly) {
         LOG2("No need to typecheck");
         prune();
-    }
+        return program;
+    }
+    // Visit the top-level declarations one at a time, so that the type map
+    // knows which one each type belongs to; skip those it has all the types of.
+    unsigned skipped = 0;
+    for (auto &object : program->objects) {
+        if (typeMap->isCurrent(object)) {
+            skipped++;
+            continue;
+        }
+        auto original = object;
+        auto errors = ::errorCount();
+        typeMap->startObject(original);
+        visit(object);
+        BUG_CHECK(object != nullptr, "%1%: declaration removed", original);
+        // Types learned while rewriting a declaration are not necessarily
+        // those a fresh look at the result would find.
+        typeMap->endObject(object, object == original && ::errorCount() == errors);
+    }
+    LOG2("Type checked " << program->objects.size() - skipped << " declarations, "
+         << skipped << " were up-to-date");
+    prune();
     return program;
 }
 
@@ -42,6 +42,7 @@ class TypeSubstitution : public IHasDbPrint {
     { return ::get(binding, t); }
 
     bool containsKey(T key) const { return binding.find(key) != binding.end(); }
+    const std::map<T, const IR::Type*>& getBindings() const { return binding; }
 
     /* This can fail if id is already bound.
      * @return true on success. */
@@ -70,6 +71,7 @@ class TypeSubstitution : public IHasDbPrint {
     }
 
     void clear() { binding.clear(); }
+    void remove(T id) { binding.erase(id); }
 };
 
 class TypeVariableSubstitution final : public TypeSubstitution<const IR::ITypeVar*> {
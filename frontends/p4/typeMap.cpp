@@ -14,20 +14,37 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+
 #include "typeMap.h"
 #include "lib/map.h"
 
 namespace P4 {
 
+namespace {
+/// The nodes in @set, in the order in which they were created.
+std::vector<const IR::Expression*> sorted(const node_set<const IR::Expression*>& set) {
+    std::vector<const IR::Expression*> result;
+    set.for_each([&](const IR::Expression* e) { result.push_back(e); });
+    std::sort(result.begin(), result.end(),
+              [](const IR::Expression* a, const IR::Expression* b) { return a->id < b->id; });
+    return result;
+}
+}  // namespace
+
 void TypeMap::dbprint(std::ostream& out) const {
     out << "TypeMap for " << dbp(program) << std::endl;
-    for (auto it : typeMap)
-        out << "\t" << dbp(it.first) << "->" << dbp(it.second) << std::endl;
+    std::vector<const IR::Node*> nodes;
+    typeMap.for_each([&](const IR::Node* node, const Entry&) { nodes.push_back(node); });
+    std::sort(nodes.begin(), nodes.end(),
+              [](const IR::Node* a, const IR::Node* b) { return a->id < b->id; });
+    for (auto node : nodes)
+        out << "\t" << dbp(node) << "->" << dbp(typeMap.find(node)->type) << std::endl;
     out << "Left values" << std::endl;
-    for (auto it : leftValues)
+    for (auto it : sorted(leftValues))
         out << "\t" << dbp(it) << std::endl;
     out << "Constants" << std::endl;
-    for (auto it : constants)
+    for (auto it : sorted(constants))
         out << "\t" << dbp(it) << std::endl;
     out << "Type variables" << std::endl;
     out << allTypeVariables << std::endl;
@@ -35,17 +52,19 @@ void TypeMap::dbprint(std::ostream& out) const {
 }
 
 void TypeMap::setLeftValue(const IR::Expression* expression) {
-    leftValues.insert(expression);
+    if (leftValues.insert(expression))
+        objects[currentObject].leftValues.push_back(expression);
     LOG1("Left value " << dbp(expression));
 }
 
 void TypeMap::setCompileTimeConstant(const IR::Expression* expression) {
-    constants.insert(expression);
+    if (constants.insert(expression))
+        objects[currentObject].constants.push_back(expression);
     LOG3("Constant value " << dbp(expression));
 }
 
 bool TypeMap::isCompileTimeConstant(const IR::Expression* expression) const {
-    bool result = constants.find(expression) != constants.end();
+    bool result = constants.count(expression) > 0;
     LOG3(dbp(expression) << (result ? " constant" : " not constant"));
     return result;
 }
@@ -53,32 +72,125 @@ bool TypeMap::isCompileTimeConstant(const IR::Expression* expression) const {
 void TypeMap::clear() {
     LOG3("Clearing typeMap");
     typeMap.clear(); leftValues.clear(); constants.clear(); allTypeVariables.clear();
+    objects.clear(); objects.emplace_back(nullptr);
+    objectIds.clear(); currentObject = 0;
     program = nullptr;
 }
 
+void TypeMap::invalidate(const IR::P4Program* program) {
+    std::unordered_set<const IR::Node*> live(program->objects.begin(), program->objects.end());
+    std::vector<unsigned> worklist = { 0 };
+    for (auto it = objectIds.begin(); it != objectIds.end();) {
+        if (live.count(it->first)) {
+            if (!objects[it->second].current)
+                worklist.push_back(it->second);
+            ++it;
+        } else {
+            worklist.push_back(it->second);
+            it = objectIds.erase(it);
+        }
+    }
+
+    size_t before = typeMap.size();
+    unsigned invalidated = 0;
+    while (!worklist.empty()) {
+        auto &info = objects[worklist.back()];
+        worklist.pop_back();
+        if (info.object != nullptr && info.current)
+            invalidated++;
+        for (auto node : info.entries)
+            typeMap.erase(node);
+        for (auto expression : info.leftValues)
+            leftValues.erase(expression);
+        for (auto expression : info.constants)
+            constants.erase(expression);
+        for (auto var : info.typeVars)
+            allTypeVariables.remove(var);
+        worklist.insert(worklist.end(), info.dependents.begin(), info.dependents.end());
+        info.entries.clear(); info.leftValues.clear(); info.constants.clear();
+        info.typeVars.clear(); info.dependents.clear();
+        info.current = false;
+    }
+    LOG2("Invalidated " << invalidated << " objects, " << before - typeMap.size() << " types");
+}
+
+void TypeMap::startObject(const IR::Node* object) {
+    auto it = objectIds.find(object);
+    if (it != objectIds.end()) {
+        currentObject = it->second;
+        return;
+    }
+    currentObject = objects.size();
+    objects.emplace_back(object);
+    objectIds.emplace(object, currentObject);
+}
+
+void TypeMap::endObject(const IR::Node* result, bool complete) {
+    auto &info = objects[currentObject];
+    if (result != info.object) {
+        objectIds.erase(info.object);
+        objectIds[result] = currentObject;
+        info.object = result;
+    }
+    info.current = complete;
+    currentObject = 0;
+}
+
+bool TypeMap::isCurrent(const IR::Node* object) const {
+    auto it = objectIds.find(object);
+    return it != objectIds.end() && objects[it->second].current;
+}
+
 void TypeMap::checkPrecondition(const IR::Node* element, const IR::Type* type) const {
     CHECK_NULL(element); CHECK_NULL(type);
     if (type->is<IR::Type_Name>())
         BUG("Element %1% maps to a Type_Name %2%", dbp(element), dbp(type));
 }
 
+bool TypeMap::contains(const IR::Node* element) {
+    auto entry = typeMap.find(element);
+    if (entry == nullptr)
+        return false;
+    addReader(entry->owner);
+    return true;
+}
+
 void TypeMap::setType(const IR::Node* element, const IR::Type* type) {
     checkPrecondition(element, type);
-    auto it = typeMap.find(element);
-    if (it != typeMap.end()) {
-        const IR::Type* existingType = it->second;
+    auto entry = typeMap.find(element);
+    if (entry != nullptr) {
+        const IR::Type* existingType = entry->type;
         if (!TypeMap::implicitlyConvertibleTo(type, existingType))
             BUG("Changing type of %1% in type map from %2% to %3%",
                 dbp(element), dbp(existingType), dbp(type));
+        addReader(entry->owner);
         return;
     }
     LOG3("setType " << dbp(element) << " => " << dbp(type));
-    typeMap.emplace(element, type);
+    // Base types do not depend on anything else, unless their width is an expression.
+    unsigned owner = currentObject;
+    if (auto tb = element->to<IR::Type_Bits>()) {
+        if (tb->expression == nullptr)
+            owner = intrinsic;
+    } else if (auto tv = element->to<IR::Type_Varbits>()) {
+        if (tv->expression == nullptr)
+            owner = intrinsic;
+    } else if (element->is<IR::Type_Base>()) {
+        owner = intrinsic;
+    }
+    if (owner != intrinsic)
+        objects[owner].entries.push_back(element);
+    typeMap.emplace(element, Entry{ type, owner });
 }
 
 const IR::Type* TypeMap::getType(const IR::Node* element, bool notNull) const {
     CHECK_NULL(element);
-    auto result = get(typeMap, element);
+    const IR::Type* result = nullptr;
+    auto entry = typeMap.find(element);
+    if (entry != nullptr) {
+        result = entry->type;
+        addReader(entry->owner);
+    }
     LOG4("Looking up type for " << dbp(element) << " => " << dbp(result));
     if (notNull && result == nullptr) {
         BUG("Could not find type for %1%", dbp(element));
@@ -100,6 +212,9 @@ void TypeMap::addSubstitutions(const TypeVariableSubstitution* tvs) {
         return;
     LOG3("New type variables " << tvs);
     allTypeVariables.simpleCompose(tvs);
+    auto &vars = objects[currentObject].typeVars;
+    for (auto &binding : tvs->getBindings())
+        vars.push_back(binding.first);
 }
 
 // Deep structural equivalence between canonical types.
@@ -17,7 +17,10 @@ limitations under the License.
 #ifndef _FRONTENDS_P4_TYPEMAP_H_
 #define _FRONTENDS_P4_TYPEMAP_H_
 
+#include <unordered_map>
+#include <unordered_set>
 #include "ir/ir.h"
+#include "lib/node_map.h"
 #include "frontends/common/programMap.h"
 #include "frontends/p4/typeChecking/typeSubstitution.h"
 
@@ -36,6 +39,13 @@ Objects that have a type in the map:
 - enum fields (pointing to the enclosing enum)
 - error (pointing to the error type)
 - type declarations - map name to the actual type
+
+Each entry is owned by the top-level declaration (element of
+P4Program::objects) that was being type-checked when it was set, and
+each declaration remembers the declarations that read its entries.
+When the program changes, invalidate() drops only the entries of the
+declarations that changed and of the declarations that depend on them,
+so that TypeInference only has to revisit those.
 */
 class TypeMap final : public ProgramMap {
  protected:
@@ -44,36 +54,81 @@ class TypeMap final : public ProgramMap {
     std::vector<const IR::Type*> canonicalTuples;
     std::vector<const IR::Type*> canonicalStacks;
 
+    struct Entry {
+        const IR::Type* type;
+        unsigned        owner;  // index in objects, or intrinsic
+    };
     // Map each node to its canonical type
-    std::map<const IR::Node*, const IR::Type*> typeMap;
+    node_map<const IR::Node*, Entry> typeMap;
     // All left-values in the program.
-    std::set<const IR::Expression*> leftValues;
+    node_set<const IR::Expression*> leftValues;
     // All compile-time constants.  A compile-time constant
     // is not necessarily a constant - it could be a directionless
     // parameter as well.
-    std::set<const IR::Expression*> constants;
+    node_set<const IR::Expression*> constants;
     // For each type variable in the program the actual
     // type that is substituted for it.
     TypeVariableSubstitution allTypeVariables;
 
+    // A top-level declaration and everything the type map knows because of it.
+    struct ObjectInfo {
+        const IR::Node*                     object;
+        // True if all the types in the object are in the map.
+        bool                                current = false;
+        std::vector<const IR::Node*>        entries;
+        std::vector<const IR::Expression*>  leftValues;
+        std::vector<const IR::Expression*>  constants;
+        std::vector<const IR::ITypeVar*>    typeVars;
+        // Objects which have read some of these entries.
+        std::unordered_set<unsigned>        dependents;
+        explicit ObjectInfo(const IR::Node* object) : object(object) {}
+    };
+    // Owner of the entries that do not depend on the program,
+    // such as the types of base types.
+    static constexpr unsigned intrinsic = ~0U;
+    // objects[0] owns whatever is set outside of any top-level declaration.
+    // Recording the readers is a side effect of lookups, hence mutable.
+    mutable std::vector<ObjectInfo> objects;
+    std::unordered_map<const IR::Node*, unsigned> objectIds;
+    unsigned currentObject = 0;
+
+    void addReader(unsigned owner) const {
+        if (owner != currentObject && owner != intrinsic && currentObject != 0)
+            objects[owner].dependents.insert(currentObject);
+    }
     // checks some preconditions before setting the type
     void checkPrecondition(const IR::Node* element, const IR::Type* type) const;
 
  public:
-    TypeMap() : ProgramMap("TypeMap") {}
+    TypeMap() : ProgramMap("TypeMap") { objects.emplace_back(nullptr); }
 
-    bool contains(const IR::Node* element) { return typeMap.count(element) != 0; }
+    bool contains(const IR::Node* element);
     void setType(const IR::Node* element, const IR::Type* type);
     const IR::Type* getType(const IR::Node* element, bool notNull = false) const;
     // unwraps a TypeType into its contents
     const IR::Type* getTypeType(const IR::Node* element, bool notNull) const;
     void dbprint(std::ostream& out) const;
     void clear();
+    /// Forget the types of the top-level declarations of the program which
+    /// are not in @program, of those which depend on them, and of anything
+    /// set outside a top-level declaration.  The other declarations stay current.
+    void invalidate(const IR::P4Program* program);
+    /// Attribute what is set and read from now on to the top-level declaration @object.
+    void startObject(const IR::Node* object);
+    /// Done with the current top-level declaration, which type checking
+    /// turned into @result; if @complete all the nodes of @result have their
+    /// types in the map.
+    void endObject(const IR::Node* result, bool complete);
+    /// True if the types in the top-level declaration @object are all known.
+    bool isCurrent(const IR::Node* object) const;
     bool isLeftValue(const IR::Expression* expression) const
     { return leftValues.count(expression) > 0; }
     bool isCompileTimeConstant(const IR::Expression* expression) const;
     size_t size() const
     { return typeMap.size(); }
+    /// Bytes of memory used for the types, left values and constants.
+    size_t memory() const
+    { return typeMap.memory() + leftValues.memory() + constants.memory(); }
 
     void setLeftValue(const IR::Expression* expression);
     void setCompileTimeConstant(const IR::Expression* expression);
@@ -0,0 +1,169 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "ir_binary.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sstream>
+#include <unordered_map>
+#include "ir.h"
+#include "json_generator.h"
+#include "json_loader.h"
+#include "json_parser.h"
+
+namespace BinaryIR {
+
+namespace {
+
+/// Converts a parsed JSON document into the binary form
+class Writer {
+    std::vector<uint32_t>                       words;
+    std::unordered_map<std::string, uint32_t>   ids;
+    std::vector<const std::string *>            strings;
+
+    uint32_t string(const std::string &s) {
+        auto it = ids.emplace(s, strings.size());
+        if (it.second) strings.push_back(&it.first->first);
+        return it.first->second; }
+
+    // Allocate @n words, returning the offset of the first
+    uint32_t allocate(size_t n) {
+        size_t at = words.size();
+        words.resize(at + n);
+        return at; }
+
+    void store(uint32_t at, slot_t slot) {
+        words[at] = slot.tag;
+        words[at + 1] = slot.value; }
+
+    slot_t value(const JsonData *json) {
+        if (auto *b = json->to<JsonBoolean>())
+            return slot_t{ b->val ? TAG_TRUE : TAG_FALSE, 0 };
+        if (auto *n = json->to<JsonNumber>()) {
+            if (n->val.fits_sint_p() && n->val >= INT32_MIN && n->val <= INT32_MAX)
+                return slot_t{ TAG_INT, uint32_t(int32_t(n->val.get_si())) };
+            return slot_t{ TAG_BIGNUM, string(n->val.get_str()) }; }
+        if (auto *s = json->to<JsonString>())
+            return slot_t{ TAG_STRING, string(*s) };
+        if (auto *v = json->to<JsonVector>()) {
+            uint32_t at = allocate(1 + 2 * v->size());
+            words[at] = v->size();
+            for (size_t i = 0; i < v->size(); ++i)
+                store(at + 1 + 2 * i, value(v->at(i)));
+            return slot_t{ TAG_ARRAY, at }; }
+        if (auto *o = json->to<JsonObject>()) {
+            uint32_t at = allocate(1 + 3 * o->size());
+            words[at] = o->size();
+            size_t i = 0;
+            for (auto &f : *o) {
+                uint32_t e = at + 1 + 3 * i++;
+                words[e] = string(f.first);
+                store(e + 1, value(f.second)); }
+            return slot_t{ TAG_OBJECT, at }; }
+        return slot_t{ TAG_NULL, 0 };
+    }
+
+ public:
+    void write(std::ostream &out, const JsonData *root) {
+        static_assert(sizeof(header_t) % sizeof(uint32_t) == 0, "header is not whole words");
+        allocate(sizeof(header_t) / sizeof(uint32_t));
+        header_t header;
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.root = value(root);
+
+        std::vector<uint32_t> index;
+        for (auto *s : strings) {
+            index.push_back(allocate(1 + (s->size() + sizeof(uint32_t)) / sizeof(uint32_t)));
+            words[index.back()] = s->size();
+            memcpy(&words[index.back() + 1], s->data(), s->size()); }
+        header.strings = strings.size();
+        header.string_index = allocate(index.size());
+        std::copy(index.begin(), index.end(), words.begin() + header.string_index);
+        header.words = words.size();
+        memcpy(words.data(), &header, sizeof(header));
+        out.write(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint32_t));
+    }
+};
+
+}  // namespace
+
+File::File(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        error_ = cstring("can't open ") + filename;
+    } else if (size_t(st.st_size) >= sizeof(header_t)) {
+        mapped = st.st_size;
+        mapping = mmap(nullptr, mapped, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            error_ = cstring("can't map ") + filename;
+        } else {
+            words = static_cast<const uint32_t *>(mapping);
+            size = mapped / sizeof(uint32_t); } }
+    if (fd >= 0) close(fd);
+    if (!error_) init();
+}
+
+File::File(std::string data) : data(std::move(data)) {
+    words = reinterpret_cast<const uint32_t *>(this->data.data());
+    size = this->data.size() / sizeof(uint32_t);
+    init();
+}
+
+File::~File() {
+    if (mapping) munmap(mapping, mapped);
+}
+
+void File::init() {
+    auto *header = reinterpret_cast<const header_t *>(words);
+    if (size * sizeof(uint32_t) < sizeof(header_t) || !isBinary(words, sizeof(header_t)))
+        error_ = "not a binary IR file";
+    else if (header->version != version)
+        error_ = "unsupported binary IR version";
+    else if (header->words != size || header->string_index + header->strings > size)
+        error_ = "truncated binary IR file";
+    if (error_) {
+        words = nullptr;
+        size = 0;
+        return; }
+    names.resize(header->strings);
+    factories.resize(header->strings);
+}
+
+File::factory_t File::factory(uint32_t id) const {
+    if (!factories[id]) factories[id] = get(IR::unpacker_table, string(id));
+    return factories[id];
+}
+
+void write(std::ostream &out, const IR::Node *node, bool dumpSourceInfo) {
+    std::stringstream json;
+    JSONGenerator(json, dumpSourceInfo, true) << node;
+    JsonData *root = nullptr;
+    json >> root;
+    if (root) Writer().write(out, root);
+}
+
+const IR::Node *load(const File &file) {
+    const IR::Node *node = nullptr;
+    if (!file.error()) JSONLoader(file) >> node;
+    return node;
+}
+
+}  // namespace BinaryIR
@@ -0,0 +1,156 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_IR_BINARY_H_
+#define _IR_IR_BINARY_H_
+
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "lib/cstring.h"
+
+namespace IR {
+class Node;
+}  // namespace IR
+class JSONLoader;
+
+/** A binary form of the IR's JSON representation, for fast reloading.
+ *
+ * The document is the one JSONGenerator writes (so node ids and shared node
+ * references are kept), stored so that it can be used in place from a memory
+ * mapped file: JSONLoader reads it directly, looking up object fields by
+ * scanning a few fixed-size entries, and builds the IR through the same
+ * generated constructors it uses for JSON without materializing a JsonData tree.
+ *
+ * The file is an array of 32-bit words in host byte order.  A value is a slot of
+ * two words (tag, value); the value is an int, a string number, or the offset of a
+ * block holding a count followed by that many slots (arrays) or key/slot entries
+ * (objects).  Every distinct string is stored once, and strings are found
+ * through an index of their offsets.
+ */
+namespace BinaryIR {
+
+enum tag_t : uint32_t {
+    TAG_NULL, TAG_FALSE, TAG_TRUE, TAG_INT, TAG_BIGNUM, TAG_STRING, TAG_ARRAY, TAG_OBJECT };
+
+struct slot_t {
+    uint32_t    tag;
+    uint32_t    value;      // int, string number (BIGNUM and STRING), or block offset
+};
+
+struct entry_t {
+    uint32_t    key;        // string number
+    slot_t      value;
+};
+
+struct header_t {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    words;          // size of the file
+    uint32_t    strings;        // number of strings
+    uint32_t    string_index;   // offset of the string index
+    slot_t      root;
+};
+
+static const char magic[8] = { 'P', '4', 'I', 'R', 'B', 'I', 'N', '\0' };
+static const uint32_t version = 1;
+
+/// Does @data (of @size bytes) start like a binary IR file?
+inline bool isBinary(const void *data, size_t size) {
+    return size >= sizeof(magic) && memcmp(data, magic, sizeof(magic)) == 0; }
+
+/// A binary IR document, normally mapped from a file
+class File {
+ public:
+    typedef IR::Node *(*factory_t)(JSONLoader &);
+
+ private:
+    const uint32_t      *words = nullptr;
+    size_t              size = 0;       // in words
+    void                *mapping = nullptr;
+    size_t              mapped = 0;
+    std::string         data;
+    mutable std::vector<cstring>        names;
+    mutable std::vector<factory_t>      factories;
+    cstring             error_;
+
+    void init();
+    const uint32_t *block(const slot_t *s) const { return words + s->value; }
+
+ public:
+    /// Map the file @filename; check `error()` before using it
+    explicit File(const char *filename);
+    /// Use the binary IR in @data
+    explicit File(std::string data);
+    ~File();
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+
+    /// @return a description of the problem if the file could not be used, else null
+    cstring error() const { return error_; }
+
+    const slot_t *root() const {
+        return &reinterpret_cast<const header_t *>(words)->root; }
+
+    /// String number @id, without terminating NUL, and its length
+    const char *chars(uint32_t id, uint32_t &length) const {
+        const uint32_t *s = words + words[reinterpret_cast<const header_t *>(words)->string_index
+                                          + id];
+        length = s[0];
+        return reinterpret_cast<const char *>(s + 1); }
+    cstring string(uint32_t id) const {
+        if (!names[id]) {
+            uint32_t length;
+            const char *s = chars(id, length);
+            names[id] = cstring(s, length); }
+        return names[id]; }
+    bool equals(uint32_t id, const char *str, size_t length) const {
+        uint32_t len;
+        const char *s = chars(id, len);
+        return len == length && memcmp(s, str, length) == 0; }
+
+    uint32_t count(const slot_t *s) const { return *block(s); }
+    /// The elements of array @s
+    const slot_t *elements(const slot_t *s) const {
+        return reinterpret_cast<const slot_t *>(block(s) + 1); }
+    /// The fields of object @s, in the order they were written
+    const entry_t *entries(const slot_t *s) const {
+        return reinterpret_cast<const entry_t *>(block(s) + 1); }
+    /// Field @key of object @s, or null if there isn't one
+    const slot_t *find(const slot_t *s, const char *key, size_t length) const {
+        if (s->tag != TAG_OBJECT) return nullptr;
+        const entry_t *e = entries(s);
+        for (uint32_t i = 0, n = count(s); i < n; ++i)
+            if (equals(e[i].key, key, length)) return &e[i].value;
+        return nullptr; }
+    const slot_t *find(const slot_t *s, const char *key) const {
+        return find(s, key, strlen(key)); }
+
+    /// The node factory for Node_Type string number @id
+    factory_t factory(uint32_t id) const;
+};
+
+/// Write @node in binary form to @out
+void write(std::ostream &out, const IR::Node *node, bool dumpSourceInfo = false);
+
+/// Load the IR in @file
+const IR::Node *load(const File &file);
+
+}  // namespace BinaryIR
+
+#endif /* _IR_IR_BINARY_H_ */
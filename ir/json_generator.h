@@ -20,6 +20,9 @@ limitations under the License.
 #include <assert.h>
 #include <boost/optional.hpp>
 #include <gmpxx.h>
+#include <algorithm>
+#include <memory>
+#include <streambuf>
 #include <string>
 #include <unordered_set>
 #include "lib/cstring.h"
@@ -30,10 +33,51 @@ limitations under the License.
 #include "lib/safe_vector.h"
 
 #include "ir.h"
+
+/** Writes the IR (and the containers and values it contains) as JSON.
+ *
+ * Output is collected in a large buffer and handed to the underlying stream in
+ * big chunks, so generating a big program is not dominated by per-line stream
+ * operations; `std::endl` only ends the line and does not flush.  The buffer
+ * is passed on to the stream whenever it fills up and after each top-level
+ * value written with `<<`, so the stream always has the complete output of
+ * every finished `gen << value`.
+ *
+ * In compact mode no newlines or indentation are written within a value, which makes
+ * the output considerably smaller and faster to generate and to load.
+ */
 class JSONGenerator {
+    /// Buffers output for `dest` in a fixed size array
+    class buffer_t : public std::streambuf {
+        std::streambuf  *dest;
+        std::unique_ptr<char[]> data;
+        bool write_out() {
+            std::streamsize n = pptr() - pbase();
+            if (n && dest->sputn(pbase(), n) != n) return false;
+            setp(data.get(), epptr());
+            return true; }
+
+     protected:
+        int_type overflow(int_type ch) override {
+            if (!write_out()) return traits_type::eof();
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1); }
+            return traits_type::not_eof(ch); }
+        int sync() override { return write_out() ? 0 : -1; }
+
+     public:
+        buffer_t(std::streambuf *dest, size_t size) : dest(dest), data(new char[size]) {
+            setp(data.get(), data.get() + size); }
+    };
+
     std::unordered_set<int> node_refs;
-    std::ostream &out;
+    std::ostream &dest;
+    buffer_t buffer;
+    std::ostream out;
     bool dumpSourceInfo;
+    bool compact;
+    int depth = 0;      // nesting of operator<< calls
 
     template<typename T>
     class has_toJSON {
@@ -46,125 +90,150 @@ class JSONGenerator {
         static const bool value = sizeof(test<T>(0)) == sizeof(char);
     };
 
+    void newline() {
+        // even compact output ends with a newline if asked to
+        if (!compact || depth == 0) out.put('\n'); }
+    void write_indent(indent_t i) {
+        if (compact) return;
+        static const char spaces[] = "                                ";
+        for (int n = i.width(); n > 0; n -= sizeof(spaces) - 1)
+            out.write(spaces, std::min(n, int(sizeof(spaces) - 1))); }
+    /// Pass the buffered output on to the stream once a top-level value is complete
+    void done() { if (depth == 0) out.flush(); }
+
  public:
     indent_t indent;
 
-    explicit JSONGenerator(std::ostream &out, bool dumpSourceInfo = false) :
-        out(out), dumpSourceInfo(dumpSourceInfo) {}
+    static const size_t default_buffer_size = 1 << 20;
+
+    explicit JSONGenerator(std::ostream &out, bool dumpSourceInfo = false,
+                           bool compact = false, size_t bufferSize = default_buffer_size) :
+        dest(out), buffer(out.rdbuf(), bufferSize), out(&buffer),
+        dumpSourceInfo(dumpSourceInfo), compact(compact) {}
+    ~JSONGenerator() {
+        out.flush();
+        dest.flush(); }
+    JSONGenerator(const JSONGenerator &) = delete;
+    JSONGenerator &operator=(const JSONGenerator &) = delete;
+
+    /// Pass all output written so far on to the stream, and flush it
+    void flush() {
+        out.flush();
+        dest.flush(); }
 
     template<typename T>
     void generate(const safe_vector<T> &v) {
-        out << "[";
+        *this << "[";
         if (v.size() > 0) {
-            out << std::endl << ++indent;
+            *this << std::endl << ++indent;
             generate(v[0]);
             for (size_t i = 1; i < v.size(); i++) {
-                out << "," << std::endl << indent;
+                *this << "," << std::endl << indent;
                 generate(v[i]); }
-            out << std::endl << --indent; }
-        out << "]";
+            *this << std::endl << --indent; }
+        *this << "]";
     }
 
     template<typename T>
     void generate(const std::vector<T> &v) {
-        out << "[";
+        *this << "[";
         if (v.size() > 0) {
-            out << std::endl << ++indent;
+            *this << std::endl << ++indent;
             generate(v[0]);
             for (size_t i = 1; i < v.size(); i++) {
-                out << "," << std::endl << indent;
+                *this << "," << std::endl << indent;
                 generate(v[i]); }
-            out << std::endl << --indent; }
-        out << "]";
+            *this << std::endl << --indent; }
+        *this << "]";
     }
 
     template<typename T, typename U>
     void generate(const std::pair<T, U> &v) {
         ++indent;
-        out << "{" << std::endl;
+        *this << "{" << std::endl;
         toJSON(v);
-        out << std::endl << --indent << "}";
+        *this << std::endl << --indent << "}";
     }
 
     template<typename T, typename U>
     void toJSON(const std::pair<T, U> &v) {
-        out << indent << "\"first\" : ";
+        *this << indent << "\"first\" : ";
         generate(v.first);
-        out << "," << std::endl << indent << "\"second\" : ";
+        *this << "," << std::endl << indent << "\"second\" : ";
         generate(v.second);
     }
 
     template<typename T>
     void generate(const boost::optional<T> &v) {
         if (!v) {
-            out << "{ \"valid\" : false }";
+            *this << "{ \"valid\" : false }";
             return;
         }
-        out << "{" << std::endl << ++indent;
-        out << "\"valid\" : true," << std::endl;
-        out << "\"value\" : ";
+        *this << "{" << std::endl << ++indent;
+        *this << "\"valid\" : true," << std::endl;
+        *this << "\"value\" : ";
         generate(*v);
-        out << std::endl << --indent << "}";
+        *this << std::endl << --indent << "}";
     }
 
     template<typename T>
     void generate(const std::set<T> &v) {
-        out << "[" << std::endl;
+        *this << "[" << std::endl;
         if (v.size() > 0) {
             auto it = v.begin();
-            out << ++indent;
+            *this << ++indent;
             generate(*it);
             for (it++; it != v.end(); ++it) {
-                out << "," << std::endl << indent;
+                *this << "," << std::endl << indent;
                 generate(*it);
             }
-            out << std::endl << --indent;
+            *this << std::endl << --indent;
         }
-        out << "]";
+        *this << "]";
     }
 
     template<typename T>
     void generate(const ordered_set<T> &v) {
-        out << "[" << std::endl;
+        *this << "[" << std::endl;
         if (v.size() > 0) {
             auto it = v.begin();
-            out << ++indent;
+            *this << ++indent;
             generate(*it);
             for (it++; it != v.end(); ++it) {
-                out << "," << std::endl << indent;
+                *this << "," << std::endl << indent;
                 generate(*it);
             }
-            out << std::endl << --indent;
+            *this << std::endl << --indent;
         }
-        out << "]";
+        *this << "]";
     }
 
     template<typename K, typename V>
     void generate(const std::map<K, V> &v) {
-        out << "[" << std::endl;
+        *this << "[" << std::endl;
         if (v.size() > 0) {
             auto it = v.begin();
-            out << ++indent;
+            *this << ++indent;
             generate(*it);
             for (it++; it != v.end(); ++it) {
-                out << "," << std::endl << indent;
+                *this << "," << std::endl << indent;
                 generate(*it); }
-            out << std::endl << --indent; }
-        out << "]";
+            *this << std::endl << --indent; }
+        *this << "]";
     }
 
     template<typename K, typename V>
     void generate(const ordered_map<K, V> &v) {
-        out << "[" << std::endl;
+        *this << "[" << std::endl;
         if (v.size() > 0) {
             auto it = v.begin();
-            out << ++indent;
+            *this << ++indent;
             generate(*it);
             for (it++; it != v.end(); ++it) {
-                out << "," << std::endl << indent;
+                *this << "," << std::endl << indent;
                 generate(*it); }
-            out << std::endl << --indent; }
-        out << "]";
+            *this << std::endl << --indent; }
+        *this << "]";
     }
 
     void generate(bool v) { out << (v ? "true" : "false"); }
@@ -175,10 +244,12 @@ class JSONGenerator {
     void generate(const mpz_class &v) { out << v; }
 
     void generate(cstring v) {
-        if (v)
-            out << "\"" << v << "\"";
-        else
-            out << "null";
+        if (v) {
+            out.put('"');
+            out.write(v.c_str(), v.size());
+            out.put('"');
+        } else {
+            out << "null"; }
     }
     template<typename T>
     typename std::enable_if<
@@ -189,10 +260,10 @@ class JSONGenerator {
     }
 
     void generate(const match_t &v) {
-        out << "{" << std::endl
-            << (indent + 1) << "\"word0\" : " << v.word0 << "," << std::endl
-            << (indent + 1) << "\"word1\" : " << v.word1 << std::endl
-            << indent << "}";
+        *this << "{" << std::endl
+              << (indent + 1) << "\"word0\" : " << v.word0 << "," << std::endl
+              << (indent + 1) << "\"word1\" : " << v.word1 << std::endl
+              << indent << "}";
     }
 
     template<typename T>
@@ -201,16 +272,16 @@ class JSONGenerator {
                     !std::is_base_of<IR::Node, T>::value>::type
     generate(const T &v) {
         ++indent;
-        out << "{" << std::endl;
+        *this << "{" << std::endl;
         v.toJSON(*this);
-        out << std::endl << --indent << "}";
+        *this << std::endl << --indent << "}";
     }
 
     void generate(const IR::Node &v) {
-        out << "{" << std::endl;
+        *this << "{" << std::endl;
         ++indent;
         if (node_refs.find(v.id) != node_refs.end()) {
-            out << indent << "\"Node_ID\" : " << v.id;
+            *this << indent << "\"Node_ID\" : " << v.id;
         } else {
             node_refs.insert(v.id);
             v.toJSON(*this);
@@ -218,7 +289,7 @@ class JSONGenerator {
                 v.sourceInfoToJSON(*this);
             }
         }
-        out << std::endl << --indent << "}";
+        *this << std::endl << --indent << "}";
     }
 
     template<typename T>
@@ -234,22 +305,35 @@ class JSONGenerator {
 
     template<typename T, size_t N>
     void generate(const T (&v)[N]) {
-        out << "[";
+        *this << "[";
         if (N > 0) {
-            out << std::endl << ++indent;
+            *this << std::endl << ++indent;
             generate(v[0]);
             for (size_t i = 1; i < N; i++) {
-                out << "," << std::endl << indent;
+                *this << "," << std::endl << indent;
                 generate(v[i]); }
-            out << std::endl << --indent; }
-        out << "]";
+            *this << std::endl << --indent; }
+        *this << "]";
     }
 
-    JSONGenerator &operator<<(char ch) { out << ch; return *this; }
-    JSONGenerator &operator<<(const char *s) { out << s; return *this; }
-    JSONGenerator &operator<<(indent_t i) { out << i; return *this; }
-    JSONGenerator &operator<<(std::ostream &(*fn)(std::ostream &)) { out << fn; return *this; }
-    template<typename T> JSONGenerator &operator<<(const T &v) { generate(v); return *this; }
+    JSONGenerator &operator<<(char ch) { out.put(ch); done(); return *this; }
+    JSONGenerator &operator<<(const char *s) { out << s; done(); return *this; }
+    JSONGenerator &operator<<(indent_t i) { write_indent(i); return *this; }
+    JSONGenerator &operator<<(std::ostream &(*fn)(std::ostream &)) {
+        if (fn == static_cast<std::ostream &(*)(std::ostream &)>(std::endl)) {
+            newline();
+            done();
+        } else if (fn == static_cast<std::ostream &(*)(std::ostream &)>(std::flush)) {
+            flush();
+        } else {
+            out << fn; }
+        return *this; }
+    template<typename T> JSONGenerator &operator<<(const T &v) {
+        ++depth;
+        generate(v);
+        --depth;
+        done();
+        return *this; }
 };
 
 
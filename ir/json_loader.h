@@ -31,6 +31,7 @@ limitations under the License.
 #include "lib/ordered_set.h"
 #include "lib/safe_vector.h"
 #include "ir.h"
+#include "ir_binary.h"
 #include "json_parser.h"
 
 class JSONLoader {
@@ -48,6 +49,16 @@ class JSONLoader {
     std::unordered_map<int, IR::Node*> &node_refs;
     JsonData *json = nullptr;
 
+ private:
+    // When loading binary IR (see ir_binary.h), the value being loaded
+    const BinaryIR::File *bin = nullptr;
+    const BinaryIR::slot_t *slot = nullptr;
+
+    JSONLoader(const BinaryIR::File *bin, const BinaryIR::slot_t *slot,
+               std::unordered_map<int, IR::Node*> &refs)
+    : node_refs(refs), bin(bin), slot(slot) {}
+
+ public:
     explicit JSONLoader(std::istream &in) : node_refs(*(new std::unordered_map<int, IR::Node*>()))
     { in >> json; }
 
@@ -57,13 +68,23 @@ class JSONLoader {
     JSONLoader(JsonData *json, std::unordered_map<int, IR::Node*> &refs)
     : node_refs(refs), json(json) {}
 
+    /// Load the binary IR in @file
+    explicit JSONLoader(const BinaryIR::File &file)
+    : node_refs(*(new std::unordered_map<int, IR::Node*>())), bin(&file), slot(file.root()) {}
+
     JSONLoader(const JSONLoader &unpacker, const std::string &field)
-    : node_refs(unpacker.node_refs), json(nullptr) {
-        if (auto obj = dynamic_cast<JsonObject *>(unpacker.json))
+    : node_refs(unpacker.node_refs), json(nullptr), bin(unpacker.bin) {
+        if (bin)
+            slot = bin->find(unpacker.slot, field.data(), field.size());
+        else if (auto obj = dynamic_cast<JsonObject *>(unpacker.json))
             json = get(obj, field); }
 
+    /// Is there nothing to load (no input, or a missing field)?
+    bool empty() const { return bin ? slot == nullptr : json == nullptr; }
+
  private:
     const IR::Node* get_node() {
+        if (bin) return get_binary_node();
         if (!json || !json->is<JsonObject>()) return nullptr;  // invalid json exception?
         int id = json->to<JsonObject>()->get_id();
         if (id >= 0) {
@@ -87,31 +108,80 @@ class JSONLoader {
         return nullptr;  // invalid json exception?
     }
 
+    const IR::Node* get_binary_node() {
+        auto *id = bin->find(slot, "Node_ID");
+        if (!id || id->tag != BinaryIR::TAG_INT) return nullptr;
+        auto it = node_refs.find(int(id->value));
+        if (it != node_refs.end()) return it->second;
+        auto *type = bin->find(slot, "Node_Type");
+        auto fn = type && type->tag == BinaryIR::TAG_STRING ? bin->factory(type->value) : nullptr;
+        if (!fn) return nullptr;
+        IR::Node *node = node_refs[int(id->value)] = fn(*this);
+        if (auto *si = bin->find(slot, "Source_Info")) {
+            cstring filename, fragment;
+            int line = -1, column = -1;
+            JSONLoader loader(bin, si, node_refs);
+            loader.load("filename", filename);
+            loader.load("line", line);
+            loader.load("column", column);
+            loader.load("source_fragment", fragment);
+            node->srcInfo = Util::SourceInfo(filename ? filename : cstring::empty, line, column,
+                                             fragment ? fragment : cstring::empty); }
+        return node;
+    }
+
+    /// Visit each element of the array being loaded
+    template<typename F> void for_each_element(F fn) {
+        if (bin) {
+            if (slot->tag != BinaryIR::TAG_ARRAY) return;
+            auto *e = bin->elements(slot);
+            for (uint32_t i = 0, n = bin->count(slot); i < n; ++i)
+                fn(JSONLoader(bin, &e[i], node_refs));
+        } else {
+            for (auto e : *json->to<JsonVector>())
+                fn(JSONLoader(e, node_refs)); } }
+
+    /// Visit each (key, value) of the object being loaded
+    template<typename F> void for_each_field(F fn) {
+        if (bin) {
+            if (slot->tag != BinaryIR::TAG_OBJECT) return;
+            auto *e = bin->entries(slot);
+            for (uint32_t i = 0, n = bin->count(slot); i < n; ++i) {
+                BinaryIR::slot_t key = { BinaryIR::TAG_STRING, e[i].key };
+                fn(JSONLoader(bin, &key, node_refs), JSONLoader(bin, &e[i].value, node_refs)); }
+        } else {
+            for (auto e : *json->to<JsonObject>())
+                fn(JSONLoader(new JsonString(e.first), node_refs),
+                   JSONLoader(e.second, node_refs)); } }
+
+    /// The string being loaded, or null
+    cstring get_string() {
+        if (bin) return slot->tag == BinaryIR::TAG_STRING ? bin->string(slot->value) : cstring();
+        if (auto *s = json->to<std::string>()) return *s;
+        return cstring(); }
+
     template<typename T>
     void unpack_json(safe_vector<T> &v) {
         T temp;
-        for (auto e : *json->to<JsonVector>()) {
-            load(e, temp);
-            v.push_back(temp);
-        }
+        for_each_element([&](JSONLoader &&e) {
+            e.unpack_json(temp);
+            v.push_back(temp); });
     }
 
     template<typename T>
     void unpack_json(std::set<T> &v) {
         T temp;
-        for (auto e : *json->to<JsonVector>()) {
-            load(e, temp);
-            v.insert(temp);
-        }
+        for_each_element([&](JSONLoader &&e) {
+            e.unpack_json(temp);
+            v.insert(temp); });
     }
 
     template<typename T>
     void unpack_json(ordered_set<T> &v) {
         T temp;
-        for (auto e : *json->to<JsonVector>()) {
-            load(e, temp);
-            v.insert(temp);
-        }
+        for_each_element([&](JSONLoader &&e) {
+            e.unpack_json(temp);
+            v.insert(temp); });
     }
 
     template<typename T> void unpack_json(IR::Vector<T> &v) {
@@ -134,85 +204,95 @@ class JSONLoader {
     template<typename K, typename V>
     void unpack_json(std::map<K, V> &v) {
         std::pair<K, V> temp;
-        for (auto e : *json->to<JsonObject>()) {
-            JsonString* k = new JsonString(e.first);
-            load(k, temp.first);
-            load(e.second, temp.second);
-            v.insert(temp);
-        }
+        for_each_field([&](JSONLoader &&k, JSONLoader &&e) {
+            k.unpack_json(temp.first);
+            e.unpack_json(temp.second);
+            v.insert(temp); });
     }
     template<typename K, typename V>
     void unpack_json(ordered_map<K, V> &v) {
         std::pair<K, V> temp;
-        for (auto e : *json->to<JsonObject>()) {
-            JsonString* k = new JsonString(e.first);
-            load(k, temp.first);
-            load(e.second, temp.second);
-            v.insert(temp);
-        }
+        for_each_field([&](JSONLoader &&k, JSONLoader &&e) {
+            k.unpack_json(temp.first);
+            e.unpack_json(temp.second);
+            v.insert(temp); });
     }
     template<typename K, typename V>
     void unpack_json(std::multimap<K, V> &v) {
         std::pair<K, V> temp;
-        for (auto e : *json->to<JsonObject>()) {
-            JsonString* k = new JsonString(e.first);
-            load(k, temp.first);
-            load(e.second, temp.second);
-            v.insert(temp);
-        }
+        for_each_field([&](JSONLoader &&k, JSONLoader &&e) {
+            k.unpack_json(temp.first);
+            e.unpack_json(temp.second);
+            v.insert(temp); });
     }
 
     template<typename T>
     void unpack_json(std::vector<T> &v) {
         T temp;
-        for (auto e : *json->to<JsonVector>()) {
-            load(e, temp);
-            v.push_back(temp);
-        }
+        for_each_element([&](JSONLoader &&e) {
+            e.unpack_json(temp);
+            v.push_back(temp); });
     }
 
     template<typename T, typename U>
     void unpack_json(std::pair<T, U> &v) {
-        const JsonObject* obj = json->to<JsonObject>();
-        load(::get(obj, "first"), v.first);
-        load(::get(obj, "second"), v.second);
+        load("first", v.first);
+        load("second", v.second);
     }
 
     template<typename T>
     void unpack_json(boost::optional<T> &v) {
-        const JsonObject* obj = json->to<JsonObject>();
         bool isValid = false;
-        load(::get(obj, "valid"), isValid);
+        load("valid", isValid);
         if (!isValid) {
             v = boost::none;
             return;
         }
         T value;
-        load(::get(obj, "value"), value),
+        load("value", value),
         v = std::move(value);
     }
 
-    void unpack_json(bool &v) { v = *json->to<JsonBoolean>(); }
+    void unpack_json(bool &v) {
+        if (bin)
+            v = slot->tag == BinaryIR::TAG_TRUE;
+        else
+            v = *json->to<JsonBoolean>(); }
 
     template<typename T>
     typename std::enable_if<std::is_integral<T>::value>::type
-    unpack_json(T &v) { v = *json->to<JsonNumber>(); }
-    void unpack_json(mpz_class &v) { v = json->to<JsonNumber>()->val; }
-    void unpack_json(cstring &v) { if (!json->is<JsonNull>()) v = *json->to<std::string>(); }
-    void unpack_json(IR::ID &v) { if (!json->is<JsonNull>()) v.name = *json->to<std::string>(); }
+    unpack_json(T &v) {
+        if (!bin) {
+            v = *json->to<JsonNumber>();
+        } else if (slot->tag == BinaryIR::TAG_INT) {
+            v = int32_t(slot->value);
+        } else if (slot->tag == BinaryIR::TAG_BIGNUM) {
+            mpz_class val(bin->string(slot->value).c_str());
+            v = val.get_si(); } }
+    void unpack_json(mpz_class &v) {
+        if (!bin)
+            v = json->to<JsonNumber>()->val;
+        else if (slot->tag == BinaryIR::TAG_INT)
+            v = long(int32_t(slot->value));
+        else if (slot->tag == BinaryIR::TAG_BIGNUM)
+            v = mpz_class(bin->string(slot->value).c_str()); }
+    void unpack_json(cstring &v) {
+        if (bin ? slot->tag != BinaryIR::TAG_NULL : !json->is<JsonNull>()) v = get_string(); }
+    void unpack_json(IR::ID &v) {
+        if (bin ? slot->tag != BinaryIR::TAG_NULL : !json->is<JsonNull>()) v.name = get_string(); }
 
     void unpack_json(LTBitMatrix &m) {
-        if (auto *s = json->to<std::string>())
-            s->c_str() >> m; }
+        if (auto s = get_string())
+            s.c_str() >> m; }
 
     template<typename T> typename std::enable_if<std::is_enum<T>::value>::type
     unpack_json(T &v) {
-        if (auto *s = json->to<std::string>())
-            *s >> v; }
+        if (auto s = get_string())
+            s >> v; }
 
     void unpack_json(match_t &v) {
-        if (auto *s = json->to<std::string>())
-            s->c_str() >> v; }
+        if (auto s = get_string())
+            s.c_str() >> v; }
 
     void unpack_json(UnparsedConstant*& v) {
         cstring text("");
@@ -260,10 +340,9 @@ class JSONLoader {
 
     template<typename T, size_t N>
     void unpack_json(T (&v)[N]) {
-        if (auto *j = json->to<JsonVector>()) {
-            for (size_t i = 0; i < N && i < j->size(); ++i) {
-                json = (*j)[i];
-                unpack_json(v[i]); } } }
+        size_t i = 0;
+        for_each_element([&](JSONLoader &&e) {
+            if (i < N) e.unpack_json(v[i++]); }); }
 
  public:
     template<typename T>
@@ -273,7 +352,7 @@ class JSONLoader {
     template<typename T>
     void load(const std::string field, T &v) {
         JSONLoader loader(*this, field);
-        if (loader.json == nullptr) return;
+        if (loader.empty()) return;
         loader.unpack_json(v); }
 
     template<typename T> JSONLoader& operator>>(T &v) {
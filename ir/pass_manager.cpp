@@ -17,6 +17,7 @@ limitations under the License.
 #include "ir.h"
 #include "lib/gc.h"
 #include "lib/n4.h"
+#include "pass_profile.h"
 
 const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *) {
     safe_vector<std::pair<safe_vector<Visitor *>::iterator, const IR::Node *>> backup;
@@ -30,6 +31,9 @@ const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *
     early_exit_flag = false;
     unsigned initial_error_count = ::errorCount();
     BUG_CHECK(running, "not calling apply properly");
+    // a PassManager records itself only at the top level; nested ones are
+    // recorded as a pass of their parent
+    PassProfile::Scope profile_self(PassProfile::inScope() ? nullptr : name());
     for (auto it = passes.begin(); it != passes.end();) {
         Visitor* v = *it;
         if (auto b = dynamic_cast<Backtrack *>(v)) {
@@ -39,6 +43,7 @@ const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *
             try {
                 size_t maxmem;
                 LOG1(log_indent << name() << " invoking " << v->name());
+                PassProfile::Scope profile_pass(v->name());
                 auto after = program->apply(**it);
                 LOG3(log_indent << "heap after " << v->name() << ": in use " <<
                      n4(gc_mem_inuse(&maxmem)) << "B, max " << n4(maxmem) << "B");
@@ -96,14 +101,52 @@ void PassManager::runDebugHooks(const char* visitorName, const IR::Node* program
         h(name(), seqNo, visitorName, program);
 }
 
+/* Apply the passes to a program containing just the objects of @program with
+ * indexes in @which, and put the results back in @program.  Returns nullptr if
+ * that is not possible because the passes added or removed objects. */
+const IR::Node *PassRepeated::apply_to_objects(const IR::P4Program *program,
+                                               const std::vector<size_t> &which,
+                                               const char *name) {
+    IR::Vector<IR::Node> objects;
+    for (auto i : which)
+        objects.push_back(program->objects[i]);
+    auto *subset = new IR::P4Program(program->srcInfo, objects);
+    running = true;
+    auto *result = PassManager::apply_visitor(subset, name);
+    if (result == subset) return program;
+    auto *newsubset = result ? result->to<IR::P4Program>() : nullptr;
+    if (!newsubset || newsubset->objects.size() != which.size()) return nullptr;
+    auto *rv = program->clone();
+    for (size_t i = 0; i < which.size(); ++i)
+        rv->objects[which[i]] = newsubset->objects[i];
+    return rv;
+}
+
 const IR::Node *PassRepeated::apply_visitor(const IR::Node *program, const char *name) {
     bool done = false;
     unsigned iterations = 0;
     unsigned initial_error_count = ::errorCount();
+    PassProfile::Scope profile_self(PassProfile::inScope() ? nullptr : this->name());
+    // indexes of the top-level objects changed by the last iteration, when
+    // only those need to be visited again
+    std::vector<size_t> changed;
+    bool all_changed = true;
+    uint64_t objects_rerun = 0, objects_skipped = 0;
     while (!done) {
         LOG5("PassRepeated state is:\n" << dumpToString(program));
-        running = true;
-        auto newprogram = PassManager::apply_visitor(program, name);
+        auto *p4program = incremental ? program->to<IR::P4Program>() : nullptr;
+        const IR::Node *newprogram = nullptr;
+        if (p4program && !all_changed) {
+            LOG3("PassRepeated rerunning on " << changed.size() << " of " <<
+                 p4program->objects.size() << " objects");
+            newprogram = apply_to_objects(p4program, changed, name);
+            if (newprogram) {
+                objects_rerun += changed.size();
+                objects_skipped += p4program->objects.size() - changed.size(); } }
+        if (!newprogram) {
+            running = true;
+            newprogram = PassManager::apply_visitor(program, name);
+            if (p4program) objects_rerun += p4program->objects.size(); }
         if (program == newprogram || newprogram == nullptr)
             done = true;
         if (stop_on_error && ::errorCount() > initial_error_count)
@@ -111,8 +154,19 @@ const IR::Node *PassRepeated::apply_visitor(const IR::Node *program, const char
         iterations++;
         if (repeats != 0 && iterations > repeats)
             done = true;
+        auto *newp4program = p4program && newprogram ? newprogram->to<IR::P4Program>() : nullptr;
+        if (newp4program) {
+            changed.clear();
+            all_changed = newp4program->objects.size() != p4program->objects.size();
+            for (size_t i = 0; !all_changed && i < p4program->objects.size(); ++i)
+                if (newp4program->objects[i] != p4program->objects[i])
+                    changed.push_back(i); }
         program = newprogram;
     }
+    PassProfile::annotate("iterations", iterations);
+    if (incremental) {
+        PassProfile::annotate("objects_rerun", objects_rerun);
+        PassProfile::annotate("objects_skipped", objects_skipped); }
     return program;
 }
 
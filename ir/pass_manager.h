@@ -67,12 +67,22 @@ class PassManager : virtual public Visitor, virtual public Backtrack {
 // Repeat a pass until convergence (or up to a fixed number of repeats)
 class PassRepeated : virtual public PassManager {
     unsigned            repeats;  // 0 = until convergence
+    bool                incremental = false;
+    const IR::Node *apply_to_objects(const IR::P4Program *program,
+                                     const std::vector<size_t> &which, const char *name);
  public:
     PassRepeated() : repeats(0) {}
     PassRepeated(const std::initializer_list<Visitor *> &init) :
             PassManager(init), repeats(0) {}
     const IR::Node *apply_visitor(const IR::Node *, const char * = 0) override;
     PassRepeated *setRepeats(unsigned repeats) { this->repeats = repeats; return this; }
+    // When applied to a P4Program, rerun the passes after the first iteration only
+    // on the top-level objects that changed in the previous iteration.  This is only
+    // correct if every pass deals with each top-level object on its own (it doesn't
+    // need to see the other objects, eg to resolve references to them), and the
+    // passes return unchanged objects when they run again on unchanged input.
+    PassRepeated *setIncremental(bool incremental = true) {
+        this->incremental = incremental; return this; }
 };
 
 class PassRepeatUntil : virtual public PassManager {
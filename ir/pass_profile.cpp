@@ -0,0 +1,184 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "pass_profile.h"
+#include <time.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <vector>
+#include "lib/gc.h"
+#include "lib/json.h"
+
+bool PassProfile::enabled = false;
+std::atomic<uint64_t> PassProfile::nodesVisited(0), PassProfile::nodesCloned(0),
+                      PassProfile::clonesAvoided(0);
+
+namespace {
+
+typedef std::vector<std::pair<cstring, uint64_t>>   counts_t;
+
+struct event_t {
+    cstring     name, path;
+    unsigned    depth;
+    uint64_t    start, duration, allocated, visited, cloned, avoided;
+    counts_t    counts;
+};
+
+struct totals_t {
+    unsigned    calls = 0;
+    uint64_t    duration = 0, allocated = 0, visited = 0, cloned = 0, avoided = 0;
+    std::map<cstring, uint64_t> counts;
+};
+
+std::vector<cstring>            stack;          // paths of the active scopes
+std::vector<counts_t>           stack_counts;   // annotations of the active scopes
+std::vector<event_t>            events;
+std::map<cstring, totals_t>     summary;
+std::vector<cstring>            summary_order;
+uint64_t                        first_start;
+cstring                         output_file;
+
+uint64_t now_usec() {
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    // FIXME -- figure out how to do this on OSX/Mach
+    ts.tv_sec = ts.tv_nsec = 0;
+#endif
+    return ts.tv_sec*1000000UL + ts.tv_nsec/1000;
+}
+
+void write_output_file() {
+    std::ofstream out(output_file.c_str());
+    if (!out) {
+        std::cerr << "Cannot open " << output_file << " for the pass profile" << std::endl;
+        return; }
+    PassProfile::write(out);
+}
+
+}  // namespace
+
+void PassProfile::enable(cstring file) {
+    if (!output_file)
+        atexit(write_output_file);
+    output_file = file;
+    enabled = true;
+}
+
+bool PassProfile::inScope() { return !stack.empty(); }
+
+void PassProfile::annotate(cstring key, uint64_t value) {
+    if (!enabled || stack_counts.empty()) return;
+    gc_global_allocation global;
+    for (auto &c : stack_counts.back()) {
+        if (c.first == key) {
+            c.second += value;
+            return; } }
+    stack_counts.back().emplace_back(key, value);
+}
+
+PassProfile::Scope::Scope(const char *name) : active(enabled && name) {
+    if (!active) return;
+    // the profile outlives the compilation it is recording
+    gc_global_allocation global;
+    start = now_usec();
+    if (!first_start) first_start = start;
+    allocated = gc_total_allocated();
+    visited = nodesVisited;
+    cloned = nodesCloned;
+    avoided = clonesAvoided;
+    stack.push_back(stack.empty() ? cstring(name) : stack.back() + "/" + name);
+    stack_counts.emplace_back();
+    if (!summary.count(stack.back())) {
+        summary.emplace(stack.back(), totals_t());
+        summary_order.push_back(stack.back()); }
+}
+
+PassProfile::Scope::~Scope() {
+    if (!active) return;
+    gc_global_allocation global;
+    event_t ev;
+    ev.path = stack.back();
+    ev.counts = std::move(stack_counts.back());
+    stack.pop_back();
+    stack_counts.pop_back();
+    const char *slash = strrchr(ev.path.c_str(), '/');
+    ev.name = slash ? cstring(slash + 1) : ev.path;
+    ev.depth = stack.size();
+    ev.start = start - first_start;
+    ev.duration = now_usec() - start;
+    ev.allocated = gc_total_allocated() - allocated;
+    ev.visited = nodesVisited - visited;
+    ev.cloned = nodesCloned - cloned;
+    ev.avoided = clonesAvoided - avoided;
+    events.push_back(ev);
+
+    auto &tot = summary.at(ev.path);
+    tot.calls++;
+    tot.duration += ev.duration;
+    tot.allocated += ev.allocated;
+    tot.visited += ev.visited;
+    tot.cloned += ev.cloned;
+    tot.avoided += ev.avoided;
+    for (auto &c : ev.counts)
+        tot.counts[c.first] += c.second;
+}
+
+void PassProfile::write(std::ostream &out) {
+    auto *trace = new Util::JsonObject();
+    auto *traceEvents = new Util::JsonArray();
+    for (auto &ev : events) {
+        auto *args = new Util::JsonObject();
+        args->emplace("path", ev.path);
+        args->emplace("allocated_bytes", ev.allocated);
+        args->emplace("nodes_visited", ev.visited);
+        args->emplace("nodes_cloned", ev.cloned);
+        args->emplace("clones_avoided", ev.avoided);
+        for (auto &c : ev.counts)
+            args->emplace(c.first, c.second);
+        auto *e = new Util::JsonObject();
+        e->emplace("name", ev.name);
+        e->emplace("cat", "pass");
+        e->emplace("ph", "X");
+        e->emplace("ts", ev.start);
+        e->emplace("dur", ev.duration);
+        e->emplace("pid", 0);
+        e->emplace("tid", 0);
+        e->emplace("args", args);
+        traceEvents->append(e); }
+    auto *passSummary = new Util::JsonArray();
+    for (auto path : summary_order) {
+        auto &tot = summary.at(path);
+        auto *s = new Util::JsonObject();
+        s->emplace("path", path);
+        s->emplace("calls", tot.calls);
+        s->emplace("time_usec", tot.duration);
+        s->emplace("allocated_bytes", tot.allocated);
+        s->emplace("nodes_visited", tot.visited);
+        s->emplace("nodes_cloned", tot.cloned);
+        s->emplace("clones_avoided", tot.avoided);
+        for (auto &c : tot.counts)
+            s->emplace(c.first, c.second);
+        passSummary->append(s); }
+    trace->emplace("traceEvents", traceEvents);
+    trace->emplace("displayTimeUnit", "ms");
+    trace->emplace("passSummary", passSummary);
+    trace->serialize(out);
+    out << std::endl;
+}
@@ -0,0 +1,69 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_PASS_PROFILE_H_
+#define _IR_PASS_PROFILE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include "lib/cstring.h"
+
+/** Per-pass statistics for --profile-passes.
+ *
+ * When enabled, every pass run by a PassManager is recorded with its wall
+ * time, the bytes allocated, and the number of IR nodes visited and cloned
+ * while it ran (including by any visitors it applies internally), as well as
+ * the clones avoided by cloneOnWrite visitors.  Passes are
+ * identified by their path through the PassManager hierarchy, e.g.
+ * "FrontEnd/TypeInference/TypeInference".
+ *
+ * The report is in Chrome trace-event format (load it in chrome://tracing or
+ * Perfetto), with an extra "passSummary" array that aggregates all the runs of
+ * each pass path, in order of first run.
+ */
+class PassProfile {
+ public:
+    static bool enabled;
+    // node counters maintained by the Inspector/Modifier/Transform traversals
+    // while profiling is enabled
+    static std::atomic<uint64_t> nodesVisited, nodesCloned, clonesAvoided;
+
+    /// Start recording; the report is written to @file when the program exits.
+    static void enable(cstring file);
+    /// Write the report for everything recorded so far.
+    static void write(std::ostream &out);
+
+    /// RAII object to record a pass from construction to destruction.
+    /// Does nothing if profiling is not enabled or @name is null.
+    class Scope {
+        bool            active;
+        uint64_t        start, allocated, visited, cloned, avoided;
+     public:
+        explicit Scope(const char *name);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    /// True if a Scope is currently recording
+    static bool inScope();
+    /// Add a named count to the innermost recording Scope (eg, the iterations of a
+    /// PassRepeated); counts with the same name are added up in the summary.
+    static void annotate(cstring key, uint64_t value);
+};
+
+#endif /* _IR_PASS_PROFILE_H_ */
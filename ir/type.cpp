@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <utility>
 #include "ir.h"
+#include "lib/gc.h"
 
 namespace IR {
 
@@ -55,6 +56,8 @@ const Type_Bits* Type_Bits::get(int width, bool isSigned) {
     // map (width, signed) to type
     using bit_type_key = std::pair<int, bool>;
     static std::map<bit_type_key, const IR::Type_Bits*> *type_map = nullptr;
+    // the types are shared by all compilations, so never come from an arena
+    gc_global_allocation global;
     if (type_map == nullptr)
         type_map = new std::map<bit_type_key, const IR::Type_Bits*>();
     auto &result = (*type_map)[std::make_pair(width, isSigned)];
@@ -65,22 +68,25 @@ const Type_Bits* Type_Bits::get(int width, bool isSigned) {
 
 const Type::Unknown *Type::Unknown::get() {
     static const Type::Unknown *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type::Unknown());
+    if (!singleton) {
+        gc_global_allocation global;
+        singleton = (new Type::Unknown()); }
     return singleton;
 }
 
 const Type::Boolean *Type::Boolean::get() {
     static const Type::Boolean *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type::Boolean());
+    if (!singleton) {
+        gc_global_allocation global;
+        singleton = (new Type::Boolean()); }
     return singleton;
 }
 
 const Type_String *Type_String::get() {
     static const Type_String *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type_String());
+    if (!singleton) {
+        gc_global_allocation global;
+        singleton = (new Type_String()); }
     return singleton;
 }
 
@@ -102,29 +108,33 @@ const Type::Varbits *Type::Varbits::get() {
 
 const Type_Dontcare *Type_Dontcare::get() {
     static const Type_Dontcare *singleton;
-    if (!singleton)
-        singleton = (new Type_Dontcare());
+    if (!singleton) {
+        gc_global_allocation global;
+        singleton = (new Type_Dontcare()); }
     return singleton;
 }
 
 const Type_State *Type_State::get() {
     static const Type_State *singleton;
-    if (!singleton)
-        singleton = (new Type_State());
+    if (!singleton) {
+        gc_global_allocation global;
+        singleton = (new Type_State()); }
     return singleton;
 }
 
 const Type_Void *Type_Void::get() {
     static const Type_Void *singleton;
-    if (!singleton)
-        singleton = (new Type_Void());
+    if (!singleton) {
+        gc_global_allocation global;
+        singleton = (new Type_Void()); }
     return singleton;
 }
 
 const Type_MatchKind *Type_MatchKind::get() {
     static const Type_MatchKind *singleton;
-    if (!singleton)
-        singleton = (new Type_MatchKind());
+    if (!singleton) {
+        gc_global_allocation global;
+        singleton = (new Type_MatchKind()); }
     return singleton;
 }
 
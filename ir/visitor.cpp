@@ -15,8 +15,14 @@ limitations under the License.
 */
 
 #include <time.h>
+#ifdef MULTITHREAD
+#include <mutex>
+#endif  // MULTITHREAD
 #include "ir.h"
+#include "lib/gc.h"
 #include "lib/log.h"
+#include "lib/thread_pool.h"
+#include "pass_profile.h"
 
 /** @class Visitor::ChangeTracker
  *  @brief Assists visitors in traversing the IR.
@@ -32,7 +38,7 @@ class Visitor::ChangeTracker {
         bool            visitOnce;
         const IR::Node  *result;
     };
-    typedef std::unordered_map<const IR::Node *, visit_info_t>  visited_t;
+    typedef flat_ptr_map<const IR::Node *, visit_info_t>  visited_t;
     visited_t           visited;
 
  public:
@@ -41,15 +47,14 @@ class Visitor::ChangeTracker {
      */
     void start(const IR::Node *n, bool defaultVisitOnce) {
         // Initialization
-        visited_t::iterator visited_it;
+        visit_info_t *visit_info;
         bool inserted;
         bool visit_in_progress = true;
-        std::tie(visited_it, inserted) =
+        std::tie(visit_info, inserted) =
             visited.emplace(n, visit_info_t{visit_in_progress, defaultVisitOnce, n});
 
         // Sanity check for IR loops
         bool already_present = !inserted;
-        visit_info_t *visit_info = &(visited_it->second);
         if (already_present && visit_info->visit_in_progress)
             BUG("IR loop detected ");
     }
@@ -68,11 +73,10 @@ class Visitor::ChangeTracker {
      * previously been invoked.
      */
     bool finish(const IR::Node *orig, const IR::Node *final) {
-        auto it = visited.find(orig);
-        if (it == visited.end())
+        visit_info_t *orig_visit_info = visited.find(orig);
+        if (!orig_visit_info)
             BUG("visitor state tracker corrupted");
 
-        visit_info_t *orig_visit_info = &(it->second);
         orig_visit_info->visit_in_progress = false;
         if (!final) {
             orig_visit_info->result = final;
@@ -90,19 +94,17 @@ class Visitor::ChangeTracker {
     /** Return a pointer to the visitOnce flag for node @n so that it can be changed
      */
     bool *refVisitOnce(const IR::Node *n) {
-        if (!visited.count(n))
+        visit_info_t *visit_info = visited.find(n);
+        if (!visit_info)
             BUG("visitor state tracker corrupted");
-        return &visited.at(n).visitOnce;
+        return &visit_info->visitOnce;
     }
 
     /** Forget nodes that have already been visited, allowing them to be visited
      * again. */
     void revisit_visited() {
-        for (auto it = visited.begin(); it != visited.end();) {
-            if (!it->second.visit_in_progress)
-                it = visited.erase(it);
-            else
-                ++it; } }
+        visited.erase_if([](const IR::Node *, const visit_info_t &info) {
+            return !info.visit_in_progress; }); }
 
     /** Determine whether @n has been visited and the visitor has finished
      *  and we don't want to visit @n again the next time we see it.
@@ -112,8 +114,8 @@ class Visitor::ChangeTracker {
      * @return true if @n has been visited and the visitor is finished and visitOnce is true
      */
     bool done(const IR::Node *n) const {
-        auto it = visited.find(n);
-        return it != visited.end() && !it->second.visit_in_progress && it->second.visitOnce;
+        const visit_info_t *visit_info = visited.find(n);
+        return visit_info && !visit_info->visit_in_progress && visit_info->visitOnce;
     }
 
     /** Produce the result of visiting @n.
@@ -123,12 +125,74 @@ class Visitor::ChangeTracker {
      * if `start(@n)` has not been invoked.
      */
     const IR::Node *result(const IR::Node *n) const {
-        if (!visited.count(n))
-            return n;
-        return visited.at(n).result;
+        const visit_info_t *visit_info = visited.find(n);
+        return visit_info ? visit_info->result : n;
     }
+
+    /** Forget everything, so the tracker can be reused for another traversal */
+    void clear() { visited.clear(); }
+};
+
+/** @class Visitor::CloneOnWrite
+ *  @brief State for Modifier and Transform passes with cloneOnWrite set.
+ *
+ *  Records, per node type, whether the visitor's preorder and postorder for
+ *  that type are the defaults (so can be skipped), and the results of the
+ *  children visited in place.  The results are kept as a stack: a node visited
+ *  in place consumes the results of its own children before it returns and its
+ *  result is recorded for its parent.
+ */
+class Visitor::CloneOnWrite {
+    flat_ptr_map<const std::type_info *, unsigned>   types;
+
+ public:
+    enum { PRE_DEFAULT = 1, POST_DEFAULT = 2 };
+    typedef std::pair<const IR::Node *, const IR::Node *>       result_t;
+    std::vector<result_t>       results;
+    const Context               *in_place = nullptr;  // node whose children are visited in place
+
+    unsigned &orders(const IR::Node *n) { return *types.emplace(&typeid(*n), 0).first; }
+    IR::Node *visit_children(Visitor &v, const IR::Node *n, Context &current);
+    static void learn(unsigned &orders, unsigned which, bool is_default) {
+        if (is_default)
+            orders |= which;
+        else
+            orders &= ~which; }
 };
 
+/* Visited tables are recycled from one traversal to the next rather than being
+ * reallocated by every pass; a table is returned to the pool (emptied) when the
+ * top-level apply_visitor call that was using it completes.  Nested traversals
+ * (a pass applying another visitor from within a preorder) just take another
+ * table from the pool.  Tables used while an arena is active live in (or have
+ * grown into) arena memory, so the pool is dropped when the arena is released.
+ * The pools are shared by the threads of parallel traversals, so they are
+ * locked when built with MULTITHREAD. */
+#ifdef MULTITHREAD
+static std::mutex visited_table_lock;
+#endif  // MULTITHREAD
+template<class T> static std::vector<T *> &visited_table_pool() {
+    static std::vector<T *> pool;
+    static bool registered = (gc_on_arena_release([]() { std::vector<T *>().swap(pool); }),
+                              true);
+    (void)registered;
+    return pool; }
+template<class T> static T *get_visited_table() {
+#ifdef MULTITHREAD
+    std::lock_guard<std::mutex> acquire(visited_table_lock);
+#endif  // MULTITHREAD
+    auto &pool = visited_table_pool<T>();
+    if (pool.empty()) return new T;
+    auto *rv = pool.back();
+    pool.pop_back();
+    return rv; }
+template<class T> static void release_visited_table(T *table) {
+    table->clear();
+#ifdef MULTITHREAD
+    std::lock_guard<std::mutex> acquire(visited_table_lock);
+#endif  // MULTITHREAD
+    visited_table_pool<T>().push_back(table); }
+
 Visitor::profile_t Visitor::init_apply(const IR::Node *root) {
     if (ctxt) BUG("previous use of visitor did not clean up properly");
     ctxt = nullptr;
@@ -137,15 +201,23 @@ Visitor::profile_t Visitor::init_apply(const IR::Node *root) {
 }
 Visitor::profile_t Modifier::init_apply(const IR::Node *root) {
     auto rv = Visitor::init_apply(root);
-    visited = new ChangeTracker();
+    visited = get_visited_table<ChangeTracker>();
+    if (cloneOnWrite) {
+        BUG_CHECK(!dynamic_cast<ControlFlowVisitor *>(this),
+                  "%s: cloneOnWrite can't be combined with ControlFlowVisitor", name());
+        cow = new CloneOnWrite; }
     return rv; }
 Visitor::profile_t Inspector::init_apply(const IR::Node *root) {
     auto rv = Visitor::init_apply(root);
-    visited = new visited_t();
+    visited = get_visited_table<visited_t>();
     return rv; }
 Visitor::profile_t Transform::init_apply(const IR::Node *root) {
     auto rv = Visitor::init_apply(root);
-    visited = new ChangeTracker();
+    visited = get_visited_table<ChangeTracker>();
+    if (cloneOnWrite) {
+        BUG_CHECK(!dynamic_cast<ControlFlowVisitor *>(this),
+                  "%s: cloneOnWrite can't be combined with ControlFlowVisitor", name());
+        cow = new CloneOnWrite; }
     return rv; }
 void Visitor::end_apply() {}
 void Visitor::end_apply(const IR::Node*) {}
@@ -202,9 +274,12 @@ void Visitor::print_context() const {
 void Visitor::visitor_const_error() {
     BUG("const Visitor wants to change IR"); }
 void Modifier::visitor_const_error() {
+    // a child changed while visiting in place; visit_in_place deals with it
+    if (cow && cow->in_place == ctxt) return;
     BUG("Modifier called const visit function -- missing template "
                             "instantiation in gen-tree-macro.h?"); }
 void Transform::visitor_const_error() {
+    if (cow && cow->in_place == ctxt) return;
     BUG("Transform called const visit function -- missing template "
                             "instantiation in gen-tree-macro.h?"); }
 
@@ -231,33 +306,89 @@ class ForwardChildren : public Visitor {
  public:
     explicit ForwardChildren(const ChangeTracker &v) : visited(v) {}
 };
+
+/* Replaces the children of a clone with the results recorded while visiting
+ * the children of the original in place.  Children are visited in the same
+ * order, though a clone may skip some (eg, the value of a deleted NodeMap key) */
+class ForwardResults : public Visitor {
+    typedef std::pair<const IR::Node *, const IR::Node *> result_t;
+    const result_t *next, *end;
+    const IR::Node *apply_visitor(const IR::Node *n, const char * = 0) override {
+        for (; next != end; ++next)
+            if (next->first == n) return (next++)->second;
+        BUG("no result for child %1% visited in place", n); }
+ public:
+    ForwardResults(const result_t *begin, const result_t *end) : next(begin), end(end) {}
+};
 }    // namespace
 
+/* Visit the children of @n in place (@current is its context).  @returns a
+ * clone of @n with the new children if any of them changed, or nullptr. */
+IR::Node *Visitor::CloneOnWrite::visit_children(Visitor &v, const IR::Node *n,
+                                                Context &current) {
+    size_t start = results.size();
+    auto *save_in_place = in_place;
+    in_place = &current;
+    n->visit_children(v);
+    in_place = save_in_place;
+    bool changed = false;
+    for (size_t i = start; i < results.size() && !changed; ++i)
+        changed = results[i].first != results[i].second;
+    IR::Node *copy = nullptr;
+    if (changed) {
+        current.node = copy = n->clone();
+        ForwardResults forward_results(results.data() + start, results.data() + results.size());
+        copy->visit_children(forward_results); }
+    results.resize(start);
+    return copy;
+}
+
 const IR::Node *Modifier::apply_visitor(const IR::Node *n, const char *name) {
     if (ctxt) ctxt->child_name = name;
+    const IR::Node *orig = n;
     if (n) {
         PushContext local(ctxt, n);
+        unsigned *orders = cow ? &cow->orders(n) : nullptr;
         if (visited->done(n)) {
             n->apply_visitor_revisit(*this, visited->result(n));
             n = visited->result(n);
+        } else if (orders && (*orders & CloneOnWrite::PRE_DEFAULT)) {
+            n = visit_in_place(n, local.current, *orders);
         } else {
             visited->start(n, visitDagOnce);
             IR::Node *copy = n->clone();
+            if (PassProfile::enabled) {
+                ++PassProfile::nodesVisited;
+                ++PassProfile::nodesCloned; }
             local.current.node = copy;
             if (!dontForwardChildrenBeforePreorder) {
                 ForwardChildren forward_children(*visited);
                 copy->visit_children(forward_children); }
             visitCurrentOnce = visited->refVisitOnce(n);
-            if (copy->apply_visitor_preorder(*this)) {
+            default_order_node = nullptr;
+            bool preorder_result = copy->apply_visitor_preorder(*this);
+            if (orders)
+                CloneOnWrite::learn(*orders, CloneOnWrite::PRE_DEFAULT,
+                                    default_order_node == copy);
+            if (preorder_result) {
                 copy->visit_children(*this);
                 visitCurrentOnce = visited->refVisitOnce(n);
-                copy->apply_visitor_postorder(*this); }
+                default_order_node = nullptr;
+                copy->apply_visitor_postorder(*this);
+                if (orders)
+                    CloneOnWrite::learn(*orders, CloneOnWrite::POST_DEFAULT,
+                                        default_order_node == copy); }
             if (visited->finish(n, copy))
                 (n = copy)->validate(); } }
-    if (ctxt)
+    if (cow && cow->in_place && cow->in_place == ctxt)
+        cow->results.emplace_back(orig, n);
+    if (ctxt) {
         ctxt->child_index++;
-    else
+    } else {
+        release_visited_table(visited);
         visited = nullptr;
+        delete cow;
+        cow = nullptr; }
     return n;
 }
 
@@ -266,37 +397,50 @@ const IR::Node *Inspector::apply_visitor(const IR::Node *n, const char *name) {
     if (n && !join_flows(n)) {
         PushContext local(ctxt, n);
         auto vp = visited->emplace(n, info_t{false, visitDagOnce});
-        if (!vp.second && !vp.first->second.done)
+        if (!vp.second && !vp.first->done)
             BUG("IR loop detected");
-        if (!vp.second && vp.first->second.visitOnce) {
+        if (!vp.second && vp.first->visitOnce) {
             n->apply_visitor_revisit(*this);
         } else {
-            vp.first->second.done = false;
-            visitCurrentOnce = &vp.first->second.visitOnce;
+            vp.first->done = false;
+            if (PassProfile::enabled) ++PassProfile::nodesVisited;
+            visitCurrentOnce = &vp.first->visitOnce;
             if (n->apply_visitor_preorder(*this)) {
-                n->visit_children(*this);
-                visitCurrentOnce = &vp.first->second.visitOnce;
+                auto *program = visitObjectsInParallel ? n->to<IR::P4Program>() : nullptr;
+                if (program)
+                    visit_objects_in_parallel(program);
+                else
+                    n->visit_children(*this);
+                visitCurrentOnce = &vp.first->visitOnce;
                 n->apply_visitor_postorder(*this); }
             if (vp.first != visited->find(n))
                 BUG("visitor state tracker corrupted");
-            vp.first->second.done = true; } }
-    if (ctxt)
+            vp.first->done = true; } }
+    if (ctxt) {
         ctxt->child_index++;
-    else
-        visited = nullptr;
+    } else {
+        release_visited_table(visited);
+        visited = nullptr; }
     return n;
 }
 
 const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
     if (ctxt) ctxt->child_name = name;
+    const IR::Node *orig = n;
     if (n) {
         PushContext local(ctxt, n);
+        unsigned *orders = cow ? &cow->orders(n) : nullptr;
         if (visited->done(n)) {
             n->apply_visitor_revisit(*this, visited->result(n));
             n = visited->result(n);
+        } else if (orders && (*orders & CloneOnWrite::PRE_DEFAULT)) {
+            n = visit_in_place(n, local.current, *orders);
         } else {
             visited->start(n, visitDagOnce);
             auto copy = n->clone();
+            if (PassProfile::enabled) {
+                ++PassProfile::nodesVisited;
+                ++PassProfile::nodesCloned; }
             local.current.node = copy;
             if (!dontForwardChildrenBeforePreorder) {
                 ForwardChildren forward_children(*visited);
@@ -305,8 +449,12 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
             prune_flag = false;
             visitCurrentOnce = visited->refVisitOnce(n);
             bool extra_clone = false;
+            default_order_node = nullptr;
             const IR::Node *preorder_result = copy->apply_visitor_preorder(*this);
             assert(preorder_result != n);  // should never happen
+            if (orders)
+                CloneOnWrite::learn(*orders, CloneOnWrite::PRE_DEFAULT,
+                                    default_order_node == copy);
             const IR::Node *final_result = preorder_result;
             if (preorder_result != copy) {
                 // FIXME -- not safe if the visitor resurrects the node (which it shouldn't)
@@ -320,11 +468,16 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
                 } else {
                     extra_clone = true;
                     visited->start(preorder_result, *visitCurrentOnce);
-                    local.current.node = copy = preorder_result->clone(); } }
+                    local.current.node = copy = preorder_result->clone();
+                    if (PassProfile::enabled) ++PassProfile::nodesCloned; } }
             if (!prune_flag) {
                 copy->visit_children(*this);
                 visitCurrentOnce = visited->refVisitOnce(n);
-                final_result = copy->apply_visitor_postorder(*this); }
+                default_order_node = nullptr;
+                final_result = copy->apply_visitor_postorder(*this);
+                if (orders && !extra_clone)
+                    CloneOnWrite::learn(*orders, CloneOnWrite::POST_DEFAULT,
+                                        default_order_node == copy); }
             prune_flag = save_prune_flag;
             if (final_result == copy
                 && final_result != preorder_result
@@ -334,19 +487,92 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
                 final_result->validate();
             if (extra_clone)
                 visited->finish(preorder_result, final_result); } }
-    if (ctxt)
+    if (cow && cow->in_place && cow->in_place == ctxt)
+        cow->results.emplace_back(orig, n);
+    if (ctxt) {
         ctxt->child_index++;
-    else
+    } else {
+        release_visited_table(visited);
         visited = nullptr;
+        delete cow;
+        cow = nullptr; }
+    return n;
+}
+
+/* Visit a node of a type known to have the default preorder: its children are
+ * visited without cloning it, and it is only cloned if a child changed or if
+ * postorder must be called. */
+const IR::Node *Modifier::visit_in_place(const IR::Node *n, Context &current,
+                                         unsigned &orders) {
+    visited->start(n, visitDagOnce);
+    if (PassProfile::enabled) ++PassProfile::nodesVisited;
+    visitCurrentOnce = visited->refVisitOnce(n);
+    IR::Node *copy = cow->visit_children(*this, n, current);
+    if (!(orders & CloneOnWrite::POST_DEFAULT)) {
+        if (!copy) current.node = copy = n->clone();
+        visitCurrentOnce = visited->refVisitOnce(n);
+        default_order_node = nullptr;
+        copy->apply_visitor_postorder(*this);
+        CloneOnWrite::learn(orders, CloneOnWrite::POST_DEFAULT, default_order_node == copy); }
+    if (PassProfile::enabled) ++(copy ? PassProfile::nodesCloned : PassProfile::clonesAvoided);
+    if (!copy) {
+        visited->finish(n, n);
+        return n; }
+    if (visited->finish(n, copy))
+        (n = copy)->validate();
+    return n;
+}
+
+const IR::Node *Transform::visit_in_place(const IR::Node *n, Context &current,
+                                          unsigned &orders) {
+    visited->start(n, visitDagOnce);
+    if (PassProfile::enabled) ++PassProfile::nodesVisited;
+    visitCurrentOnce = visited->refVisitOnce(n);
+    IR::Node *copy = cow->visit_children(*this, n, current);
+    const IR::Node *final_result = copy;
+    if (!(orders & CloneOnWrite::POST_DEFAULT)) {
+        if (!copy) current.node = copy = n->clone();
+        visitCurrentOnce = visited->refVisitOnce(n);
+        default_order_node = nullptr;
+        final_result = copy->apply_visitor_postorder(*this);
+        CloneOnWrite::learn(orders, CloneOnWrite::POST_DEFAULT, default_order_node == copy); }
+    if (PassProfile::enabled) ++(copy ? PassProfile::nodesCloned : PassProfile::clonesAvoided);
+    if (!copy) {
+        visited->finish(n, n);
+        return n; }
+    if (visited->finish(n, final_result) && (n = final_result))
+        final_result->validate();
     return n;
 }
 
+void Inspector::visit_objects_in_parallel(const IR::P4Program *program) {
+    BUG_CHECK(!joinFlows, "%s: joinFlows can't be combined with visitObjectsInParallel", name());
+    auto &objects = program->objects;
+    std::vector<Inspector *> clones(objects.size());
+    std::vector<visited_t *> tables(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        clones[i] = dynamic_cast<Inspector *>(clone());
+        BUG_CHECK(clones[i] && clones[i]->check_clone(this), "%s: clone failed", name());
+        tables[i] = get_visited_table<visited_t>(); }
+    const Context *parent = ctxt;
+    Util::parallel_for(objects.size(), [&](size_t i) {
+        // each clone gets its own copy of the parent context, as visiting
+        // a child updates the child_index of its parent
+        Context local = *parent;
+        local.child_index = i;
+        clones[i]->ctxt = &local;
+        clones[i]->visited = tables[i];
+        clones[i]->apply_visitor(objects[i]);
+        clones[i]->ctxt = nullptr; });
+    for (size_t i = 0; i < objects.size(); ++i) {
+        clones[i]->visited = nullptr;
+        release_visited_table(tables[i]);
+        parallel_merge(*clones[i]); }
+    ctxt->child_index += objects.size();
+}
+
 void Inspector::revisit_visited() {
-    for (auto it = visited->begin(); it != visited->end();) {
-        if (it->second.done)
-            it = visited->erase(it);
-        else
-            ++it; }
+    visited->erase_if([](const IR::Node *, const info_t &info) { return info.done; });
 }
 void Modifier::revisit_visited() {
     visited->revisit_visited();
@@ -20,6 +20,7 @@ limitations under the License.
 #include <stdexcept>
 #include <unordered_map>
 #include "lib/cstring.h"
+#include "lib/flat_ptr_map.h"
 #include "ir/ir.h"
 #include "lib/exceptions.h"
 
@@ -202,6 +203,17 @@ class Visitor {
     // pass, this will result in them being duplicated if they are modified.
     bool visitDagOnce = true;
     bool dontForwardChildrenBeforePreorder = false;
+    // if cloneOnWrite is set to 'true' (in a Modifier or Transform constructor),
+    // a node is only cloned if the visitor might change it: nodes whose type
+    // reaches the default (do-nothing) preorder are not given to preorder at all,
+    // their children are visited in place, and a clone is only made if a child
+    // changed or a postorder that is not the default must be called.  Which types
+    // reach the defaults is learned the first time a node of that type is visited
+    // in a traversal, so this may only be set by passes whose preorder and postorder
+    // overrides never forward to the base class versions conditionally.  While a
+    // node's children are visited in place, the context refers to the original node.
+    // It can't be used by a ControlFlowVisitor.
+    bool cloneOnWrite = false;
     // if joinFlows is 'true', Visitor will track nodes with more than one parent and
     // flow_merge the visitor from all the parents before visiting the node and its
     // children.  This only works for Inspector (not Modifier/Transform) currently.
@@ -233,6 +245,7 @@ class Visitor {
 
     void visit_children(const IR::Node *, std::function<void()> fn) { fn(); }
     class ChangeTracker;  // used by Modifier and Transform -- private to them
+    class CloneOnWrite;   // used by Modifier and Transform with cloneOnWrite set
     virtual bool check_clone(const Visitor *) { return true; }
     // This overrides visitDagOnce for a single node -- can only be called from
     // preorder and postorder functions
@@ -251,13 +264,16 @@ class Visitor {
 
 class Modifier : public virtual Visitor {
     ChangeTracker       *visited = nullptr;
+    CloneOnWrite        *cow = nullptr;
+    const IR::Node      *default_order_node = nullptr;  // last node given to a default order
     void visitor_const_error() override;
     bool check_clone(const Visitor *) override;
+    const IR::Node *visit_in_place(const IR::Node *n, Context &current, unsigned &orders);
  public:
     profile_t init_apply(const IR::Node *root) override;
     const IR::Node *apply_visitor(const IR::Node *n, const char *name = 0) override;
-    virtual bool preorder(IR::Node *) { return true; }
-    virtual void postorder(IR::Node *) {}
+    virtual bool preorder(IR::Node *n) { default_order_node = n; return true; }
+    virtual void postorder(IR::Node *n) { default_order_node = n; }
     virtual void revisit(const IR::Node *, const IR::Node *) {}
 #define DECLARE_VISIT_FUNCTIONS(CLASS, BASE)                            \
     virtual bool preorder(IR::CLASS *);                                 \
@@ -270,9 +286,11 @@ class Modifier : public virtual Visitor {
 
 class Inspector : public virtual Visitor {
     struct info_t { bool done, visitOnce; };
-    typedef std::unordered_map<const IR::Node *, info_t>       visited_t;
+    typedef flat_ptr_map<const IR::Node *, info_t>             visited_t;
     visited_t   *visited = nullptr;
     bool check_clone(const Visitor *) override;
+    void visit_objects_in_parallel(const IR::P4Program *program);
+
  public:
     profile_t init_apply(const IR::Node *root) override;
     const IR::Node *apply_visitor(const IR::Node *, const char *name = 0) override;
@@ -286,19 +304,35 @@ class Inspector : public virtual Visitor {
     IRNODE_ALL_SUBCLASSES(DECLARE_VISIT_FUNCTIONS)
 #undef DECLARE_VISIT_FUNCTIONS
     void revisit_visited();
+
+ protected:
+    // If visitObjectsInParallel is set to 'true' (in the derived Inspector's
+    // constructor), the objects of a P4Program are each visited by a separate
+    // clone() of the visitor, made after preorder(P4Program) returns; the clones
+    // run concurrently when built with MULTITHREAD (see Util::parallel_for).
+    // Each clone has its own visited table, so nodes shared between top-level
+    // objects are visited once per object.  When all are done, parallel_merge
+    // is called with each clone in program order, then postorder(P4Program).
+    // The pass must only modify state owned by the visitor object, and clone()
+    // must give the copy its own (normally empty) result state.
+    bool visitObjectsInParallel = false;
+    virtual void parallel_merge(Inspector &) {}
 };
 
 class Transform : public virtual Visitor {
     ChangeTracker       *visited = nullptr;
+    CloneOnWrite        *cow = nullptr;
+    const IR::Node      *default_order_node = nullptr;  // last node given to a default order
     bool prune_flag = false;
     void visitor_const_error() override;
     bool check_clone(const Visitor *) override;
+    const IR::Node *visit_in_place(const IR::Node *n, Context &current, unsigned &orders);
 
  public:
     profile_t init_apply(const IR::Node *root) override;
     const IR::Node *apply_visitor(const IR::Node *, const char *name = 0) override;
-    virtual const IR::Node *preorder(IR::Node *n) {return n;}
-    virtual const IR::Node *postorder(IR::Node *n) {return n;}
+    virtual const IR::Node *preorder(IR::Node *n) { default_order_node = n; return n; }
+    virtual const IR::Node *postorder(IR::Node *n) { default_order_node = n; return n; }
     virtual void revisit(const IR::Node *, const IR::Node *) {}
 #define DECLARE_VISIT_FUNCTIONS(CLASS, BASE)                            \
     virtual const IR::Node *preorder(IR::CLASS *);                      \
@@ -407,7 +441,7 @@ void forAllMatching(const IR::Node* root, Func&& function) {
 template <typename NodeType, typename RootType, typename Func>
 const RootType* modifyAllMatching(const RootType* root, Func&& function) {
     struct NodeVisitor : public Modifier {
-        explicit NodeVisitor(Func&& function) : function(function) { }
+        explicit NodeVisitor(Func&& function) : function(function) { cloneOnWrite = true; }
         Func function;
         void postorder(NodeType* node) override { function(node); }
     };
@@ -423,7 +457,7 @@ const RootType* modifyAllMatching(const RootType* root, Func&& function) {
 template <typename NodeType, typename Func>
 const IR::Node* transformAllMatching(const IR::Node* root, Func&& function) {
     struct NodeVisitor : public Transform {
-        explicit NodeVisitor(Func&& function) : function(function) { }
+        explicit NodeVisitor(Func&& function) : function(function) { cloneOnWrite = true; }
         Func function;
         const IR::Node* postorder(NodeType* node) override {
             return function(node);
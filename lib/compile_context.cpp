@@ -17,6 +17,7 @@ limitations under the License.
 #include "lib/compile_context.h"
 #include "lib/error.h"
 #include "lib/exceptions.h"
+#include "lib/gc.h"
 
 ICompileContext::~ICompileContext() { }
 
@@ -51,11 +52,26 @@ CompileContextStack::reportContextMismatch(const char* desiredContextType) {
     return stack;
 }
 
+/// Is there an AutoCompileContext that owns an arena?
+static bool arenaOwned = false;
+
 AutoCompileContext::AutoCompileContext(ICompileContext* context) {
-    CompileContextStack::push(context);
+    {
+        gc_global_allocation global;
+        CompileContextStack::push(context);
+    }
+    if (!arenaOwned && gc_arenas_enabled()) {
+        arenaOwned = inArena = true;
+        arenaMark = gc_arena_begin();
+    }
 }
 
 AutoCompileContext::~AutoCompileContext() {
+    if (inArena) {
+        gc_arena_end(arenaMark);
+        arenaOwned = false;
+    }
+    gc_global_allocation global;
     CompileContextStack::pop();
 }
 
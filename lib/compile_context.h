@@ -70,9 +70,17 @@ struct CompileContextStack final {
 /// created and pops it off when it's destroyed. To ensure the compilation stack
 /// is always nested correctly, this is the only interface for pushing or popping
 /// compilation contexts.
+///
+/// If arena allocation has been enabled (see gc_enable_arenas), an
+/// AutoCompileContext created when no other one owns an arena starts one:
+/// everything allocated while it exists is released when it is destroyed.
 struct AutoCompileContext {
     explicit AutoCompileContext(ICompileContext* context);
     ~AutoCompileContext();
+
+ private:
+    bool inArena = false;
+    size_t arenaMark = 0;
 };
 
 /// A base compilation context which provides members needed by code in
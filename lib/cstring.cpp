@@ -16,171 +16,177 @@ limitations under the License.
 
 #include "cstring.h"
 
+#include <atomic>
 #include <string>
-#include <unordered_set>
+#ifdef MULTITHREAD
+#include <mutex>
+#endif  // MULTITHREAD
 
+#include "gc.h"
 #include "hash.h"
 
 namespace {
-enum class table_entry_flags {
-    none,
-    no_need_copy = 1 << 0,
-    require_destruction = 1 << 1,
-    inplace = 1 << 2,
-};
-
-inline table_entry_flags operator &(table_entry_flags l, table_entry_flags r) {
-    return static_cast<table_entry_flags>(static_cast<int>(l) & static_cast<int>(r));
-}
-
-inline table_entry_flags operator |(table_entry_flags l, table_entry_flags r) {
-    return static_cast<table_entry_flags>(static_cast<int>(l) | static_cast<int>(r));
-}
 
-// cache entry, ordered by string length
-class table_entry {
-    std::size_t m_length = 0;
-    table_entry_flags m_flags = table_entry_flags::none;
+/* The intern table is split into shards, selected by the string hash, each
+ * with its own open-addressing table of entries and its own arena for the
+ * copies of interned strings.  Lookups do not lock: entries never change once
+ * they are published in a slot, and when a shard grows it publishes a new slot
+ * array and leaves the old one to readers that may still be probing it.
+ * Insertions lock the shard (when built with MULTITHREAD) and look again before
+ * adding, so every string is interned exactly once and cstrings with the same
+ * contents always share the same pointer. */
+struct table_entry {
+    std::size_t hash;
+    std::size_t length;
+    const char  *string;
+};
 
-    union {
-        const char *m_string;
-        char m_inplace_string[sizeof(const char *)];
+class table_shard {
+    struct slots_t {
+        std::size_t                             mask;
+        std::atomic<const table_entry *>        *slot;
+        explicit slots_t(std::size_t size)
+        : mask(size - 1), slot(new std::atomic<const table_entry *>[size]) {
+            for (std::size_t i = 0; i < size; ++i) slot[i].store(nullptr); }
     };
+    enum { INITIAL_SIZE = 64, ARENA_CHUNK = 16 * 1024 };
+
+    std::atomic<slots_t *>      slots;
+    char                        *arena_next = nullptr, *arena_end = nullptr;
+#ifdef MULTITHREAD
+    std::mutex                  lock;
+#endif  // MULTITHREAD
+
+    // Allocate @size bytes (aligned for a table_entry) from the arena
+    char *allocate(std::size_t size) {
+        size = (size + alignof(table_entry) - 1) & ~(alignof(table_entry) - 1);
+        if (size > ARENA_CHUNK / 4)
+            return new char[size];
+        if (size > std::size_t(arena_end - arena_next)) {
+            arena_next = new char[ARENA_CHUNK];
+            arena_end = arena_next + ARENA_CHUNK;
+            bytes.fetch_add(ARENA_CHUNK, std::memory_order_relaxed); }
+        char *rv = arena_next;
+        arena_next += size;
+        return rv; }
+
+    static const table_entry *find(const slots_t *t, const char *string, std::size_t length,
+                                   std::size_t hash, std::size_t &i) {
+        for (i = hash & t->mask;; i = (i + 1) & t->mask) {
+            auto *e = t->slot[i].load(std::memory_order_acquire);
+            if (!e) return nullptr;
+            if (e->hash == hash && e->length == length &&
+                std::memcmp(e->string, string, length) == 0)
+                return e; } }
+
+    void grow() {
+        slots_t *old = slots.load(std::memory_order_relaxed);
+        auto *t = new slots_t(2 * (old->mask + 1));
+        for (std::size_t i = 0; i <= old->mask; ++i) {
+            auto *e = old->slot[i].load(std::memory_order_relaxed);
+            if (!e) continue;
+            std::size_t j = e->hash & t->mask;
+            while (t->slot[j].load(std::memory_order_relaxed)) j = (j + 1) & t->mask;
+            t->slot[j].store(e, std::memory_order_relaxed); }
+        slots.store(t, std::memory_order_release);
+        bytes.fetch_add((t->mask + 1) * sizeof(*t->slot), std::memory_order_relaxed); }
 
  public:
-    // entry ctor, makes copy of passed string
-    table_entry(const char *string, std::size_t length, table_entry_flags flags)
-        : m_length(length) {
-        if ((flags & table_entry_flags::no_need_copy) == table_entry_flags::no_need_copy) {
-            // No need to copy object, it's view of string, string literal or string allocated
-            // on heap and wrapped with cstring.
-            // Inherit require_destruction flag here, because string can be allready
-            // allocated on heap and wrapped with cstring object, so cstring owns the string now
-
-            m_flags = flags & table_entry_flags::require_destruction;
-            m_string = string;
-            return;
-        }
-
-        if (length < sizeof(const char *)) {
-            // String with length less than size of pointer store directly
-            // in pointer, that hint allows reduce stack fragmentation.
-            // We can make such optimization because std::unordered_set never
-            // moves objects in memory on new element insert
-            std::memcpy(m_inplace_string, string, length);
-            m_inplace_string[length] = '\0';
-            m_flags = table_entry_flags::inplace;
+    // statistics for cstring::cache_size; readable without the lock
+    std::atomic<std::size_t>    entries, bytes;
+
+    table_shard() : slots(new slots_t(INITIAL_SIZE)), entries(0),
+                    bytes(INITIAL_SIZE * sizeof(std::atomic<const table_entry *>)) {}
+
+    /// Look up @string without locking; nullptr if it's not (yet) in the table.
+    const char *lookup(const char *string, std::size_t length, std::size_t hash) const {
+        std::size_t i;
+        auto *e = find(slots.load(std::memory_order_acquire), string, length, hash, i);
+        return e ? e->string : nullptr; }
+
+    /// Intern @string.  If @copy is false, @string will be used as is.  @owned is set to
+    /// false if the string was already in the table (so the table didn't take @string).
+    const char *insert(const char *string, std::size_t length, std::size_t hash, bool copy,
+                       bool &owned) {
+#ifdef MULTITHREAD
+        std::lock_guard<std::mutex> acquire(lock);
+#endif  // MULTITHREAD
+        // interned strings outlive any compilation
+        gc_global_allocation global;
+        slots_t *t = slots.load(std::memory_order_relaxed);
+        std::size_t i;
+        if (auto *e = find(t, string, length, hash, i)) {
+            owned = false;
+            return e->string; }
+        if ((entries.load(std::memory_order_relaxed) + 1) * 2 > t->mask + 1) {
+            grow();
+            t = slots.load(std::memory_order_relaxed);
+            find(t, string, length, hash, i); }
+        char *mem = allocate(sizeof(table_entry) + (copy ? length + 1 : 0));
+        auto *e = reinterpret_cast<table_entry *>(mem);
+        e->hash = hash;
+        e->length = length;
+        if (copy) {
+            char *str = mem + sizeof(table_entry);
+            std::memcpy(str, string, length);
+            str[length] = '\0';
+            e->string = str;
         } else {
-            // Make copy of string elseware
-            auto copy = new char[length + 1];
-            std::memcpy(copy, string, length);
-            copy[length] = '\0';
-            m_string = copy;
-
-            // destruction required, because we own copy of string
-            m_flags = table_entry_flags::require_destruction;
-        }
-    }
-
-    // table_entry moveable only
-    table_entry(const table_entry &) = delete;
-
-    table_entry(table_entry &&other) : m_length(other.m_length), m_flags(other.m_flags) {
-        // this object for internal usage only, length will never be accessed
-        // if object was moved, so do not zero other.m_length here
-
-        if (is_inplace()) {
-            std::memcpy(m_inplace_string, other.m_inplace_string, sizeof(m_inplace_string));
-        } else {
-            m_string = other.string();
-            other.m_string = nullptr;
-        }
-    }
-
-    ~table_entry() {
-        if ((m_flags & table_entry_flags::require_destruction) ==
-                table_entry_flags::require_destruction) {
-            // null pointer checked in operator delete [], so we don't need
-            // to check it explicitly
-
-            delete [] m_string;
-        }
-    }
-
-    std::size_t length() const {
-        return m_length;
-    }
-
-    const char *string() const {
-        if (is_inplace()) {
-            return m_inplace_string;
-        }
-
-        return m_string;
-    }
-
-    bool operator ==(const table_entry &other) const {
-        return length() == other.length() && std::memcmp(string(), other.string(), length()) == 0;
-    }
-
- private:
-    bool is_inplace() const {
-        return (m_flags & table_entry_flags::inplace) == table_entry_flags::inplace;
-    }
+            e->string = string; }
+        t->slot[i].store(e, std::memory_order_release);
+        entries.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(sizeof(table_entry) + length + 1, std::memory_order_relaxed);
+        owned = true;
+        return e->string; }
 };
-}  // namespace
 
-namespace std {
-template<>
-struct hash<table_entry> {
-    std::size_t operator()(const table_entry &entry) const {
-        return Util::Hash::murmur(entry.string(), entry.length());
-    }
-};
-}
+enum { SHARD_BITS = 6, SHARDS = 1 << SHARD_BITS };
 
-namespace {
-std::unordered_set<table_entry>& cache() {
-    static std::unordered_set<table_entry> g_cache;
+table_shard *cache() {
+    static table_shard *g_cache = new table_shard[SHARDS];
 
     return g_cache;
 }
 
-const char *save_to_cache(const char *string, std::size_t length, table_entry_flags flags) {
-    if ((flags & table_entry_flags::no_need_copy) == table_entry_flags::no_need_copy) {
-        return cache().emplace(string, length, flags).first->string();
-    }
-
-    // temporary table_entry, used for searching only. no need to copy string
-    auto found = cache().find(table_entry(string, length, table_entry_flags::no_need_copy));
-
-    if (found == cache().end()) {
-        return cache().emplace(string, length, flags).first->string();
-    }
-
-    return found->string();
+inline table_shard &shard(std::size_t hash) {
+    // the table index uses the low bits of the hash, so pick the shard with the high bits
+    return cache()[(hash >> (sizeof(std::size_t) * 8 - SHARD_BITS)) & (SHARDS - 1)];
 }
 
 }  // namespace
 
 void cstring::construct_from_shared(const char *string, std::size_t length) {
-    str = save_to_cache(string, length, table_entry_flags::none);
+    std::size_t hash = Util::Hash::murmur(string, length);
+    auto &s = shard(hash);
+    bool owned;
+    if (!(str = s.lookup(string, length, hash)))
+        str = s.insert(string, length, hash, true, owned);
 }
 
 void cstring::construct_from_unique(const char *string, std::size_t length) {
-    str = save_to_cache(string, length,
-        table_entry_flags::no_need_copy | table_entry_flags::require_destruction);
+    std::size_t hash = Util::Hash::murmur(string, length);
+    bool owned;
+    // a string allocated in an arena has to be copied out of it
+    bool copy = gc_in_arena(string);
+    str = shard(hash).insert(string, length, hash, copy, owned);
+    // cstring owns the string, so it is freed if an equal one is already interned
+    if (!owned || copy) delete [] string;
 }
 
 void cstring::construct_from_literal(const char *string, std::size_t length) {
-    str = save_to_cache(string, length, table_entry_flags::no_need_copy);
+    std::size_t hash = Util::Hash::murmur(string, length);
+    auto &s = shard(hash);
+    bool owned;
+    if (!(str = s.lookup(string, length, hash)))
+        str = s.insert(string, length, hash, false, owned);
 }
 
 size_t cstring::cache_size(size_t &count) {
     size_t rv = 0;
-    count = cache().size();
-    for (auto &s : cache())
-        rv += sizeof(s) + s.length();
+    count = 0;
+    for (int i = 0; i < SHARDS; ++i) {
+        count += cache()[i].entries.load(std::memory_order_relaxed);
+        rv += cache()[i].bytes.load(std::memory_order_relaxed); }
     return rv;
 }
 
@@ -51,8 +51,9 @@ limitations under the License.
  *     std::string.
  *   - Interned strings can never be freed, so they'll stick around for the
  *     lifetime of the program.
- *   - The string interning cstring performs is currently not threadsafe, so you
- *     can't safely use cstrings off the main thread.
+ *   - The string interning cstring performs is only threadsafe when built with
+ *     MULTITHREAD; otherwise you can't safely create cstrings off the main
+ *     thread.
  *
  * Given these tradeoffs, the general rule of thumb to follow is that you should
  * try to convert strings to cstrings early and keep them in that form. That
@@ -254,8 +255,8 @@ class cstring {
         return cstring(ss.str()); }
     template<class T> static cstring make_unique(const T &inuse, cstring base, char sep = '.');
 
-    /// @return the total size in bytes of all interned strings. @count is set
-    /// to the total number of interned strings.
+    /// @return the total size in bytes of the intern table, including all interned
+    /// strings. @count is set to the total number of interned strings.
     static size_t cache_size(size_t &count);
 };
 
@@ -0,0 +1,182 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef LIB_FLAT_PTR_MAP_H_
+#define LIB_FLAT_PTR_MAP_H_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** An open-addressing hash map keyed by (non-null) pointers.
+ *
+ * The index is a flat array of (key, slot) pairs probed linearly, so a lookup
+ * normally touches a single cache line.  The values themselves live in
+ * fixed-size chunks that are never moved, so pointers returned by `find` and
+ * `emplace` stay valid until the entry is erased or the map is cleared, even
+ * if the map grows in the meantime.
+ *
+ * `clear` keeps all memory allocated, so a map can be reused cheaply (the
+ * visitors keep a pool of these for their visited tables).  The entries of
+ * erased values are kept on a free list and reused by later insertions.
+ */
+template<class K, class V>
+class flat_ptr_map {
+    static_assert(std::is_pointer<K>::value, "flat_ptr_map key must be a pointer");
+
+ public:
+    typedef K                           key_type;
+    typedef V                           mapped_type;
+    typedef std::pair<K, V>             value_type;
+
+ private:
+    enum : uint32_t { EMPTY = 0, ERASED = ~0U, CHUNK_BITS = 10, CHUNK_SIZE = 1U << CHUNK_BITS };
+    struct slot_t {
+        K               key;
+        uint32_t        entry;      // 1-based index into the chunks, or EMPTY/ERASED
+    };
+    std::vector<slot_t>                         index;
+    std::vector<std::unique_ptr<value_type[]>>  chunks;
+    std::vector<uint32_t>                       freed;  // erased entries, for reuse
+    uint32_t    used = 0;           // entries allocated from the chunks since the last clear
+    uint32_t    inuse = 0;          // live entries
+    uint32_t    erased = 0;         // ERASED markers in the index
+
+    static size_t hash(K key) {
+        uintptr_t v = reinterpret_cast<uintptr_t>(key);
+        v ^= v >> 17;
+        return v * UINT64_C(0x9E3779B97F4A7C15) >> 16; }
+    value_type &entry(uint32_t e) {
+        --e;
+        return chunks[e >> CHUNK_BITS][e & (CHUNK_SIZE - 1)]; }
+    const value_type &entry(uint32_t e) const {
+        --e;
+        return chunks[e >> CHUNK_BITS][e & (CHUNK_SIZE - 1)]; }
+    const slot_t *lookup(K key) const {
+        if (index.empty()) return nullptr;
+        size_t mask = index.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            const slot_t &s = index[i];
+            if (s.entry == EMPTY) return nullptr;
+            if (s.key == key && s.entry != ERASED) return &s; } }
+    void rehash(size_t size) {
+        std::vector<slot_t> old(size, slot_t{nullptr, EMPTY});
+        old.swap(index);
+        erased = 0;
+        size_t mask = index.size() - 1;
+        for (auto &s : old) {
+            if (s.entry == EMPTY || s.entry == ERASED) continue;
+            size_t i = hash(s.key) & mask;
+            while (index[i].entry != EMPTY) i = (i + 1) & mask;
+            index[i] = s; } }
+
+ public:
+    flat_ptr_map() = default;
+    flat_ptr_map(const flat_ptr_map &) = delete;
+    flat_ptr_map &operator=(const flat_ptr_map &) = delete;
+
+    size_t size() const { return inuse; }
+    bool empty() const { return inuse == 0; }
+    size_t count(K key) const { return lookup(key) != nullptr; }
+    V *find(K key) {
+        auto *s = lookup(key);
+        return s ? &entry(s->entry).second : nullptr; }
+    const V *find(K key) const {
+        auto *s = lookup(key);
+        return s ? &entry(s->entry).second : nullptr; }
+
+    /// Insert @key with value @val if it is not already present.
+    /// @return a pointer to the value for @key and whether it was inserted.
+    std::pair<V *, bool> emplace(K key, const V &val) {
+        if ((inuse + erased + 1) * 4 > index.size() * 3)
+            rehash(index.empty() ? 64 : inuse * 2 < index.size() ? index.size()
+                                                                 : index.size() * 2);
+        size_t mask = index.size() - 1;
+        slot_t *reuse = nullptr;
+        size_t i = hash(key) & mask;
+        for (;; i = (i + 1) & mask) {
+            slot_t &s = index[i];
+            if (s.entry == EMPTY) break;
+            if (s.entry == ERASED) {
+                if (!reuse) reuse = &s;
+            } else if (s.key == key) {
+                return std::make_pair(&entry(s.entry).second, false); } }
+        slot_t &s = reuse ? *reuse : index[i];
+        if (reuse) --erased;
+        s.key = key;
+        if (!freed.empty()) {
+            s.entry = freed.back();
+            freed.pop_back();
+        } else {
+            if ((used >> CHUNK_BITS) >= chunks.size())
+                chunks.emplace_back(new value_type[CHUNK_SIZE]);
+            s.entry = ++used; }
+        ++inuse;
+        value_type &e = entry(s.entry);
+        e.first = key;
+        e.second = val;
+        return std::make_pair(&e.second, true); }
+
+    bool erase(K key) {
+        auto *s = const_cast<slot_t *>(lookup(key));
+        if (!s) return false;
+        entry(s->entry) = value_type();
+        freed.push_back(s->entry);
+        s->entry = ERASED;
+        --inuse;
+        ++erased;
+        return true; }
+
+    /// Erase all entries for which @pred(key, value) returns true.
+    template<class Pred> void erase_if(Pred pred) {
+        for (auto &s : index) {
+            if (s.entry == EMPTY || s.entry == ERASED) continue;
+            value_type &e = entry(s.entry);
+            if (pred(e.first, e.second)) {
+                e = value_type();
+                freed.push_back(s.entry);
+                s.entry = ERASED;
+                --inuse;
+                ++erased; } } }
+
+    /// Call @fn(key, value) for every entry, in unspecified order.
+    template<class Fn> void for_each(Fn fn) const {
+        for (auto &s : index)
+            if (s.entry != EMPTY && s.entry != ERASED) {
+                const value_type &e = entry(s.entry);
+                fn(e.first, e.second); } }
+
+    /// Remove all entries but keep the memory for reuse.  Stale keys and values
+    /// are cleared as well, so that the map does not keep garbage alive.
+    void clear() {
+        if (used || erased) {
+            for (uint32_t e = 1; e <= used; ++e)
+                entry(e) = value_type();
+            std::memset(static_cast<void *>(index.data()), 0, index.size() * sizeof(slot_t)); }
+        freed.clear();
+        used = inuse = erased = 0; }
+
+    /// Bytes of memory currently held by the map.
+    size_t memory() const {
+        return index.capacity() * sizeof(slot_t) + chunks.size() * CHUNK_SIZE * sizeof(value_type)
+               + freed.capacity() * sizeof(uint32_t);
+    }
+};
+
+#endif /* LIB_FLAT_PTR_MAP_H_ */
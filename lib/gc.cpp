@@ -16,9 +16,20 @@ limitations under the License.
 
 #include "config.h"
 #if HAVE_LIBGC
+#ifdef MULTITHREAD
+#define GC_THREADS
+#endif  /* MULTITHREAD */
 #include <gc/gc_cpp.h>
 #include <gc/gc_mark.h>
 #endif  /* HAVE_LIBGC */
+#if HAVE_ARENA_ALLOCATOR
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#endif  /* HAVE_ARENA_ALLOCATOR */
 #include <new>
 #include "log.h"
 #include "gc.h"
@@ -31,10 +42,46 @@ limitations under the License.
 #define _GLIBCXX_USE_NOEXCEPT _NOEXCEPT
 #endif
 
+#if HAVE_ARENA_ALLOCATOR
+/* All arenas are carved from a single reservation of address space, so a
+ * pointer is in an arena iff it is in that range.  The OS commits pages as they
+ * are first touched, and gets them back when the arena is released. */
+static const size_t arena_reserve = size_t(1) << 38;
+static char *arena_base;
+static std::atomic<size_t> arena_top(0), arena_peak(0), arena_total(0);
+static std::atomic<int> arena_active(0);
+static bool arena_enabled;
+static thread_local int global_allocation;
+
+static inline bool in_arena(const void *p) {
+    return arena_base && p >= arena_base && p < arena_base + arena_reserve;
+}
+static inline bool use_arena() {
+    return arena_active.load(std::memory_order_relaxed) && !global_allocation;
+}
+static void *arena_allocate(std::size_t size) {
+    size = (size + 15) & ~size_t(15);
+    size_t at = arena_top.fetch_add(size, std::memory_order_relaxed);
+    if (at + size > arena_reserve) throw std::bad_alloc();
+    arena_total.fetch_add(size, std::memory_order_relaxed);
+    size_t peak = arena_peak.load(std::memory_order_relaxed);
+    while (at + size > peak &&
+           !arena_peak.compare_exchange_weak(peak, at + size, std::memory_order_relaxed)) {}
+    return arena_base + at;
+}
+static std::vector<void (*)()> &arena_release_callbacks() {
+    static std::vector<void (*)()> callbacks;
+    return callbacks;
+}
+#endif  /* HAVE_ARENA_ALLOCATOR */
+
 // One can disable the GC, e.g., to run under Valgrind, by editing config.h
 #if HAVE_LIBGC
 static bool done_init;
 void *operator new(std::size_t size) {
+#if HAVE_ARENA_ALLOCATOR
+    if (use_arena()) return arena_allocate(size);
+#endif  /* HAVE_ARENA_ALLOCATOR */
     /* DANGER -- on OSX, can't safely call the garbage collector allocation
      * routines from a static global constructor without manually initializing
      * it first.  Since we have global constructors that want to allocate
@@ -45,13 +92,23 @@ void *operator new(std::size_t size) {
     return ::operator new(size, UseGC, 0, 0);
 }
 void *operator new[](std::size_t size) {
+#if HAVE_ARENA_ALLOCATOR
+    if (use_arena()) return arena_allocate(size);
+#endif  /* HAVE_ARENA_ALLOCATOR */
     if (!done_init) {
         GC_INIT();
         done_init = true; }
     return ::operator new(size, UseGC, 0, 0);
 }
+#if HAVE_ARENA_ALLOCATOR
+void operator delete(void *p) _GLIBCXX_USE_NOEXCEPT {
+    if (!in_arena(p)) gc::operator delete(p); }
+void operator delete[](void *p) _GLIBCXX_USE_NOEXCEPT {
+    if (!in_arena(p)) gc::operator delete(p); }
+#else
 void operator delete(void *p) _GLIBCXX_USE_NOEXCEPT { return gc::operator delete(p); }
 void operator delete[](void *p) _GLIBCXX_USE_NOEXCEPT { return gc::operator delete(p); }
+#endif  /* HAVE_ARENA_ALLOCATOR */
 
 #if HAVE_GC_PRINT_STATS
 /* GC_print_stats is not exported as an API symbol and cannot be used on some systems */
@@ -78,6 +135,16 @@ void reset_gc_logging() {
 #endif /* HAVE_GC_PRINT_STATS */
 }
 
+#elif HAVE_ARENA_ALLOCATOR
+static void *heap_allocate(std::size_t size) {
+    if (use_arena()) return arena_allocate(size);
+    if (void *rv = malloc(size ? size : 1)) return rv;
+    throw std::bad_alloc();
+}
+void *operator new(std::size_t size) { return heap_allocate(size); }
+void *operator new[](std::size_t size) { return heap_allocate(size); }
+void operator delete(void *p) _GLIBCXX_USE_NOEXCEPT { if (!in_arena(p)) free(p); }
+void operator delete[](void *p) _GLIBCXX_USE_NOEXCEPT { if (!in_arena(p)) free(p); }
 #endif  /* HAVE_LIBGC */
 
 void setup_gc_logging() {
@@ -90,14 +157,137 @@ void setup_gc_logging() {
 }
 
 size_t gc_mem_inuse(size_t *max) {
+    size_t inuse = 0, maxsize = 0;
 #if HAVE_LIBGC
     GC_word heapsize, heapfree;
     GC_gcollect();
     GC_get_heap_usage_safe(&heapsize, &heapfree, 0, 0, 0);
-    if (max) *max = heapsize;
-    return heapsize - heapfree;
+    inuse = heapsize - heapfree;
+    maxsize = heapsize;
+#endif
+#if HAVE_ARENA_ALLOCATOR
+    size_t peak;
+    inuse += gc_arena_inuse(&peak);
+    maxsize += peak;
+#endif
+    if (max) *max = maxsize;
+    return inuse;
+}
+
+size_t gc_total_allocated() {
+    size_t rv = 0;
+#if HAVE_LIBGC
+    rv += GC_get_total_bytes();
+#endif
+#if HAVE_ARENA_ALLOCATOR
+    rv += arena_total;
+#endif
+    return rv;
+}
+
+void gc_enable_threads() {
+#if HAVE_LIBGC && defined(MULTITHREAD)
+    GC_allow_register_threads();
+#endif
+}
+
+void gc_register_thread() {
+#if HAVE_LIBGC && defined(MULTITHREAD)
+    struct GC_stack_base sb;
+    GC_get_stack_base(&sb);
+    GC_register_my_thread(&sb);
+#endif
+}
+
+bool gc_enable_arenas(bool enable) {
+#if HAVE_ARENA_ALLOCATOR
+    if (enable && !arena_base) {
+        void *base = mmap(nullptr, arena_reserve, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) return false;
+        arena_base = static_cast<char *>(base); }
+    arena_enabled = enable;
+    return true;
+#else
+    return !enable;
+#endif  /* HAVE_ARENA_ALLOCATOR */
+}
+
+bool gc_arenas_enabled() {
+#if HAVE_ARENA_ALLOCATOR
+    return arena_enabled;
+#else
+    return false;
+#endif  /* HAVE_ARENA_ALLOCATOR */
+}
+
+size_t gc_arena_begin() {
+#if HAVE_ARENA_ALLOCATOR
+    if (!arena_enabled) return 0;
+#if HAVE_LIBGC
+    // the collector can't see pointers stored in the arena
+    if (arena_active == 0) GC_disable();
+#endif  /* HAVE_LIBGC */
+    ++arena_active;
+    return arena_top;
 #else
-    if (max) *max = 0;
     return 0;
-#endif
+#endif  /* HAVE_ARENA_ALLOCATOR */
+}
+
+void gc_arena_end(size_t mark) {
+#if HAVE_ARENA_ALLOCATOR
+    if (!arena_enabled || arena_active == 0) return;
+    for (auto fn : arena_release_callbacks()) fn();
+    size_t top = arena_top.exchange(mark);
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t from = (mark + page - 1) & ~(page - 1);
+    if (top > from)
+        madvise(arena_base + from, top - from, MADV_DONTNEED);
+    if (--arena_active == 0) {
+#if HAVE_LIBGC
+        GC_enable();
+#endif  /* HAVE_LIBGC */
+    }
+#else
+    (void)mark;
+#endif  /* HAVE_ARENA_ALLOCATOR */
+}
+
+size_t gc_arena_inuse(size_t *peak, size_t *total) {
+#if HAVE_ARENA_ALLOCATOR
+    if (peak) *peak = arena_peak;
+    if (total) *total = arena_total;
+    return arena_active ? size_t(arena_top) : 0;
+#else
+    if (peak) *peak = 0;
+    if (total) *total = 0;
+    return 0;
+#endif  /* HAVE_ARENA_ALLOCATOR */
+}
+
+bool gc_in_arena(const void *p) {
+#if HAVE_ARENA_ALLOCATOR
+    return in_arena(p);
+#else
+    (void)p;
+    return false;
+#endif  /* HAVE_ARENA_ALLOCATOR */
+}
+
+#if HAVE_ARENA_ALLOCATOR
+gc_global_allocation::gc_global_allocation() { ++global_allocation; }
+gc_global_allocation::~gc_global_allocation() { --global_allocation; }
+#else
+gc_global_allocation::gc_global_allocation() {}
+gc_global_allocation::~gc_global_allocation() {}
+#endif  /* HAVE_ARENA_ALLOCATOR */
+
+void gc_on_arena_release(void (*fn)()) {
+#if HAVE_ARENA_ALLOCATOR
+    gc_global_allocation global;
+    arena_release_callbacks().push_back(fn);
+#else
+    (void)fn;
+#endif  /* HAVE_ARENA_ALLOCATOR */
 }
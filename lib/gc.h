@@ -21,5 +21,37 @@ limitations under the License.
 
 void setup_gc_logging();
 size_t gc_mem_inuse(size_t *max = 0);  // trigger GC, return inuse after
+size_t gc_total_allocated();  // bytes allocated since startup (0 if not using libgc)
+void gc_enable_threads();   // call from the main thread before starting other threads
+void gc_register_thread();  // call at the start of any thread that allocates
+
+/* Arena allocation (builds with ENABLE_ARENA_ALLOCATOR).  Once enabled with
+ * gc_enable_arenas, everything allocated with operator new while an
+ * AutoCompileContext exists comes from a bump arena instead of the (garbage
+ * collected) heap, and is all released at once when that context ends; delete
+ * of arena memory does nothing.  Anything that must outlive the compilation
+ * (global caches, lazily created singletons) has to be allocated in the scope
+ * of a gc_global_allocation object.  Arenas are meant for a long running process
+ * doing one compilation at a time; garbage collection is disabled while an
+ * arena is active. */
+bool gc_enable_arenas(bool enable = true);  // false if not supported by this build
+bool gc_arenas_enabled();
+size_t gc_arena_begin();            // start allocating from the arena; returns a mark
+void gc_arena_end(size_t mark);     // release everything allocated since @mark
+size_t gc_arena_inuse(size_t *peak = 0, size_t *total = 0);  // current, peak and total bytes
+bool gc_in_arena(const void *p);    // is @p arena memory
+
+/// While an object of this type exists, operator new on this thread allocates from
+/// the heap even if an arena is active.
+struct gc_global_allocation {
+    gc_global_allocation();
+    ~gc_global_allocation();
+    gc_global_allocation(const gc_global_allocation &) = delete;
+    gc_global_allocation &operator=(const gc_global_allocation &) = delete;
+};
+
+/// Register @fn to be called whenever an arena is released, to drop any
+/// references to arena memory kept by caches that are reused between compilations.
+void gc_on_arena_release(void (*fn)());
 
 #endif /* LIB_GC_H_ */
@@ -14,8 +14,12 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
+#include <string>
 #include "json.h"
 #include "indent.h"
 #include "lib/gmputil.h"
@@ -54,16 +58,41 @@ mpz_class JsonValue::makeValue(unsigned long long v) {
 // According to the GMP documentation
 // (https://gmplib.org/manual/C_002b_002b-Interface-Integers.html), mpz_class
 // cannot be constructed from a "long long". This means that on systems where
-// "long" != "long long", we cannot construct the "value" member directly from
-// parameter v. Instead, we use this suggested workaround:
+// "long" != "long long", we cannot construct an mpz_class directly from a
+// long long value. Instead, we use this suggested workaround:
 // https://stackoverflow.com/questions/6598265/convert-uint64-to-gmp-mpir-number
-// Because the "value" member is const, we use a helper (makeValue) to
-// initialize it.
-JsonValue::JsonValue(long long v)
-    : tag(Kind::Number), value(makeValue(v)) { }
+JsonValue::JsonValue(const mpz_class& v) : tag(Kind::Number) {
+    setValue(v);
+}
+
+JsonValue::JsonValue(unsigned long v) : tag(Kind::Number) {
+    if (v <= static_cast<unsigned long long>(LLONG_MAX))
+        small = v;
+    else
+        setValue(makeValue(static_cast<unsigned long long>(v)));
+}
 
-JsonValue::JsonValue(unsigned long long v)
-    : tag(Kind::Number), value(makeValue(v)) { }
+JsonValue::JsonValue(unsigned long long v) : tag(Kind::Number) {
+    if (v <= static_cast<unsigned long long>(LLONG_MAX))
+        small = v;
+    else
+        setValue(makeValue(v));
+}
+
+void JsonValue::setValue(const mpz_class& v) {
+    // Anything of at most 63 bits fits in small; mpz_export gives the
+    // magnitude whatever the size of long is.
+    if (mpz_sizeinbase(v.get_mpz_t(), 2) > 63) {
+        isBig = true;
+        big = new mpz_class(v);
+        return;
+    }
+    unsigned long long magnitude = 0;
+    mpz_export(&magnitude, nullptr, 1, sizeof(magnitude), 0, 0, v.get_mpz_t());
+    small = static_cast<long long>(magnitude);
+    if (sgn(v) < 0)
+        small = -small;
+}
 
 void JsonValue::serialize(std::ostream& out) const {
     switch (tag) {
@@ -71,7 +100,10 @@ void JsonValue::serialize(std::ostream& out) const {
             out << "\"" << str << "\"";
             break;
         case Kind::Number:
-            out << value;
+            if (isBig)
+                out << *big;
+            else
+                out << small;
             break;
         case Kind::True:
             out << "true";
@@ -86,11 +118,11 @@ void JsonValue::serialize(std::ostream& out) const {
 }
 
 bool JsonValue::operator==(const mpz_class& v) const
-{ return tag == Kind::Number ? v == value : false; }
+{ return tag == Kind::Number ? v == getValue() : false; }
 bool JsonValue::operator==(const double& v) const
-{ return tag == Kind::Number ? v == value : false; }
+{ return tag == Kind::Number ? v == getValue() : false; }
 bool JsonValue::operator==(const float& v) const
-{ return tag == Kind::Number ? v == value : false; }
+{ return tag == Kind::Number ? v == getValue() : false; }
 bool JsonValue::operator==(const cstring& s) const
 { return tag == Kind::String ? s == str : false; }
 bool JsonValue::operator==(const std::string& s) const
@@ -103,7 +135,9 @@ bool JsonValue::operator==(const JsonValue& other) const {
         case Kind::String:
             return str == other.str;
         case Kind::Number:
-            return value == other.value;
+            if (isBig || other.isBig)
+                return getValue() == other.getValue();
+            return small == other.small;
         case Kind::True:
         case Kind::False:
         case Kind::Null:
@@ -157,14 +191,15 @@ cstring JsonValue::getString() const {
 mpz_class JsonValue::getValue() const {
     if (!isNumber())
         throw std::logic_error("Incorrect json value kind");
-    return value;
+    return isBig ? *big : makeValue(small);
 }
 
 int JsonValue::getInt() const {
-    auto val = getValue();
-    if (!value.fits_sint_p())
+    if (!isNumber())
+        throw std::logic_error("Incorrect json value kind");
+    if (isBig || small < INT_MIN || small > INT_MAX)
         throw std::logic_error("Value too large for an int");
-    return val.get_si();
+    return small;
 }
 
 JsonArray* JsonArray::append(IJson* value) {
@@ -206,4 +241,187 @@ JsonObject* JsonObject::emplace_non_null(cstring label, IJson* value) {
     return this;
 }
 
+JsonWriter::JsonWriter(std::ostream& out)
+        : out(out), indent(indent_t::getindent(out).width()) {}
+
+void JsonWriter::newline() {
+    static const char spaces[] = "                                ";
+    out.put('\n');
+    for (int n = indent; n > 0; n -= sizeof(spaces) - 1)
+        out.write(spaces, std::min(n, static_cast<int>(sizeof(spaces) - 1)));
+}
+
+// Called before each value; writes what separates it from the previous one.
+void JsonWriter::element(bool scalar) {
+    if (scopes.empty() || !scopes.back().array)
+        return;
+    auto& scope = scopes.back();
+    if (!scope.multiline && !scalar) {
+        // The array holds a nested value, so it is written one element per line.
+        scope.multiline = true;
+        indent += indent_t::tabsz;
+        size_t start = 0;
+        for (size_t i = 0; i < pendingEnds.size(); ++i) {
+            if (i > 0)
+                out.put(',');
+            newline();
+            out.write(pending.data() + start, pendingEnds[i] - start);
+            start = pendingEnds[i];
+        }
+        pending.clear();
+        pendingEnds.clear();
+    }
+    if (scope.multiline) {
+        if (!scope.empty)
+            out.put(',');
+        newline();
+    }
+    scope.empty = false;
+}
+
+void JsonWriter::scalar(const char* text, size_t size, bool quoted) {
+    element(true);
+    if (!scopes.empty() && scopes.back().array && !scopes.back().multiline) {
+        if (quoted) pending.push_back('"');
+        pending.append(text, size);
+        if (quoted) pending.push_back('"');
+        pendingEnds.push_back(pending.size());
+    } else {
+        if (quoted) out.put('"');
+        out.write(text, size);
+        if (quoted) out.put('"');
+    }
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    element(false);
+    out.put('{');
+    indent += indent_t::tabsz;
+    scopes.push_back({ false, true, true });
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    if (scopes.empty() || scopes.back().array)
+        throw std::logic_error("Json writer is not in an object");
+    indent -= indent_t::tabsz;
+    newline();
+    out.put('}');
+    scopes.pop_back();
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    element(false);
+    out.put('[');
+    scopes.push_back({ true, false, true });
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    if (scopes.empty() || !scopes.back().array)
+        throw std::logic_error("Json writer is not in an array");
+    if (scopes.back().multiline) {
+        indent -= indent_t::tabsz;
+        newline();
+    } else {
+        size_t start = 0;
+        for (size_t i = 0; i < pendingEnds.size(); ++i) {
+            if (i > 0)
+                out.write(", ", 2);
+            out.write(pending.data() + start, pendingEnds[i] - start);
+            start = pendingEnds[i];
+        }
+        pending.clear();
+        pendingEnds.clear();
+    }
+    out.put(']');
+    scopes.pop_back();
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(cstring label) {
+    if (scopes.empty() || scopes.back().array)
+        throw std::logic_error("Json writer is not in an object");
+    if (label.isNullOrEmpty())
+        throw std::logic_error("Empty label");
+    if (!scopes.back().empty)
+        out.put(',');
+    scopes.back().empty = false;
+    newline();
+    out.put('"');
+    out.write(label.c_str(), label.size());
+    out.write("\" : ", 4);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const IJson* json) {
+    if (json == nullptr) {
+        // serialize does not count a missing element as a scalar of its array
+        element(false);
+        out.write("null", 4);
+        return *this;
+    }
+    if (auto v = json->to<JsonValue>()) {
+        if (v->isString())
+            return value(v->getString());
+        if (v->isNumber())
+            return v->isBig ? value(*v->big) : value(v->small);
+        if (v->isBool())
+            return value(v->getBool());
+        return null();
+    }
+    if (auto array = json->to<JsonArray>()) {
+        beginArray();
+        for (auto v : *array)
+            value(v);
+        return endArray();
+    }
+    if (auto object = json->to<JsonObject>()) {
+        beginObject();
+        for (auto &it : *object) {
+            key(it.first);
+            value(it.second);
+        }
+        return endObject();
+    }
+    throw std::logic_error("Unexpected json value");
+}
+
+JsonWriter& JsonWriter::value(const mpz_class& v) {
+    if (v.fits_slong_p())
+        return value(v.get_si());
+    scalar(v.get_str());
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(long long v) {
+    scalar(std::to_string(v));
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(unsigned long long v) {
+    scalar(std::to_string(v));
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool b) {
+    if (b)
+        scalar("true", 4);
+    else
+        scalar("false", 5);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(cstring s) {
+    const char* text = s ? s.c_str() : "<null>";
+    scalar(text, strlen(text), true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    scalar("null", 4);
+    return *this;
+}
+
 }  // namespace Util
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <iostream>
 #include <stdexcept>
+#include <string>
 #include <vector>
 #include <type_traits>
 
@@ -44,6 +45,7 @@ class IJson {
 
 class JsonValue final : public IJson {
     FRIEND_TEST(Util, Json);
+    FRIEND_TEST(Util, JsonNumbers);
 
  public:
     enum Kind {
@@ -55,15 +57,15 @@ class JsonValue final : public IJson {
     };
     JsonValue() : tag(Kind::Null) {}
     JsonValue(bool b) : tag(b ? Kind::True : Kind::False) {}          // NOLINT
-    JsonValue(mpz_class v) : tag(Kind::Number), value(v) {}           // NOLINT
-    JsonValue(int v) : tag(Kind::Number), value(v) {}                 // NOLINT
-    JsonValue(long v) : tag(Kind::Number), value(v) {}                // NOLINT
-    JsonValue(long long v);                                           // NOLINT
-    JsonValue(unsigned v) : tag(Kind::Number), value(v) {}            // NOLINT
-    JsonValue(unsigned long v) : tag(Kind::Number), value(v) {}       // NOLINT
+    JsonValue(const mpz_class& v);                                    // NOLINT
+    JsonValue(int v) : tag(Kind::Number), small(v) {}                 // NOLINT
+    JsonValue(long v) : tag(Kind::Number), small(v) {}                // NOLINT
+    JsonValue(long long v) : tag(Kind::Number), small(v) {}           // NOLINT
+    JsonValue(unsigned v) : tag(Kind::Number), small(v) {}            // NOLINT
+    JsonValue(unsigned long v);                                       // NOLINT
     JsonValue(unsigned long long v);                                  // NOLINT
-    JsonValue(double v) : tag(Kind::Number), value(v) {}              // NOLINT
-    JsonValue(float v) : tag(Kind::Number), value(v) {}               // NOLINT
+    JsonValue(double v) : JsonValue(mpz_class(v)) {}                  // NOLINT
+    JsonValue(float v) : JsonValue(mpz_class(v)) {}                   // NOLINT
     JsonValue(cstring s) : tag(Kind::String), str(s) {}               // NOLINT
     JsonValue(const std::string &s) : tag(Kind::String), str(s) {}    // NOLINT
     JsonValue(const char* s) : tag(Kind::String), str(s) {}           // NOLINT
@@ -72,8 +74,11 @@ class JsonValue final : public IJson {
     bool operator==(const mpz_class& v) const;
     // is_integral is true for bool
     template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
-    bool operator==(const T& v) const
-    { return (tag == Kind::Number) && (v == value); }
+    bool operator==(const T& v) const {
+        typedef typename std::conditional<std::is_signed<T>::value,
+                                          long long, unsigned long long>::type wide;
+        return (tag == Kind::Number) && *this == JsonValue(static_cast<wide>(v));
+    }
     bool operator==(const double& v) const;
     bool operator==(const float& v) const;
     bool operator==(const cstring& s) const;
@@ -101,10 +106,18 @@ class JsonValue final : public IJson {
 
     static mpz_class makeValue(long long v);
     static mpz_class makeValue(unsigned long long v);
+    void setValue(const mpz_class& v);
 
+    friend class JsonWriter;
     const Kind tag;
-    const mpz_class value = 0;
-    const cstring str = nullptr;
+    // Numbers are kept in small unless they need more than 64 bits; only then
+    // is a big integer allocated for them.
+    bool isBig = false;
+    union {
+        long long small = 0;
+        const mpz_class* big;
+    };
+    const cstring str = nullptr;  // interned, like every cstring
 };
 
 class JsonArray final : public IJson, public std::vector<IJson*> {
@@ -154,6 +167,64 @@ class JsonObject final : public IJson, public ordered_map<cstring, IJson*> {
     IJson* get(cstring label) const { return ::get(*this, label); }
 };
 
+/** Writes JSON to a stream as it is produced, in exactly the format of
+ * IJson::serialize, without building a tree of IJson values first.
+ *
+ * Values are written with beginObject/key/endObject, beginArray/endArray
+ * and the scalar overloads of `value`; existing trees can be written with
+ * `value(const IJson*)`.  serialize prints an array on one line when all
+ * its elements are scalars.  The writer cannot know this before the array
+ * ends, so it holds back the scalars of the innermost open array until
+ * either the array ends or a nested object or array starts in it.
+ * Lines end with '\n' and the stream is never flushed.
+ */
+class JsonWriter {
+    struct Scope {
+        bool array;
+        bool multiline;  // elements are written one per line
+        bool empty;
+    };
+    std::ostream&      out;
+    int                indent;  // in spaces
+    std::vector<Scope> scopes;
+    // Scalars of the innermost array, while it may still be printed on one line
+    std::string        pending;
+    std::vector<size_t> pendingEnds;
+
+    void newline();
+    void element(bool scalar);
+    void scalar(const char* text, size_t size, bool quoted = false);
+    void scalar(const std::string& text) { scalar(text.data(), text.size()); }
+
+ public:
+    explicit JsonWriter(std::ostream& out);
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    /// Starts a member of the current object; its value is written next.
+    JsonWriter& key(cstring label);
+
+    JsonWriter& value(const IJson* json);
+    JsonWriter& value(const mpz_class& v);
+    JsonWriter& value(long long v);
+    JsonWriter& value(unsigned long long v);
+    JsonWriter& value(int v) { return value(static_cast<long long>(v)); }
+    JsonWriter& value(long v) { return value(static_cast<long long>(v)); }
+    JsonWriter& value(unsigned v) { return value(static_cast<unsigned long long>(v)); }
+    JsonWriter& value(unsigned long v) { return value(static_cast<unsigned long long>(v)); }
+    JsonWriter& value(bool b);
+    JsonWriter& value(cstring s);
+    JsonWriter& value(const char* s) { return value(cstring(s)); }
+    JsonWriter& null();
+
+    /// True when every value that was started has been completed.
+    bool done() const { return scopes.empty(); }
+};
+
 }  // namespace Util
 
 #endif  /* _LIB_JSON_H_ */
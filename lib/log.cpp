@@ -22,6 +22,7 @@ limitations under the License.
 #define NOGC_ARGS
 #endif /* HAVE_LIBGC */
 
+#include "gc.h"
 #include "log.h"
 #include <string.h>
 #include <iostream>
@@ -214,6 +215,8 @@ LevelAndOutput *cachedFileLogInfo(const char* file) {
     static std::mutex lock;
     std::lock_guard<std::mutex> acquire(lock);
 #endif  // MULTITHREAD
+    // the caches are kept across compilations
+    gc_global_allocation global;
 
     // There are two layers of caching here. First, we cache the most recent
     // result we returned, to minimize expensive lookups in tight loops.
@@ -247,6 +250,7 @@ std::ostream &uncachedFileLogOutput(const char* file) {
             const char *end = strchr(spec, ',');
             if (!end) end = spec + strlen(spec);
             std::string logname(spec, end-spec);
+            gc_global_allocation global;
             if (!logfiles.count(logname)) {
                 // FIXME: can't emplace a unique_ptr in some versions of gcc -- need
                 // explicit reset call.
@@ -276,6 +280,7 @@ void invalidateCaches(int possibleNewMaxLogLevel) {
 }
 
 void addInvalidateCallback(void (*fn)(void)) {
+    gc_global_allocation global;
     invalidateCallbacks.push_back(fn);
 }
 
@@ -310,6 +315,7 @@ void addDebugSpec(const char* spec) {
     std::lock_guard<std::mutex> acquire(lock);
 #endif  // MULTITHREAD
 
+    gc_global_allocation global;
     Detail::debugSpecs.push_back(spec);
     Detail::invalidateCaches(maxLogLevelInSpec);
 }
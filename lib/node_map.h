@@ -0,0 +1,152 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef LIB_NODE_MAP_H_
+#define LIB_NODE_MAP_H_
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** An open-addressing hash map keyed by (non-null) pointers to IR nodes, for
+ * the per-node facts the compiler looks up most, such as the reference map
+ * and the type map.
+ *
+ * Keys and values are stored inline in one flat array probed linearly, so a
+ * lookup is normally a single cache miss instead of a tree walk.  Entries are
+ * placed by a hash of the node's `id`, so the layout (and the iteration order)
+ * is the same from one run to the next; keys are still compared by pointer,
+ * as ids are not unique (a program loaded from JSON keeps the ids it was
+ * saved with).  Erasing shifts the following entries back, so there are no
+ * tombstones to slow down maps which see many erasures.
+ *
+ * Pointers returned by `find` and `emplace` are only valid until the next
+ * insertion or erasure.
+ */
+template<class K, class V>
+class node_map {
+    static_assert(std::is_pointer<K>::value, "node_map key must be a pointer");
+
+    struct slot_t {
+        K       key;        // nullptr if empty
+        V       value;
+    };
+    std::vector<slot_t>     slots;
+    size_t                  inuse = 0;
+    unsigned                shift = 64;
+
+    size_t home(K key) const {
+        return static_cast<uint64_t>(static_cast<uint32_t>(key->id)) *
+               UINT64_C(0x9E3779B97F4A7C15) >> shift; }
+    const slot_t *lookup(K key) const {
+        if (inuse == 0) return nullptr;
+        size_t mask = slots.size() - 1;
+        for (size_t i = home(key);; i = (i + 1) & mask) {
+            const slot_t &s = slots[i];
+            if (s.key == key) return &s;
+            if (s.key == nullptr) return nullptr; } }
+    void rehash(size_t size) {
+        std::vector<slot_t> old(size, slot_t{nullptr, V()});
+        old.swap(slots);
+        shift = 64;
+        for (size_t s = size; s > 1; s >>= 1) --shift;
+        size_t mask = size - 1;
+        for (auto &s : old) {
+            if (s.key == nullptr) continue;
+            size_t i = home(s.key);
+            while (slots[i].key != nullptr) i = (i + 1) & mask;
+            slots[i] = s; } }
+
+ public:
+    typedef K   key_type;
+    typedef V   mapped_type;
+
+    size_t size() const { return inuse; }
+    bool empty() const { return inuse == 0; }
+    size_t count(K key) const { return lookup(key) != nullptr; }
+    V *find(K key) {
+        auto *s = lookup(key);
+        return s ? const_cast<V *>(&s->value) : nullptr; }
+    const V *find(K key) const {
+        auto *s = lookup(key);
+        return s ? &s->value : nullptr; }
+
+    /// Insert @key with value @val if it is not already present.
+    /// @return a pointer to the value for @key and whether it was inserted.
+    std::pair<V *, bool> emplace(K key, const V &val) {
+        if ((inuse + 1) * 4 > slots.size() * 3)
+            rehash(slots.empty() ? 64 : slots.size() * 2);
+        size_t mask = slots.size() - 1;
+        size_t i = home(key);
+        for (; slots[i].key != nullptr; i = (i + 1) & mask)
+            if (slots[i].key == key)
+                return std::make_pair(&slots[i].value, false);
+        slots[i].key = key;
+        slots[i].value = val;
+        ++inuse;
+        return std::make_pair(&slots[i].value, true); }
+
+    bool erase(K key) {
+        auto *found = lookup(key);
+        if (!found) return false;
+        size_t mask = slots.size() - 1;
+        size_t hole = found - slots.data();
+        // Move back every following entry which may not be probed for past the hole.
+        for (size_t i = (hole + 1) & mask; slots[i].key != nullptr; i = (i + 1) & mask) {
+            size_t h = home(slots[i].key);
+            if (((i - h) & mask) >= ((i - hole) & mask)) {
+                slots[hole] = slots[i];
+                hole = i; } }
+        slots[hole] = slot_t{nullptr, V()};
+        --inuse;
+        return true; }
+
+    /// Call @fn(key, value) for every entry, in unspecified (but repeatable) order.
+    template<class Fn> void for_each(Fn fn) const {
+        for (auto &s : slots)
+            if (s.key != nullptr)
+                fn(s.key, s.value); }
+
+    /// Remove all entries but keep the memory for reuse.
+    void clear() {
+        if (inuse)
+            for (auto &s : slots) s = slot_t{nullptr, V()};
+        inuse = 0; }
+
+    /// Bytes of memory currently held by the map.
+    size_t memory() const { return slots.capacity() * sizeof(slot_t); }
+};
+
+/// A set of IR nodes with the same layout as node_map.
+template<class K>
+class node_set {
+    node_map<K, bool>   map;
+
+ public:
+    size_t size() const { return map.size(); }
+    bool empty() const { return map.empty(); }
+    size_t count(K key) const { return map.count(key); }
+    /// @return true if @key was not in the set yet.
+    bool insert(K key) { return map.emplace(key, true).second; }
+    bool erase(K key) { return map.erase(key); }
+    template<class Fn> void for_each(Fn fn) const {
+        map.for_each([&fn](K key, bool) { fn(key); }); }
+    void clear() { map.clear(); }
+    size_t memory() const { return map.memory(); }
+};
+
+#endif /* LIB_NODE_MAP_H_ */
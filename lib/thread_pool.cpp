@@ -0,0 +1,142 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "thread_pool.h"
+#include <exception>
+#include <vector>
+#ifdef MULTITHREAD
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "gc.h"
+#endif  // MULTITHREAD
+
+namespace Util {
+
+static unsigned parallel_threads = 0;
+
+#ifdef MULTITHREAD
+namespace {
+
+static thread_local bool in_worker = false;
+
+/* Workers are started the first time they are needed, and then sleep between
+ * jobs.  A job is a single parallel_for call; every thread (including the
+ * caller) claims indexes from a shared counter until none are left.  There is
+ * one pool per process: it grows when more threads are requested, and when
+ * fewer are requested the extra workers sit the jobs out. */
+class ThreadPool {
+    std::vector<std::thread>            workers;
+    std::mutex                          lock;
+    std::condition_variable             start, finish;
+    const std::function<void(size_t)>   *job = nullptr;
+    size_t                              count = 0;
+    std::atomic<size_t>                 next;
+    std::vector<std::exception_ptr>     errors;
+    unsigned                            generation = 0;
+    unsigned                            active = 0;     // workers taking part in the job
+    unsigned                            running = 0;
+
+    void run_tasks() {
+        size_t i;
+        while ((i = next++) < count) {
+            try {
+                (*job)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(lock);
+                errors[i] = std::current_exception(); } } }
+
+    void worker(unsigned index, unsigned seen) {
+        in_worker = true;
+        gc_register_thread();
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            start.wait(guard, [&]() { return generation != seen; });
+            seen = generation;
+            if (index >= active) continue;
+            guard.unlock();
+            run_tasks();
+            guard.lock();
+            if (--running == 0) finish.notify_one(); } }
+
+ public:
+    ThreadPool() : next(0) { gc_enable_threads(); }
+
+    /// Run @fn(0) ... @fn(@n-1) on @threads threads, including the caller.
+    void run(size_t n, const std::function<void(size_t)> &fn, unsigned threads) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (workers.size() + 1 < threads) {
+            gc_global_allocation global;
+            // new workers must wait for the next job, not take the current generation for one
+            while (workers.size() + 1 < threads) {
+                workers.emplace_back(&ThreadPool::worker, this, workers.size(), generation);
+                workers.back().detach(); } }
+        job = &fn;
+        count = n;
+        next = 0;
+        errors.assign(n, nullptr);
+        running = active = threads - 1;
+        ++generation;
+        start.notify_all();
+        guard.unlock();
+        in_worker = true;
+        run_tasks();
+        in_worker = false;
+        guard.lock();
+        finish.wait(guard, [&]() { return running == 0; });
+        job = nullptr;
+        for (auto &e : errors)
+            if (e) std::rethrow_exception(e); }
+};
+
+}  // namespace
+#endif  // MULTITHREAD
+
+void setParallelThreads(unsigned threads) { parallel_threads = threads; }
+
+unsigned getParallelThreads() {
+#ifdef MULTITHREAD
+    if (parallel_threads == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw ? hw : 1; }
+    return parallel_threads;
+#else
+    return 1;
+#endif  // MULTITHREAD
+}
+
+void parallel_for(size_t count, const std::function<void(size_t)> &fn) {
+#ifdef MULTITHREAD
+    unsigned threads = getParallelThreads();
+    if (count > 1 && threads > 1 && !in_worker) {
+        static ThreadPool *pool = nullptr;
+        if (!pool) {
+            gc_global_allocation global;
+            pool = new ThreadPool; }
+        pool->run(count, fn, threads);
+        return; }
+#endif  // MULTITHREAD
+    std::exception_ptr error;
+    for (size_t i = 0; i < count; ++i) {
+        try {
+            fn(i);
+        } catch (...) {
+            if (!error) error = std::current_exception(); } }
+    if (error) std::rethrow_exception(error);
+}
+
+}  // namespace Util
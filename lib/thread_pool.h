@@ -0,0 +1,41 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef LIB_THREAD_POOL_H_
+#define LIB_THREAD_POOL_H_
+
+#include <cstddef>
+#include <functional>
+
+namespace Util {
+
+/// Run @fn(0) ... @fn(@count-1), possibly concurrently.  When built with
+/// MULTITHREAD the calls are spread over a process-wide pool of worker threads
+/// (plus the calling thread); idle threads take the next unstarted index, so
+/// uneven work is balanced dynamically.  Without MULTITHREAD, or when called
+/// from one of the worker threads, the calls are made sequentially in order.
+/// Returns once all calls are complete; if any of them threw, the exception
+/// from the lowest index is rethrown.
+void parallel_for(size_t count, const std::function<void(size_t)> &fn);
+
+/// Set the number of threads parallel_for may use (including the caller).
+/// 0 selects the hardware concurrency, 1 disables parallelism.
+void setParallelThreads(unsigned threads);
+unsigned getParallelThreads();
+
+}  // namespace Util
+
+#endif /* LIB_THREAD_POOL_H_ */
@@ -9,6 +9,9 @@ unsigned SymbolicValue::crtid = 0;
 
 SymbolicValue* SymbolicValueFactory::create(const IR::Type* type, bool uninitialized) const {
     type = typeMap->getType(type, true);
+    if (type->is<IR::Type_Type>())
+        // declared types, such as externs, map to their type type
+        type = type->to<IR::Type_Type>()->type;
     if (type->is<IR::Type_Bits>())
         return new SymbolicInteger(ScalarValue::init(uninitialized), type->to<IR::Type_Bits>());
     if (type->is<IR::Type_Boolean>())
@@ -80,6 +83,9 @@ bool SymbolicValueFactory::isFixedWidth(const IR::Type* type) const {
 
 unsigned SymbolicValueFactory::getWidth(const IR::Type* type) const {
     type = typeMap->getType(type, true);
+    if (type->is<IR::Type_Type>())
+        // declared types, such as externs, map to their type type
+        type = type->to<IR::Type_Type>()->type;
     if (type->is<IR::Type_Bits>())
         return type->to<IR::Type_Bits>()->size;
     if (type->is<IR::Type_Boolean>())
@@ -153,6 +159,12 @@ bool SymbolicBool::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicBool::hash() const {
+    if (isKnown())
+        return hashCombine(ScalarValue::hash(), value);
+    return ScalarValue::hash();
+}
+
 bool SymbolicInteger::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicInteger>(), "%1%: expected an integer", other);
     auto io = other->to<SymbolicInteger>();
@@ -184,6 +196,12 @@ bool SymbolicInteger::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicInteger::hash() const {
+    if (isKnown())
+        return hashCombine(ScalarValue::hash(), mpz_get_ui(constant->value.get_mpz_t()));
+    return ScalarValue::hash();
+}
+
 bool SymbolicVarbit::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicVarbit>(), "%1%: expected a varbit", other);
     auto vo = other->to<SymbolicVarbit>();
@@ -233,6 +251,12 @@ bool SymbolicEnum::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicEnum::hash() const {
+    if (isKnown())
+        return hashCombine(ScalarValue::hash(), std::hash<cstring>()(value.name));
+    return ScalarValue::hash();
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 
 SymbolicStruct::SymbolicStruct(const IR::Type_StructLike* type, bool uninitialized,
@@ -251,12 +275,21 @@ SymbolicValue* SymbolicStruct::clone() const {
     return result;
 }
 
+SymbolicValue* SymbolicStruct::thaw() const {
+    auto result = new SymbolicStruct(type->to<IR::Type_StructLike>());
+    for (auto f : fieldValue) {
+        f.second->frozen = true;
+        result->fieldValue[f.first] = f.second;
+    }
+    return result;
+}
+
 void SymbolicStruct::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicStruct>(), "%1%: expected a struct", other);
     auto sv = other->to<SymbolicStruct>();
     for (auto f : sv->fieldValue)
-        fieldValue[f.first]->assign(f.second);
+        writable(fieldValue[f.first])->assign(f.second);
 }
 
 bool SymbolicStruct::merge(const SymbolicValue* other) {
@@ -264,13 +297,13 @@ bool SymbolicStruct::merge(const SymbolicValue* other) {
     auto sv = other->to<SymbolicStruct>();
     bool changes = false;
     for (auto f : sv->fieldValue)
-        changes = changes || fieldValue[f.first]->merge(f.second);
+        changes = changes || writable(fieldValue[f.first])->merge(f.second);
     return changes;
 }
 
 void SymbolicStruct::setAllUnknown() {
     for (auto f : type->to<IR::Type_StructLike>()->fields)
-        fieldValue[f->name.name]->setAllUnknown();
+        writable(fieldValue[f->name.name])->setAllUnknown();
 }
 
 bool SymbolicStruct::equals(const SymbolicValue* other) const {
@@ -283,6 +316,13 @@ bool SymbolicStruct::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicStruct::hash() const {
+    size_t result = fieldValue.size();
+    for (auto f : fieldValue)
+        result = hashCombine(result, f.second->hash());
+    return result;
+}
+
 bool SymbolicStruct::hasUninitializedParts() const {
     for (auto f : fieldValue)
         if (f.second->hasUninitializedParts())
@@ -324,9 +364,15 @@ SymbolicValue* SymbolicHeader::get(const IR::Node* node, cstring field) const {
     return SymbolicStruct::get(node, field);
 }
 
+SymbolicValue* SymbolicHeader::getWritable(const IR::Node* node, cstring field) {
+    if (valid->isKnown() && !valid->value)
+        return new SymbolicStaticError(node, "Reading field from invalid header");
+    return SymbolicStruct::getWritable(node, field);
+}
+
 void SymbolicHeader::setAllUnknown() {
     SymbolicStruct::setAllUnknown();
-    valid->setAllUnknown();
+    writable(valid)->setAllUnknown();
 }
 
 SymbolicValue* SymbolicHeader::clone() const {
@@ -337,13 +383,24 @@ SymbolicValue* SymbolicHeader::clone() const {
     return result;
 }
 
+SymbolicValue* SymbolicHeader::thaw() const {
+    auto result = new SymbolicHeader(type->to<IR::Type_Header>());
+    for (auto f : fieldValue) {
+        f.second->frozen = true;
+        result->fieldValue[f.first] = f.second;
+    }
+    valid->frozen = true;
+    result->valid = valid;
+    return result;
+}
+
 void SymbolicHeader::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicHeader>(), "%1%: expected a header", other);
     auto hv = other->to<SymbolicHeader>();
     for (auto f : hv->fieldValue)
-        fieldValue[f.first]->assign(f.second);
-    valid->assign(hv->valid);
+        writable(fieldValue[f.first])->assign(f.second);
+    writable(valid)->assign(hv->valid);
 }
 
 bool SymbolicHeader::merge(const SymbolicValue* other) {
@@ -351,8 +408,8 @@ bool SymbolicHeader::merge(const SymbolicValue* other) {
     auto hv = other->to<SymbolicHeader>();
     bool changes = false;
     for (auto f : hv->fieldValue)
-        changes = changes || fieldValue[f.first]->merge(f.second);
-    changes = changes || valid->merge(hv->valid);
+        changes = changes || writable(fieldValue[f.first])->merge(f.second);
+    changes = changes || writable(valid)->merge(hv->valid);
     return changes;
 }
 
@@ -368,6 +425,12 @@ bool SymbolicHeader::equals(const SymbolicValue* other) const {
     return SymbolicStruct::equals(other);
 }
 
+size_t SymbolicHeader::hash() const {
+    if (valid->isKnown() && !valid->value)
+        return valid->hash();
+    return hashCombine(valid->hash(), SymbolicStruct::hash());
+}
+
 void SymbolicHeader::dbprint(std::ostream& out) const {
     out << "{ ";
     out << "valid=>";
@@ -393,16 +456,22 @@ SymbolicArray::SymbolicArray(const IR::Type_Stack* type, bool uninitialized,
 }
 
 void SymbolicArray::shift(int amount) {
+    // The elements shifted in are new invalid headers; the others move.
+    auto invalid = [this](unsigned i) {
+        auto hdr = values[i]->thaw()->to<SymbolicHeader>();
+        hdr->setValid(false);
+        values[i] = hdr;
+    };
     if (amount < 0) {
         for (unsigned i = 0; i < values.size() + amount; i++)
             values[i] = values[i - amount];
         for (unsigned i = values.size() + amount; i < values.size(); i++)
-            values[i]->setValid(false);
+            invalid(i);
     } else if (amount > 0) {
         for (unsigned i = 0; i < values.size() - amount; i++)
             values[values.size() - i - 1] = values[values.size() - i - amount - 1];
         for (unsigned i = 0; i < (unsigned)amount; i++)
-            values[i]->setValid(false);
+            invalid(i);
     }
 }
 
@@ -412,7 +481,7 @@ SymbolicValue* SymbolicArray::next(const IR::Node* node) {
         if (v->valid->isUnknown() || v->valid->isUninitialized())
             return new AnyElement(this);
         if (!v->valid->value)
-            return v;
+            return writable(values.at(i));
     }
     return new SymbolicException(node, P4::StandardExceptions::StackOutOfBounds);
 }
@@ -424,14 +493,14 @@ SymbolicValue* SymbolicArray::last(const IR::Node* node) {
         if (v->valid->isUnknown() || v->valid->isUninitialized())
             return new AnyElement(this);
         if (v->valid->value)
-            return v;
+            return writable(values.at(index));
     }
     return new SymbolicException(node, P4::StandardExceptions::StackOutOfBounds);
 }
 
 void SymbolicArray::setAllUnknown() {
     for (unsigned i = 0; i < values.size(); i++)
-        values.at(i)->setAllUnknown();
+        writable(values.at(i))->setAllUnknown();
 }
 
 SymbolicValue* SymbolicArray::clone() const {
@@ -441,18 +510,28 @@ SymbolicValue* SymbolicArray::clone() const {
     return result;
 }
 
+SymbolicValue* SymbolicArray::thaw() const {
+    auto result = new SymbolicArray(type->to<IR::Type_Stack>());
+    for (auto v : values) {
+        v->frozen = true;
+        result->values.push_back(v);
+    }
+    return result;
+}
+
 void SymbolicArray::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicArray>(), "%1%: expected an array", other);
     for (unsigned i=0; i < values.size(); i++)
-        values.at(i)->assign(other->to<SymbolicArray>()->get(nullptr, i));
+        writable(values.at(i))->assign(other->to<SymbolicArray>()->get(nullptr, i));
 }
 
 bool SymbolicArray::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicArray>(), "%1%: expected an array", other);
     bool changes = false;
     for (unsigned i=0; i < values.size(); i++)
-        changes = changes || values.at(i)->merge(other->to<SymbolicArray>()->get(nullptr, i));
+        changes = changes ||
+                writable(values.at(i))->merge(other->to<SymbolicArray>()->get(nullptr, i));
     return changes;
 }
 
@@ -467,6 +546,13 @@ bool SymbolicArray::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicArray::hash() const {
+    size_t result = values.size();
+    for (auto v : values)
+        result = hashCombine(result, v->hash());
+    return result;
+}
+
 bool SymbolicArray::hasUninitializedParts() const {
     for (unsigned i=0; i < values.size(); i++)
         if (values.at(i)->hasUninitializedParts())
@@ -517,7 +603,7 @@ SymbolicTuple::SymbolicTuple(const IR::Type_Tuple* type, bool uninitialized,
 
 void SymbolicTuple::setAllUnknown() {
     for (unsigned i = 0; i < values.size(); i++)
-        values.at(i)->setAllUnknown();
+        writable(values.at(i))->setAllUnknown();
 }
 
 SymbolicValue* SymbolicTuple::clone() const {
@@ -527,13 +613,22 @@ SymbolicValue* SymbolicTuple::clone() const {
     return result;
 }
 
+SymbolicValue* SymbolicTuple::thaw() const {
+    auto result = new SymbolicTuple(type->to<IR::Type_Tuple>());
+    for (auto v : values) {
+        v->frozen = true;
+        result->values.push_back(v);
+    }
+    return result;
+}
+
 bool SymbolicTuple::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicTuple>(), "%1%: expected a tuple value", other);
     auto tpl = other->to<SymbolicTuple>();
     BUG_CHECK(values.size() == tpl->values.size(), "merging tuples with different sizes");
     bool changes = false;
     for (unsigned i=0; i < values.size(); i++)
-        changes = changes || values.at(i)->merge(tpl->get(i));
+        changes = changes || writable(values.at(i))->merge(tpl->get(i));
     return changes;
 }
 
@@ -547,6 +642,13 @@ bool SymbolicTuple::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicTuple::hash() const {
+    size_t result = values.size();
+    for (auto v : values)
+        result = hashCombine(result, v->hash());
+    return result;
+}
+
 bool SymbolicTuple::hasUninitializedParts() const {
     for (unsigned i=0; i < values.size(); i++)
         if (values.at(i)->hasUninitializedParts())
@@ -772,7 +874,7 @@ void ExpressionEvaluator::postorder(const IR::Member* expression) {
         set(expression, v);
     } else {
         BUG_CHECK(l->is<SymbolicStruct>(), "%1%: expected a struct", l);
-        auto v = l->to<SymbolicStruct>()->get(expression, expression->member.name);
+        auto v = l->to<SymbolicStruct>()->getWritable(expression, expression->member.name);
         set(expression, v);
     }
 }
@@ -816,7 +918,7 @@ void ExpressionEvaluator::postorder(const IR::ArrayIndex* expression) {
     CHECK_NULL(lv);
     auto ix = r->to<SymbolicInteger>();
     CHECK_NULL(ix);
-    auto result = lv->get(expression, ix->constant->asInt());
+    auto result = lv->getWritable(expression, ix->constant->asInt());
     set(expression, result);
 }
 
@@ -827,7 +929,7 @@ void ExpressionEvaluator::postorder(const IR::PathExpression* expression) {
     if (type->is<IR::Type_Error>())
         result = new SymbolicEnum(type, decl->getName());
     else
-        result = valueMap->get(decl);
+        result = valueMap->getWritable(decl);
     set(expression, result);
 }
 
@@ -928,7 +1030,7 @@ void ExpressionEvaluator::postorder(const IR::MethodCallExpression* expression)
                 }
 
                 auto decl = em->object;
-                auto obj = valueMap->get(decl);
+                auto obj = valueMap->getWritable(decl);
                 CHECK_NULL(obj);
                 if (obj->is<SymbolicError>()) {
                     set(expression, obj);
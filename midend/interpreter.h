@@ -38,6 +38,9 @@ class SymbolicValue {
  public:
     const unsigned id;
     const IR::Type* type;
+    // Frozen values may be shared by several value maps (see
+    // ValueMap::clone), so they are never changed: they are thawed first.
+    bool frozen = false;
     virtual bool isScalar() const = 0;
     virtual void dbprint(std::ostream& out) const = 0;
     template<typename T> T* to() {
@@ -48,12 +51,25 @@ class SymbolicValue {
         CHECK_NULL(result); return result; }
     template<typename T> bool is() const { return dynamic_cast<const T*>(this) != nullptr; }
     virtual SymbolicValue* clone() const = 0;
+    // A copy of this value which can be changed.  Aggregates share their
+    // components with the copy; the components are frozen.
+    virtual SymbolicValue* thaw() const { return clone(); }
+    // Returns 'value', which is first replaced by a thawed copy if frozen.
+    template<typename T> static T* writable(T*& value) {
+        if (value->frozen)
+            value = value->thaw()->template to<T>();
+        return value;
+    }
     virtual void setAllUnknown() = 0;
     virtual void assign(const SymbolicValue* other) = 0;
     // Merging two symbolic values; values should form a lattice.
     // Returns 'true' if merging changed the current value.
     virtual bool merge(const SymbolicValue* other) = 0;
     virtual bool equals(const SymbolicValue* other) const = 0;
+    // Values which are equal have the same hash.
+    virtual size_t hash() const = 0;
+    static size_t hashCombine(size_t seed, size_t value)
+    { return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)); }
     // True if some parts of this value are definitely uninitialized
     virtual bool hasUninitializedParts() const = 0;
 };
@@ -76,10 +92,14 @@ class SymbolicValueFactory {
 class ValueMap final : public IHasDbPrint {
  public:
     std::map<const IR::IDeclaration*, SymbolicValue*> map;
+    // The values are frozen and shared with the result; they are only
+    // copied (one component at a time) when one of the maps changes them.
     ValueMap* clone() const {
         auto result = new ValueMap();
-        for (auto v : map)
-            result->map.emplace(v.first, v.second->clone());
+        for (auto v : map) {
+            v.second->frozen = true;
+            result->map.emplace(v.first, v.second);
+        }
         return result;
     }
     ValueMap* filter(std::function<bool(const IR::IDeclaration*, const SymbolicValue*)> filter) {
@@ -93,6 +113,14 @@ class ValueMap final : public IHasDbPrint {
     { CHECK_NULL(left); CHECK_NULL(right); map[left] = right; }
     SymbolicValue* get(const IR::IDeclaration* left) const
     { CHECK_NULL(left); return ::get(map, left); }
+    // The value of 'left', which can be changed.
+    SymbolicValue* getWritable(const IR::IDeclaration* left) {
+        CHECK_NULL(left);
+        auto it = map.find(left);
+        if (it == map.end())
+            return nullptr;
+        return SymbolicValue::writable(it->second);
+    }
 
     void dbprint(std::ostream& out) const {
         bool first = true;
@@ -106,19 +134,25 @@ class ValueMap final : public IHasDbPrint {
     bool merge(const ValueMap* other) {
         bool change = false;
         BUG_CHECK(map.size() == other->map.size(), "Merging incompatible maps?");
-        for (auto d : map) {
+        for (auto &d : map) {
             auto v = other->get(d.first);
             CHECK_NULL(v);
-            change = change || d.second->merge(v);
+            change = change || SymbolicValue::writable(d.second)->merge(v);
         }
         return change;
     }
+    size_t hash() const {
+        size_t result = map.size();
+        for (auto v : map)
+            result = SymbolicValue::hashCombine(result, v.second->hash());
+        return result;
+    }
     bool equals(const ValueMap* other) const {
         BUG_CHECK(map.size() == other->map.size(), "Incompatible maps compared");
         for (auto v : map) {
             auto ov = other->get(v.first);
             CHECK_NULL(ov);
-            if (!v.second->equals(ov))
+            if (v.second != ov && !v.second->equals(ov))
                 return false;
         }
         return true;
@@ -197,6 +231,7 @@ class SymbolicException : public SymbolicError {
         return str.str();
     }
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override { return static_cast<size_t>(exc); }
 };
 
 class SymbolicStaticError : public SymbolicError {
@@ -209,6 +244,7 @@ class SymbolicStaticError : public SymbolicError {
     { out << "Error: " << msg; }
     cstring message() const override { return msg; }
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override { return std::hash<cstring>()(msg); }
 };
 
 class ScalarValue : public SymbolicValue {
@@ -249,6 +285,7 @@ class ScalarValue : public SymbolicValue {
     }
     bool hasUninitializedParts() const override
     { return state == ValueState::Uninitialized; }
+    size_t hash() const override { return static_cast<size_t>(state); }
 };
 
 class SymbolicVoid : public SymbolicValue {
@@ -266,6 +303,7 @@ class SymbolicVoid : public SymbolicValue {
     { BUG_CHECK(other->is<SymbolicVoid>(), "%1%: expected void", other); return false; }
     bool equals(const SymbolicValue* other) const override
     { return other == instance; }
+    size_t hash() const override { return 0; }
     bool hasUninitializedParts() const override
     { return false; }
 };
@@ -296,6 +334,7 @@ class SymbolicBool final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicInteger final : public ScalarValue {
@@ -322,6 +361,7 @@ class SymbolicInteger final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicVarbit final : public ScalarValue {
@@ -360,6 +400,7 @@ class SymbolicEnum final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicStruct : public SymbolicValue {
@@ -376,6 +417,12 @@ class SymbolicStruct : public SymbolicValue {
         CHECK_NULL(r);
         return r;
     }
+    // Like get, but the field can be changed.
+    virtual SymbolicValue* getWritable(const IR::Node*, cstring field) {
+        auto it = fieldValue.find(field);
+        BUG_CHECK(it != fieldValue.end(), "%1%: no such field", field);
+        return writable(it->second);
+    }
     void set(cstring field, SymbolicValue* value) {
         CHECK_NULL(value);
         fieldValue[field] = value;
@@ -383,10 +430,12 @@ class SymbolicStruct : public SymbolicValue {
     void dbprint(std::ostream& out) const override;
     bool isScalar() const override { return false; }
     SymbolicValue* clone() const override;
+    SymbolicValue* thaw() const override;
     void setAllUnknown() override;
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
 };
 
@@ -398,12 +447,15 @@ class SymbolicHeader : public SymbolicStruct {
                    const SymbolicValueFactory* factory);
     virtual void setValid(bool v);
     SymbolicValue* clone() const override;
+    SymbolicValue* thaw() const override;
     SymbolicValue* get(const IR::Node* node, cstring field) const override;
+    SymbolicValue* getWritable(const IR::Node* node, cstring field) override;
     void setAllUnknown() override;
     void assign(const SymbolicValue* other) override;
     void dbprint(std::ostream& out) const override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicArray final : public SymbolicValue {
@@ -423,6 +475,12 @@ class SymbolicArray final : public SymbolicValue {
             return new SymbolicStaticError(node, "Out of bounds");
         return values.at(index);
     }
+    // Like get, but the element can be changed.
+    SymbolicValue* getWritable(const IR::Node* node, size_t index) {
+        if (index >= values.size())
+            return new SymbolicStaticError(node, "Out of bounds");
+        return writable(values.at(index));
+    }
     void shift(int amount);  // negative = shift left
     void set(size_t index, SymbolicHeader* value) {
         CHECK_NULL(value);
@@ -430,6 +488,7 @@ class SymbolicArray final : public SymbolicValue {
     }
     void dbprint(std::ostream& out) const override;
     SymbolicValue* clone() const override;
+    SymbolicValue* thaw() const override;
     SymbolicValue* next(const IR::Node* node);
     SymbolicValue* last(const IR::Node* node);
     bool isScalar() const override { return false; }
@@ -437,6 +496,7 @@ class SymbolicArray final : public SymbolicValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
 };
 
@@ -449,6 +509,8 @@ class AnyElement final : public SymbolicHeader {
     { CHECK_NULL(parent); valid = new SymbolicBool(); }
     SymbolicValue* clone() const override
     { auto result = new AnyElement(parent); return result; }
+    SymbolicValue* thaw() const override
+    { BUG("AnyElement cannot be frozen"); }
     void setAllUnknown() override
     { parent->setAllUnknown(); }
     void assign(const SymbolicValue*) override
@@ -458,6 +520,8 @@ class AnyElement final : public SymbolicHeader {
     void setValid(bool) override { parent->setAllUnknown(); }
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override
+    { BUG("Hash should not be called on AnyElement"); }
     SymbolicValue* collapse() const;
     bool hasUninitializedParts() const override
     { BUG("Should not be called"); }
@@ -482,6 +546,7 @@ class SymbolicTuple final : public SymbolicValue {
         }
     }
     SymbolicValue* clone() const override;
+    SymbolicValue* thaw() const override;
     bool isScalar() const override { return false; }
     void setAllUnknown() override;
     void assign(const SymbolicValue*) override
@@ -490,6 +555,7 @@ class SymbolicTuple final : public SymbolicValue {
     { values.push_back(value); }
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
 };
 
@@ -510,6 +576,7 @@ class SymbolicExtern : public SymbolicValue {
     { BUG("%1%: extern is read-only", this); }
     bool merge(const SymbolicValue*) override { return false; }
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override { return 0; }
     bool hasUninitializedParts() const override
     { return false; }
 };
@@ -545,6 +612,7 @@ class SymbolicPacketIn final : public SymbolicExtern {
     { minimumStreamOffset += width; }
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override { return minimumStreamOffset; }
 };
 
 }  // namespace P4
@@ -1,4 +1,5 @@
 #include "parserUnroll.h"
+#include <unordered_map>
 #include "lib/stringify.h"
 
 namespace P4 {
@@ -50,6 +51,10 @@ class ParserSymbolicInterpreter {
     SymbolicValueFactory* factory;
     ParserInfo*         synthesizedParser;  // output produced
     bool                unroll;
+    unsigned            maxStates;  // budget of state evaluations; 0 is unlimited
+    // States evaluated so far (and whether they were not the first visit of
+    // their original state), indexed by the hash of the values they start from.
+    std::unordered_multimap<size_t, std::pair<const ParserStateInfo*, bool>> evaluated;
 
     ValueMap* initializeVariables() {
         ValueMap* result = new ValueMap();
@@ -92,7 +97,8 @@ class ParserSymbolicInterpreter {
             stateName == IR::ParserState::reject)
             return nullptr;
         auto state = structure->get(stateName);
-        auto pi = new ParserStateInfo(stateName, parser, state, predecessor, values->clone());
+        // Value maps are never changed once computed, so they can be shared.
+        auto pi = new ParserStateInfo(stateName, parser, state, predecessor, values);
         synthesizedParser->add(pi);
         return pi;
     }
@@ -113,22 +119,20 @@ class ParserSymbolicInterpreter {
         return result.str();
     }
 
+    // The closest predecessor produced from the same original state.
+    static const ParserStateInfo* previousVisit(const ParserStateInfo* state) {
+        for (auto crt = state->predecessor; crt != nullptr; crt = crt->predecessor)
+            if (crt->state == state->state)
+                return crt;
+        return nullptr;
+    }
+
     // Return false if an error can be detected statically
     bool reportIfError(const ParserStateInfo* state, SymbolicValue* value) const {
         if (value->is<SymbolicException>()) {
             auto exc = value->to<SymbolicException>();
 
-            bool stateClone = false;
-            auto orig = state->state;
-            auto crt = state;
-            while (crt->predecessor != nullptr) {
-                crt = crt->predecessor;
-                if (crt->state == orig) {
-                    stateClone = true;
-                    break;
-                }
-            }
-
+            bool stateClone = previousVisit(state) != nullptr;
             if (!stateClone)
                 // errors in the original state are signalled
                 ::error("%1%: error %2% will be triggered\n%3%",
@@ -246,56 +250,71 @@ class ParserSymbolicInterpreter {
         return false;
     }
 
-    // Return true if we have detected a loop we cannot unroll
-    bool checkLoops(ParserStateInfo* state) const {
-        const ParserStateInfo* crt = state;
-        while (true) {
-            crt = crt->predecessor;
-            if (crt == nullptr)
-                break;
-            if (crt->state == state->state) {
-                // Loop detected.
-                // Check if any packet in the valueMap has changed
-                auto filter = [](const IR::IDeclaration*, const SymbolicValue* value)
-                        { return value->is<SymbolicPacketIn>(); };
-                auto packets = state->before->filter(filter);
-                auto prevPackets = crt->before->filter(filter);
-                if (packets->equals(prevPackets)) {
-                    bool conservative = false;
-                    for (auto p : state->before->map) {
-                        auto pkt = p.second->to<SymbolicPacketIn>();
-                        if (pkt->isConservative()) {
-                            conservative = true;
-                            break;
-                        }
-                    }
-
-                    if (conservative)
-                        ::warning(ErrorType::WARN_PARSER_TRANSITION,
-                                  "Potential parser cycle without extracting any bytes:\n%1%",
-                                  stateChain(state));
-                    else
-                        ::error("Parser cycle without extracting any bytes:\n%1%",
-                                stateChain(state));
-                    return true;
-                }
-
-                // If no header validity has changed we can't really unroll
-                if (!headerValidityChange(crt->before, state->before)) {
-                    if (unroll)
-                        ::error("Parser cycle cannot be unrolled:\n%1%",
-                                stateChain(state));
-                    return true;
+    // Return true if we have detected a loop we cannot unroll.
+    // 'previous' is the previous visit of the same original state.
+    bool checkLoops(ParserStateInfo* state, const ParserStateInfo* previous) const {
+        if (previous == nullptr)
+            return false;
+        // Loop detected.
+        // Check if any packet in the valueMap has changed
+        auto filter = [](const IR::IDeclaration*, const SymbolicValue* value)
+                { return value->is<SymbolicPacketIn>(); };
+        auto packets = state->before->filter(filter);
+        auto prevPackets = previous->before->filter(filter);
+        if (packets->equals(prevPackets)) {
+            bool conservative = false;
+            for (auto p : packets->map) {
+                auto pkt = p.second->to<SymbolicPacketIn>();
+                if (pkt->isConservative()) {
+                    conservative = true;
+                    break;
                 }
-                break;
             }
+
+            if (conservative)
+                ::warning(ErrorType::WARN_PARSER_TRANSITION,
+                          "Potential parser cycle without extracting any bytes:\n%1%",
+                          stateChain(state));
+            else
+                ::error("Parser cycle without extracting any bytes:\n%1%",
+                        stateChain(state));
+            return true;
+        }
+
+        // If no header validity has changed we can't really unroll
+        if (!headerValidityChange(previous->before, state->before)) {
+            if (unroll)
+                ::error("Parser cycle cannot be unrolled:\n%1%",
+                        stateChain(state));
+            return true;
         }
         return false;
     }
 
+    // Returns a state evaluated before which starts from the same original
+    // state with the same values: evaluating 'state' would only repeat its
+    // evaluation and the evaluation of all its successors.
+    // Otherwise 'state' is remembered as evaluated.
+    // Errors are reported differently in the first visit of a state, so
+    // 'clone' (whether this is not the first visit) is part of the key.
+    const ParserStateInfo* findEvaluated(const ParserStateInfo* state, bool clone) {
+        size_t hash = SymbolicValue::hashCombine(
+            SymbolicValue::hashCombine(std::hash<const void*>()(state->state), clone),
+            state->before->hash());
+        auto range = evaluated.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            auto crt = it->second;
+            if (crt.first->state == state->state && crt.second == clone &&
+                (crt.first->before == state->before || crt.first->before->equals(state->before)))
+                return crt.first;
+        }
+        evaluated.emplace(hash, std::make_pair(state, clone));
+        return nullptr;
+    }
+
     std::vector<ParserStateInfo*>* evaluateState(ParserStateInfo* state) {
         LOG1("Analyzing " << state->state);
-        auto valueMap = state->before->clone();
+        auto valueMap = state->state->components.empty() ? state->before : state->before->clone();
         for (auto s : state->state->components) {
             bool success = executeStatement(state, s, valueMap);
             if (!success)
@@ -308,9 +327,9 @@ class ParserSymbolicInterpreter {
 
  public:
     ParserSymbolicInterpreter(ParserStructure* structure, ReferenceMap* refMap,
-                              TypeMap* typeMap, bool unroll)
+                              TypeMap* typeMap, bool unroll, unsigned maxStates)
             : structure(structure), refMap(refMap), typeMap(typeMap),
-              synthesizedParser(nullptr), unroll(unroll) {
+              synthesizedParser(nullptr), unroll(unroll), maxStates(maxStates) {
         CHECK_NULL(structure); CHECK_NULL(refMap); CHECK_NULL(typeMap);
         factory = new SymbolicValueFactory(typeMap);
         parser = structure->parser;
@@ -330,10 +349,24 @@ class ParserSymbolicInterpreter {
             auto stateInfo = toRun.back();
             toRun.pop_back();
             LOG1("Symbolic evaluation of " << stateChain(stateInfo));
-            bool infLoop = checkLoops(stateInfo);
+            auto previous = previousVisit(stateInfo);
+            bool infLoop = checkLoops(stateInfo, previous);
             if (infLoop)
                 // don't evaluate successors anymore
                 continue;
+            if (auto same = findEvaluated(stateInfo, previous != nullptr)) {
+                LOG1("Same values as in " << stateChain(same));
+                stateInfo->after = same->after;
+                synthesizedParser->shared++;
+                continue;
+            }
+            if (maxStates != 0 && synthesizedParser->evaluated == maxStates) {
+                ::warning(ErrorType::WARN_PARSER_TRANSITION,
+                          "%1%: parser analysis stopped after evaluating %2% states",
+                          parser, maxStates);
+                break;
+            }
+            synthesizedParser->evaluated++;
             auto nextStates = evaluateState(stateInfo);
             if (nextStates == nullptr) {
                 LOG1("No next states");
@@ -347,8 +380,9 @@ class ParserSymbolicInterpreter {
 };
 }  // namespace ParserStructureImpl
 
-void ParserStructure::analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) {
-    ParserStructureImpl::ParserSymbolicInterpreter psi(this, refMap, typeMap, unroll);
+void ParserStructure::analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                              unsigned maxStates) {
+    ParserStructureImpl::ParserSymbolicInterpreter psi(this, refMap, typeMap, unroll, maxStates);
     result = psi.run();
 }
 
@@ -50,6 +50,8 @@ class ParserInfo {
     // for each original state a vector of states produced by unrolling
     std::map<cstring, std::vector<ParserStateInfo*>*> states;
  public:
+    unsigned evaluated = 0;  // states evaluated symbolically
+    unsigned shared = 0;     // states reached again with the same values
     std::vector<ParserStateInfo*>* get(cstring origState) {
         std::vector<ParserStateInfo*> *vec;
         auto it = states.find(origState);
@@ -74,6 +76,7 @@ typedef CallGraph<const IR::ParserState*> StateCallGraph;
 class ParserStructure {
     std::map<cstring, const IR::ParserState*> stateMap;
     StateCallGraph* callGraph;
+
  public:
     const IR::P4Parser*    parser;
     const IR::ParserState* start;
@@ -91,7 +94,12 @@ class ParserStructure {
     void calls(const IR::ParserState* caller, const IR::ParserState* callee)
     { callGraph->calls(caller, callee); }
 
-    void analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll);
+    // Default budget of state evaluations for the symbolic evaluator.
+    static const unsigned defaultMaxStates = 100000;
+    // Evaluate the parser symbolically; gives up (with a warning) after
+    // evaluating maxStates states, unless maxStates is 0.
+    void analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                 unsigned maxStates = defaultMaxStates);
 };
 
 class AnalyzeParser : public Inspector {
@@ -127,12 +135,13 @@ class ParserUnroller : public Transform {
 class ParserRewriter : public PassManager {
     ParserStructure  current;
  public:
-    ParserRewriter(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) {
+    ParserRewriter(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                   unsigned maxStates = ParserStructure::defaultMaxStates) {
         CHECK_NULL(refMap); CHECK_NULL(typeMap);
         passes.push_back(new AnalyzeParser(refMap, &current));
         passes.push_back(new VisitFunctor (
-            [this, refMap, typeMap, unroll](const IR::Node* root) -> const IR::Node* {
-                current.analyze(refMap, typeMap, unroll);
+            [this, refMap, typeMap, unroll, maxStates](const IR::Node* root) -> const IR::Node* {
+                current.analyze(refMap, typeMap, unroll, maxStates);
                 return root;
             }));
 #if 0
@@ -143,8 +152,8 @@ class ParserRewriter : public PassManager {
     Visitor::profile_t init_apply(const IR::Node* node) override {
         LOG1("Scanning " << node);
         BUG_CHECK(node->is<IR::P4Parser>(), "%1%: expected a parser", node);
-        current.parser = node->to<IR::P4Parser>();
-        return Visitor::init_apply(node);
+        current.setParser(node->to<IR::P4Parser>());
+        return PassManager::init_apply(node);
     }
 };
 
@@ -155,21 +164,24 @@ class RewriteAllParsers : public Transform {
     ReferenceMap* refMap;
     TypeMap*      typeMap;
     bool          unroll;
+    unsigned      maxStates;
  public:
-    RewriteAllParsers(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) :
-            refMap(refMap), typeMap(typeMap), unroll(unroll)
+    RewriteAllParsers(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                      unsigned maxStates = ParserStructure::defaultMaxStates) :
+            refMap(refMap), typeMap(typeMap), unroll(unroll), maxStates(maxStates)
     { CHECK_NULL(refMap); CHECK_NULL(typeMap); }
     const IR::Node* postorder(IR::P4Parser* parser) override {
-        ParserRewriter rewriter(refMap, typeMap, unroll);
+        ParserRewriter rewriter(refMap, typeMap, unroll, maxStates);
         return parser->apply(rewriter);
     }
 };
 
 class ParsersUnroll : public PassManager {
  public:
-    ParsersUnroll(bool unroll, ReferenceMap* refMap, TypeMap* typeMap) {
+    ParsersUnroll(bool unroll, ReferenceMap* refMap, TypeMap* typeMap,
+                  unsigned maxStates = ParserStructure::defaultMaxStates) {
         passes.push_back(new TypeChecking(refMap, typeMap));
-        passes.push_back(new RewriteAllParsers(refMap, typeMap, unroll));
+        passes.push_back(new RewriteAllParsers(refMap, typeMap, unroll, maxStates));
         setName("ParsersUnroll");
     }
 };
@@ -0,0 +1,105 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <chrono>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "ir/visitor.h"
+#include "lib/compile_context.h"
+#include "lib/gc.h"
+
+namespace Test {
+
+namespace {
+
+struct IncrementConstants : public Transform {
+    const IR::Node *postorder(IR::Constant *c) override {
+        return new IR::Constant(c->value + 1); }
+};
+
+/// A stand-in for a compilation: builds some IR and runs a pass over it.
+/// Nothing allocated in here may be used once the arena is released (gtest's
+/// own bookkeeping included), so the checks are made by the callers.
+size_t compile(int depth) {
+    AutoCompileContext context(new GTestContext(GTestContext::get()));
+    auto *expr = makeExpr(depth)->apply(IncrementConstants());
+    return gc_in_arena(expr) ? gc_arena_inuse() : 0;
+}
+
+}  // namespace
+
+TEST(arena_allocator, released_with_context) {
+    if (!gc_enable_arenas()) {
+        std::cout << "arena allocation is not supported by this build" << std::endl;
+        return; }
+
+    size_t inuse = 0, after = 0, peak = 0, total = 0, total_before;
+    bool expr_in_arena = false, type_in_arena = true, name_in_arena = true;
+    gc_arena_inuse(nullptr, &total_before);
+    {
+        AutoCompileContext context(new GTestContext(GTestContext::get()));
+        auto *expr = makeExpr(8);
+        expr_in_arena = gc_in_arena(expr);
+        // global caches and singletons must stay on the heap
+        type_in_arena = gc_in_arena(IR::Type_Bits::get(23, true));
+        cstring name(std::string("arena_") + std::to_string(inuse));
+        name_in_arena = gc_in_arena(name.c_str());
+        inuse = gc_arena_inuse();
+    }
+    after = gc_arena_inuse(&peak, &total);
+    gc_enable_arenas(false);
+
+    EXPECT_TRUE(expr_in_arena);
+    EXPECT_FALSE(type_in_arena);
+    EXPECT_FALSE(name_in_arena);
+    EXPECT_GT(inuse, 0U);
+    EXPECT_EQ(after, 0U);
+    EXPECT_GE(peak, inuse);
+    EXPECT_GE(total - total_before, inuse);
+}
+
+TEST(arena_allocator, many_compilations) {
+    if (!gc_enable_arenas()) return;
+
+    size_t first = compile(10), last = 0, peak, total_before, total;
+    gc_arena_inuse(&peak, &total_before);
+    auto start = std::chrono::steady_clock::now();
+    const int compilations = 50;
+    for (int i = 0; i < compilations; ++i) last = compile(10);
+    auto end = std::chrono::steady_clock::now();
+    size_t inuse = gc_arena_inuse(&peak, &total);
+    gc_enable_arenas(false);
+
+    // each compilation reuses the memory released by the previous one
+    EXPECT_GT(first, 0U);
+    EXPECT_EQ(first, last);
+    EXPECT_EQ(inuse, 0U);
+    EXPECT_LT(peak, 2 * first);
+    EXPECT_EQ(total - total_before, compilations * first);
+
+    auto heap_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < compilations; ++i) compile(10);
+    auto heap_end = std::chrono::steady_clock::now();
+    std::cout << "per compilation: arena "
+              << std::chrono::duration<double, std::micro>(end - start).count() / compilations
+              << " usec, heap "
+              << std::chrono::duration<double, std::micro>(heap_end - heap_start).count() /
+                 compilations
+              << " usec; " << first << " arena bytes, peak " << peak << std::endl;
+}
+
+}  // namespace Test
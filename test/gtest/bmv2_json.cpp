@@ -0,0 +1,149 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/json_parser.h"
+#include "lib/gc.h"
+#include "lib/json.h"
+
+namespace Test {
+
+namespace {
+
+/// Counts the allocations (and reallocations) made by GMP while it exists.
+struct GmpAllocations {
+    static size_t count;
+    static void *(*allocate)(size_t);
+    static void *(*reallocate)(void *, size_t, size_t);
+    static void (*release)(void *, size_t);
+
+    static void *countAllocate(size_t size) { ++count; return allocate(size); }
+    static void *countReallocate(void *p, size_t old, size_t size) {
+        ++count; return reallocate(p, old, size); }
+
+    GmpAllocations() {
+        count = 0;
+        mp_get_memory_functions(&allocate, &reallocate, &release);
+        mp_set_memory_functions(countAllocate, countReallocate, release);
+    }
+    ~GmpAllocations() { mp_set_memory_functions(allocate, reallocate, release); }
+};
+
+size_t GmpAllocations::count;
+void *(*GmpAllocations::allocate)(size_t);
+void *(*GmpAllocations::reallocate)(void *, size_t, size_t);
+void (*GmpAllocations::release)(void *, size_t);
+
+/// @return the resident set size of the process, in bytes.
+size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+/// Rebuilds the BMv2 output @json as a Util::IJson tree, the way the backend
+/// builds it; counts the numbers which do not fit in 64 bits in @big.
+Util::IJson *toBMv2Json(JsonData *json, size_t &big) {
+    if (auto number = json->to<JsonNumber>()) {
+        if (mpz_sizeinbase(number->val.get_mpz_t(), 2) > 63) ++big;
+        return new Util::JsonValue(number->val);
+    }
+    if (auto boolean = json->to<JsonBoolean>())
+        return new Util::JsonValue(boolean->val);
+    if (auto string = json->to<JsonString>())
+        return new Util::JsonValue(cstring(*string));
+    if (auto vector = json->to<JsonVector>()) {
+        auto array = new Util::JsonArray();
+        for (auto element : *vector)
+            array->append(toBMv2Json(element, big));
+        return array;
+    }
+    if (auto object = json->to<::JsonObject>()) {
+        auto result = new Util::JsonObject();
+        for (auto &member : *object)
+            result->emplace(member.first, toBMv2Json(member.second, big));
+        return result;
+    }
+    return Util::JsonValue::null;
+}
+
+}  // namespace
+
+// Compiles the largest BMv2 programs of the testdata corpus with p4c-bm2-ss,
+// then builds and serializes their output again, reporting what that costs.
+TEST(BMv2Json, benchmark) {
+    std::string dir = sourcePath("testdata/p4_16_samples");
+    std::vector<std::pair<off_t, std::string>> programs;
+    if (DIR *d = opendir(dir.c_str())) {
+        while (auto *e = readdir(d)) {
+            std::string name = e->d_name;
+            struct stat st;
+            if (name.size() > 8 && name.compare(name.size() - 8, 8, "-bmv2.p4") == 0 &&
+                stat((dir + "/" + name).c_str(), &st) == 0)
+                programs.emplace_back(st.st_size, name); }
+        closedir(d); }
+    std::sort(programs.rbegin(), programs.rend());
+    if (programs.size() > 10)
+        programs.resize(10);
+
+    for (auto &program : programs) {
+        std::string output = "bmv2_json_benchmark.json";
+        std::string command = "./p4c-bm2-ss -o " + output + " " + dir + "/" + program.second +
+                              " > /dev/null 2>&1";
+        if (system(command.c_str()) != 0)
+            continue;
+        JsonData *json = nullptr;
+        {
+            std::ifstream in(output);
+            in >> json;
+        }
+        std::remove(output.c_str());
+        ASSERT_TRUE(json != nullptr) << program.second;
+
+        size_t big = 0;
+        Util::IJson *tree = nullptr;
+        size_t bytes = gc_total_allocated();
+        long resident = residentBytes();
+        GmpAllocations gmp;
+        double buildUsec = time_usec([&]() { tree = toBMv2Json(json, big); });
+        size_t buildAllocations = GmpAllocations::count;
+        bytes = gc_total_allocated() - bytes;
+        resident = static_cast<long>(residentBytes()) - resident;
+
+        std::stringstream text;
+        double serializeUsec = time_usec([&]() { Util::JsonWriter(text).value(tree); });
+        // Only numbers of more than 64 bits are allocated by GMP
+        EXPECT_LE(buildAllocations, big) << program.second;
+        std::cout << program.second << ": " << text.str().size() << " bytes of JSON, build "
+                  << buildUsec << " usec, " << buildAllocations << " GMP allocations, "
+                  << bytes << " bytes allocated, RSS " << resident << " bytes, serialize "
+                  << serializeUsec << " usec, " << GmpAllocations::count - buildAllocations
+                  << " GMP allocations" << std::endl;
+    }
+}
+
+}  // namespace Test
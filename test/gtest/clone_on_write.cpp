@@ -0,0 +1,161 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <chrono>
+#include "gtest/gtest.h"
+#include "frontends/p4/strengthReduction.h"
+#include "ir/ir.h"
+#include "ir/pass_profile.h"
+#include "ir/visitor.h"
+
+namespace Test {
+
+namespace {
+
+// a balanced tree of Adds over the constants first .. first + 2^depth - 1
+const IR::Expression *makeSum(int depth, int first = 0) {
+    if (depth == 0) return new IR::Constant(first);
+    return new IR::Add(makeSum(depth - 1, first),
+                       makeSum(depth - 1, first + (1 << (depth - 1))));
+}
+
+/// Replaces the constant @from with @to, and prunes (so doesn't change) any Sub
+class Replace : public Transform {
+    int from, to;
+ public:
+    Replace(int from, int to, bool cow) : from(from), to(to) { cloneOnWrite = cow; }
+    const IR::Node *preorder(IR::Sub *s) override { prune(); return s; }
+    const IR::Node *postorder(IR::Constant *c) override {
+        if (c->value == from) return new IR::Constant(to);
+        return c; }
+};
+
+class ReplaceModifier : public Modifier {
+    int from, to;
+ public:
+    ReplaceModifier(int from, int to, bool cow) : from(from), to(to) { cloneOnWrite = cow; }
+    void postorder(IR::Constant *c) override {
+        if (c->value == from) c->value = to; }
+};
+
+struct RemoveConstant : public Transform {
+    int value;
+    explicit RemoveConstant(int value) : value(value) { cloneOnWrite = true; }
+    const IR::Node *postorder(IR::Constant *c) override {
+        return c->value == value ? nullptr : c; }
+};
+
+struct Counts {
+    uint64_t cloned, avoided;
+    template<class F> explicit Counts(F fn) {
+        PassProfile::enabled = true;
+        uint64_t c = PassProfile::nodesCloned, a = PassProfile::clonesAvoided;
+        fn();
+        cloned = PassProfile::nodesCloned - c;
+        avoided = PassProfile::clonesAvoided - a;
+        PassProfile::enabled = false; }
+};
+
+}  // namespace
+
+TEST(CloneOnWrite, Transform) {
+    const IR::Expression *expr = makeSum(6);
+    const IR::Node *classic = nullptr, *cow = nullptr;
+    Counts classic_counts([&]() { classic = expr->apply(Replace(17, 100, false)); });
+    Counts cow_counts([&]() { cow = expr->apply(Replace(17, 100, true)); });
+
+    EXPECT_TRUE(classic->equiv(*cow));
+    EXPECT_NE(expr, cow);
+    // unchanged subtrees are shared with the original
+    EXPECT_EQ(expr->to<IR::Add>()->right, cow->to<IR::Add>()->right);
+    EXPECT_EQ(classic_counts.avoided, 0U);
+    EXPECT_GT(cow_counts.avoided, 0U);
+    // only the constants (which have a postorder) and the path to the change are cloned
+    EXPECT_LT(cow_counts.cloned, classic_counts.cloned / 2);
+
+    // nothing changes if the constant is under a pruned Sub
+    const IR::Expression *sub = new IR::Sub(makeSum(2), new IR::Constant(17));
+    EXPECT_EQ(sub->apply(Replace(17, 100, true)), sub);
+    expr = new IR::Add(sub, new IR::Constant(17));
+    cow = expr->apply(Replace(17, 100, true));
+    EXPECT_EQ(cow->to<IR::Add>()->left, sub);
+    EXPECT_EQ(cow->to<IR::Add>()->right->to<IR::Constant>()->value, 100);
+}
+
+TEST(CloneOnWrite, Modifier) {
+    const IR::Expression *expr = makeSum(5);
+    const IR::Node *classic = expr->apply(ReplaceModifier(3, 42, false));
+    const IR::Node *cow = expr->apply(ReplaceModifier(3, 42, true));
+    EXPECT_TRUE(classic->equiv(*cow));
+    EXPECT_EQ(expr->to<IR::Add>()->right, cow->to<IR::Add>()->right);
+    EXPECT_NE(expr->to<IR::Add>()->left, cow->to<IR::Add>()->left);
+}
+
+TEST(CloneOnWrite, VectorElements) {
+    auto *vec = new IR::Vector<IR::Expression>();
+    for (int i = 0; i < 4; ++i) {
+        vec->push_back(new IR::Neg(new IR::Constant(10 + i)));
+        vec->push_back(new IR::Constant(i)); }
+
+    auto *result = vec->apply(RemoveConstant(2))->to<IR::Vector<IR::Expression>>();
+    ASSERT_NE(result, nullptr);
+    ASSERT_EQ(result->size(), 7U);
+    EXPECT_EQ(result->at(4), vec->at(4));
+    EXPECT_EQ(result->at(5), vec->at(6));
+    EXPECT_EQ(result->at(6), vec->at(7));
+    EXPECT_EQ(vec->apply(RemoveConstant(7)), vec);
+}
+
+TEST(CloneOnWrite, StrengthReduction) {
+    // (x.f + 0) * 1 + (y.g & z.h), where only the left operand can be simplified
+    auto *left = new IR::Mul(new IR::Add(new IR::Member(new IR::PathExpression("x"), "f"),
+                                         new IR::Constant(0)),
+                             new IR::Constant(1));
+    auto *right = new IR::BAnd(new IR::Member(new IR::PathExpression("y"), "g"),
+                               new IR::Member(new IR::PathExpression("z"), "h"));
+    const IR::Expression *expr = new IR::Equ(new IR::Add(left, right), right);
+
+    const IR::Node *result = nullptr;
+    Counts counts([&]() { result = expr->apply(P4::DoStrengthReduction()); });
+    auto *sum = result->to<IR::Equ>()->left->to<IR::Add>();
+    ASSERT_NE(sum, nullptr);
+    EXPECT_EQ(sum->left, left->left->to<IR::Add>()->left);
+    EXPECT_EQ(sum->right, right);
+    EXPECT_EQ(result->to<IR::Equ>()->right, right);
+    EXPECT_GT(counts.avoided, 0U);
+    // there is nothing left to simplify, so a second application returns the same tree
+    EXPECT_EQ(result->apply(P4::DoStrengthReduction()), result);
+}
+
+// Times a Transform that changes a single leaf with and without cloneOnWrite.
+TEST(CloneOnWrite, DISABLED_Benchmark) {
+    const IR::Expression *expr = makeSum(13);
+    const int passes = 10;
+    auto time_usec = [&](bool cow) {
+        auto start = std::chrono::steady_clock::now();
+        for (int p = 0; p < passes; ++p) expr->apply(Replace(5, 6, cow));
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::micro>(end - start).count() / passes; };
+    double classic = time_usec(false);
+    double cow = time_usec(true);
+    Counts counts([&]() { expr->apply(Replace(5, 6, true)); });
+    RecordProperty("clone_every_node_usec", static_cast<int>(classic));
+    RecordProperty("clone_on_write_usec", static_cast<int>(cow));
+    RecordProperty("nodes_cloned", static_cast<int>(counts.cloned));
+    RecordProperty("clones_avoided", static_cast<int>(counts.avoided));
+}
+
+}  // namespace Test
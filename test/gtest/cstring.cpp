@@ -14,8 +14,12 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <chrono>
+#include <string>
+#include <vector>
 #include "gtest/gtest.h"
 #include "lib/cstring.h"
+#include "lib/thread_pool.h"
 
 namespace Test {
 
@@ -110,4 +114,56 @@ TEST(cstring, replace) {
     EXPECT_EQ(c.replace("i", ""), "Orgnal");
 }
 
+TEST(cstring, interning) {
+    std::vector<cstring> names;
+    for (int i = 0; i < 10000; ++i)
+        names.push_back(cstring("intern_" + std::to_string(i)));
+    for (int i = 0; i < 10000; ++i) {
+        std::string name = "intern_" + std::to_string(i);
+        EXPECT_EQ(cstring(name).c_str(), names[i].c_str());
+        EXPECT_EQ(cstring(name.c_str()).c_str(), names[i].c_str()); }
+
+    char *owned = new char[8];
+    strcpy(owned, "intern_7");  // NOLINT
+    EXPECT_EQ(cstring::own(owned, 8).c_str(), names[7].c_str());
+    EXPECT_EQ(cstring::literal("intern_42").c_str(), names[42].c_str());
+
+    size_t count;
+    EXPECT_GT(cstring::cache_size(count), 10000U * 8);
+    EXPECT_GE(count, 10000U);
+}
+
+// Interns strings from 1 to 32 threads; half the strings are shared by all the
+// threads, half are private to each.  Without MULTITHREAD all the work runs on
+// the calling thread.
+TEST(cstring, intern_benchmark) {
+    const int per_thread = 20000;
+    std::vector<std::string> shared;
+    for (int i = 0; i < per_thread; ++i)
+        shared.push_back("shared_name_" + std::to_string(i));
+    std::vector<const char *> reference(per_thread);
+    for (int i = 0; i < per_thread; ++i)
+        reference[i] = cstring(shared[i]).c_str();
+
+    for (unsigned threads = 1; threads <= 32; threads *= 2) {
+        std::vector<std::vector<std::string>> own(threads);
+        for (unsigned t = 0; t < threads; ++t)
+            for (int i = 0; i < per_thread; ++i)
+                own[t].push_back("thread_" + std::to_string(threads) + "_" +
+                                 std::to_string(t) + "_" + std::to_string(i));
+        std::vector<int> mismatches(threads);
+        Util::setParallelThreads(threads);
+        auto start = std::chrono::steady_clock::now();
+        Util::parallel_for(threads, [&](size_t t) {
+            for (int i = 0; i < per_thread; ++i) {
+                if (cstring(shared[i]).c_str() != reference[i]) ++mismatches[t];
+                cstring name(own[t][i]); } });
+        auto end = std::chrono::steady_clock::now();
+        double usec = std::chrono::duration<double, std::micro>(end - start).count();
+        for (auto m : mismatches) EXPECT_EQ(m, 0);
+        std::cout << threads << " threads: " << 2.0 * per_thread * threads / usec
+                  << " M interns/sec" << std::endl; }
+    Util::setParallelThreads(0);
+}
+
 }  // namespace Test
@@ -0,0 +1,179 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/def_use.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "frontends/p4/typeMap.h"
+
+using namespace P4;
+
+namespace Test {
+
+class DefUseTest : public P4CTest { };
+
+namespace {
+
+/// The definitions computed for each parser and control of a program.
+struct ProgramDefinitions {
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    std::vector<AllDefinitions*> blocks;
+    double usec = 0;
+
+    ProgramDefinitions(const IR::P4Program* program, bool bitvecs) {
+        program->apply(TypeChecking(&refMap, &typeMap));
+        for (auto object : program->objects) {
+            if (!object->is<IR::P4Parser>() && !object->is<IR::P4Control>())
+                continue;
+            auto defs = new AllDefinitions(&refMap, &typeMap, bitvecs);
+            usec += time_usec([&]() { object->apply(ComputeWriteSet(defs)); });
+            blocks.push_back(defs);
+        }
+    }
+
+    /// Every definition as "point: location <= writers", in a canonical order.
+    std::multiset<std::string> describe() const {
+        std::multiset<std::string> result;
+        for (auto all : blocks) {
+            for (auto &at : *all) {
+                for (auto location : at.second->getLocations()) {
+                    std::set<std::string> writers;
+                    for (auto &point : *at.second->getPoints(location)) {
+                        std::stringstream writer;
+                        writer << point;
+                        writers.insert(writer.str());
+                    }
+                    std::stringstream line;
+                    line << at.first << ": " << location->name << " <=";
+                    for (auto &w : writers)
+                        line << " " << w;
+                    result.insert(line.str());
+                }
+            }
+        }
+        return result;
+    }
+};
+
+/// A control which merges the definitions of many fields at many joins.
+std::string largeControl(int fields, int statements) {
+    std::stringstream source;
+    source << "struct m_t {\n";
+    for (int f = 0; f < fields; ++f)
+        source << "    bit<8> f" << f << ";\n";
+    source << "}\n"
+              "control c(inout m_t m) {\n"
+              "    apply {\n";
+    for (int s = 0; s < statements; ++s)
+        source << "        if (m.f" << s % fields << " == " << s % 256 << ") {\n"
+                  "            m.f" << (s * 7) % fields << " = m.f" << (s * 3) % fields << ";\n"
+                  "        } else if (m.f" << (s + 1) % fields << " != 0) {\n"
+                  "            return;\n"
+                  "        }\n";
+    source << "    }\n"
+              "}\n"
+              "control c_t(inout m_t m);\n"
+              "package top(c_t c);\n"
+              "top(c()) main;\n";
+    return P4_SOURCE(P4Headers::CORE, source.str().c_str());
+}
+
+}  // namespace
+
+TEST_F(DefUseTest, same_results) {
+    auto test = FrontendTestCase::create(P4_SOURCE(P4Headers::V1MODEL, R"(
+        header h_t { bit<8> a; bit<8> b; }
+        struct headers_t { h_t[4] stack; h_t h; }
+        struct meta_t { bit<8> x; bit<8> y; }
+        parser p(packet_in pkt, out headers_t hdr, inout meta_t meta,
+                 inout standard_metadata_t sm) {
+            state start {
+                pkt.extract(hdr.stack.next);
+                transition select(hdr.stack.last.a) {
+                    0: start;
+                    default: accept;
+                }
+            }
+        }
+        control c(inout headers_t hdr, inout meta_t meta, inout standard_metadata_t sm) {
+            action set(bit<8> v) { meta.x = v; }
+            action drop() { mark_to_drop(sm); exit; }
+            table t {
+                key = { hdr.h.a : exact; }
+                actions = { set; drop; NoAction; }
+            }
+            apply {
+                bit<8> tmp;
+                if (hdr.h.isValid()) {
+                    tmp = hdr.h.a;
+                    hdr.h.setInvalid();
+                } else {
+                    tmp = meta.y;
+                }
+                switch (t.apply().action_run) {
+                    set: { meta.y = tmp; }
+                    drop: { return; }
+                }
+                hdr.stack[1].b = meta.x + tmp;
+            }
+        }
+        parser p_t(packet_in pkt, out headers_t hdr, inout meta_t meta,
+                   inout standard_metadata_t sm);
+        control c_t(inout headers_t hdr, inout meta_t meta, inout standard_metadata_t sm);
+        package top(p_t p, c_t c);
+        top(p(), c()) main;
+    )"));
+    ASSERT_TRUE(test);
+    ProgramDefinitions maps(test->program, false);
+    ProgramDefinitions bits(test->program, true);
+    EXPECT_FALSE(maps.describe().empty());
+    EXPECT_EQ(maps.describe(), bits.describe());
+}
+
+// Compares both representations on a large synthetic control and on the
+// largest programs of the testdata corpus.
+TEST_F(DefUseTest, benchmark) {
+    std::vector<std::pair<std::string, std::string>> programs = {
+        { "large control", largeControl(64, 300) } };
+    auto samples = readSamples("testdata/p4_16_samples", 10000);
+    std::sort(samples.begin(), samples.end(), [](const std::pair<std::string, std::string>& a,
+                                                 const std::pair<std::string, std::string>& b) {
+        return a.second.size() > b.second.size(); });
+    if (samples.size() > 10)
+        samples.resize(10);
+    programs.insert(programs.end(), samples.begin(), samples.end());
+
+    for (auto &program : programs) {
+        AutoCompileContext context(new GTestContext(GTestContext::get()));
+        auto test = FrontendTestCase::create(program.second);
+        if (!test) continue;
+        ProgramDefinitions maps(test->program, false);
+        ProgramDefinitions bits(test->program, true);
+        EXPECT_EQ(maps.describe(), bits.describe()) << program.first;
+        std::cout << program.first << ": maps " << maps.usec << " usec, bit vectors "
+                  << bits.usec << " usec" << std::endl;
+    }
+}
+
+}  // namespace Test
@@ -0,0 +1,135 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <unordered_map>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "ir/visitor.h"
+#include "lib/flat_ptr_map.h"
+
+namespace Test {
+
+TEST(FlatPtrMap, InsertFindErase) {
+    std::vector<int> keys(1000);
+    flat_ptr_map<const int *, int> m;
+
+    EXPECT_TRUE(m.empty());
+    for (int i = 0; i < 1000; ++i) {
+        auto rv = m.emplace(&keys[i], i);
+        EXPECT_TRUE(rv.second);
+        EXPECT_EQ(*rv.first, i); }
+    EXPECT_EQ(m.size(), 1000U);
+
+    auto rv = m.emplace(&keys[10], 42);
+    EXPECT_FALSE(rv.second);
+    EXPECT_EQ(*rv.first, 10);
+
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_NE(m.find(&keys[i]), nullptr);
+        EXPECT_EQ(*m.find(&keys[i]), i); }
+
+    m.erase_if([](const int *, int v) { return v % 2 == 0; });
+    EXPECT_EQ(m.size(), 500U);
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_EQ(m.count(&keys[i]), size_t(i % 2));
+
+    EXPECT_TRUE(m.erase(&keys[1]));
+    EXPECT_FALSE(m.erase(&keys[1]));
+    EXPECT_EQ(m.size(), 499U);
+
+    m.clear();
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(m.find(&keys[3]), nullptr);
+    EXPECT_TRUE(m.emplace(&keys[3], 3).second);
+}
+
+TEST(FlatPtrMap, StableValues) {
+    // values must not move when the table grows, as the visitors hold on to
+    // pointers into their visited tables while visiting children
+    std::vector<int> keys(10000);
+    flat_ptr_map<const int *, int> m;
+    int *first = m.emplace(&keys[0], 0).first;
+    for (int i = 1; i < 10000; ++i)
+        m.emplace(&keys[i], i);
+    EXPECT_EQ(first, m.find(&keys[0]));
+    EXPECT_EQ(*first, 0);
+}
+
+TEST(FlatPtrMap, ReuseErased) {
+    // erasing and inserting keys, as TypeMap invalidation does, must not grow the map
+    std::vector<int> keys(5000);
+    flat_ptr_map<const int *, int> m;
+    size_t memory = 0;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 5000; ++i)
+            EXPECT_TRUE(m.emplace(&keys[(i + round) % 5000], i).second);
+        if (round == 1)
+            memory = m.memory();
+        else if (round > 1)
+            EXPECT_EQ(m.memory(), memory);
+        for (int i = 0; i < 5000; i += 2)
+            EXPECT_TRUE(m.erase(&keys[i]));
+        m.erase_if([](const int *, int) { return true; });
+        EXPECT_TRUE(m.empty()); }
+}
+
+// Compares the visited-table access pattern of an Inspector pass with the previous
+// std::unordered_map representation and times complete traversals.  The times
+// are recorded as test properties (see --gtest_output).
+TEST(FlatPtrMap, DISABLED_VisitorBenchmark) {
+    const IR::Expression *expr = makeExpr(13);
+    std::vector<const IR::Node *> nodes;
+    forAllMatching<IR::Node>(expr, [&](const IR::Node *n) { nodes.push_back(n); });
+
+    struct info_t { bool done, visitOnce; };
+    const int passes = 10;
+    size_t count = 0;
+    double unordered = time_usec([&]() {
+        for (int p = 0; p < passes; ++p) {
+            auto *visited = new std::unordered_map<const IR::Node *, info_t>();
+            for (auto *n : nodes) visited->emplace(n, info_t{false, true});
+            for (auto *n : nodes) count += visited->find(n)->second.visitOnce;
+            delete visited; } });
+    flat_ptr_map<const IR::Node *, info_t> visited;
+    double flat = time_usec([&]() {
+        for (int p = 0; p < passes; ++p) {
+            for (auto *n : nodes) visited.emplace(n, info_t{false, true});
+            for (auto *n : nodes) count += visited.find(n)->visitOnce;
+            visited.clear(); } });
+    EXPECT_EQ(count, 2 * passes * nodes.size());
+
+    struct CountNodes : public Inspector {
+        size_t nodes = 0;
+        bool preorder(const IR::Node *) override { ++nodes; return true; }
+    };
+    struct Increment : public Transform {
+        const IR::Node *postorder(IR::Constant *c) override {
+            return new IR::Constant(c->value + 1); }
+    };
+    double inspect = time_usec([&]() {
+        for (int p = 0; p < passes; ++p) expr->apply(CountNodes()); });
+    double transform = time_usec([&]() {
+        for (int p = 0; p < passes; ++p) expr->apply(Increment()); });
+
+    RecordProperty("nodes", static_cast<int>(nodes.size()));
+    RecordProperty("unordered_map_usec", std::to_string(unordered / passes));
+    RecordProperty("flat_ptr_map_usec", std::to_string(flat / passes));
+    RecordProperty("inspector_usec", std::to_string(inspect / passes));
+    RecordProperty("transform_usec", std::to_string(transform / passes));
+}
+
+}  // namespace Test
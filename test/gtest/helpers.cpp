@@ -14,6 +14,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <sstream>
@@ -174,4 +177,54 @@ FrontendTestCase::create(const std::string& source,
     return FrontendTestCase{program};
 }
 
+const IR::Expression *makeExpr(int depth, int value, const IR::Type *type) {
+    if (depth == 0)
+        return type ? new IR::Constant(type, value) : new IR::Constant(value);
+    return new IR::Add(makeExpr(depth - 1, value, type), makeExpr(depth - 1, value + 1, type));
+}
+
+const IR::P4Program *makeProgram(int objects, int depth) {
+    IR::Vector<IR::Node> decls;
+    for (int i = 0; i < objects; ++i)
+        decls.push_back(new IR::Declaration_Constant(IR::ID("c" + std::to_string(i)),
+                                                     IR::Type_Bits::get(32), makeExpr(depth, i)));
+    return new IR::P4Program(decls);
+}
+
+std::string sourcePath(const char *path) {
+    std::string parent = std::string("../") + path;
+    if (access(path, F_OK) != 0 && access(parent.c_str(), F_OK) == 0)
+        return parent;
+    return path;
+}
+
+std::vector<std::pair<std::string, std::string>> readSamples(const char *samples, size_t max) {
+    std::string dir = sourcePath(samples);
+    std::vector<std::string> files;
+    if (DIR *d = opendir(dir.c_str())) {
+        while (auto *e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, ".p4") == 0)
+                files.push_back(name); }
+        closedir(d); }
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::pair<std::string, std::string>> rv;
+    for (auto &name : files) {
+        std::ifstream in(dir + "/" + name);
+        std::stringstream source;
+        source << P4CTestEnvironment::get()->coreP4() << P4CTestEnvironment::get()->v1Model()
+               << "#line 1 \"" << name << "\"" << std::endl;
+        bool ok = true;
+        for (std::string line; ok && std::getline(in, line); ) {
+            if (line.compare(0, 1, "#") == 0) {
+                if (line != "#include <core.p4>" && line != "#include <v1model.p4>") ok = false;
+                line.clear(); }
+            source << line << std::endl; }
+        if (!ok) continue;
+        rv.emplace_back(name, source.str());
+        if (rv.size() >= max) break; }
+    return rv;
+}
+
 }  // namespace Test
@@ -18,14 +18,19 @@ limitations under the License.
 #define TEST_GTEST_HELPERS_H_
 
 #include <boost/optional.hpp>
+#include <chrono>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "frontends/common/options.h"
 #include "frontends/p4/parseAnnotations.h"
 #include "gtest/gtest.h"
 
 namespace IR {
+class Expression;
 class P4Program;
+class Type;
 }  // namespace IR
 
 /// Specifies which standard headers should be included by a GTest.
@@ -124,6 +129,31 @@ struct FrontendTestCase {
     const IR::P4Program* program;
 };
 
+/// @return a balanced tree of Adds @depth levels deep, whose leaves are the
+/// constants @value, @value + 1, ... (of @type, if given).
+const IR::Expression *makeExpr(int depth, int value = 0, const IR::Type *type = nullptr);
+
+/// @return a program declaring the bit<32> constants c0, c1, ... c<@objects - 1>,
+/// where ci is initialized with makeExpr(@depth, i).
+const IR::P4Program *makeProgram(int objects, int depth = 0);
+
+/// @return @path if it exists; otherwise @path in the source tree, when the tests
+/// run in a build directory inside it (as they do under ctest).
+std::string sourcePath(const char *path);
+
+/// Reads (at most @max of) the programs in the testdata directory @dir which only
+/// need the headers the test environment provides, with those headers prepended.
+/// @return the name and source of each program.
+std::vector<std::pair<std::string, std::string>> readSamples(const char *dir, size_t max);
+
+/// @return the time it takes to call @fn, in microseconds.
+template<class F> double time_usec(F fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
 }  // namespace Test
 
 #endif /* TEST_GTEST_HELPERS_H_ */
@@ -0,0 +1,135 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "ir/ir_binary.h"
+#include "ir/json_loader.h"
+
+namespace Test {
+
+class BinaryIRTest : public P4CTest { };
+
+namespace {
+
+/// A program with a shared subexpression in every declaration, some source
+/// positions, and constants too big for 32 bits.
+const IR::P4Program *makeLocatedProgram(int objects, int depth) {
+    auto *sources = new Util::InputSources;
+    sources->mapLine("test.p4", 1);
+    for (int i = 0; i < objects; ++i)
+        sources->appendText(("const bit<32> c" + std::to_string(i) + " = ...;\n").c_str());
+    sources->seal();
+
+    IR::Vector<IR::Node> decls;
+    auto *shared = new IR::Constant(IR::Type_Bits::get(64), mpz_class("12345678901234567890"));
+    for (int i = 0; i < objects; ++i) {
+        auto *init = new IR::Sub(makeExpr(depth, i, IR::Type_Bits::get(16)), shared);
+        init->srcInfo = Util::SourceInfo(sources, Util::SourcePosition(i + 1, 14),
+                                         Util::SourcePosition(i + 1, 17));
+        decls.push_back(new IR::Declaration_Constant(IR::ID("c" + std::to_string(i)),
+                                                     IR::Type_Bits::get(32), init)); }
+    return new IR::P4Program(decls);
+}
+
+std::string jsonText(const IR::Node *node, bool sourceInfo = false) {
+    std::stringstream out;
+    JSONGenerator(out, sourceInfo) << node;
+    return out.str();
+}
+
+std::string toBinary(const IR::Node *node, bool sourceInfo = false) {
+    std::stringstream out;
+    BinaryIR::write(out, node, sourceInfo);
+    return out.str();
+}
+
+}  // namespace
+
+TEST_F(BinaryIRTest, round_trip) {
+    auto *program = makeLocatedProgram(10, 3);
+    BinaryIR::File file(toBinary(program, true));
+    ASSERT_FALSE(file.error());
+    auto *loaded = BinaryIR::load(file);
+    ASSERT_NE(loaded, nullptr);
+    ASSERT_TRUE(loaded->is<IR::P4Program>());
+
+    // the same JSON, so the same node ids, types and values
+    EXPECT_EQ(jsonText(loaded), jsonText(program));
+    EXPECT_TRUE(loaded->equiv(*program));
+
+    // shared nodes are still shared
+    auto *objects = &loaded->to<IR::P4Program>()->objects;
+    auto *c0 = objects->at(0)->to<IR::Declaration_Constant>()->initializer->to<IR::Sub>();
+    auto *c1 = objects->at(1)->to<IR::Declaration_Constant>()->initializer->to<IR::Sub>();
+    ASSERT_NE(c0, nullptr);
+    ASSERT_NE(c1, nullptr);
+    EXPECT_EQ(c0->right, c1->right);
+    EXPECT_EQ(c0->right->to<IR::Constant>()->value, mpz_class("12345678901234567890"));
+    EXPECT_EQ(c1->srcInfo.filename, "test.p4");
+    EXPECT_EQ(c1->srcInfo.line, c0->srcInfo.line + 1);
+    EXPECT_EQ(c1->srcInfo.srcBrief, "c1 ");
+}
+
+TEST_F(BinaryIRTest, mapped_file) {
+    auto *program = makeLocatedProgram(5, 2);
+    const char *name = "ir_binary_test.bin";
+    {
+        std::ofstream out(name, std::ios::binary);
+        BinaryIR::write(out, program);
+    }
+    BinaryIR::File file(name);
+    ASSERT_FALSE(file.error());
+    auto *loaded = BinaryIR::load(file);
+    std::remove(name);
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(jsonText(loaded), jsonText(program));
+
+    BinaryIR::File missing("no/such/file.bin");
+    EXPECT_TRUE(missing.error());
+    BinaryIR::File json(jsonText(program));
+    EXPECT_TRUE(json.error());
+    EXPECT_EQ(BinaryIR::load(json), nullptr);
+    std::string truncated = toBinary(program);
+    truncated.resize(truncated.size() / 2);
+    EXPECT_TRUE(BinaryIR::File(truncated).error());
+}
+
+// Compares the time to reload a program from JSON and from the binary form.
+TEST_F(BinaryIRTest, load_benchmark) {
+    auto *program = makeLocatedProgram(200, 6);
+    std::string json = jsonText(program, true), binary = toBinary(program, true);
+    const IR::Node *from_json = nullptr, *from_binary = nullptr;
+    double json_usec = time_usec([&]() {
+        std::stringstream in(json);
+        JSONLoader(in) >> from_json; });
+    double binary_usec = time_usec([&]() {
+        BinaryIR::File file(binary);
+        from_binary = BinaryIR::load(file); });
+    ASSERT_NE(from_json, nullptr);
+    ASSERT_NE(from_binary, nullptr);
+    EXPECT_TRUE(from_json->equiv(*from_binary));
+    EXPECT_LT(binary.size(), json.size());
+    std::cout << "JSON " << json.size() << " bytes, loaded in " << json_usec << " usec; binary "
+              << binary.size() << " bytes, loaded in " << binary_usec << " usec ("
+              << json_usec / binary_usec << "x)" << std::endl;
+}
+
+}  // namespace Test
@@ -0,0 +1,96 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <chrono>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "frontends/common/parseInput.h"
+#include "ir/ir.h"
+#include "ir/json_loader.h"
+
+namespace Test {
+
+class JSONGeneratorTest : public P4CTest { };
+
+namespace {
+
+std::string toJSON(const IR::Node *node, bool compact, size_t bufferSize = 1 << 20) {
+    std::stringstream out;
+    JSONGenerator(out, false, compact, bufferSize) << node << std::endl;
+    return out.str();
+}
+
+}  // namespace
+
+TEST_F(JSONGeneratorTest, compact) {
+    auto *program = makeProgram(10);
+    std::string pretty = toJSON(program, false);
+    std::string compact = toJSON(program, true);
+    EXPECT_NE(pretty.find("\n  "), std::string::npos);
+    EXPECT_EQ(compact.find('\n'), compact.size() - 1);
+    EXPECT_LT(compact.size(), pretty.size());
+
+    // both load back to the same program
+    const IR::Node *loaded = nullptr;
+    std::stringstream in(compact);
+    JSONLoader(in) >> loaded;
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(toJSON(loaded, false), pretty);
+}
+
+TEST_F(JSONGeneratorTest, small_buffer) {
+    // output longer than the buffer is written out in pieces, with the same result
+    auto *program = makeProgram(50);
+    EXPECT_EQ(toJSON(program, false, 64), toJSON(program, false));
+    EXPECT_EQ(toJSON(program, true, 1), toJSON(program, true));
+
+    // the stream has all the output of each completed <<
+    std::stringstream out;
+    JSONGenerator gen(out);
+    gen << program->objects.at(0);
+    EXPECT_EQ(out.str(), toJSON(program->objects.at(0), false).substr(0, out.str().size()));
+    EXPECT_EQ(out.str().back(), '}');
+}
+
+// Compares the size of the pretty-printed and compact output and the speed at
+// which each is written, for the IR of programs from the testdata corpus.
+TEST_F(JSONGeneratorTest, testdata_benchmark) {
+    auto samples = readSamples("testdata/p4_16_samples", 40);
+    size_t programs = 0, pretty_bytes = 0, compact_bytes = 0;
+    double pretty_usec = 0, compact_usec = 0;
+    for (auto &sample : samples) {
+        // a separate context for each program, so errors in one don't affect the others
+        AutoCompileContext context(new GTestContext(GTestContext::get()));
+        auto *program = P4::parseP4String(sample.second, CompilerOptions::FrontendVersion::P4_16);
+        if (!program || ::errorCount() > 0) continue;
+        ++programs;
+        for (bool compact : { false, true }) {
+            std::stringstream out;
+            auto start = std::chrono::steady_clock::now();
+            JSONGenerator(out, true, compact) << program << std::endl;
+            auto end = std::chrono::steady_clock::now();
+            double usec = std::chrono::duration<double, std::micro>(end - start).count();
+            (compact ? compact_bytes : pretty_bytes) += out.str().size();
+            (compact ? compact_usec : pretty_usec) += usec; } }
+    if (programs == 0) return;
+    EXPECT_LT(compact_bytes, pretty_bytes);
+    std::cout << programs << " programs: pretty " << pretty_bytes << " bytes, "
+              << pretty_bytes / pretty_usec << " MB/s; compact " << compact_bytes << " bytes, "
+              << compact_bytes / compact_usec << " MB/s" << std::endl;
+}
+
+}  // namespace Test
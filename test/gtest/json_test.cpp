@@ -14,10 +14,15 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <cstdio>
+#include <fstream>
+#include <limits>
 #include <sstream>
 
 #include "gtest/gtest.h"
+#include "helpers.h"
 #include "lib/json.h"
+#include "lib/stringify.h"
 
 namespace Util {
 
@@ -71,4 +76,166 @@ TEST(Util, Json) {
               obj->toString());
 }
 
+// Numbers of up to 64 bits are kept inline; larger ones in a big integer.
+TEST(Util, JsonNumbers) {
+    auto smallest = static_cast<long long>(1LL << 63);
+    auto largest = std::numeric_limits<unsigned long long>::max();
+    EXPECT_FALSE(JsonValue(smallest).isBig);
+    EXPECT_FALSE(JsonValue(mpz_class(-5)).isBig);
+    EXPECT_TRUE(JsonValue(largest).isBig);
+    EXPECT_TRUE(JsonValue(mpz_class("123456789012345678901234567890")).isBig);
+
+    EXPECT_EQ(getNumStringRepr(largest), JsonValue(largest).toString());
+    EXPECT_EQ("-5", JsonValue(mpz_class(-5)).toString());
+    EXPECT_EQ("123456789012345678901234567890",
+              JsonValue(mpz_class("123456789012345678901234567890")).toString());
+    EXPECT_EQ(JsonValue::makeValue(smallest), JsonValue(smallest).getValue());
+    EXPECT_EQ(JsonValue::makeValue(largest), JsonValue(largest).getValue());
+
+    EXPECT_TRUE(JsonValue(smallest) == JsonValue(JsonValue::makeValue(smallest)));
+    EXPECT_TRUE(JsonValue(largest) == JsonValue(JsonValue::makeValue(largest)));
+    EXPECT_TRUE(JsonValue(largest) == largest);
+    EXPECT_FALSE(JsonValue(-1) == largest);
+    EXPECT_TRUE(JsonValue(smallest) == smallest);
+    EXPECT_TRUE(JsonValue(1) == true);
+    EXPECT_TRUE(JsonValue(42) == mpz_class(42));
+    EXPECT_FALSE(JsonValue(42) == JsonValue("42"));
+
+    EXPECT_EQ(-7, JsonValue(-7).getInt());
+    EXPECT_THROW(JsonValue(1LL << 40).getInt(), std::logic_error);
+    EXPECT_THROW(JsonValue(largest).getInt(), std::logic_error);
+}
+
+namespace {
+
+std::string writeJson(const IJson* json) {
+    std::stringstream out;
+    JsonWriter writer(out);
+    writer.value(json);
+    EXPECT_TRUE(writer.done());
+    return out.str();
+}
+
+/// A tree shaped like the output of the BMv2 backends: objects with arrays
+/// of scalars, arrays of objects and arrays of arrays.
+JsonObject* bmv2Program(int actions, int entries) {
+    auto program = new JsonObject();
+    program->emplace("header_types", new JsonArray());
+    auto types = program->get("header_types")->to<JsonArray>();
+    auto type = new JsonObject();
+    type->emplace("name", "h_t");
+    type->emplace("id", 0);
+    type->emplace("fields", new JsonArray({
+        new JsonArray({ new JsonValue("a"), new JsonValue(8), new JsonValue(false) }),
+        new JsonArray({ new JsonValue("b"), new JsonValue(16), new JsonValue(false) }) }));
+    types->append(type);
+    program->emplace("errors", new JsonArray());
+    auto acts = new JsonArray();
+    for (int a = 0; a < actions; ++a) {
+        auto action = new JsonObject();
+        action->emplace("name", cstring("a") + Util::toString(a));
+        action->emplace("id", a);
+        action->emplace("runtime_data", new JsonArray());
+        auto primitive = new JsonObject();
+        primitive->emplace("op", "assign");
+        auto parameters = new JsonArray();
+        auto field = new JsonObject();
+        field->emplace("type", "field");
+        field->emplace("value", new JsonArray({ new JsonValue("hdr"), new JsonValue("a") }));
+        parameters->append(field);
+        auto constant = new JsonObject();
+        constant->emplace("type", "hexstr");
+        constant->emplace("value", mpz_class("123456789012345678901234567890"));
+        parameters->append(constant);
+        primitive->emplace("parameters", parameters);
+        primitive->emplace("source_info", static_cast<IJson*>(nullptr));
+        action->emplace("primitives", new JsonArray({ primitive }));
+        acts->append(action);
+    }
+    program->emplace("actions", acts);
+    auto table = new JsonObject();
+    table->emplace("name", "t");
+    table->emplace("max_size", static_cast<unsigned long long>(1) << 40);
+    auto list = new JsonArray();
+    for (int e = 0; e < entries; ++e) {
+        auto entry = new JsonObject();
+        entry->emplace("match_key", new JsonArray({ new JsonValue(-e), new JsonValue(e) }));
+        entry->emplace("priority", e);
+        list->append(entry);
+    }
+    table->emplace("entries", list);
+    program->emplace("tables", new JsonArray({ table }));
+    program->emplace("program", "p.p4");
+    return program;
+}
+
+}  // namespace
+
+TEST(Util, JsonWriter) {
+    auto arr = new JsonArray();
+    EXPECT_EQ("[]", writeJson(arr));
+    arr->append(5);
+    arr->append("5");
+    arr->append(JsonValue::null);
+    EXPECT_EQ(arr->toString(), writeJson(arr));
+    arr->append(static_cast<IJson*>(nullptr));
+    EXPECT_EQ(arr->toString(), writeJson(arr));
+    auto arr1 = new JsonArray();
+    arr->append(arr1);
+    EXPECT_EQ(arr->toString(), writeJson(arr));
+    arr1->append(true);
+    arr1->append(new JsonObject());
+    EXPECT_EQ(arr->toString(), writeJson(arr));
+
+    auto obj = new JsonObject();
+    EXPECT_EQ(obj->toString(), writeJson(obj));
+    obj->emplace("x", "x");
+    obj->emplace("y", arr);
+    obj->emplace("z", static_cast<IJson*>(nullptr));
+    obj->emplace("big", mpz_class("-98765432109876543210"));
+    obj->emplace("small", static_cast<long long>(1LL << 63));
+    EXPECT_EQ(obj->toString(), writeJson(obj));
+
+    // Values written directly give the same text as the tree
+    std::stringstream out;
+    JsonWriter writer(out);
+    writer.beginObject();
+    writer.key("x").value("x");
+    writer.key("y").beginArray().value(5).value("5").null().value(static_cast<IJson*>(nullptr));
+    writer.beginArray().value(true).beginObject().endObject().endArray();
+    writer.endArray();
+    writer.key("z").null();
+    writer.key("big").value(mpz_class("-98765432109876543210"));
+    writer.key("small").value(static_cast<long long>(1LL << 63));
+    EXPECT_FALSE(writer.done());
+    writer.endObject();
+    EXPECT_TRUE(writer.done());
+    EXPECT_EQ(obj->toString(), out.str());
+
+    EXPECT_THROW(JsonWriter(out).beginArray().endObject(), std::logic_error);
+    EXPECT_THROW(JsonWriter(out).beginArray().key("x"), std::logic_error);
+}
+
+// The BMv2 backends serialize through JsonWriter; its output must be
+// identical to the one of serialize.
+TEST(Util, JsonWriterBMv2) {
+    auto program = bmv2Program(100, 100);
+    EXPECT_EQ(program->toString(), writeJson(program));
+}
+
+// Writes a large BMv2-like program to a file with both emitters.
+TEST(Util, JsonWriterBenchmark) {
+    auto program = bmv2Program(20000, 50000);
+    std::string file = "json_writer_benchmark.json";
+    double serializeUsec = ::Test::time_usec([&]() {
+        std::ofstream out(file);
+        program->serialize(out); });
+    double writerUsec = ::Test::time_usec([&]() {
+        std::ofstream out(file);
+        JsonWriter(out).value(program); });
+    std::remove(file.c_str());
+    std::cout << "serialize " << serializeUsec << " usec, JsonWriter " << writerUsec
+              << " usec" << std::endl;
+}
+
 }  // namespace Util
@@ -0,0 +1,221 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <random>
+#include <set>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "lib/node_map.h"
+
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "frontends/p4/typeMap.h"
+
+namespace Test {
+
+class NodeMapTest : public P4CTest { };
+
+namespace {
+
+std::vector<const IR::Constant *> makeConstants(int count) {
+    std::vector<const IR::Constant *> rv;
+    for (int i = 0; i < count; ++i)
+        rv.push_back(new IR::Constant(i));
+    return rv;
+}
+
+/// An allocator which keeps track of how many bytes are in use.
+template<class T> struct CountingAllocator {
+    typedef T value_type;
+    size_t *bytes;
+    explicit CountingAllocator(size_t *bytes) : bytes(bytes) {}
+    template<class U> CountingAllocator(const CountingAllocator<U> &a) : bytes(a.bytes) {}
+    T *allocate(size_t n) {
+        *bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n); }
+    void deallocate(T *p, size_t n) {
+        *bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n); }
+    template<class U> bool operator==(const CountingAllocator<U> &a) const {
+        return bytes == a.bytes; }
+    template<class U> bool operator!=(const CountingAllocator<U> &a) const {
+        return bytes != a.bytes; }
+};
+
+template<class K, class V> using counted_map =
+    std::map<K, V, std::less<K>, CountingAllocator<std::pair<const K, V>>>;
+template<class K> using counted_set = std::set<K, std::less<K>, CountingAllocator<K>>;
+
+/// The nodes of a program, as often as they are visited.
+class AllNodes : public Inspector {
+ public:
+    std::vector<const IR::Node *> nodes;
+    std::vector<const IR::Expression *> expressions;
+    std::vector<const IR::Path *> paths;
+    AllNodes() { visitDagOnce = false; }
+    bool preorder(const IR::Node *node) override {
+        nodes.push_back(node);
+        if (auto *e = node->to<IR::Expression>()) expressions.push_back(e);
+        if (auto *p = node->to<IR::Path>()) paths.push_back(p);
+        return true; }
+};
+
+}  // namespace
+
+TEST(node_map, insert_find_erase) {
+    auto keys = makeConstants(1000);
+    node_map<const IR::Node *, int> m;
+
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(m.find(keys[0]), nullptr);
+    for (int i = 0; i < 1000; ++i) {
+        auto rv = m.emplace(keys[i], i);
+        EXPECT_TRUE(rv.second);
+        EXPECT_EQ(*rv.first, i); }
+    EXPECT_EQ(m.size(), 1000U);
+
+    auto rv = m.emplace(keys[10], 42);
+    EXPECT_FALSE(rv.second);
+    EXPECT_EQ(*rv.first, 10);
+
+    for (int i = 0; i < 1000; i += 2)
+        EXPECT_TRUE(m.erase(keys[i]));
+    EXPECT_FALSE(m.erase(keys[0]));
+    EXPECT_EQ(m.size(), 500U);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(m.count(keys[i]), size_t(i % 2));
+        if (i % 2) {
+            EXPECT_EQ(*m.find(keys[i]), i); } }
+
+    size_t memory = m.memory();
+    m.clear();
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(m.memory(), memory);
+    EXPECT_EQ(m.find(keys[3]), nullptr);
+    EXPECT_TRUE(m.emplace(keys[3], 3).second);
+}
+
+// Nodes with the same id (as after loading a program from JSON) are still
+// different keys, and erasing from the middle of their run keeps the rest.
+TEST(node_map, same_ids) {
+    auto keys = makeConstants(100);
+    for (auto *key : keys)
+        const_cast<IR::Constant *>(key)->id = keys[0]->id;
+    node_set<const IR::Node *> s;
+    for (auto *key : keys)
+        EXPECT_TRUE(s.insert(key));
+    EXPECT_FALSE(s.insert(keys[50]));
+    for (int i = 0; i < 100; i += 3)
+        EXPECT_TRUE(s.erase(keys[i]));
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(s.count(keys[i]), size_t(i % 3 != 0)) << i;
+}
+
+TEST(node_map, random) {
+    auto keys = makeConstants(300);
+    std::mt19937 random(1);
+    std::map<const IR::Node *, int> expected;
+    node_map<const IR::Node *, int> m;
+    for (int op = 0; op < 20000; ++op) {
+        auto *key = keys[random() % keys.size()];
+        if (random() % 3 == 0) {
+            EXPECT_EQ(m.erase(key), expected.erase(key) > 0);
+        } else {
+            EXPECT_EQ(m.emplace(key, op).second, expected.emplace(key, op).second); } }
+
+    ASSERT_EQ(m.size(), expected.size());
+    size_t seen = 0;
+    m.for_each([&](const IR::Node *key, int value) {
+        ++seen;
+        EXPECT_EQ(expected.at(key), value); });
+    EXPECT_EQ(seen, expected.size());
+}
+
+// Compares the layout of the reference and type maps with the tree-based maps
+// they replace, replaying the lookups of a visit of each program of the
+// testdata corpus.
+TEST_F(NodeMapTest, testdata_benchmark) {
+    auto samples = readSamples("testdata/p4_16_samples", 100);
+    size_t programs = 0, lookups = 0, tree_bytes = 0, flat_bytes = 0;
+    double tree_usec = 0, flat_usec = 0;
+    const int rounds = 10;
+    for (auto &sample : samples) {
+        AutoCompileContext context(new GTestContext(GTestContext::get()));
+        auto *program = P4::parseP4String(sample.second, CompilerOptions::FrontendVersion::P4_16);
+        if (!program || ::errorCount() > 0) continue;
+        P4::ReferenceMap refMap;
+        P4::TypeMap typeMap;
+        PassManager typeCheck = {
+            new P4::ResolveReferences(&refMap),
+            new P4::TypeInference(&refMap, &typeMap, false),
+            new P4::TypeChecking(&refMap, &typeMap)
+        };
+        program = program->apply(typeCheck);
+        if (!program || ::errorCount() > 0) continue;
+        ++programs;
+
+        AllNodes all;
+        program->apply(all);
+        size_t bytes = 0;
+        counted_map<const IR::Node *, const IR::Type *> treeTypes{
+            CountingAllocator<const IR::Node *>(&bytes)};
+        counted_set<const IR::Expression *> treeLeftValues{
+            CountingAllocator<const IR::Expression *>(&bytes)};
+        counted_map<const IR::Path *, const IR::IDeclaration *> treeDecls{
+            CountingAllocator<const IR::Path *>(&bytes)};
+        node_map<const IR::Node *, const IR::Type *> flatTypes;
+        node_set<const IR::Expression *> flatLeftValues;
+        node_map<const IR::Path *, const IR::IDeclaration *> flatDecls;
+        for (auto *node : all.nodes) {
+            if (auto *type = typeMap.getType(node)) {
+                treeTypes.emplace(node, type);
+                flatTypes.emplace(node, type); } }
+        for (auto *e : all.expressions) {
+            if (typeMap.isLeftValue(e)) {
+                treeLeftValues.insert(e);
+                flatLeftValues.insert(e); } }
+        for (auto *path : all.paths) {
+            if (auto *decl = refMap.getDeclaration(path)) {
+                treeDecls.emplace(path, decl);
+                flatDecls.emplace(path, decl); } }
+        tree_bytes += bytes;
+        flat_bytes += flatTypes.memory() + flatLeftValues.memory() + flatDecls.memory();
+        lookups += rounds * (all.nodes.size() + all.expressions.size() + all.paths.size());
+
+        size_t tree_found = 0, flat_found = 0;
+        tree_usec += time_usec([&]() {
+            for (int r = 0; r < rounds; ++r) {
+                for (auto *node : all.nodes) tree_found += treeTypes.count(node);
+                for (auto *e : all.expressions) tree_found += treeLeftValues.count(e);
+                for (auto *path : all.paths) tree_found += treeDecls.count(path); } });
+        flat_usec += time_usec([&]() {
+            for (int r = 0; r < rounds; ++r) {
+                for (auto *node : all.nodes) flat_found += flatTypes.count(node);
+                for (auto *e : all.expressions) flat_found += flatLeftValues.count(e);
+                for (auto *path : all.paths) flat_found += flatDecls.count(path); } });
+        EXPECT_EQ(tree_found, flat_found) << sample.first;
+    }
+    if (programs == 0) return;
+    std::cout << programs << " programs, " << lookups << " lookups: std::map " << tree_bytes
+              << " bytes, " << tree_usec << " usec; node_map " << flat_bytes << " bytes, "
+              << flat_usec << " usec" << std::endl;
+}
+
+}  // namespace Test
@@ -0,0 +1,175 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "frontends/common/parseInput.h"
+#include "frontends/p4/checkNamedArgs.h"
+#include "frontends/p4/frontend.h"
+#include "ir/ir.h"
+#include "ir/visitor.h"
+#include "lib/thread_pool.h"
+
+namespace Test {
+
+namespace {
+
+/// Records the constants and declarations seen, in visit order
+class CollectConstants : public Inspector {
+ public:
+    std::vector<cstring> decls;
+    mpz_class sum = 0;
+    size_t programs = 0;
+    bool contextOk = true;
+
+    explicit CollectConstants(bool parallel) { visitObjectsInParallel = parallel; }
+    CollectConstants *clone() const override {
+        auto *rv = new CollectConstants(*this);
+        rv->decls.clear();
+        rv->sum = 0;
+        return rv; }
+    void parallel_merge(Inspector &other) override {
+        auto &o = dynamic_cast<CollectConstants &>(other);
+        decls.insert(decls.end(), o.decls.begin(), o.decls.end());
+        sum += o.sum;
+        contextOk &= o.contextOk; }
+
+    void postorder(const IR::Constant *c) override {
+        if (!findContext<IR::Declaration_Constant>() || !findContext<IR::P4Program>())
+            contextOk = false;
+        sum += c->value; }
+    void postorder(const IR::Declaration_Constant *d) override {
+        if (getContext()->child_index != atoi(d->name.name.c_str() + 1))
+            contextOk = false;
+        decls.push_back(d->name); }
+    void postorder(const IR::P4Program *) override { ++programs; }
+};
+
+}  // namespace
+
+TEST(ParallelVisit, SameResultAsSequential) {
+    auto *program = makeProgram(50, 6);
+
+    CollectConstants sequential(false);
+    program->apply(sequential);
+    CollectConstants parallel(true);
+    Util::setParallelThreads(4);
+    program->apply(parallel);
+    Util::setParallelThreads(0);
+
+    EXPECT_EQ(sequential.decls.size(), 50U);
+    EXPECT_EQ(sequential.decls, parallel.decls);
+    EXPECT_EQ(sequential.sum, parallel.sum);
+    EXPECT_EQ(parallel.programs, 1U);
+    EXPECT_TRUE(sequential.contextOk);
+    EXPECT_TRUE(parallel.contextOk);
+}
+
+TEST(ParallelVisit, ParallelFor) {
+    std::vector<int> out(1000);
+    Util::setParallelThreads(4);
+    Util::parallel_for(out.size(), [&](size_t i) { out[i] = i * 2; });
+    for (size_t i = 0; i < out.size(); ++i)
+        EXPECT_EQ(out[i], int(i * 2));
+
+    // the exception from the lowest index is the one that is reported
+    try {
+        Util::parallel_for(100, [](size_t i) {
+            if (i % 10 == 3)
+                throw std::runtime_error(std::to_string(i));
+        });
+        FAIL() << "expected an exception";
+    } catch (std::runtime_error &e) {
+        EXPECT_EQ(std::string(e.what()), "3");
+    }
+
+    // the pool is shared by calls with different numbers of threads
+    for (unsigned threads : { 2, 8, 3 }) {
+        Util::setParallelThreads(threads);
+        Util::parallel_for(out.size(), [&](size_t i) { out[i] = i * threads; });
+        for (size_t i = 0; i < out.size(); ++i)
+            EXPECT_EQ(out[i], int(i * threads)); }
+    Util::setParallelThreads(0);
+}
+
+namespace {
+
+/// @return the errors reported by CheckNamedArgs for @program, run on @threads threads.
+std::string checkNamedArgsErrors(const IR::P4Program *program, unsigned threads) {
+    AutoCompileContext context(new GTestContext(GTestContext::get()));
+    std::stringstream errors;
+    BaseCompileContext::get().errorReporter().setOutputStream(&errors);
+    BaseCompileContext::get().errorReporter().setMaxErrorCount(1000);
+    Util::setParallelThreads(threads);
+    program->apply(P4::CheckNamedArgs());
+    Util::setParallelThreads(0);
+    return errors.str();
+}
+
+}  // namespace
+
+TEST(ParallelVisit, CheckNamedArgs) {
+    // CheckNamedArgs visits the objects in parallel, and must report their
+    // errors in program order
+    std::string source;
+    for (int i = 0; i < 20; ++i) {
+        auto n = std::to_string(i);
+        source += "extern void f" + n + "(in bit<8> a, in bit<8> b);\n"
+                  "control c" + n + "() { apply { f" + n + "(a = 1, 2); } }\n"; }
+    auto *program = P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr);
+
+    auto sequential = checkNamedArgsErrors(program, 1);
+    EXPECT_EQ(sequential, checkNamedArgsErrors(program, 4));
+    size_t last = 0;
+    for (int i = 0; i < 20; ++i) {
+        auto at = sequential.find("f" + std::to_string(i) + "(a = 1, 2)");
+        ASSERT_NE(at, std::string::npos);
+        EXPECT_GE(at, last);
+        last = at; }
+}
+
+// Runs CheckNamedArgs, and the whole front end, over (the first 200 programs
+// of) the testdata corpus on one and on four threads.  The times are recorded
+// as test properties.
+TEST(ParallelVisit, DISABLED_FrontendBenchmark) {
+    auto samples = readSamples("testdata/p4_16_samples", 200);
+    const unsigned threads[] = { 1, 4 };
+    double check[2] = { 0, 0 }, frontend[2] = { 0, 0 };
+    int programs = 0;
+    for (auto &sample : samples) {
+        AutoCompileContext context(new GTestContext(GTestContext::get()));
+        BaseCompileContext::get().errorReporter().setOutputStream(new std::stringstream);
+        auto *program = P4::parseP4String(sample.second, CompilerOptions::FrontendVersion::P4_16);
+        if (!program || ::errorCount() > 0) continue;
+        ++programs;
+        // the runs alternate, so that both see the same state of the heap
+        for (int i = 0; i < 2; ++i) {
+            Util::setParallelThreads(threads[i]);
+            check[i] += time_usec([&]() { program->apply(P4::CheckNamedArgs()); });
+            CompilerOptions options;
+            options.langVersion = CompilerOptions::FrontendVersion::P4_16;
+            frontend[i] += time_usec([&]() { P4::FrontEnd().run(options, program); }); } }
+    Util::setParallelThreads(0);
+    RecordProperty("programs", programs);
+    for (int i = 0; i < 2; ++i) {
+        auto prefix = std::to_string(threads[i]) + "_threads_";
+        RecordProperty(prefix + "check_named_args_usec", std::to_string(check[i]));
+        RecordProperty(prefix + "frontend_usec", std::to_string(frontend[i])); }
+}
+
+}  // namespace Test
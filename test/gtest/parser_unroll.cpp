@@ -0,0 +1,224 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "frontends/p4/typeMap.h"
+#include "midend/parserUnroll.h"
+
+using namespace P4;
+
+namespace Test {
+
+class ParserUnrollTest : public P4CTest { };
+
+namespace {
+
+/// What the symbolic evaluation of all parsers of a program did.
+struct UnrollStatistics {
+    unsigned evaluated = 0;
+    unsigned shared = 0;
+    double usec = 0;
+
+    UnrollStatistics(const IR::P4Program* program, unsigned maxStates) {
+        ReferenceMap refMap;
+        TypeMap typeMap;
+        program->apply(TypeChecking(&refMap, &typeMap));
+        for (auto object : program->objects) {
+            auto parser = object->to<IR::P4Parser>();
+            if (parser == nullptr)
+                continue;
+            ParserStructure structure;
+            structure.setParser(parser);
+            parser->apply(AnalyzeParser(&refMap, &structure));
+            usec += time_usec([&]() {
+                structure.analyze(&refMap, &typeMap, false, maxStates); });
+            evaluated += structure.result->evaluated;
+            shared += structure.result->shared;
+        }
+    }
+};
+
+std::string parserPackage(const char* parserType) {
+    std::stringstream source;
+    source << "parser p_t(packet_in pkt, out " << parserType << " hdr);\n"
+              "package top(p_t p);\n"
+              "top(p()) main;\n";
+    return source.str();
+}
+
+/// A chain of selects whose two branches join again; every path through
+/// it reaches the last state with the same values.
+std::string diamondParser(int stages) {
+    std::stringstream source;
+    source << "header h_t { bit<8> tag; }\n"
+              "struct headers_t {\n";
+    for (int s = 0; s < stages; ++s)
+        source << "    h_t h" << s << ";\n";
+    source << "}\n"
+              "parser p(packet_in pkt, out headers_t hdr) {\n"
+              "    state start { transition s0; }\n";
+    for (int s = 0; s < stages; ++s)
+        source << "    state s" << s << " {\n"
+                  "        pkt.extract(hdr.h" << s << ");\n"
+                  "        transition select(hdr.h" << s << ".tag) {\n"
+                  "            0: a" << s << ";\n"
+                  "            default: b" << s << ";\n"
+                  "        }\n"
+                  "    }\n"
+                  "    state a" << s << " { transition s" << s + 1 << "; }\n"
+                  "    state b" << s << " { transition s" << s + 1 << "; }\n";
+    source << "    state s" << stages << " { transition accept; }\n"
+              "}\n" << parserPackage("headers_t");
+    return P4_SOURCE(P4Headers::CORE, source.str().c_str());
+}
+
+/// VLAN tags followed by an MPLS label stack followed by an inner Ethernet
+/// header with its own VLAN tags: a loop nested in a loop nested in a loop.
+std::string encapsulationParser(int tags, int labels) {
+    std::stringstream source;
+    source << "header eth_t { bit<48> dst; bit<48> src; bit<16> type; }\n"
+              "header vlan_t { bit<16> tci; bit<16> type; }\n"
+              "header mpls_t { bit<20> label; bit<3> tc; bit<1> bos; bit<8> ttl; }\n"
+              "struct headers_t {\n"
+              "    eth_t eth;\n"
+              "    vlan_t[" << tags << "] vlan;\n"
+              "    mpls_t[" << labels << "] mpls;\n"
+              "    eth_t inner;\n"
+              "    vlan_t[" << tags << "] inner_vlan;\n"
+              "}\n";
+    source << R"(parser p(packet_in pkt, out headers_t hdr) {
+    state start {
+        pkt.extract(hdr.eth);
+        transition select(hdr.eth.type) {
+            0x8100: vlan;
+            0x8847: mpls;
+            default: accept;
+        }
+    }
+    state vlan {
+        pkt.extract(hdr.vlan.next);
+        transition select(hdr.vlan.last.type) {
+            0x8100: vlan;
+            0x8847: mpls;
+            default: accept;
+        }
+    }
+    state mpls {
+        pkt.extract(hdr.mpls.next);
+        transition select(hdr.mpls.last.bos) {
+            0: mpls;
+            1: inner;
+        }
+    }
+    state inner {
+        pkt.extract(hdr.inner);
+        transition select(hdr.inner.type) {
+            0x8100: inner_vlan;
+            default: accept;
+        }
+    }
+    state inner_vlan {
+        pkt.extract(hdr.inner_vlan.next);
+        transition select(hdr.inner_vlan.last.type) {
+            0x8100: inner_vlan;
+            0x8847: mpls;
+            default: accept;
+        }
+    }
+}
+)" << parserPackage("headers_t");
+    return P4_SOURCE(P4Headers::CORE, source.str().c_str());
+}
+
+}  // namespace
+
+// Each state of the chain is evaluated once, although there are
+// 2^stages paths through it.
+TEST_F(ParserUnrollTest, shared_states) {
+    auto test = FrontendTestCase::create(diamondParser(24));
+    ASSERT_TRUE(test);
+    UnrollStatistics stats(test->program, 0);
+    EXPECT_EQ(::errorCount(), 0u);
+    EXPECT_LE(stats.evaluated, 3u * 24 + 2);
+    EXPECT_EQ(stats.shared, 24u);
+}
+
+// A clone of a value map shares the values of the map; changing a field
+// copies only the values on the way to it.
+TEST_F(ParserUnrollTest, value_map_sharing) {
+    auto test = FrontendTestCase::create(encapsulationParser(2, 2));
+    ASSERT_TRUE(test);
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    test->program->apply(TypeChecking(&refMap, &typeMap));
+    const IR::P4Parser* parser = nullptr;
+    for (auto object : test->program->objects)
+        if (object->is<IR::P4Parser>())
+            parser = object->to<IR::P4Parser>();
+    ASSERT_TRUE(parser != nullptr);
+    auto param = parser->getApplyParameters()->parameters.at(1);
+    SymbolicValueFactory factory(&typeMap);
+    ValueMap original;
+    original.set(param, factory.create(typeMap.getType(param, true), true));
+
+    auto copy = original.clone();
+    auto hdr = copy->getWritable(param)->to<SymbolicStruct>();
+    hdr->getWritable(nullptr, "inner")->to<SymbolicHeader>()->setValid(true);
+
+    auto before = original.get(param)->to<SymbolicStruct>();
+    EXPECT_NE(before, hdr);
+    EXPECT_FALSE(before->get(nullptr, "inner")->to<SymbolicHeader>()->valid->value);
+    EXPECT_TRUE(hdr->get(nullptr, "inner")->to<SymbolicHeader>()->valid->value);
+    EXPECT_EQ(before->get(nullptr, "eth"), hdr->get(nullptr, "eth"));
+    EXPECT_EQ(before->get(nullptr, "mpls"), hdr->get(nullptr, "mpls"));
+    EXPECT_FALSE(original.equals(copy));
+}
+
+TEST_F(ParserUnrollTest, budget) {
+    auto test = FrontendTestCase::create(encapsulationParser(4, 4));
+    ASSERT_TRUE(test);
+    unsigned warnings = ::diagnosticCount();
+    UnrollStatistics stats(test->program, 10);
+    EXPECT_EQ(stats.evaluated, 10u);
+    EXPECT_EQ(::diagnosticCount(), warnings + 1);
+}
+
+// Parsers with nested loops over header stacks of growing depth.
+TEST_F(ParserUnrollTest, benchmark) {
+    std::vector<std::pair<int, int>> sizes = { { 2, 2 }, { 4, 4 }, { 4, 8 }, { 8, 8 } };
+    for (auto size : sizes) {
+        auto test = FrontendTestCase::create(encapsulationParser(size.first, size.second));
+        ASSERT_TRUE(test);
+        UnrollStatistics stats(test->program, 0);
+        EXPECT_EQ(::errorCount(), 0u);
+        std::cout << size.first << " VLAN tags, " << size.second << " MPLS labels: "
+                  << stats.evaluated << " states evaluated, " << stats.shared
+                  << " shared, " << stats.usec << " usec" << std::endl;
+    }
+    auto test = FrontendTestCase::create(diamondParser(200));
+    ASSERT_TRUE(test);
+    UnrollStatistics stats(test->program, 0);
+    std::cout << "200 joining selects: " << stats.evaluated << " states evaluated, "
+              << stats.shared << " shared, " << stats.usec << " usec" << std::endl;
+}
+
+}  // namespace Test
@@ -0,0 +1,102 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "ir/pass_manager.h"
+#include "ir/pass_profile.h"
+
+namespace Test {
+
+class PassProfileTest : public P4CTest { };
+
+namespace {
+
+struct CountNodes : public Inspector {
+    CountNodes() { setName("CountNodes"); }
+};
+
+struct Increment : public Transform {
+    Increment() { setName("Increment"); }
+    const IR::Node *postorder(IR::Constant *c) override {
+        return new IR::Constant(c->value + 1); }
+};
+
+/// Counts constants down to 0, one step per application
+struct CountDown : public Transform {
+    CountDown() { setName("CountDown"); }
+    const IR::Node *postorder(IR::Constant *c) override {
+        if (c->value > 0) return new IR::Constant(c->value - 1);
+        return c; }
+};
+
+}  // namespace
+
+TEST_F(PassProfileTest, RecordsPasses) {
+    const IR::Expression *expr =
+        new IR::Add(new IR::Constant(1), new IR::Sub(new IR::Constant(2), new IR::Constant(3)));
+
+    PassManager inner({ new Increment });
+    inner.setName("Inner");
+    PassManager outer({ new CountNodes, &inner });
+    outer.setName("Outer");
+
+    PassProfile::enabled = true;
+    expr = expr->apply(outer);
+    PassProfile::enabled = false;
+    EXPECT_EQ(expr->to<IR::Add>()->left->to<IR::Constant>()->value, 2);
+
+    std::stringstream out;
+    PassProfile::write(out);
+    std::string report = out.str();
+    EXPECT_NE(report.find("\"traceEvents\""), std::string::npos);
+    EXPECT_NE(report.find("\"passSummary\""), std::string::npos);
+    EXPECT_NE(report.find("\"Outer/CountNodes\""), std::string::npos);
+    EXPECT_NE(report.find("\"Outer/Inner/Increment\""), std::string::npos);
+    EXPECT_NE(report.find("\"nodes_cloned\""), std::string::npos);
+    // the nested PassManager is only recorded as a pass of its parent
+    EXPECT_EQ(report.find("\"path\" : \"Inner\""), std::string::npos);
+}
+
+TEST_F(PassProfileTest, IncrementalPassRepeated) {
+    auto *program = makeProgram(20);
+    PassRepeated full({ new CountDown });
+    auto *expected = program->apply(full);
+
+    PassRepeated incremental({ new CountDown });
+    incremental.setIncremental();
+    PassManager outer({ &incremental });
+    outer.setName("Outer");
+    PassProfile::enabled = true;
+    auto *result = program->apply(outer);
+    PassProfile::enabled = false;
+
+    EXPECT_TRUE(expected->equiv(*result));
+    for (auto *obj : result->objects)
+        EXPECT_EQ(obj->to<IR::Declaration_Constant>()->initializer->to<IR::Constant>()->value, 0);
+
+    std::stringstream out;
+    PassProfile::write(out);
+    std::string report = out.str();
+    // the 20 objects converge after 1..20 iterations; one more finds nothing changed
+    EXPECT_NE(report.find("\"iterations\" : 20"), std::string::npos);
+    EXPECT_NE(report.find("\"objects_rerun\" : 210"), std::string::npos);
+    EXPECT_NE(report.find("\"objects_skipped\" : 190"), std::string::npos);
+}
+
+}  // namespace Test
@@ -0,0 +1,492 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+
+#include "backends/graphs/injectEncoding.h"
+#include "backends/graphs/parserPaths.h"
+#include "backends/graphs/pathDecoder.h"
+#include "backends/graphs/pathEncoding.h"
+#include "backends/graphs/pathGraph.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/toP4/toP4.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "frontends/p4/typeMap.h"
+
+using namespace P4;
+
+namespace Test {
+
+class PathProfileTest : public P4CTest { };
+
+namespace {
+
+/// A control with 20 paths: 10 through the if statement, times 2 through
+/// the switch statement.
+std::string pathControl() {
+    return P4_SOURCE(P4Headers::CORE, R"(
+        header h_t { bit<8> a; bit<8> b; }
+        struct headers_t { h_t h; }
+        struct meta_t { bit<32> BL; bit<8> x; }
+        control c(inout headers_t hdr, inout meta_t meta) {
+            action set_x(bit<8> v) { meta.x = v; }
+            action drop() { meta.x = 0; }
+            table t {
+                key = { hdr.h.a : exact; }
+                actions = { set_x; drop; NoAction; }
+                default_action = NoAction();
+            }
+            table u {
+                key = { hdr.h.b : exact; }
+                actions = { set_x; drop; }
+            }
+            apply {
+                if (hdr.h.isValid()) {
+                    t.apply();
+                    if (hdr.h.a == 1) {
+                        meta.x = 2;
+                    } else if (hdr.h.a == 2) {
+                        meta.x = 3;
+                    }
+                }
+                switch (u.apply().action_run) {
+                    set_x: { meta.x = meta.x + 1; }
+                }
+            }
+        }
+        control c_t(inout headers_t hdr, inout meta_t meta);
+        package top(c_t c);
+        top(c()) main;
+    )");
+}
+
+/// A control with @ifs sequential if statements calling an action, with a
+/// table applied after the first @before of them.
+std::string sequentialIfs(int ifs, int before, P4Headers headers = P4Headers::CORE) {
+    std::stringstream source;
+    source << "header h_t { bit<8> a; }\n"
+              "struct headers_t { h_t h; }\n"
+              "struct meta_t { bit<32> BL; bit<8> x; }\n"
+              "control c(inout headers_t hdr, inout meta_t meta) {\n"
+              "    action set_x(bit<8> v) { meta.x = v; }\n"
+              "    action inc() { meta.x = meta.x + 1; }\n"
+              "    table t {\n"
+              "        key = { hdr.h.a : exact; }\n"
+              "        actions = { set_x; NoAction; }\n"
+              "    }\n"
+              "    apply {\n";
+    for (int i = 0; i < ifs; ++i) {
+        if (i == before)
+            source << "        t.apply();\n";
+        source << "        if (hdr.h.a == " << i % 256 << ") { inc(); }\n";
+    }
+    source << "    }\n"
+              "}\n"
+              "control c_t(inout headers_t hdr, inout meta_t meta);\n"
+              "package top(c_t c);\n"
+              "top(c()) main;\n";
+    return P4_SOURCE(headers, source.str().c_str());
+}
+
+/// A v1model parser with 11 paths: 7 from start, which loop back to vlan or
+/// go on through ip, and 4 resuming at vlan.
+std::string pathParser() {
+    return P4_SOURCE(P4Headers::V1MODEL, R"(
+        header eth_t { bit<16> type; }
+        header vlan_t { bit<16> type; }
+        header ip_t { bit<8> proto; }
+        struct headers_t { eth_t eth; vlan_t[2] vlan; ip_t ip; }
+        struct meta_t { bit<32> BL; }
+        parser p(packet_in pkt, out headers_t hdr, inout meta_t meta,
+                 inout standard_metadata_t sm) {
+            state start {
+                pkt.extract(hdr.eth);
+                transition select(hdr.eth.type) {
+                    0x8100: vlan;
+                    0x800: ip;
+                    default: accept;
+                }
+            }
+            state vlan {
+                pkt.extract(hdr.vlan.next);
+                transition select(hdr.vlan.last.type) {
+                    0x8100: vlan;
+                    0x800: ip;
+                    default: accept;
+                }
+            }
+            state ip {
+                pkt.extract(hdr.ip);
+                transition select(hdr.ip.proto) {
+                    0: reject;
+                    default: accept;
+                }
+            }
+        }
+        control c(inout headers_t hdr, inout meta_t meta) { apply { } }
+        control mau(inout headers_t hdr, inout meta_t meta,
+                    inout standard_metadata_t sm) { apply { } }
+        control deparse(packet_out pkt, in headers_t hdr) { apply { } }
+        V1Switch(p(), c(), mau(), mau(), c(), deparse()) main;
+    )");
+}
+
+/// The type checked program of a test case.
+struct TypedProgram {
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    const IR::P4Program *program;
+
+    explicit TypedProgram(const IR::P4Program *program)
+        : program(program->apply(TypeChecking(&refMap, &typeMap))) { }
+
+    std::vector<const IR::P4Control *> controls() const {
+        std::vector<const IR::P4Control *> rv;
+        for (auto object : program->objects)
+            if (auto control = object->to<IR::P4Control>())
+                rv.push_back(control);
+        return rv;
+    }
+};
+
+/// Checks that both the values and the increments of the edges along each of
+/// the first @max paths of @graph add up to the id of the path.
+void expectPathIds(const graphs::PathGraph &graph, unsigned max, const std::string &where) {
+    std::vector<unsigned> path;
+    for (mpz_class id = 0; id < graph.numPaths() && id < max; ++id) {
+        ASSERT_TRUE(graph.decode(id, path)) << where;
+        mpz_class value = 0, reg = graph.init;
+        for (auto e : path) {
+            value += graph.edges[e].value;
+            reg += graph.edges[e].increment;
+        }
+        EXPECT_EQ(value, id) << where;
+        EXPECT_EQ(reg, id) << where;
+    }
+    EXPECT_FALSE(graph.decode(graph.numPaths(), path)) << where;
+}
+
+}  // namespace
+
+TEST_F(PathProfileTest, numbering) {
+    auto test = FrontendTestCase::create(pathControl());
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    auto controls = typed.controls();
+    ASSERT_EQ(controls.size(), 1u);
+    graphs::PathGraph graph(controls[0], &typed.refMap, &typed.typeMap);
+    EXPECT_EQ(graph.numPaths(), 20);
+    graph.placeIncrements();
+    expectPathIds(graph, 20, "c");
+
+    auto program = typed.program->apply(graphs::PathEncoding(&typed.refMap, &typed.typeMap));
+    EXPECT_EQ(program->getDeclsByName("c")->single()->to<IR::P4Control>()->body->numPaths, 20);
+}
+
+// With a profile, the edges of the hottest path are all part of the spanning
+// tree: it is taken without executing any increment.
+TEST_F(PathProfileTest, hot_path) {
+    auto test = FrontendTestCase::create(pathControl());
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    graphs::PathGraph graph(typed.controls().at(0), &typed.refMap, &typed.typeMap);
+    std::vector<unsigned> path;
+    for (unsigned hot = 0; hot < 20; ++hot) {
+        graphs::PathCounts profile;
+        for (unsigned id = 0; id < 20; ++id)
+            profile[id] = id == hot ? 1000 : 1;
+        graph.placeIncrements(&profile);
+        expectPathIds(graph, 20, "c");
+        ASSERT_TRUE(graph.decode(hot, path));
+        for (auto e : path)
+            EXPECT_FALSE(graph.edges[e].chord) << "path " << hot;
+    }
+}
+
+TEST_F(PathProfileTest, read_profile) {
+    graphs::PathProfile profile;
+    std::stringstream in("# path id, count\n"
+                         "7 100\n"
+                         "c\n"
+                         "3 10\n"
+                         "\n"
+                         "3 5\n"
+                         "123456789012345678901234567890 2\n");
+    ASSERT_TRUE(profile.read(in));
+    EXPECT_EQ(profile.get("c")->at(3), 15u);
+    EXPECT_EQ(profile.get("c")->at(mpz_class("123456789012345678901234567890")), 2u);
+    EXPECT_EQ(profile.get("d")->at(7), 100u);
+
+    std::stringstream malformed("c\n3 ten\n");
+    EXPECT_FALSE(graphs::PathProfile().read(malformed));
+    EXPECT_EQ(::errorCount(), 1u);
+}
+
+// The instrumented program is a valid P4 program.
+TEST_F(PathProfileTest, instrumented_program) {
+    auto test = FrontendTestCase::create(pathControl());
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    graphs::InjectEncoding inject(&typed.refMap, &typed.typeMap);
+    auto program = typed.program->apply(inject);
+    // One increment per case of the switch statement
+    EXPECT_EQ(inject.structuralIncrements, 7u);
+    EXPECT_LE(inject.placedIncrements, 6u);
+    EXPECT_LE(inject.placedCost, inject.structuralCost);
+
+    std::stringstream instrumented;
+    program->apply(ToP4(&instrumented, false));
+    EXPECT_NE(instrumented.str().find("meta.BL = "), std::string::npos);
+    EXPECT_TRUE(FrontendTestCase::create(instrumented.str()));
+    EXPECT_EQ(::errorCount(), 0u);
+}
+
+TEST_F(PathProfileTest, decode_paths) {
+    auto test = FrontendTestCase::create(pathControl());
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    graphs::PathProfile profile;
+    std::stringstream samples("c\n"
+                              "0 5\n"
+                              "19 10\n"
+                              "20 2\n");
+    ASSERT_TRUE(profile.read(samples));
+    std::stringstream json;
+    graphs::PathDecoder(typed.program, &typed.refMap, &typed.typeMap).write(profile, json);
+    auto decoded = json.str();
+    EXPECT_NE(decoded.find("\"paths\" : 20"), std::string::npos);
+    EXPECT_NE(decoded.find("\"samples\" : 17"), std::string::npos);
+    EXPECT_NE(decoded.find("\"invalid_samples\" : 2"), std::string::npos);
+    // The hottest path comes first
+    EXPECT_LT(decoded.find("\"id\" : 19"), decoded.find("\"id\" : 0"));
+    EXPECT_NE(decoded.find("\"if\" : "), std::string::npos);
+    EXPECT_NE(decoded.find("\"action\" : "), std::string::npos);
+    EXPECT_NE(decoded.find("\"case\" : \"default\""), std::string::npos);
+    EXPECT_EQ(::diagnosticCount(), 1u);
+}
+
+// Reads and decodes millions of samples of the paths of a control.
+TEST_F(PathProfileTest, decode_benchmark) {
+    auto test = FrontendTestCase::create(pathControl());
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    const unsigned samples = 4000000;
+    std::string dump = "c\n";
+    for (unsigned i = 0; i < samples; ++i)
+        dump += std::to_string(i * 7 % 20) + " 1\n";
+
+    graphs::PathProfile profile;
+    double readUsec = time_usec([&]() { EXPECT_TRUE(profile.read(dump.data(), dump.size())); });
+    EXPECT_EQ(profile.get("c")->size(), 20u);
+    std::stringstream json;
+    double decodeUsec = time_usec([&]() {
+        graphs::PathDecoder(typed.program, &typed.refMap, &typed.typeMap).write(profile, json);
+    });
+    std::cout << samples << " samples: read in " << readUsec << " usec ("
+              << samples / readUsec << " million samples per second), decoded in "
+              << decodeUsec << " usec" << std::endl;
+}
+
+// The if statement, with 10 paths, has more paths than the bound: its ids are
+// hashed.  The switch statement is numbered in a region of its own.
+TEST_F(PathProfileTest, regions) {
+    auto test = FrontendTestCase::create(pathControl());
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    graphs::ControlPaths paths(typed.controls().at(0), &typed.refMap, &typed.typeMap, 4);
+    ASSERT_EQ(paths.regions.size(), 2u);
+    EXPECT_TRUE(paths.regions[0].hashed);
+    EXPECT_EQ(paths.regions[0].size, 4);
+    EXPECT_FALSE(paths.regions[1].hashed);
+    EXPECT_EQ(paths.regions[1].offset, 4);
+    EXPECT_EQ(paths.size(), 6);
+    EXPECT_EQ(paths.numPaths(), 20);
+    mpz_class id;
+    EXPECT_EQ(paths.find(5, id), &paths.regions[1]);
+    EXPECT_EQ(id, 1);
+    EXPECT_EQ(paths.find(6, id), nullptr);
+    for (auto &region : paths.regions) {
+        region.graph.placeIncrements();
+        expectPathIds(region.graph, 20, "c");
+    }
+
+    // Without a bound, the control is a single region
+    graphs::ControlPaths whole(typed.controls().at(0), &typed.refMap, &typed.typeMap, 0);
+    EXPECT_EQ(whole.regions.size(), 1u);
+    EXPECT_EQ(whole.size(), 20);
+}
+
+// Each region of a v1model control counts its path ids in a counter.
+TEST_F(PathProfileTest, path_counters) {
+    auto test = FrontendTestCase::create(sequentialIfs(10, 4, P4Headers::V1MODEL));
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    // 64 paths through the first four ifs, the table and an if; 32 through the others
+    auto program = typed.program->apply(graphs::InjectEncoding(&typed.refMap, &typed.typeMap,
+                                                               nullptr, 64));
+    std::stringstream instrumented;
+    program->apply(ToP4(&instrumented, false));
+    auto source = instrumented.str();
+    EXPECT_NE(source.find("counter(96, CounterType.packets) path_counter;"), std::string::npos);
+    auto first = source.find("path_counter.count(");
+    ASSERT_NE(first, std::string::npos);
+    EXPECT_NE(source.find("path_counter.count(64 + ", first + 1), std::string::npos);
+    EXPECT_TRUE(FrontendTestCase::create(source));
+    EXPECT_EQ(::errorCount(), 0u);
+
+    graphs::PathProfile profile;
+    std::stringstream samples("70 3\n");
+    ASSERT_TRUE(profile.read(samples));
+    std::stringstream json;
+    graphs::PathDecoder(typed.program, &typed.refMap, &typed.typeMap, 64).write(profile, json);
+    auto decoded = json.str();
+    EXPECT_NE(decoded.find("\"first_index\" : 64"), std::string::npos);
+    EXPECT_NE(decoded.find("\"index\" : 70,\n"), std::string::npos);
+    EXPECT_NE(decoded.find("\"id\" : 6,\n"), std::string::npos);
+}
+
+// The back edge of the vlan loop is cut: paths end when they take it, and
+// resume at vlan.
+TEST_F(PathProfileTest, parser_paths) {
+    auto test = FrontendTestCase::create(pathParser());
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    auto parser = typed.program->getDeclsByName("p")->single()->to<IR::P4Parser>();
+    ASSERT_NE(parser, nullptr);
+    graphs::ParserPaths paths(parser);
+    EXPECT_EQ(paths.graph.numPaths(), 11);
+    EXPECT_EQ(paths.transitions.size(), paths.graph.edges.size());
+    paths.graph.placeIncrements();
+    expectPathIds(paths.graph, 11, "p");
+
+    auto program = typed.program->apply(graphs::InjectEncoding(&typed.refMap, &typed.typeMap));
+    std::stringstream instrumented;
+    program->apply(ToP4(&instrumented, false));
+    auto source = instrumented.str();
+    EXPECT_NE(source.find("counter(11, CounterType.packets) path_counter;"), std::string::npos);
+    EXPECT_NE(source.find("state path_accept {"), std::string::npos);
+    EXPECT_NE(source.find("state path_reject {"), std::string::npos);
+    EXPECT_NE(source.find("state path_loop {"), std::string::npos);
+    EXPECT_NE(source.find("path_counter.count((bit<32>)meta.BL);"), std::string::npos);
+    EXPECT_TRUE(FrontendTestCase::create(source));
+    EXPECT_EQ(::errorCount(), 0u);
+
+    // Path 9 resumes at vlan and goes through ip to accept
+    graphs::PathProfile profile;
+    std::stringstream samples("p\n"
+                              "0 1\n"
+                              "9 4\n");
+    ASSERT_TRUE(profile.read(samples));
+    std::stringstream json;
+    graphs::PathDecoder(typed.program, &typed.refMap, &typed.typeMap).write(profile, json);
+    auto decoded = json.str();
+    EXPECT_NE(decoded.find("\"parsers\" : ["), std::string::npos);
+    EXPECT_NE(decoded.find("\"paths\" : 11"), std::string::npos);
+    EXPECT_NE(decoded.find("\"samples\" : 5"), std::string::npos);
+    auto resume = decoded.find("\"resume\" : \"vlan\"");
+    auto loop = decoded.find("\"loop\" : true");
+    ASSERT_NE(resume, std::string::npos);
+    ASSERT_NE(loop, std::string::npos);
+    EXPECT_LT(resume, loop);
+    EXPECT_NE(decoded.find("\"to\" : \"ip\"", resume), std::string::npos);
+}
+
+// The scaling of a table is the number of paths through the statements
+// following it.
+TEST_F(PathProfileTest, sequential_scaling) {
+    auto test = FrontendTestCase::create(sequentialIfs(10, 4));
+    ASSERT_TRUE(test);
+    TypedProgram typed(test->program);
+    auto program = typed.program->apply(graphs::PathEncoding(&typed.refMap, &typed.typeMap));
+    auto control = program->getDeclsByName("c")->single()->to<IR::P4Control>();
+    EXPECT_EQ(control->body->numPaths, 2 * 1024);
+    EXPECT_EQ(graphs::actionMap.at("t_0/t").second, 64);
+
+    graphs::PathGraph graph(typed.controls().at(0), &typed.refMap, &typed.typeMap);
+    EXPECT_EQ(graph.numPaths(), 2 * 1024);
+}
+
+// Numbers the paths of controls made of thousands of sequential if statements.
+TEST_F(PathProfileTest, benchmark) {
+    for (int ifs : { 1000, 2000 }) {
+        auto test = FrontendTestCase::create(sequentialIfs(ifs, ifs / 2));
+        ASSERT_TRUE(test);
+        TypedProgram typed(test->program);
+        graphs::PathEncoding encoding(&typed.refMap, &typed.typeMap);
+        double encodingUsec = time_usec([&]() { typed.program->apply(encoding); });
+        graphs::InjectEncoding inject(&typed.refMap, &typed.typeMap);
+        double injectUsec = time_usec([&]() { typed.program->apply(inject); });
+        EXPECT_EQ(inject.placedIncrements, unsigned(ifs + 1));
+        std::cout << ifs << " sequential ifs: path encoding " << encodingUsec
+                  << " usec, injecting the encoding " << injectUsec << " usec" << std::endl;
+    }
+}
+
+// Reports how many increments instrumenting the largest BMv2 programs of the
+// testdata corpus takes, numbering each arm and placing them on chords.
+TEST_F(PathProfileTest, testdata) {
+    auto samples = readSamples("testdata/p4_16_samples", 10000);
+    samples.erase(std::remove_if(samples.begin(), samples.end(),
+                                 [](const std::pair<std::string, std::string>& sample) {
+        auto &name = sample.first;
+        return name.size() < 8 || name.compare(name.size() - 8, 8, "-bmv2.p4") != 0; }),
+        samples.end());
+    std::sort(samples.begin(), samples.end(), [](const std::pair<std::string, std::string>& a,
+                                                 const std::pair<std::string, std::string>& b) {
+        return a.second.size() > b.second.size(); });
+    if (samples.size() > 40)
+        samples.resize(40);
+
+    unsigned structural = 0, placed = 0;
+    double structuralCost = 0, placedCost = 0;
+    for (auto &sample : samples) {
+        AutoCompileContext context(new GTestContext(GTestContext::get()));
+        auto test = FrontendTestCase::create(sample.second);
+        if (!test) continue;
+        TypedProgram typed(test->program);
+        for (auto control : typed.controls()) {
+            graphs::PathGraph graph(control, &typed.refMap, &typed.typeMap);
+            graph.placeIncrements();
+            expectPathIds(graph, 4096, sample.first + ": " + control->name);
+        }
+        for (auto object : typed.program->objects) {
+            if (auto parser = object->to<IR::P4Parser>()) {
+                graphs::ParserPaths paths(parser);
+                paths.graph.placeIncrements();
+                expectPathIds(paths.graph, 4096, sample.first + ": " + parser->name);
+            }
+        }
+        graphs::InjectEncoding inject(&typed.refMap, &typed.typeMap);
+        typed.program->apply(inject);
+        EXPECT_LE(inject.placedIncrements, inject.structuralIncrements) << sample.first;
+        std::cout << sample.first << ": " << inject.structuralIncrements << " increments ("
+                  << inject.structuralCost << " per packet) before, " << inject.placedIncrements
+                  << " (" << inject.placedCost << " per packet) after" << std::endl;
+        structural += inject.structuralIncrements;
+        placed += inject.placedIncrements;
+        structuralCost += inject.structuralCost;
+        placedCost += inject.placedCost;
+    }
+    std::cout << samples.size() << " programs: " << structural << " increments ("
+              << structuralCost << " per packet) before, " << placed << " (" << placedCost
+              << " per packet) after" << std::endl;
+}
+
+}  // namespace Test
@@ -0,0 +1,195 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "frontends/common/preprocessor.h"
+#include "lib/error.h"
+
+namespace Test {
+
+class PreprocessorTest : public P4CTest { };
+
+namespace {
+
+void writeFile(const char *name, const std::string &contents) {
+    std::ofstream out(name);
+    out << contents;
+}
+
+std::string preprocess(const P4::Preprocessor &cpp, const char *file) {
+    std::string output;
+    EXPECT_TRUE(cpp.preprocess(file, output));
+    return output;
+}
+
+/// Is the system preprocessor the GCC 12 (or later) cpp whose output the
+/// built-in one reproduces?
+bool haveSystemPreprocessor() {
+#ifdef __clang__
+    return false;
+#else
+    static int major = -1;
+    if (major < 0) {
+        major = 0;
+        if (FILE *version = popen("cpp -dumpversion 2>/dev/null", "r")) {
+            if (fscanf(version, "%d", &major) != 1) major = 0;
+            pclose(version); } }
+    return major >= 12;
+#endif
+}
+
+std::string systemPreprocess(const std::string &options, const char *file) {
+    std::string cmd = "cpp -C -undef -nostdinc -x assembler-with-cpp " + options + " " + file;
+    FILE *in = popen(cmd.c_str(), "r");
+    if (!in) return "";
+    std::string output;
+    char buffer[4096];
+    while (size_t n = fread(buffer, 1, sizeof(buffer), in)) output.append(buffer, n);
+    return pclose(in) == 0 ? output : "";
+}
+
+}  // namespace
+
+TEST_F(PreprocessorTest, macros) {
+    writeFile("pp_test.p4",
+        "#define F(a, ...) f(a, ## __VA_ARGS__)\n"
+        "F(1) F(1,) F(1, 2 , 3)\n"
+        "#define H(x, y) x ## y\n"
+        "H(a,b) H(,b) H(+,=) H(/,/)\n"
+        "#define STR(x) #x\n"
+        "#define XSTR(x) STR(x)\n"
+        "STR( \"a\\n\"  'b' ) XSTR(__LINE__)\n"
+        "#define f(x) x f\n"
+        "f(1)(2) f /* c */ (3)\n"
+        "#if defined(H) && (1 << 4) == 0x10\n"
+        "yes  /* comment */ // comment\n"
+        "#else\n"
+        "no\n"
+        "#endif\n");
+    P4::Preprocessor cpp;
+    EXPECT_EQ(preprocess(cpp, "pp_test.p4"),
+        "# 0 \"pp_test.p4\"\n"
+        "# 0 \"<built-in>\"\n"
+        "# 0 \"<command-line>\"\n"
+        "# 1 \"pp_test.p4\"\n"
+        "\n"
+        "f(1) f(1,) f(1, 2 , 3)\n"
+        "\n"
+        "ab b += / /\n"
+        "\n"
+        "\n"
+        "\"\\\"a\\\\n\\\" 'b'\" \"7\"\n"
+        "\n"
+        "1 f(2) f /* c */ (3)\n"
+        "\n"
+        "yes /* comment */ // comment\n");
+    std::remove("pp_test.p4");
+}
+
+TEST_F(PreprocessorTest, options) {
+    writeFile("pp_test.p4", "#ifdef B\nA B\n#endif\n");
+    P4::Preprocessor cpp;
+    EXPECT_TRUE(cpp.addOptions(" -DA=x -DB -UB -DB=(1+1)"));
+    EXPECT_FALSE(P4::Preprocessor().addOptions(" -include foo.h"));
+    EXPECT_EQ(preprocess(cpp, "pp_test.p4"),
+        "# 0 \"pp_test.p4\"\n"
+        "# 0 \"<built-in>\"\n"
+        "# 0 \"<command-line>\"\n"
+        "# 1 \"pp_test.p4\"\n"
+        "\n"
+        "x (1+1)\n");
+    std::remove("pp_test.p4");
+}
+
+TEST_F(PreprocessorTest, include) {
+    mkdir("pp_inc", 0755);
+    writeFile("pp_inc/guard.h", "#ifndef GUARD_H\n#define GUARD_H\nguarded VALUE\n#endif\n");
+    writeFile("pp_test.p4", "#define VALUE 1\n#include \"guard.h\"\n#include <guard.h>\nend\n");
+    P4::Preprocessor cpp;
+    cpp.addIncludePath("pp_inc", true);
+    std::string expected =
+        "# 0 \"pp_test.p4\"\n"
+        "# 0 \"<built-in>\"\n"
+        "# 0 \"<command-line>\"\n"
+        "# 1 \"pp_test.p4\"\n"
+        "\n"
+        "# 1 \"pp_inc/guard.h\" 1\n"
+        "\n"
+        "\n"
+        "guarded 1\n"
+        "# 3 \"pp_test.p4\" 2\n"
+        "\n"
+        "end\n";
+    EXPECT_EQ(preprocess(cpp, "pp_test.p4"), expected);
+    // the second time the header comes from the cache
+    EXPECT_EQ(preprocess(cpp, "pp_test.p4"), expected);
+
+    // but not once it has changed
+    writeFile("pp_inc/guard.h",
+              "#ifndef GUARD_H\n#define GUARD_H\nchanged again VALUE\n#endif\n");
+    std::string changed = preprocess(cpp, "pp_test.p4");
+    EXPECT_NE(changed.find("changed again 1"), std::string::npos);
+
+    std::string output;
+    writeFile("pp_test.p4", "#include \"missing.h\"\n");
+    unsigned errors = ::errorCount();
+    EXPECT_FALSE(cpp.preprocess("pp_test.p4", output));
+    EXPECT_GT(::errorCount(), errors);
+
+    P4::Preprocessor::clearCache();
+    std::remove("pp_inc/guard.h");
+    rmdir("pp_inc");
+    std::remove("pp_test.p4");
+}
+
+// The output is the same as the system preprocessor's for the standard headers.
+TEST_F(PreprocessorTest, matches_cpp) {
+    if (!haveSystemPreprocessor()) {
+        std::cout << "no GCC 12 cpp; skipping comparison" << std::endl;
+        return; }
+    P4::Preprocessor cpp;
+    cpp.addIncludePath("p4include", true);
+    for (auto *file : { "p4include/core.p4", "p4include/v1model.p4", "p4include/psa.p4" }) {
+        EXPECT_EQ(preprocess(cpp, file), systemPreprocess("-Ip4include", file)) << file;
+    }
+}
+
+// Compares the time to preprocess a small program including v1model.p4 by
+// running cpp and in process, with the standard headers cached.
+TEST_F(PreprocessorTest, benchmark) {
+    writeFile("pp_test.p4", "#include <v1model.p4>\ncontrol c() { apply {} }\n");
+    const int runs = 20;
+    P4::Preprocessor cpp;
+    cpp.addIncludePath("p4include", true);
+    std::string output;
+    double builtin_usec = time_usec([&]() {
+        for (int i = 0; i < runs; ++i) cpp.preprocess("pp_test.p4", output); });
+    EXPECT_NE(output.find("control c()"), std::string::npos);
+    if (!haveSystemPreprocessor()) {
+        std::remove("pp_test.p4");
+        return; }
+    double cpp_usec = time_usec([&]() {
+        for (int i = 0; i < runs; ++i) systemPreprocess("-Ip4include", "pp_test.p4"); });
+    std::cout << "cpp " << cpp_usec / runs << " usec, built-in " << builtin_usec / runs
+              << " usec per program (" << cpp_usec / builtin_usec << "x)" << std::endl;
+    std::remove("pp_test.p4");
+}
+
+}  // namespace Test
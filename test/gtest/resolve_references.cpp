@@ -0,0 +1,119 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "helpers.h"
+
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+
+using namespace P4;
+
+namespace Test {
+
+class ResolveReferencesTest : public P4CTest { };
+
+namespace {
+
+/// Maps the name of each path in a program to the kind of node it resolves to.
+class PathTargets : public Inspector {
+    const ReferenceMap* refMap;
+ public:
+    std::vector<std::string> targets;
+    explicit PathTargets(const ReferenceMap* refMap) : refMap(refMap) {}
+    void add(const IR::Path* path) {
+        auto decl = refMap->getDeclaration(path);
+        std::stringstream target;
+        target << path->name.name << "->";
+        if (decl == nullptr) {
+            target << "?";
+        } else {
+            target << decl->getNode()->node_type_name();
+            if (auto method = decl->to<IR::Method>())
+                target << method->getParameters()->size();
+        }
+        targets.push_back(target.str());
+    }
+    void postorder(const IR::PathExpression* path) override { add(path->path); }
+    void postorder(const IR::Type_Name* type) override { add(type->path); }
+};
+
+}  // namespace
+
+TEST_F(ResolveReferencesTest, lookup) {
+    auto program = P4::parseP4String(P4_SOURCE(R"(
+        extern void f(in bit<8> a);
+        extern void f(in bit<8> a, in bit<8> b);
+        struct S { bit<8> x; }
+        const bit<8> S2 = 1;
+        control c(inout S s) {
+            apply {
+                f(s.x);
+                f(s.x, S2);
+            }
+        }
+    )"), CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+    ReferenceMap refMap;
+    program->apply(ResolveReferences(&refMap));
+    ASSERT_EQ(::errorCount(), 0u);
+
+    PathTargets targets(&refMap);
+    program->apply(targets);
+    std::vector<std::string> expected = {
+        "S->Type_Struct", "f->Method1", "s->Parameter", "f->Method2", "s->Parameter",
+        "S2->Declaration_Constant" };
+    EXPECT_EQ(targets.targets, expected);
+}
+
+TEST_F(ResolveReferencesTest, undeclared) {
+    auto program = P4::parseP4String(P4_SOURCE(R"(
+        const bit<8> a = b;
+        const bit<8> b = 1;
+    )"), CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+    ReferenceMap refMap;
+    program->apply(ResolveReferences(&refMap));
+    EXPECT_EQ(::errorCount(), 1u);
+}
+
+// Resolving references in a program four times as large should take about
+// four times as long.
+TEST_F(ResolveReferencesTest, benchmark) {
+    double usec[2];
+    int sizes[2] = { 500, 2000 };
+    for (int i = 0; i < 2; ++i) {
+        std::stringstream source;
+        source << "struct S { bit<8> x; }\n";
+        for (int a = 0; a < sizes[i]; ++a)
+            source << "action a" << a << "(inout S s) { s.x = s.x + " << a << "; }\n";
+        auto program = P4::parseP4String(P4_SOURCE(P4Headers::V1MODEL, source.str().c_str()),
+                                         CompilerOptions::FrontendVersion::P4_16);
+        ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+        ReferenceMap refMap;
+        usec[i] = time_usec([&]() {
+            refMap.clear();
+            program->apply(ResolveReferences(&refMap)); });
+        ASSERT_EQ(::errorCount(), 0u);
+    }
+    std::cout << sizes[0] << " actions " << usec[0] << " usec, "
+              << sizes[1] << " actions " << usec[1] << " usec" << std::endl;
+}
+
+}  // namespace Test
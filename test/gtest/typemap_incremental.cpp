@@ -0,0 +1,226 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "helpers.h"
+
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "frontends/p4/typeMap.h"
+
+using namespace P4;
+
+namespace Test {
+
+class TypeMapIncremental : public P4CTest { };
+
+namespace {
+
+/// A v1model program with @actions top-level actions, called ten at a time
+/// by @actions / 10 controls.  The constants have widths, so that type
+/// inference does not have to rewrite the actions.
+std::string largeProgram(int actions) {
+    std::stringstream source;
+    source << "header h_t { bit<8> a; bit<16> b; }\n"
+              "struct headers_t { h_t h; }\n"
+              "struct meta_t { bit<16> x; bit<8> y; }\n";
+    for (int i = 0; i < actions; ++i)
+        source << "action a" << i << "(inout headers_t hdr, inout meta_t meta) {\n"
+                  "    meta.x = hdr.h.b + 16w" << i << ";\n"
+                  "    meta.y = meta.y |+| hdr.h.a;\n"
+                  "}\n";
+    for (int c = 0; c < actions / 10; ++c) {
+        source << "control c" << c << "(inout headers_t hdr, inout meta_t meta,\n"
+                  "        inout standard_metadata_t sm) {\n"
+                  "    table t {\n"
+                  "        key = { hdr.h.a : exact; }\n"
+                  "        actions = { NoAction; }\n"
+                  "    }\n"
+                  "    apply {\n"
+                  "        t.apply();\n";
+        for (int i = c * 10; i < c * 10 + 10; ++i)
+            source << "        a" << i << "(hdr, meta);\n";
+        source << "        if (!hdr.h.isValid()) { mark_to_drop(sm); }\n"
+                  "    }\n"
+                  "}\n";
+    }
+    return P4_SOURCE(P4Headers::V1MODEL, source.str().c_str());
+}
+
+/// Replaces the constant in the action named @name.
+class ChangeAction : public Transform {
+    cstring name;
+ public:
+    explicit ChangeAction(cstring name) : name(name) {}
+    const IR::Node* preorder(IR::P4Action* action) override {
+        if (action->name != name)
+            prune();
+        return action;
+    }
+    const IR::Node* postorder(IR::Constant* constant) override {
+        if (!findContext<IR::P4Action>())
+            return constant;
+        return new IR::Constant(constant->srcInfo, constant->type, constant->value + 1);
+    }
+};
+
+/// Type-checks @program, starting with inference that may insert casts.
+const IR::P4Program* typeCheck(const IR::P4Program* program,
+                               ReferenceMap* refMap, TypeMap* typeMap) {
+    PassManager passes = {
+        new ClearTypeMap(typeMap),
+        new ResolveReferences(refMap),
+        new TypeInference(refMap, typeMap, false),
+        new TypeChecking(refMap, typeMap)
+    };
+    return program->apply(passes);
+}
+
+class CollectNodes : public Inspector {
+ public:
+    std::vector<const IR::Node*> nodes;
+    CollectNodes() { visitDagOnce = false; }
+    bool preorder(const IR::Node* node) override { nodes.push_back(node); return true; }
+};
+
+/// Both maps have the same types for all the nodes in @program.
+void expectSameTypes(const IR::P4Program* program, TypeMap& left, TypeMap& right) {
+    CollectNodes collect;
+    program->apply(collect);
+    for (auto node : collect.nodes) {
+        auto type = left.getType(node);
+        EXPECT_TRUE(TypeMap::equivalent(type, right.getType(node))) << node;
+        if (auto expression = node->to<IR::Expression>()) {
+            EXPECT_EQ(left.isLeftValue(expression), right.isLeftValue(expression)) << node;
+            EXPECT_EQ(left.isCompileTimeConstant(expression),
+                      right.isCompileTimeConstant(expression)) << node;
+        }
+    }
+}
+
+const IR::Node* findObject(const IR::P4Program* program, cstring name) {
+    for (auto object : program->objects) {
+        if (auto decl = object->to<IR::IDeclaration>())
+            if (decl->getName() == name)
+                return object;
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+// Only the changed action and the control calling it are type-checked again,
+// and the result is the same as type-checking the whole program.
+TEST_F(TypeMapIncremental, changed_declarations) {
+    auto program = P4::parseP4String(largeProgram(40), CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    program = typeCheck(program, &refMap, &typeMap);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+
+    program = program->apply(ChangeAction("a15"));
+    ClearTypeMap clear(&typeMap);
+    program->apply(clear);
+    EXPECT_FALSE(typeMap.isCurrent(findObject(program, "a15")));
+    EXPECT_FALSE(typeMap.isCurrent(findObject(program, "c1")));
+    EXPECT_TRUE(typeMap.isCurrent(findObject(program, "a14")));
+    EXPECT_TRUE(typeMap.isCurrent(findObject(program, "c0")));
+    EXPECT_TRUE(typeMap.isCurrent(findObject(program, "h_t")));
+    EXPECT_TRUE(typeMap.isCurrent(findObject(program, "mark_to_drop")));
+
+    program = typeCheck(program, &refMap, &typeMap);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+    EXPECT_TRUE(typeMap.isCurrent(findObject(program, "a15")));
+    EXPECT_TRUE(typeMap.isCurrent(findObject(program, "c1")));
+
+    ReferenceMap fullRefMap;
+    TypeMap full;
+    PassManager check = { new TypeChecking(&fullRefMap, &full) };
+    program->apply(check);
+    ASSERT_EQ(::errorCount(), 0u);
+    expectSameTypes(program, typeMap, full);
+    expectSameTypes(program, full, typeMap);
+}
+
+// A change to a type invalidates everything that uses it.
+TEST_F(TypeMapIncremental, changed_type) {
+    auto program = P4::parseP4String(largeProgram(20), CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    program = typeCheck(program, &refMap, &typeMap);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+
+    struct AddField : public Transform {
+        const IR::Node* preorder(IR::Type_Struct* type) override {
+            if (type->name == "meta_t")
+                type->fields.push_back(new IR::StructField("z", IR::Type_Bits::get(4)));
+            return type;
+        }
+    };
+    program = program->apply(AddField());
+    ClearTypeMap clear(&typeMap);
+    program->apply(clear);
+    EXPECT_FALSE(typeMap.isCurrent(findObject(program, "a3")));
+    EXPECT_FALSE(typeMap.isCurrent(findObject(program, "c1")));
+    EXPECT_TRUE(typeMap.isCurrent(findObject(program, "h_t")));
+
+    program = typeCheck(program, &refMap, &typeMap);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+    ReferenceMap fullRefMap;
+    TypeMap full;
+    PassManager check = { new TypeChecking(&fullRefMap, &full) };
+    program->apply(check);
+    expectSameTypes(program, typeMap, full);
+}
+
+// Compares re-inferring the types of a large program after changing one
+// action with inferring them from scratch.
+TEST_F(TypeMapIncremental, benchmark) {
+    auto program = P4::parseP4String(largeProgram(1000), CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    program = typeCheck(program, &refMap, &typeMap);
+    ASSERT_TRUE(program != nullptr && ::errorCount() == 0);
+
+    const int runs = 10;
+    double incremental_usec = 0, full_usec = 0;
+    for (int i = 0; i < runs; ++i) {
+        program = program->apply(ChangeAction("a" + Util::toString(i * 97)));
+        PassManager resolve = { new ResolveReferences(&refMap) };
+        program = program->apply(resolve);
+        PassManager incremental = {
+            new ClearTypeMap(&typeMap),
+            new TypeInference(&refMap, &typeMap, true)
+        };
+        incremental_usec += time_usec([&]() { program->apply(incremental); });
+
+        TypeMap fresh;
+        PassManager full = { new TypeInference(&refMap, &fresh, true) };
+        full_usec += time_usec([&]() { program->apply(full); });
+    }
+    ASSERT_EQ(::errorCount(), 0u);
+    std::cout << "full " << full_usec / runs << " usec, incremental " << incremental_usec / runs
+              << " usec per change (" << full_usec / incremental_usec << "x)" << std::endl;
+}
+
+}  // namespace Test